@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Span.h"
+
+using namespace std;
+
+constexpr size_t AES_LANES = 8;   // streams advanced together, the depth of the AES-NI pipeline
+
+/* one independent CBC stream of a multi-buffer encryption: its own 16 byte key and chaining block,
+left at the last cipher block like AESWrapper::encryptChunk leaves its chain */
+struct AESLane
+{
+	const uint8_t* key;
+	uint8_t* chain;
+	ConstByteSpan plain;
+	ByteSpan cipher;   // may be plain itself, with room for the padding of a last chunk
+	bool last;         // the end of the message, padded like AESWrapper
+	size_t written;    // cipher bytes, set by encrypt
+};
+
+/* multi-buffer AES-128 CBC encryption. a CBC stream cannot be parallelised - every block waits for the one before
+it - so one stream keeps a single AES round in flight and leaves the rest of the AES-NI pipeline idle. the kernel
+runs the rounds of up to AES_LANES independent streams interleaved, each stream still gets the exact CBC cipher text
+(PKCS#7 padded) that AESWrapper produces and the server decrypts. without AES-NI the lanes are encrypted one after
+the other through AESWrapper */
+class AESLanes
+{
+public:
+	static bool accelerated();   // the CPU has AES-NI
+	static void encrypt(AESLane* lanes, size_t count);   // count is at most AES_LANES
+private:
+	static void encryptInterleaved(AESLane* lanes, size_t count);
+};
@@ -1,24 +1,37 @@
-#pragma once
-
-#include <string>
-
-
-class AESWrapper
-{
-public:
-	static const unsigned int DEFAULT_KEYLENGTH = 16;
-private:
-	unsigned char _key[DEFAULT_KEYLENGTH];
-	AESWrapper(const AESWrapper& aes);
-public:
-	static unsigned char* GenerateKey(unsigned char* buffer, unsigned int length);
-
-	AESWrapper();
-	AESWrapper(const unsigned char* key, unsigned int size);
-	~AESWrapper();
-
-	const unsigned char* getKey() const;
-
-	std::string encrypt(const char* plain, unsigned int length);
-	std::string decrypt(const char* cipher, unsigned int length);
-};
+#pragma once
+
+#include <string>
+#include "Span.h"
+
+
+class AESWrapper
+{
+public:
+	static const unsigned int DEFAULT_KEYLENGTH = 16;
+private:
+	unsigned char _key[DEFAULT_KEYLENGTH];
+	unsigned char _chain[DEFAULT_KEYLENGTH];  // last cipher block of a chunked encryption
+	AESWrapper(const AESWrapper& aes);
+	friend class AESLanes;   // the lanes fall back to encryptBlocks without AES-NI
+	size_t encryptBlocks(unsigned char* chain, ConstByteSpan plain, ByteSpan cipher, bool last) const;
+	size_t decryptBlocks(unsigned char* chain, ConstByteSpan cipher, ByteSpan plain, bool last) const;
+public:
+	static unsigned char* GenerateKey(unsigned char* buffer, unsigned int length);
+
+	AESWrapper();
+	AESWrapper(const unsigned char* key, unsigned int size);
+	~AESWrapper();
+
+	const unsigned char* getKey() const;
+
+	std::string encrypt(const char* plain, unsigned int length);
+	size_t encrypt(ConstByteSpan plain, ByteSpan cipher) const;  // the whole message into cipher, which has room for cipherSize() bytes
+	static unsigned int cipherSize(unsigned int length);
+	void resetChain();
+	unsigned int encryptChunk(const char* plain, unsigned int length, unsigned char* cipher, bool last);
+	size_t encryptChunk(ConstByteSpan plain, ByteSpan cipher, bool last);  // cipher may be plain itself
+	std::string decrypt(const char* cipher, unsigned int length);
+	size_t decrypt(ConstByteSpan cipher, ByteSpan plain) const;
+	unsigned int decryptChunk(const unsigned char* cipher, unsigned int length, char* plain, bool last);
+	size_t decryptChunk(ConstByteSpan cipher, ByteSpan plain, bool last);  // plain may be cipher itself
+};
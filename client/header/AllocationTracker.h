@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/* opt-in allocation tracking - build with TRACK_ALLOCATIONS defined (msbuild /p:TrackAllocations=true) and every
+operator new and delete of the client is counted. without it nothing is replaced and the scopes do nothing */
+class AllocationTracker
+{
+public:
+	static bool enabled();
+	static uint64_t allocations();      // allocations made by the calling thread
+	static uint64_t allocatedBytes();   // bytes allocated by the calling thread
+	static uint64_t liveBytes();        // bytes allocated and not freed yet by all threads
+	static uint64_t processAllocations(); // allocations made by all threads, the pipeline stages included
+	static uint64_t processBytes();     // bytes allocated by all threads
+	static bool limitExceeded();        // some scope went over its limit, the run should fail
+	static void reportExceeded();
+};
+
+/* counts the allocations the calling thread makes during one phase of the client. a phase that goes over
+its limit is reported and fails the run, so a hot path that starts copying whole files is caught by the
+tracking build instead of by memory graphs. a zero limit only reports the phase totals */
+class AllocationScope
+{
+public:
+	AllocationScope(const char* phase, uint64_t maxAllocations = 0, uint64_t maxBytes = 0);
+	~AllocationScope();
+	uint64_t allocations() const;
+	uint64_t bytes() const;
+	static void allow(uint64_t allocations, uint64_t bytes);  // raise the limits of the open scopes of the thread by an expected cost
+private:
+	AllocationScope(const AllocationScope& scope);
+	AllocationScope& operator=(const AllocationScope& scope);
+	const char* _phase;
+	uint64_t _maxAllocations;
+	uint64_t _maxBytes;
+	uint64_t _startAllocations;
+	uint64_t _startBytes;
+	AllocationScope* _outer;
+};
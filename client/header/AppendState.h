@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <map>
+#include "Span.h"
+
+using namespace std;
+
+class RandomAccessFile;
+
+constexpr size_t APPEND_TAIL_SIZE = 4096;  // last bytes of the uploaded content that are read again to see the file only grew
+
+/* what was uploaded of a growing file: its length, the CKsum of that content and the one of its last bytes */
+struct AppendEntry
+{
+	uint64_t length;
+	uint32_t crc;
+	uint32_t tailCRC;
+	int64_t modified;   // last write time of the file as it was before it was read for the upload
+};
+
+/* upload state of append only files (logs, WAL segments), kept by file name between runs. the next upload of
+a file that only grew sends the new bytes and continues the CKsum of the whole file from the stored one */
+class AppendState
+{
+public:
+	AppendState();
+	~AppendState();
+	bool load(const string& path);        // a missing file is an empty state
+	bool save(const string& path) const;  // written to a temporary file first, so a crash keeps the old state
+	bool find(const string& name, AppendEntry& entry) const;
+	void update(const string& name, const AppendEntry& entry);
+	void forget(const string& name);
+	static bool tailCRC(RandomAccessFile& file, uint64_t length, uint32_t& crc);  // CKsum of the APPEND_TAIL_SIZE bytes before length
+	static bool prefixCRC(RandomAccessFile& file, uint64_t length, ByteSpan buffer, uint32_t& crc);  // CKsum of the first length bytes
+private:
+	map<string, AppendEntry> _entries;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+class MemoryBudget;
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/* pool of fixed size, cache line aligned buffers. blocks are allocated once (optionally on large pages),
+charged to the memory budget and then leased and returned, so the transfer loop does not allocate */
+class BufferPool
+{
+public:
+	BufferPool(size_t blockSize, size_t maxBlocks, MemoryBudget* budget = nullptr, bool largePages = false);
+	~BufferPool();
+	size_t blockSize() const;
+
+	/* a leased block, returned to the pool when the lease is destroyed */
+	class Lease
+	{
+	public:
+		Lease();
+		Lease(BufferPool* pool, uint8_t* block);
+		Lease(Lease&& other) noexcept;
+		Lease& operator=(Lease&& other) noexcept;
+		~Lease();
+		uint8_t* data() const;
+		size_t size() const;
+		bool valid() const;
+		void reset();
+	private:
+		Lease(const Lease& lease);
+		Lease& operator=(const Lease& lease);
+		BufferPool* _pool;
+		uint8_t* _block;
+	};
+
+	Lease lease();      // waits for a returned block when the pool or the budget is exhausted
+	Lease tryLease();   // invalid lease instead of waiting
+private:
+	BufferPool(const BufferPool& pool);
+	BufferPool& operator=(const BufferPool& pool);
+	bool grow(bool wait);
+	void giveBack(uint8_t* block);
+	static uint8_t* allocateSlab(size_t size, bool largePages, bool& onLargePages);
+	static void freeSlab(uint8_t* slab, size_t size, bool onLargePages);
+
+	struct Slab
+	{
+		uint8_t* memory;
+		size_t size;
+		bool onLargePages;
+	};
+
+	size_t _blockSize;
+	size_t _maxBlocks;
+	size_t _totalBlocks;
+	MemoryBudget* _budget;
+	bool _largePages;
+	vector<Slab> _slabs;
+	vector<uint8_t*> _free;
+	mutex _lock;
+	condition_variable _returned;
+};
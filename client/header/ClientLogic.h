@@ -1,60 +1,197 @@
-#pragma once
-#include <boost/asio.hpp>
-#include "protocol.h"
-#include "SocketHandler.h"
-#include "FileHandler.h"
-#include "Utils.h"
-
-constexpr auto CLIENT_INFO = "../Debug/me.info"; // Should be located near exe file.
-constexpr auto TRANSFER_INFO = "../Debug/transfer.info"; // Should be located near exe file.
-
-using namespace std;
-using boost::asio::ip::tcp;
-
-class FileHandler;
-class SocketHandler;
-class RSAPrivateWrapper;
-
-class ClientLogic
-{
-public:
-	ClientLogic();
-	~ClientLogic();
-	void clientStop(const string& error);
-	ServerResponse* unpackResponse(vector<uint8_t> responseBuffer, const uint32_t size);
-	bool parseAndStoreTransferInfo(const string& path);
-	string extractAESKey(uint8_t* payload, uint32_t len);
-	uint32_t caulcalateCRC(string fileContent);
-	string encryptFileUsingAESKey(string fileContent);
-	void clientMain();
-	bool parseAndStoreClientInfo();
-	void createRegisterationRequest(vector<uint8_t>& requestBuffer, bool reconnect = false);  //reconnect initialize to false - if client want to reconnect then we pass true as the senocd argument
-	void createPublicKeyRequest(vector<uint8_t>& requestBuffer);
-	bool createFileStorageRequest(vector<std::uint8_t>& requestBuffer);
-	bool createCRCFailedRequest(vector<uint8_t>& requestBuffer);
-	bool createCRCValidateRequest(vector<uint8_t>& requestBuffer, bool validate = true);  // validate true indicate the the crc check was succeeded
-	void handleRetryCRCRequest(vector<uint8_t>& requestBuffer);
-	void handleFailedCRCRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer);
-	void handleReconnectRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer);
-	void handleSendFileAndCRCRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer);
-	void handleCRCIsOkREQUEST(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer);
-	void handlePublicKeyRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer);
-	uint8_t* handleRegisterationRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer); // returning the client ID
-	uint32_t handleFileStorageRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer);  // returning the culcaulate CKsum
-private:
-	string _userName;
-	string _filePath;
-	string address;
-	string port;
-	string _publicKey;
-	string _base64privateKey;
-	string _AESKey;
-	string uid;
-	string _encryptedContent;
-	FileHandler* _fileHandler;
-	SocketHandler* _socket;
-	RSAPrivateWrapper* _RSAPair;
-	string _clientUID;
-	bool _succseed;
-	uint32_t _clientCRC;
+#pragma once
+#include <boost/asio.hpp>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include "protocol.h"
+#include "SocketHandler.h"
+#include "FileHandler.h"
+#include "Utils.h"
+#include "ClientOptions.h"
+#include "MemoryBudget.h"
+#include "BufferPool.h"
+#include "UploadQueue.h"
+#include "DirectoryScanner.h"
+#include "AllocationTracker.h"
+#include "Logger.h"
+#include "PipelineExecutor.h"
+#include "UploadScheduler.h"
+#include "FileSnapshot.h"
+#include "AppendState.h"
+#include "Replicator.h"
+#include "ShardRing.h"
+#include "TransferTuner.h"
+#include "FingerprintFilter.h"
+
+constexpr auto CLIENT_INFO = "../Debug/me.info"; // Should be located near exe file.
+constexpr auto TRANSFER_INFO = "../Debug/transfer.info"; // Should be located near exe file.
+constexpr auto APPEND_INFO = "../Debug/append.info";  // --append state of the files uploaded so far
+constexpr auto REPLICA_INFO = "../Debug/replicas.info";  // uid of the client on every --replica server
+constexpr auto SHARD_INFO = "../Debug/shards.info";  // uid of the client on every --shard node
+constexpr auto TUNING_INFO = "../Debug/tuning.info";  // --tune settings learned for every server
+constexpr auto FINGERPRINT_INFO = "../Debug/fingerprints.bloom";  // --dedup filter of the fingerprints the server stores
+constexpr size_t UPLOAD_QUEUE_SIZE = 1024;  // files found by the scan and not sent yet
+constexpr size_t SCHEDULE_QUEUE_SIZE = 64 * 1024;  // batch an ordered queue looks at before the first file is sent
+constexpr uint64_t PIPELINE_MIN_SIZE = 4 * CHUNK_SIZE;  // smaller files are streamed on the calling thread
+constexpr uint64_t FILE_UPLOAD_MAX_ALLOCATIONS = 256;  // allocation limits of one file upload or range fetch in a tracking build,
+constexpr uint64_t FILE_UPLOAD_MAX_BYTES = CHUNK_SIZE;  // they do not depend on the file size - the content is never copied
+constexpr uint32_t STRIPE_PROBE_RANGES = 4;  // ranges per stream stored between two throughput samples of --stripes=auto
+constexpr double STRIPE_MIN_GAIN = 0.1;      // a stream is added only while the last one raised the throughput by this much
+
+using namespace std;
+using boost::asio::ip::tcp;
+
+class FileHandler;
+class SocketHandler;
+class RSAPrivateWrapper;
+class MemoryBudget;
+class RandomAccessFile;
+struct FileExtent;
+struct BlockMatch;
+
+/* a file the server keeps for this client */
+struct BackedUpFile
+{
+	string name;
+	uint64_t size;
+	uint32_t crc;
+};
+
+/* state the streams of one striped upload share */
+struct StripeProgress
+{
+	atomic<uint32_t> nextRange;
+	atomic<bool> failed;
+	vector<uint32_t> rangeCRCs;  // CKsum of every plain range, combined into the one of the file
+	uint32_t stored;             // ranges the server stored, guarded by lock
+	uint64_t storedBytes;
+	vector<std::chrono::steady_clock::time_point> streamEnds;  // when every stream found no range left
+	uint32_t lanes;              // ranges a stream takes and encrypts together at most
+	mutex lock;
+	condition_variable rangeStored;
+	StripeProgress(uint32_t ranges, uint32_t lanes) : nextRange(0), failed(false), rangeCRCs(ranges), stored(0), storedBytes(0), lanes(lanes) {}
+};
+
+/* CKsum of the head of the file to send, computed while the handshake is in flight */
+struct PreparedFile
+{
+	string path;
+	FileStamp stamp;       // the file as it was read, the CKsum is dropped if it changed since
+	uint64_t bytes;        // the CKsum covers this many bytes from the start, whole chunks or the whole file
+	uint32_t remainder;    // interim CKsum the stream continues from
+	bool active;           // the file being streamed is the prepared one
+};
+
+class ClientLogic
+{
+	friend class AllocationTest;   // test/AllocationTest.cpp streams files through the upload path without a server
+public:
+	ClientLogic(const ClientOptions& options = ClientOptions());
+	~ClientLogic();
+	void clientStop(const string& error);
+	bool unpackResponse(const uint8_t* responseBuffer, const uint32_t size, ServerResponse& response);
+	void setClientUID(const string& hexUID);
+	void packClientID(ClientRequestHeader& header) const;
+	bool parseAndStoreTransferInfo(const string& path);
+	string extractAESKey(uint8_t* payload, uint32_t len);
+	bool streamFileContent(uint32_t contentSize);  // read, checksum, encrypt and send the file chunk by chunk
+	bool streamSparseContent(RandomAccessFile& file, const vector<FileExtent>& extents, uint32_t contentSize);
+	bool sparseExtents(RandomAccessFile& file, vector<FileExtent>& extents, uint64_t& dataSize);
+	bool sendSparseFile(BufferPool::Lease& requestBuffer);
+	bool streamAppendedContent(RandomAccessFile& file, uint64_t offset, uint32_t storedCRC, uint32_t contentSize);
+	bool sendAppendedFile(BufferPool::Lease& requestBuffer);
+	bool unchangedSinceAppend(const UploadJob& job, const FileStamp& stamp);
+	void recordAppendState(const FileStamp& stamp);
+	void replicateStored(const UploadJob& job);
+	void startShards();
+	size_t placeFile(const UploadJob& job);
+	bool collectShards(bool wait, vector<UploadJob>& orphans, uint64_t& sent, uint64_t& failed);
+	void restoreSharded();
+	void tuneTransfer(uint64_t bytes, bool stripable, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed);
+	void syncFingerprints(BufferPool::Lease& requestBuffer);
+	bool fingerprintFile(const UploadJob& job, uint8_t* fingerprint, uint32_t& crc);
+	bool storedByFingerprint(const UploadJob& job, const uint8_t* fingerprint, uint32_t crc, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	bool requestSignatures(BufferPool::Lease& page, uint32_t startIndex, ServerResponse& response);
+	bool streamDeltaContent(RandomAccessFile& file, const vector<BlockMatch>& matches, uint32_t blockSize, uint32_t contentSize);
+	bool sendDeltaFile(BufferPool::Lease& requestBuffer);
+	void sendRanges(RandomAccessFile& file, BufferPool& rangePool, StripeProgress& progress);
+	uint32_t tuneStripes(RandomAccessFile& file, BufferPool& rangePool, StripeProgress& progress, vector<thread>& workers, uint32_t maxStreams);
+	bool sendStripedFile(BufferPool::Lease& requestBuffer);
+	bool clientMain();   // true when every file was stored
+	void clientRestore();
+	void clientLoad();
+	void clientLogin(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	void prepareFile(const string& path);
+	void resumePrepared(const string& path);
+	bool readResponse(SocketHandler& socket, uint8_t* buffer, size_t capacity, ServerResponse& response);
+	bool listBackedUpFiles(vector<BackedUpFile>& files);
+	void createFetchRangeRequest(uint8_t* requestBuffer, const string& fileName, uint64_t offset, uint32_t length);
+	void fetchRanges(const BackedUpFile& file, RandomAccessFile& output, BufferPool& rangePool,
+		atomic<uint32_t>& nextRange, vector<uint32_t>& rangeCRCs, atomic<bool>& failed);
+	bool restoreFile(const BackedUpFile& file, const string& directory);
+	bool parseAndStoreClientInfo();
+	void createRegisterationRequest(BufferPool::Lease& requestBuffer, bool reconnect = false);  //reconnect initialize to false - if client want to reconnect then we pass true as the senocd argument
+	void createPublicKeyRequest(BufferPool::Lease& requestBuffer);
+	bool createFileStorageRequest(BufferPool::Lease& requestBuffer);
+	bool createCRCFailedRequest(BufferPool::Lease& requestBuffer);
+	bool createCRCValidateRequest(BufferPool::Lease& requestBuffer, bool validate = true);  // validate true indicate the the crc check was succeeded
+	void handleRetryCRCRequest(BufferPool::Lease& requestBuffer);
+	void handleFailedCRCRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	void handleReconnectRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	bool handleSendFileAndCRCRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);  // true when the server CKsum matched
+	bool uploadFile(const UploadJob& job, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	bool streamPackedContent(const vector<UploadJob>& pack, uint32_t contentSize, vector<bool>& readable);
+	bool handlePackedFilesRequest(const vector<UploadJob>& pack, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, vector<bool>& stored);
+	bool sendPipelinedFile(const UploadJob& job, uint32_t sequence, BufferPool::Lease& requestBuffer);
+	void readFileStored(BufferPool::Lease& responseBuffer, uint64_t& sent);
+	void uploadWindowed(const UploadJob& job, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed);
+	void drainWindow(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed);
+	void uploadPack(vector<UploadJob>& pack, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed);
+	void handleCRCIsOkREQUEST(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	void handlePublicKeyRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);
+	uint8_t* handleRegisterationRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer); // returning the client ID
+	uint32_t handleFileStorageRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer);  // returning the culcaulate CKsum
+private:
+	ClientOptions _options;
+	string _userName;
+	string _filePath;
+	string address;
+	string port;
+	string _publicKey;
+	string _base64privateKey;
+	string _AESKey;
+	string _rawClientUID;
+	string _fileName;
+	uint64_t _fileSize;
+	FileHandler* _fileHandler;
+	SocketHandler* _socket;
+	RSAPrivateWrapper* _RSAPair;
+	MemoryBudget* _budget;
+	BufferPool* _packetPool;
+	BufferPool* _chunkPool;
+	string _clientUID;
+	bool _succseed;
+	uint32_t _clientCRC;
+	map<uint32_t, UploadJob> _inFlight;  // pipelined uploads by sequence, waiting for their FILE_STORED
+	vector<UploadJob> _retry;            // pipelined uploads the server did not store
+	uint32_t _nextSequence;
+	UploadScheduler _scheduler;
+	FileSnapshot _snapshot;              // --snapshot view of the file being sent
+	PreparedFile _prepared;
+	atomic<bool> _loggedIn;              // the handshake thread is done, file preparation stops
+	AppendState _appendState;            // --append length and CKsum of every file uploaded so far
+	bool _appended;                      // the last file storage request sent only the appended bytes
+	Replicator* _replicator;             // --replica sessions, null without replicas
+	uint64_t _replicated;                // the file being uploaded as the replicator knows it
+	ShardRing* _ring;                    // --shard nodes and the server of transfer.info as node 0, null without shards
+	Replicator* _shards;                 // sessions of the nodes after node 0
+	vector<uint64_t> _placed;            // files placed on every node
+	map<uint64_t, UploadJob> _sharded;   // files offered to the other nodes by their id, until a node stored them
+	TransferTuner* _tuner;               // --tune, null without it
+	FingerprintFilter _fingerprints;     // --dedup filter, a file it does not contain is new to the server
+	uint64_t _lookups;                   // fingerprint lookups sent
+	uint64_t _deduplicated;              // files the server stored from their fingerprint
+	uint64_t _deduplicatedBytes;
 };
\ No newline at end of file
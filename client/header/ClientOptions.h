@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <vector>
+#include "DirectoryScanner.h"
+#include "UploadScheduler.h"
+#include "LoadGenerator.h"
+#include "TransferTuner.h"
+
+using namespace std;
+
+constexpr size_t DEFAULT_MAX_MEMORY = 64 * 1024 * 1024;
+constexpr unsigned int DEFAULT_STREAMS = 4;
+constexpr unsigned int MAX_COUNT = 1024;
+constexpr unsigned int MAX_WINDOW = 16;  // unread acknowledgements must fit in the socket buffers while the client is still sending
+constexpr auto RESTORE_ALL = "*";
+constexpr auto DEFAULT_RESTORE_DIRECTORY = "restored";
+constexpr size_t DEFAULT_PACK_THRESHOLD = 64 * 1024;
+constexpr unsigned int MAX_STRIPES = 16;
+
+/* client command line options, every option has a default so the client still runs without arguments */
+struct ClientOptions
+{
+	size_t maxMemory;   // --max-memory=256M
+	bool largePages;    // --large-pages, back the transfer buffers with large pages when the system allows it
+	bool restore;       // --restore[=NAME], download all or one of the backed up files instead of sending one
+	string restoreFile;
+	string restoreDirectory;   // --restore-dir=DIR
+	unsigned int streams;      // --streams=N, parallel connections used for one file
+	ScanOptions scan;          // --include=PATTERN --exclude=PATTERN --one-file-system --follow-symlinks --scan-threads=N
+	unsigned int window;       // --window=N, file uploads sent before their acknowledgement is read, 1 waits for every file
+	size_t packThreshold;      // --pack[=SIZE], files up to this size are sent together in packed containers, 0 sends every file on its own
+	bool delta;                // --delta, a file the server already keeps is sent as its changes against the stored copy
+	unsigned int stripes;      // --stripes=N|auto, connections one large file is striped over, 1 sends it on the session connection
+	bool autoStripes;          // add stripes while the measured throughput still grows
+	size_t socketBuffer;       // --socket-buffer=SIZE, kernel send and receive buffers of the connections, 0 keeps the system default
+	bool tune;                 // --tune, climb the window, stripes and socket buffer on the measured throughput and keep them per server
+	ScheduleOptions schedule;  // --schedule=POLICY --priority=PATTERN --deadline=SECONDS:PATTERN
+	bool snapshot;             // --snapshot, read a copy on write clone of each file, or check it did not change while read
+	bool append;               // --append, a file that only grew since its last upload is sent as the appended bytes
+	bool dedup;                // --dedup, a file whose content the server already stores for this client is recorded instead of sent
+	vector<string> replicas;   // --replica=HOST:PORT, more servers every file is also backed up to
+	vector<string> shards;     // --shard=HOST:PORT, more servers the files are spread over with the one of transfer.info
+	string trace;              // --trace=FILE, write a Chrome trace timeline of the run to FILE
+	LoadOptions load;          // --load=N --load-concurrency=N --load-rate=PER_SECOND --load-reconnect=RATIO --load-sizes=SHAPE --load-server=HOST:PORT --load-seed=N
+	ClientOptions();
+	bool parse(int argc, char* argv[], string& error);
+	static bool parseCount(const string& value, unsigned int& count);
+	static bool parseNumber(const string& value, double& number);
+};
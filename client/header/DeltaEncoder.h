@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <bitset>
+#include "protocol.h"
+
+using namespace std;
+
+class RandomAccessFile;
+
+/* weak and strong checksum of one block of the stored copy of a file */
+struct BlockSignature
+{
+	uint32_t weak;
+	uint8_t strong[STRONG_HASH_SIZE];
+	uint32_t index;
+};
+
+/* count consecutive stored blocks, starting at index, that are found at offset of the new file */
+struct BlockMatch
+{
+	uint64_t offset;
+	uint32_t index;
+	uint32_t count;
+};
+
+/* rsync style matching of a file against the block signatures of its stored copy. a rolling weak checksum
+is moved over the file one byte at a time, only a weak hit is confirmed with the strong hash - the blocks
+found are sent as copies and only the bytes between them go over the wire */
+class DeltaEncoder
+{
+public:
+	DeltaEncoder(uint32_t blockSize);
+	~DeltaEncoder();
+	uint32_t blockSize() const;
+	void reserve(size_t blocks);
+	void addSignature(uint32_t weak, const uint8_t* strong);  // in block order
+	bool scan(RandomAccessFile& file, uint64_t fileSize, uint8_t* window, size_t windowSize, vector<BlockMatch>& matches, uint32_t& crc);
+	static uint64_t deltaSize(const vector<BlockMatch>& matches, uint32_t blockSize, uint64_t fileSize);
+	static void weakSums(const uint8_t* data, size_t length, uint32_t& a, uint32_t& b);
+	static void strongHash(const uint8_t* data, size_t length, uint8_t* hash);
+private:
+	DeltaEncoder(const DeltaEncoder& encoder);
+	DeltaEncoder& operator=(const DeltaEncoder& encoder);
+	bool find(uint32_t weak, const uint8_t* block, uint32_t preferred, uint32_t& index);
+	static uint32_t tag(uint32_t weak);
+
+	uint32_t _blockSize;
+	vector<BlockSignature> _signatures;  // sorted by weak checksum once the scan starts
+	bool _sorted;
+	bitset<65536> _tags;  // weak checksums that exist, most positions are rejected without the search
+};
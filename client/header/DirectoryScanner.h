@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <filesystem>
+#include "UploadQueue.h"
+
+using namespace std;
+
+/* what the directory scan picks up */
+struct ScanOptions
+{
+	vector<string> includes;   // glob patterns on the relative path, empty means everything
+	vector<string> excludes;   // matching files are skipped and matching directories are not entered
+	bool oneFileSystem;        // do not cross into other volumes / mounted file systems
+	bool followSymlinks;       // descend into linked directories and send linked files
+	unsigned int threads;
+	ScanOptions() : oneFileSystem(false), followSymlinks(false), threads(4) {}
+};
+
+/* parallel directory tree walker. every thread owns a deque of directories, works from its back
+and steals from the front of the others when it runs dry. files are pushed to the upload queue
+as they are found, so uploads start while the scan is still running */
+class DirectoryScanner
+{
+public:
+	DirectoryScanner(const ScanOptions& options, UploadQueue& queue);
+	~DirectoryScanner();
+	void start(const string& root);   // returns at once, the queue is closed when the scan ends
+	void wait();
+	uint64_t filesFound() const;
+	uint64_t errors() const;
+	static bool matchPattern(const string& pattern, const string& path);
+	static bool matchesPath(const string& pattern, const string& relative);  // a pattern without '/' matches the file name
+private:
+	DirectoryScanner(const DirectoryScanner& scanner);
+	DirectoryScanner& operator=(const DirectoryScanner& scanner);
+
+	struct WorkDeque
+	{
+		mutex lock;
+		deque<filesystem::path> directories;
+	};
+
+	void worker(unsigned int id);
+	void pushDirectory(unsigned int id, const filesystem::path& directory);
+	bool takeDirectory(unsigned int id, filesystem::path& directory);
+	void scanDirectory(unsigned int id, const filesystem::path& directory);
+	bool matches(const vector<string>& patterns, const string& relative) const;
+	bool sameFileSystem(const filesystem::path& path) const;
+	bool firstVisit(const filesystem::path& directory);
+	static string fileSystemOf(const filesystem::path& path);
+
+	ScanOptions _options;
+	UploadQueue& _queue;
+	filesystem::path _root;
+	string _rootFileSystem;
+	vector<unique_ptr<WorkDeque>> _deques;
+	vector<thread> _workers;
+	atomic<size_t> _pending;    // directories queued or being scanned
+	mutex _workLock;
+	condition_variable _workChanged;   // a directory was queued or the last one was scanned
+	uint64_t _pushes;           // directories queued so far, an idle thread waits for it to move
+	atomic<unsigned int> _running;
+	atomic<uint64_t> _filesFound;
+	atomic<uint64_t> _errors;
+	mutex _visitedLock;
+	set<filesystem::path> _visited;  // real paths of followed directories, breaks symlink loops
+};
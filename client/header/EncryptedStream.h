@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "BufferPool.h"
+#include "AESWrapper.h"
+
+using namespace std;
+
+class SocketHandler;
+
+/* encrypts a stream of plain bytes that arrive in pieces of any size and sends it on the way. the bytes are
+collected in one pooled chunk that is encrypted in place and sent when full, finish() pads and sends the rest */
+class EncryptedStream
+{
+public:
+	EncryptedStream(BufferPool& pool, const string& key, SocketHandler& socket);
+	~EncryptedStream();
+	bool valid() const;   // false when no chunk could be leased
+	bool put(const uint8_t* data, size_t length);
+	uint8_t* space(size_t& length);   // room left in the chunk to read into directly, at most length bytes
+	bool commit(size_t length);       // length bytes were written into space()
+	bool finish();
+	uint32_t sent() const;
+private:
+	EncryptedStream(const EncryptedStream& stream);
+	EncryptedStream& operator=(const EncryptedStream& stream);
+	bool flush(bool last);
+
+	BufferPool::Lease _chunk;
+	AESWrapper _aes;
+	SocketHandler& _socket;
+	size_t _filled;
+	uint32_t _sent;
+};
@@ -1,22 +1,28 @@
-#pragma once
-#include <fstream>
-#include <string>
-
-using namespace std;
-
-class FileHandler
-{
-public:
-    FileHandler();
-    bool openFile(const string& filepath, bool read = true);
-    void closeFile();
-    void readLine(string& line);
-    void writeLine(const string& line);
-    bool checkFileExsistance(string info);
-    std::string extractFileContent(string& path);
-    std::string extractBase64privateKey(const string& path);
-    void writeAtOnce(const string& line);
-    ~FileHandler();
-private:
-    std::fstream* ioFile;
-};
+#pragma once
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include "Span.h"
+
+using namespace std;
+
+class FileHandler
+{
+public:
+    FileHandler();
+    bool openFile(const string& filepath, bool read = true);
+    void closeFile();
+    void readLine(string& line);
+    void writeLine(const string& line);
+    bool checkFileExsistance(string info);
+    std::string extractFileContent(string& path);
+    size_t extractFileContent(const string& path, ByteSpan content);
+    static uint64_t fileSize(const string& path);
+    size_t readChunk(char* buffer, size_t length);
+    size_t readChunk(ByteSpan buffer);
+    std::string extractBase64privateKey(const string& path);
+    void writeAtOnce(const string& line);
+    ~FileHandler();
+private:
+    std::fstream* ioFile;
+};
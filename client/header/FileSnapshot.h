@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+constexpr auto SNAPSHOT_SUFFIX = ".backup-snapshot";  // clones are made next to their file, the scan skips them
+
+/* size and last write time of a file - a file written while it was read has another stamp afterwards */
+struct FileStamp
+{
+	uint64_t size;
+	int64_t modified;
+	bool operator==(const FileStamp& other) const { return size == other.size && modified == other.modified; }
+	bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+/* point in time view of a file that may still be written while it is backed up. on file systems with
+copy on write cloning (btrfs and XFS FICLONE, ReFS block cloning) the file is reflinked next to itself and the
+clone is read - no data is copied and writers are not blocked. elsewhere the file is read in place and its
+stamp is compared before and after, a file that changed in between is sent again */
+class FileSnapshot
+{
+public:
+	FileSnapshot();
+	~FileSnapshot();
+	bool take(const string& path, bool clone = true);   // false when the file cannot be stamped
+	const string& path() const;   // what to read, the clone or the file itself
+	bool cloned() const;
+	bool unchanged();             // the content read since take() or the last unchanged() is consistent
+	void release();
+	static bool stamp(const string& path, FileStamp& stamp);
+	static bool reflink(const string& source, const string& target);
+private:
+	FileSnapshot(const FileSnapshot& snapshot);
+	FileSnapshot& operator=(const FileSnapshot& snapshot);
+	string _source;
+	string _path;
+	bool _cloned;
+	FileStamp _stamp;
+};
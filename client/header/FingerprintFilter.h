@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "protocol.h"
+
+using namespace std;
+
+constexpr auto FINGERPRINT_FILTER_MAGIC = "FPBLOOM1";
+constexpr size_t FINGERPRINT_FILTER_HEADER = 16;   // magic, bits and hash count
+constexpr size_t FINGERPRINT_FILTER_BYTES = FINGERPRINT_FILTER_BITS / 8;
+
+/* Bloom filter of the content fingerprints the server stores, kept in a memory mapped file between runs. a file
+whose fingerprint is not in the filter is surely new and is sent without asking the server; only a possible hit
+costs a lookup round trip. the server keeps a filter of the same shape and sends it in pages, the bits are OR-ed
+into the local one, and the fingerprints of the files this client uploads are added as they are sent. bits are
+never cleared, a stale bit only costs a lookup */
+class FingerprintFilter
+{
+public:
+	FingerprintFilter();
+	~FingerprintFilter();
+	bool open(const string& path);   // a missing file or one of another shape starts empty
+	void close();
+	bool isOpen() const;
+	bool mayContain(const uint8_t* fingerprint) const;
+	void add(const uint8_t* fingerprint);
+	bool merge(uint64_t offset, const uint8_t* bits, size_t length);   // OR a page of the server filter in
+	bool flush();
+private:
+	FingerprintFilter(const FingerprintFilter& filter);
+	FingerprintFilter& operator=(const FingerprintFilter& filter);
+	static void positions(const uint8_t* fingerprint, uint64_t* bits);
+
+	uint8_t* _view;   // header, then the bits
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#else
+	int _fd;
+#endif
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include "Span.h"
+
+using namespace std;
+
+class SocketHandler;
+class AESWrapper;
+class RSAPrivateWrapper;
+
+constexpr uint16_t LOAD_CONNECT_CODE = 0;   // connection setup is reported next to the request codes
+constexpr size_t LOAD_KEY_POOL_SIZE = 16;   // RSA keys the virtual clients share, generating one per client would load the generator itself
+
+enum FileSizeShape
+{
+	SIZE_FIXED = 0,       // fixed:SIZE
+	SIZE_UNIFORM = 1,     // uniform:MIN-MAX
+	SIZE_LOGNORMAL = 2    // lognormal:MEDIAN,SIGMA - many small files and a long tail of large ones
+};
+
+/* sizes of the files the virtual clients send */
+struct FileSizeDistribution
+{
+	FileSizeShape shape;
+	uint64_t first;   // the size, the minimum or the median
+	uint64_t second;  // the maximum
+	double sigma;
+	FileSizeDistribution() : shape(SIZE_FIXED), first(64 * 1024), second(0), sigma(0) {}
+	static bool parse(const string& value, FileSizeDistribution& sizes);
+	uint64_t draw(mt19937_64& random) const;
+};
+
+/* virtual clients of a load run against a server */
+struct LoadOptions
+{
+	unsigned int clients;          // --load=N sessions to run, 0 runs the backup
+	unsigned int concurrency;      // --load-concurrency=N sessions connected at the same time
+	double arrivalRate;            // --load-rate=PER_SECOND Poisson arrivals, 0 starts a session whenever one ends
+	double reconnectRatio;         // --load-reconnect=RATIO sessions that log in again as a client registered before
+	FileSizeDistribution sizes;    // --load-sizes=fixed:SIZE|uniform:MIN-MAX|lognormal:MEDIAN,SIGMA
+	string server;                 // --load-server=HOST:PORT, the server of transfer.info by default
+	uint64_t seed;                 // --load-seed=N
+	LoadOptions() : clients(0), concurrency(64), arrivalRate(0), reconnectRatio(0), seed(1) {}
+};
+
+/* simulates many clients against one server to find where its latency collapses. every session connects,
+registers (name, then public key) or reconnects, sends one file and confirms its CKsum, each on a connection
+of its own. sessions arrive open loop at the given rate and queue for one of the concurrency workers - their
+latency counts from the arrival, so a server that falls behind shows up as growing latency and not as a
+lower arrival rate. the report has the throughput and the latency percentiles of every request code */
+class LoadGenerator
+{
+public:
+	LoadGenerator(const LoadOptions& options, const string& address, const string& port);
+	~LoadGenerator();
+	bool run();      // false if no session could be run at all
+	void report();
+private:
+	LoadGenerator(const LoadGenerator& generator);
+	LoadGenerator& operator=(const LoadGenerator& generator);
+
+	/* a client the server knows, sessions may log in again as it */
+	struct Identity
+	{
+		string name;
+		string uid;       // raw bytes
+		size_t key;       // index in the key pool
+	};
+
+	/* latencies of one request code in microseconds */
+	struct CodeStats
+	{
+		vector<uint32_t> latencies;
+		uint64_t errors;
+		CodeStats() : errors(0) {}
+	};
+
+	/* per worker state, nothing of it is shared */
+	struct Worker
+	{
+		mt19937_64 random;
+		vector<uint8_t> chunk;   // one transfer chunk and its padding, encrypted in place
+		map<uint16_t, CodeStats> stats;
+		vector<uint32_t> sessions;   // ms from arrival to the end of every session
+		uint64_t failed;
+		uint64_t bytes;
+		Worker() : failed(0), bytes(0) {}
+	};
+
+	void work(Worker& worker);
+	bool session(Worker& worker);
+	bool exchange(Worker& worker, SocketHandler& socket, uint16_t code, ConstByteSpan payload, uint16_t expected, uint8_t* response);
+	bool login(Worker& worker, SocketHandler& socket, Identity& identity, string& aesKey);
+	bool sendFile(Worker& worker, SocketHandler& socket, const Identity& identity, const string& aesKey);
+	bool decryptKey(size_t key, const uint8_t* response, string& aesKey);
+	void packHeader(uint8_t* buffer, const string& uid, uint16_t code, uint32_t payloadSize) const;
+	static void percentiles(vector<uint32_t>& values, uint32_t& p50, uint32_t& p90, uint32_t& p99, uint32_t& max);
+
+	LoadOptions _options;
+	string _address;
+	string _port;
+	string _namePrefix;
+	vector<RSAPrivateWrapper*> _keys;
+	vector<string> _publicKeys;
+	vector<mutex*> _keyLocks;
+	vector<uint8_t> _content;   // the bytes every file is made of, repeated
+	vector<Worker*> _workers;
+
+	mutex _lock;
+	condition_variable _arrived;
+	deque<chrono::steady_clock::time_point> _arrivals;
+	bool _closed;
+	uint64_t _nextName;
+	vector<Identity> _registered;
+
+	chrono::steady_clock::time_point _start;
+	chrono::steady_clock::time_point _end;
+};
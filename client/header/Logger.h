@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+enum LogLevel
+{
+	LOG_LEVEL_DEBUG = 0,
+	LOG_LEVEL_INFO = 1,
+	LOG_LEVEL_WARN = 2,
+	LOG_LEVEL_ERROR = 3
+};
+
+/* records below this level are compiled out together with the evaluation of their arguments */
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+/* LOG_INFO("file.sent", "name=%s bytes=%llu", ...) - an event name and printf style key=value fields */
+#define CLIENT_LOG(level, event, ...) \
+	do { if (level >= LOG_COMPILE_LEVEL) Logger::instance().log(level, event, __VA_ARGS__); } while (0)
+#define LOG_DEBUG(event, ...) CLIENT_LOG(LOG_LEVEL_DEBUG, event, __VA_ARGS__)
+#define LOG_INFO(event, ...) CLIENT_LOG(LOG_LEVEL_INFO, event, __VA_ARGS__)
+#define LOG_WARN(event, ...) CLIENT_LOG(LOG_LEVEL_WARN, event, __VA_ARGS__)
+#define LOG_ERROR(event, ...) CLIENT_LOG(LOG_LEVEL_ERROR, event, __VA_ARGS__)
+
+constexpr size_t LOG_RING_SIZE = 1024;    // records, a power of two
+constexpr size_t LOG_RECORD_SIZE = 256;   // longer records are cut
+
+/* asynchronous logger. a record is formatted by the calling thread into a slot of a lock free ring and written
+and flushed by a background thread, so the transfer loop never waits for the console. when the ring is full
+the record is dropped and counted instead of blocking the caller */
+class Logger
+{
+public:
+	static Logger& instance();
+	~Logger();
+	void log(LogLevel level, const char* event, const char* format, ...);
+	void flush();   // wait until every record logged so far was written
+	uint64_t dropped() const;
+private:
+	Logger();
+	Logger(const Logger& logger);
+	Logger& operator=(const Logger& logger);
+	void run();
+	bool writeNext();
+
+	struct Slot
+	{
+		atomic<size_t> sequence;   // the ring position the slot is free for, or that position + 1 once it is written
+		size_t length;
+		char text[LOG_RECORD_SIZE];
+	};
+
+	Slot* _slots;
+	atomic<size_t> _enqueue;
+	size_t _dequeue;                 // only the flusher thread moves it
+	atomic<size_t> _written;
+	atomic<uint64_t> _dropped;
+	atomic<bool> _stop;
+	mutex _lock;
+	condition_variable _wake;
+	thread _flusher;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/* global memory budget shared by the read, encrypt and send stages -
+a stage that cannot get its bytes blocks until another stage releases them */
+class MemoryBudget
+{
+public:
+	MemoryBudget(size_t limit);
+	~MemoryBudget();
+	static bool parseSize(const string& text, size_t& bytes);
+	bool acquire(size_t bytes);   // blocks while the budget is exhausted, false if bytes can never fit
+	bool tryAcquire(size_t bytes);
+	void release(size_t bytes);
+	size_t limit() const;
+	size_t inUse();
+
+	/* bytes held from the budget for the lifetime of the lease */
+	class Lease
+	{
+	public:
+		Lease(MemoryBudget& budget, size_t bytes);
+		~Lease();
+		bool granted() const;
+		size_t size() const;
+	private:
+		Lease(const Lease& lease);
+		Lease& operator=(const Lease& lease);
+		MemoryBudget& _budget;
+		size_t _bytes;
+		bool _granted;
+	};
+private:
+	MemoryBudget(const MemoryBudget& budget);
+	MemoryBudget& operator=(const MemoryBudget& budget);
+	size_t _limit;
+	size_t _inUse;
+	mutex _lock;
+	condition_variable _released;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include "BufferPool.h"
+#include "SpscRing.h"
+
+using namespace std;
+
+constexpr size_t PIPELINE_DEPTH = 4;   // blocks waiting between two stages, a power of two
+
+/* a pooled block moving through the pipeline, the stages work on it in place */
+struct PipelineBlock
+{
+	BufferPool::Lease lease;
+	uint64_t offset;   // where the content of the block is in the file
+	size_t length;
+	bool last;
+	PipelineBlock() : offset(0), length(0), last(false) {}
+};
+
+/* ns each stage spent working on blocks, not waiting on its neighbours - the busiest one bounds the stream */
+struct PipelineTimes
+{
+	uint64_t read;
+	uint64_t transform;
+	uint64_t write;
+	PipelineTimes() : read(0), transform(0), write(0) {}
+};
+
+/* runs a stream of blocks through three stages - read, transform and write - each on its own thread, connected by
+SPSC rings, so disk, CPU and network work at the same time and the stream moves at the speed of the slowest stage.
+blocks come from the pool, so the memory in flight stays within the budget. the read stage marks the last block */
+class PipelineExecutor
+{
+public:
+	typedef function<bool(PipelineBlock&)> Stage;
+
+	PipelineExecutor(BufferPool& pool);
+	~PipelineExecutor();
+	bool run(const Stage& read, const Stage& transform, const Stage& write, bool threaded = true);
+	const PipelineTimes& times() const;   // of the last run
+private:
+	PipelineExecutor(const PipelineExecutor& executor);
+	PipelineExecutor& operator=(const PipelineExecutor& executor);
+	typedef SpscRing<PipelineBlock, PIPELINE_DEPTH> Ring;
+	bool push(Ring& ring, PipelineBlock& block);
+	bool pop(Ring& ring, PipelineBlock& block, const atomic<bool>& producerDone);
+	void readStage(const Stage& read);
+	void transformStage(const Stage& transform);
+	bool runInline(const Stage& read, const Stage& transform, const Stage& write);
+
+	BufferPool& _pool;
+	Ring _toTransform;
+	Ring _toWrite;
+	atomic<bool> _failed;
+	atomic<bool> _readDone;
+	atomic<bool> _transformDone;
+	PipelineTimes _times;   // every field is written by its own stage thread and read after they are joined
+};
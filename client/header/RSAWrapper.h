@@ -1,35 +1,35 @@
-#pragma once
-
-#include <osrng.h>
-#include <rsa.h>
-
-#include <string>
-
-class RSAPrivateWrapper
-{
-public:
-	static const unsigned int BITS = 1024;
-
-private:
-	CryptoPP::AutoSeededRandomPool _rng;
-	CryptoPP::RSA::PrivateKey _privateKey;
-
-	RSAPrivateWrapper(const RSAPrivateWrapper& rsaprivate);
-	RSAPrivateWrapper& operator=(const RSAPrivateWrapper& rsaprivate);
-public:
-	RSAPrivateWrapper();
-	RSAPrivateWrapper(const char* key, unsigned int length);
-	RSAPrivateWrapper(const std::string& key);
-	~RSAPrivateWrapper();
-
-	std::string getPrivateKey() const;
-	char* getPrivateKey(char* keyout, unsigned int length) const;
-
-	std::string getPublicKey() const;
-	char* getPublicKey(char* keyout, unsigned int length) const;
-
-	std::string decrypt(const std::string& cipher);
-	std::string decrypt(const char* cipher, unsigned int length);
-};
-
-
+#pragma once
+
+#include <osrng.h>
+#include <rsa.h>
+
+#include <string>
+
+class RSAPrivateWrapper
+{
+public:
+	static const unsigned int BITS = 1024;
+
+private:
+	CryptoPP::AutoSeededRandomPool _rng;
+	CryptoPP::RSA::PrivateKey _privateKey;
+
+	RSAPrivateWrapper(const RSAPrivateWrapper& rsaprivate);
+	RSAPrivateWrapper& operator=(const RSAPrivateWrapper& rsaprivate);
+public:
+	RSAPrivateWrapper();
+	RSAPrivateWrapper(const char* key, unsigned int length);
+	RSAPrivateWrapper(const std::string& key);
+	~RSAPrivateWrapper();
+
+	std::string getPrivateKey() const;
+	char* getPrivateKey(char* keyout, unsigned int length) const;
+
+	std::string getPublicKey() const;
+	char* getPublicKey(char* keyout, unsigned int length) const;
+
+	std::string decrypt(const std::string& cipher);
+	std::string decrypt(const char* cipher, unsigned int length);
+};
+
+
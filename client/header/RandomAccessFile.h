@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+/* a range of a file that holds data, the gaps between extents are holes that read as zeros */
+struct FileExtent
+{
+	uint64_t offset;
+	uint64_t length;
+};
+
+/* positional file I/O (pread/pwrite) - several threads may read or write different offsets of the same open file */
+class RandomAccessFile
+{
+public:
+	RandomAccessFile();
+	~RandomAccessFile();
+	bool open(const string& path, bool write = false, bool truncate = false);
+	void close();
+	bool isOpen() const;
+	bool readAt(uint64_t offset, uint8_t* buffer, size_t length, size_t& read);
+	bool writeAt(uint64_t offset, const uint8_t* data, size_t length);
+	bool resize(uint64_t size);
+	uint64_t size();
+	bool dataExtents(vector<FileExtent>& extents, size_t maxExtents);  // false if the layout cannot be read or has more extents
+private:
+	RandomAccessFile(const RandomAccessFile& file);
+	RandomAccessFile& operator=(const RandomAccessFile& file);
+#ifdef _WIN32
+	void* _handle;
+#else
+	int _fd;
+#endif
+};
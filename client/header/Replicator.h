@@ -0,0 +1,141 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include "Span.h"
+#include "protocol.h"
+
+using namespace std;
+
+class SocketHandler;
+class RSAPrivateWrapper;
+class RandomAccessFile;
+
+constexpr size_t REPLICA_WINDOW = 16;          // chunks of the read pass kept for the replicas, one that falls further behind reads the file itself
+constexpr size_t REPLICA_MAX_BACKLOG = 1024;   // files a replica keeps in memory, the ones after them wait in its backlog file
+
+/* a file every replica sends, in the order the backup offered them */
+struct ReplicaTask
+{
+	uint64_t id;
+	string path;
+	string name;
+};
+
+/* how a file offered to one session ended, for the callers that follow every file */
+struct ReplicaOutcome
+{
+	uint64_t id;
+	size_t replica;
+	bool stored;
+	bool returned;      // the session was dropped before it stored the file, the file has to go elsewhere
+};
+
+/* one chunk of the shared read pass */
+struct ReplicaChunk
+{
+	uint64_t offset;
+	size_t length;
+	uint32_t crc;   // CKsum of the file up to the end of this chunk
+};
+
+/* one backup server the files are replicated to, with a session of its own */
+struct Replica
+{
+	size_t index;
+	string endpoint;    // HOST:PORT as given and as kept in replicas.info
+	string address;
+	string port;
+	string uid;         // raw bytes, empty until the replica registered this client
+	string aesKey;
+	SocketHandler* socket;
+	deque<ReplicaTask> tasks;
+	string backlogPath;       // files offered while REPLICA_MAX_BACKLOG are queued, in order, read back as the list runs dry
+	ofstream backlog;
+	uint64_t backlogWritten;
+	uint64_t backlogRead;
+	uint64_t backlogOffset;   // of the next file to read back
+	bool alive;
+	bool attached;      // reading the current task from the shared pass
+	uint64_t consumed;  // chunks of the shared pass taken so far
+	uint64_t stored;
+	uint64_t failed;
+	uint64_t sharedBytes;
+	uint64_t ownBytes;
+	vector<uint8_t> chunk;   // one chunk and its padding, encrypted in place
+	thread worker;
+	Replica() : index(0), socket(nullptr), backlogWritten(0), backlogRead(0), backlogOffset(0), alive(true), attached(false), consumed(0), stored(0), failed(0), sharedBytes(0), ownBytes(0) {}
+};
+
+/* fan-out of the backup to more servers. the file is read and checksummed once by the upload to the main server,
+which publishes every plain chunk into a small window; each replica encrypts the chunks with its own AES key and
+streams them on its own thread and connection. the read pass never waits for a replica - one that falls more than
+the window behind is detached and reads the rest of the file itself, so a slow server costs its own extra reads
+and does not hold back the fast ones. files the main upload does not stream whole (packed, pipelined, delta and
+the other partial sends) are read by every replica on its own. the nodes of a sharded backup are sessions of the
+same kind, each sends only the files placed on it */
+class Replicator
+{
+public:
+	Replicator(const vector<string>& endpoints, const string& userName, const string& privateKey);
+	~Replicator();
+	bool load(const string& path);        // uids of the client on every replica, a missing file is no uids
+	bool save(const string& path) const;
+	void start();                         // log in to every replica on its own thread
+	void trackOutcomes();                 // keep the outcome of every file, the files of a dropped session are handed back
+	uint64_t offer(const string& path, const string& name);   // queue the file for every replica, the id of the file
+	uint64_t offerTo(size_t replica, const string& path, const string& name);   // queue the file for one of them, which reads it itself
+	bool collect(vector<ReplicaOutcome>& outcomes, bool wait);   // the outcomes since the last call, wait for one while files are open
+	bool beginPass(uint64_t file, uint64_t size);             // the first read of the file starts, false if it is not shared
+	void publish(ConstByteSpan plain, uint64_t offset, uint32_t crc);
+	void endPass();
+	void endFile(uint64_t file);          // no shared read of the file follows
+	void finish();                        // wait for every replica to send its files
+	void report() const;
+	size_t size() const;
+	bool alive(size_t replica) const;
+	bool connect(size_t replica);         // log in on the calling thread, for sessions used without the upload threads
+	SocketHandler& socket(size_t replica);
+	const string& uid(size_t replica) const;
+	const string& aesKey(size_t replica) const;
+private:
+	Replicator(const Replicator& replicator);
+	Replicator& operator=(const Replicator& replicator);
+	uint64_t queue(size_t first, size_t last, const string& path, const string& name, bool current);
+	void run(Replica& replica);
+	bool login(Replica& replica, uint8_t* buffer);
+	bool exchange(Replica& replica, uint8_t* buffer, size_t requestSize, uint16_t& code);
+	void packRequest(const Replica& replica, uint8_t* buffer, uint16_t code, uint32_t payloadSize, const string& text) const;
+	bool sendFile(Replica& replica, const ReplicaTask& task, RandomAccessFile& file, bool shared, uint8_t* buffer);
+	void nextChunk(Replica& replica, RandomAccessFile& file, uint64_t size, uint64_t& offset, uint32_t& crc, size_t& length, bool& complete);
+	void drop(Replica& replica, const string& reason);
+	void finishTask(Replica& replica, uint64_t file, bool stored);
+	void push(Replica& replica, const ReplicaTask& task);
+	void readBacklog(Replica& replica, size_t limit);
+
+	string _userName;
+	string _privateKey;
+	string _publicKey;
+	vector<Replica*> _replicas;
+
+	mutable mutex _lock;
+	condition_variable _changed;
+	uint64_t _nextFile;
+	uint64_t _currentFile;        // the file the main upload is sending, 0 between files
+	uint64_t _passFile;           // the file of the shared pass
+	uint64_t _passSize;
+	bool _passOpen;
+	uint64_t _published;          // chunks of the shared pass so far
+	vector<uint8_t> _window;      // REPLICA_WINDOW chunks, chunk i of the pass is in slot i % REPLICA_WINDOW
+	vector<ReplicaChunk> _slots;
+	bool _closed;
+	bool _tracked;
+	uint64_t _open;               // tracked files without an outcome yet
+	vector<ReplicaOutcome> _outcomes;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+constexpr size_t SHARD_VIRTUAL_NODES = 128;  // points of every node on the ring, more points spread the files more evenly
+
+/* consistent hash ring of the servers of a sharded backup. every node is placed on the ring at SHARD_VIRTUAL_NODES
+points hashed from its HOST:PORT, and a file belongs to the first point after the hash of its key. adding a node
+takes over only the keys between its points and the ones before them, about 1/N of the files - the placement of
+the other files does not change, so the nodes do not depend on their order on the command line */
+class ShardRing
+{
+public:
+	ShardRing(const vector<string>& nodes);
+	size_t nodes() const;
+	const string& node(size_t index) const;
+	size_t locate(const string& key) const;
+	size_t locate(const string& key, const vector<bool>& down) const;  // the next node on the ring that is not down
+	static string key(const string& clientID, const string& name);
+	static uint64_t hash(const string& text);
+private:
+	vector<string> _nodes;
+	vector<pair<uint64_t, size_t>> _points;  // hash and node, sorted by hash
+};
@@ -1,30 +1,39 @@
-#pragma once
-#include <string>
-#include <cstdint>
-#include <ostream>
-#include <boost/asio/ip/tcp.hpp>
-
-using boost::asio::ip::tcp;
-using boost::asio::io_context;
-using namespace std;
-
-class SocketHandler
-{
-public:
-	SocketHandler();
-	~SocketHandler();
-	static bool addressValidation(const string& address);
-	static bool portValidation(const string& port);
-	bool connectToServer();
-	bool initializeSocketInfo(const string& address, const string& port);
-	vector<uint8_t> read();
-
-	bool writeChuncks(vector<uint8_t>& requestBuffer, uint32_t payload_size);
-	bool write(vector<uint8_t>& requestBuffer);
-private:
-	std::string    _address;
-	std::string    _port;
-	io_context* _ioContext;
-	tcp::resolver* _resolver;
-	tcp::socket* _socket;
+#pragma once
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <boost/asio/ip/tcp.hpp>
+#include "Logger.h"
+
+using boost::asio::ip::tcp;
+using boost::asio::io_context;
+using namespace std;
+
+constexpr unsigned int READ_TIMEOUT_SECONDS = 25;  // a server that sends nothing for this long is taken as gone
+
+class SocketHandler
+{
+public:
+	SocketHandler();
+	~SocketHandler();
+	static bool addressValidation(const string& address);
+	static bool portValidation(const string& port);
+	bool connectToServer();
+	bool initializeSocketInfo(const string& address, const string& port);
+	bool read(uint8_t* packet);   // one packet of PACKET_SIZE bytes into a caller owned buffer
+
+	bool readBytes(uint8_t* buffer, size_t length);
+	bool writeBytes(const uint8_t* data, size_t length);
+	bool write(const uint8_t* packet);
+	size_t available();   // bytes that can be read without blocking
+	void setBufferSize(size_t bytes);   // kernel send and receive buffers of the connection, 0 keeps the system default
+private:
+	void applyBufferSize();
+	bool readFully(uint8_t* buffer, size_t length, boost::system::error_code& error);
+	std::string    _address;
+	std::string    _port;
+	io_context* _ioContext;
+	tcp::resolver* _resolver;
+	tcp::socket* _socket;
+	size_t _bufferSize;
 };
\ No newline at end of file
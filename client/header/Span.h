@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace std;
+
+/* non-owning view of contiguous elements, the stages of a transfer hand buffers to each other through it
+instead of copying them into strings. std::span needs C++20, the client builds as C++17 */
+template <typename T>
+class Span
+{
+public:
+	Span() : _data(nullptr), _size(0) {}
+	Span(T* data, size_t size) : _data(data), _size(size) {}
+	template <size_t N>
+	Span(T (&array)[N]) : _data(array), _size(N) {}
+	template <typename U>
+	Span(const Span<U>& other) : _data(other.data()), _size(other.size()) {}  // a mutable view converts to a const one
+
+	T* data() const { return _data; }
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	T& operator[](size_t index) const { return _data[index]; }
+	T* begin() const { return _data; }
+	T* end() const { return _data + _size; }
+
+	Span first(size_t count) const
+	{
+		if (count > _size)
+			throw out_of_range("span is shorter than the requested part");
+		return Span(_data, count);
+	}
+
+	Span subspan(size_t offset) const
+	{
+		if (offset > _size)
+			throw out_of_range("span is shorter than the requested part");
+		return Span(_data + offset, _size - offset);
+	}
+
+	Span subspan(size_t offset, size_t count) const
+	{
+		return subspan(offset).first(count);
+	}
+
+private:
+	T* _data;
+	size_t _size;
+};
+
+typedef Span<uint8_t> ByteSpan;
+typedef Span<const uint8_t> ConstByteSpan;
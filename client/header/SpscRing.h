@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include "BufferPool.h"
+
+using namespace std;
+
+/* bounded lock free ring between exactly one producer thread and one consumer thread. the indexes only
+grow, each is written by one side and sits on its own cache line so the two threads do not share one */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "ring capacity must be a power of two");
+public:
+	SpscRing() : _head(0), _tail(0) {}
+
+	bool tryPush(T& item)   // producer only, item is moved into the ring
+	{
+		const size_t tail = _tail.load(memory_order_relaxed);
+		if (tail - _head.load(memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+		_items[tail & (Capacity - 1)] = std::move(item);
+		_tail.store(tail + 1, memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T& item)    // consumer only
+	{
+		const size_t head = _head.load(memory_order_relaxed);
+		if (head == _tail.load(memory_order_acquire))
+		{
+			return false;
+		}
+		item = std::move(_items[head & (Capacity - 1)]);
+		_head.store(head + 1, memory_order_release);
+		return true;
+	}
+private:
+	SpscRing(const SpscRing& ring);
+	SpscRing& operator=(const SpscRing& ring);
+	alignas(CACHE_LINE_SIZE) atomic<size_t> _head;
+	alignas(CACHE_LINE_SIZE) atomic<size_t> _tail;
+	alignas(CACHE_LINE_SIZE) T _items[Capacity];
+};
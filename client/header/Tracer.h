@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+constexpr size_t TRACE_BUFFER_EVENTS = 64 * 1024;   // events of one thread buffer, later events of a full buffer are dropped
+
+/* TRACE_SCOPE("aes.encrypt", bytes) - a complete event from here to the end of the enclosing block, when tracing is on */
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+/* one span of a thread, the name is a string literal */
+struct TraceEvent
+{
+	const char* name;
+	uint64_t start;      // ns since the tracer started
+	uint64_t duration;   // ns
+	uint64_t bytes;      // 0 when the span has no size
+};
+
+/* opt-in timeline of the client in Chrome Trace Event format (chrome://tracing, Perfetto). every thread records
+into a buffer of its own without locks - the lock is taken once when a thread records its first event and once
+when it exits and hands the buffer back for the next thread to continue. the transfer threads live for one file,
+so the buffers are reused and the memory stays at one buffer per thread that runs at the same time. a buffer goes
+to a thread of the name it had before, so the threads of every file show up on the same tracks */
+class Tracer
+{
+public:
+	static Tracer& instance();
+	~Tracer();
+	void enable(const string& path);
+	bool enabled() const;
+	uint64_t now() const;
+	void record(const char* name, uint64_t start, uint64_t bytes);
+	void nameThread(const char* name);   // shown as the track name, threads without one show their number
+	bool write();                        // the events so far into the file given to enable
+	uint64_t dropped() const;
+
+	/* one track of the timeline: events of the threads that held the buffer one after the other,
+	only the thread that holds it appends */
+	struct Buffer
+	{
+		TraceEvent* events;
+		atomic<size_t> count;
+		uint32_t id;         // the tid of the track
+		const char* name;
+		Buffer() : events(new TraceEvent[TRACE_BUFFER_EVENTS]), count(0), id(0), name(nullptr) {}
+		~Buffer() { delete[] events; }
+	};
+	Buffer* acquire(const char* name);
+	void release(Buffer* buffer);
+private:
+	Tracer();
+	Tracer(const Tracer& tracer);
+	Tracer& operator=(const Tracer& tracer);
+
+	atomic<bool> _enabled;
+	string _path;
+	uint64_t _origin;
+	atomic<uint32_t> _nextThread;
+	atomic<uint64_t> _dropped;
+	mutex _lock;
+	vector<Buffer*> _buffers;
+	vector<Buffer*> _free;
+};
+
+/* RAII span, costs one relaxed load when tracing is off */
+class TraceScope
+{
+public:
+	TraceScope(const char* name, uint64_t bytes = 0) : _name(name), _bytes(bytes), _start(0)
+	{
+		if (Tracer::instance().enabled())
+		{
+			_start = Tracer::instance().now() + 1;
+		}
+	}
+	~TraceScope()
+	{
+		if (_start != 0)
+		{
+			Tracer::instance().record(_name, _start - 1, _bytes);
+		}
+	}
+	void setBytes(uint64_t bytes) { _bytes = bytes; }
+private:
+	TraceScope(const TraceScope& scope);
+	TraceScope& operator=(const TraceScope& scope);
+	const char* _name;
+	uint64_t _bytes;
+	uint64_t _start;   // start + 1, 0 when the span is not traced
+};
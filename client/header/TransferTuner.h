@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include "PipelineExecutor.h"
+
+using namespace std;
+
+struct ClientOptions;
+
+constexpr uint64_t TUNE_EPOCH_BYTES = 32 * 1024 * 1024;   // bytes sent with the same settings before they are measured
+constexpr double TUNE_EPOCH_SECONDS = 1.0;                  // and the least time, so a burst of small files is not a sample
+constexpr double TUNE_MIN_GAIN = 0.05;                      // a probe is kept when it is this much better, less is noise
+constexpr unsigned int TUNE_REPROBE_EPOCHS = 16;            // epochs a converged tuner only measures before it probes again
+constexpr size_t TUNE_MIN_SOCKET_BUFFER = 64 * 1024;
+constexpr size_t TUNE_MAX_SOCKET_BUFFER = 16 * 1024 * 1024;
+
+/* one parameter the tuner climbs on, every step doubles or halves it */
+struct TunedParameter
+{
+	const char* name;   // as kept in tuning.info
+	size_t value;
+	size_t min;
+	size_t max;
+	bool network;       // only pays off when the network is what bounds the transfer
+};
+
+/* --tune: hill climbing of the transfer settings on the measured throughput of the run. the uploads are cut into
+epochs of TUNE_EPOCH_BYTES; after an epoch with the current settings the tuner steps one parameter up or down and
+keeps the step when the next epoch is faster by TUNE_MIN_GAIN, or as fast for TUNE_MIN_GAIN less CPU per byte. a
+step that does not pay off is undone and the other direction, then the next parameter, is tried. the busy time of
+the read, transform and write stages tells which one bounds the stream - while it is the disk or the CPU the
+network parameters are not probed. the settings are learned per server endpoint and kept in tuning.info, the next
+run starts from them */
+class TransferTuner
+{
+public:
+	TransferTuner(const string& endpoint, const ClientOptions& options);
+	bool load(const string& path);         // the settings learned for the endpoint, a missing file or endpoint keeps the options
+	bool save(const string& path) const;   // endpoints of other servers keep their line
+	void apply(ClientOptions& options) const;
+	void record(uint64_t bytes, bool stripable);   // one file sent, stripable when it is large enough to be striped
+	void recordStages(const PipelineTimes& times);
+	bool sample();   // true when the epoch ended and the settings changed, apply them again
+	void report() const;
+private:
+	enum Stage { STAGE_READ, STAGE_TRANSFORM, STAGE_WRITE };
+	bool probe();
+	bool step(TunedParameter& parameter, int direction) const;
+	TunedParameter* find(const string& name);
+	Stage bottleneck() const;
+
+	string _endpoint;
+	vector<TunedParameter> _parameters;
+	size_t _current;        // parameter probed
+	int _direction;         // +1 doubles it, -1 halves it
+	unsigned int _misses;   // probes in a row that did not pay off
+	bool _probing;
+	size_t _previous;       // value of the probed parameter before the step
+	unsigned int _idle;     // epochs since the tuner converged
+	double _best;           // bytes per second of the settings kept
+	double _bestCPU;        // CPU seconds per byte of the settings kept
+	uint64_t _epochs;
+	uint64_t _kept;
+
+	/* the epoch being measured */
+	uint64_t _bytes;
+	uint64_t _stripable;
+	PipelineTimes _stages;
+	std::chrono::steady_clock::time_point _start;
+	double _startCPU;
+};
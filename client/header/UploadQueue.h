@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/* a file waiting to be sent for backup */
+struct UploadJob
+{
+	string path;    // local path
+	string name;    // name on the server, relative to the backed up directory
+	uint64_t size = 0;
+	uint32_t priority = 0;   // class of the job, lower is sent first
+	uint64_t deadline = 0;   // ms from the start of the run, 0 for none
+	uint64_t sequence = 0;   // order the job was queued in
+};
+
+class UploadScheduler;
+
+/* bounded queue between the directory scan and the upload loop - the scanner blocks when the uploads fall behind.
+with a scheduler the jobs are kept in a heap in its order. when the order is not plain FIFO the first job is
+handed out only once the scan ended or the queue is full, so the order covers the whole batch */
+class UploadQueue
+{
+public:
+	UploadQueue(size_t capacity, UploadScheduler* scheduler = nullptr);
+	~UploadQueue();
+	bool push(const UploadJob& job);   // false once the queue is closed
+	bool pop(UploadJob& job);          // false when the queue is closed and empty
+	void close();
+	size_t size();
+private:
+	UploadQueue(const UploadQueue& queue);
+	UploadQueue& operator=(const UploadQueue& queue);
+	bool ready() const;
+
+	size_t _capacity;
+	bool _closed;
+	bool _batchStarted;
+	uint64_t _sequence;
+	UploadScheduler* _scheduler;
+	deque<UploadJob> _jobs;   // FIFO order without a scheduler, a heap with one
+	mutex _lock;
+	condition_variable _notEmpty;
+	condition_variable _notFull;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+
+using namespace std;
+
+struct UploadJob;
+
+enum SchedulePolicy
+{
+	SCHEDULE_FIFO = 0,       // files go in the order the scan finds them
+	SCHEDULE_SMALLEST = 1,   // shortest job first, many small files are done early
+	SCHEDULE_LARGEST = 2,    // longest processing time first, the large files do not end up alone at the tail
+	SCHEDULE_DEADLINE = 3    // earliest deadline first, files without a deadline last
+};
+
+/* a deadline in seconds from the start of the run for the files matching pattern */
+struct FileDeadline
+{
+	string pattern;
+	uint64_t seconds;
+};
+
+/* how queued files are ordered, priority classes come before the policy */
+struct ScheduleOptions
+{
+	SchedulePolicy policy;        // --schedule=fifo|smallest|largest|deadline
+	vector<string> priorities;    // --priority=PATTERN, files matching an earlier pattern go first, unmatched files last
+	vector<FileDeadline> deadlines;   // --deadline=SECONDS:PATTERN
+	ScheduleOptions() : policy(SCHEDULE_FIFO) {}
+	bool ordered() const;         // false when the queue is a plain FIFO
+	static bool parsePolicy(const string& value, SchedulePolicy& policy);
+	static bool parseDeadline(const string& value, FileDeadline& deadline);
+};
+
+/* orders the upload queue and measures the batch: makespan from the first file handed out to the last one
+finished, time the upload loop sat idle waiting for work, tail idle time of connections that ran out of work
+while others were still busy, the finish time of every priority class and the files that missed their deadline */
+class UploadScheduler
+{
+public:
+	UploadScheduler(const ScheduleOptions& options);
+	~UploadScheduler();
+	const ScheduleOptions& options() const;
+	void classify(UploadJob& job) const;   // priority class and deadline of a job, called as it is queued
+	bool before(const UploadJob& first, const UploadJob& second) const;   // first is sent before second
+	void dispatched();
+	void idle(chrono::steady_clock::duration waited);
+	void tailIdle(chrono::steady_clock::duration waited);
+	void finished(const UploadJob& job, bool stored);
+	void report();
+private:
+	UploadScheduler(const UploadScheduler& scheduler);
+	UploadScheduler& operator=(const UploadScheduler& scheduler);
+	static uint64_t milliseconds(chrono::steady_clock::duration duration);
+
+	ScheduleOptions _options;
+	chrono::steady_clock::time_point _start;      // deadlines count from here
+	chrono::steady_clock::time_point _firstDispatch;
+	chrono::steady_clock::time_point _lastFinish;
+	bool _dispatched;
+	chrono::steady_clock::duration _idle;
+	chrono::steady_clock::duration _tailIdle;
+	uint64_t _files;
+	uint64_t _failed;
+	uint64_t _missed;
+	vector<uint64_t> _classFinish;   // ms from the first dispatch to the last finished file of every class
+};
@@ -1,14 +1,19 @@
-#pragma once
-#include <iostream>
-#include <base64.h>
-
-using namespace std;
-
-class Utils
-{
-public:
-	static string reverse_hexi(const string& hexString);
-	static string hexi(const uint8_t* buffer, const size_t size);
-	static string encode(const string& str);
-	static string decode(const std::string& str);
+#pragma once
+#include <iostream>
+#include <base64.h>
+#include <cstdint>
+#include "Span.h"
+
+using namespace std;
+
+class Utils
+{
+public:
+	static string reverse_hexi(const string& hexString);
+	static string hexi(const uint8_t* buffer, const size_t size);
+	static string encode(const string& str);
+	static string decode(const std::string& str);
+	static uint32_t crc32Update(uint32_t crc, ConstByteSpan data);
+	static uint32_t crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+	static uint32_t crc32ZeroExtend(uint32_t crc, uint64_t zeros);
 };
\ No newline at end of file
@@ -1,123 +1,267 @@
-#pragma once
-
-constexpr auto VERSION = 3;
-constexpr auto PACKET_SIZE = 2048;
-constexpr auto UID_SIZE = 16;
-constexpr auto VERSION_SIZE = 1;
-constexpr auto CODE_SIZE = 2;
-constexpr auto PAYLOAD_SIZE = 4;
-constexpr auto REQUEST_HEADER_SIZE = 23;
-constexpr auto HEADER_SIZE = 7;
-constexpr auto NAME_SIZE = 255;
-constexpr auto PUBLIC_KEY_SIZE = 160;
-constexpr auto CLIENT_HEADER_SIZE = 23;
-constexpr auto CONTENT_SIZE = 4;
-constexpr auto CRC_SIZE = 4;
-constexpr auto FILE_NAME_SIZE = 255;
-constexpr auto MAX_CRC_SEND = 4;
-constexpr auto MAX_NAME_SIZE = 100;
-constexpr auto MAX_SENDS = 4;
-
-enum { DEF_VAL = 0 };  // default value used to initialize protocol structures.
-
-typedef uint16_t code_t;
-typedef uint32_t payload_t;
-
-enum CRequestCode
-{
-	REGISTRATION_REQUEST = 1100,   // uuid ignored.
-	PUBLIC_KEY_REQUEST = 1101,
-	LOGIN_REQUEST = 1102,
-	FILE_SEND_REQUEST = 1103,
-	CRC_VALID_REQUEST = 1104,
-	CRC_FAILED_REQUEST = 1105,
-	FOUR_FAILED_CRC_REQUEST = 1106
-};
-
-#pragma pack(push, 1) // with this we can pack all the struct in once
-struct ClientRequestHeader
-{
-	uint8_t uid[16]; //16 bytes
-	uint8_t  version; //one byte
-	uint16_t  code;   // the request code to execute  , 2 byets
-	uint32_t payloadSize; //4 byets  payload size
-	ClientRequestHeader(code_t requestCode, payload_t payloadSize) : uid{ '\0' }, version(VERSION), code(requestCode), payloadSize(payloadSize) {}
-};
-#pragma pack(pop)
-
-
-struct PublicKeyRequest
-{
-	ClientRequestHeader header;
-	PublicKeyRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-
-};
-
-struct RegisterationRequest
-{
-	ClientRequestHeader header;
-	RegisterationRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-};
-
-struct ReconnectionRequest
-{
-	ClientRequestHeader header;
-	ReconnectionRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-};
-
-struct fileSendRequest
-{
-	ClientRequestHeader header;
-	fileSendRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-};
-
-struct CRCValidateRequest
-{
-	ClientRequestHeader header;
-	CRCValidateRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-};
-
-struct CRCFailedRequest
-{
-	ClientRequestHeader header;
-	CRCFailedRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-};
-
-struct retryFileSendRequest
-{
-	ClientRequestHeader header;
-	retryFileSendRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
-};
-
-struct ServerResponse
-{
-
-	struct SResponseHeader
-	{
-		uint8_t  version; //one byte
-		uint16_t  code;   // the request code to execute  , 2 byets
-		uint32_t payloadSize; //4 byets  payload size
-		SResponseHeader() : version(VERSION), code(DEF_VAL), payloadSize(DEF_VAL) {}
-
-	};
-	enum SResponseCode
-	{
-		REGISTRATION_REQUEST_SUCCESS = 2100,   // uuid ignored.
-		REGISTRATION_REQUEST_FAILED = 2101,
-		GOT_PC_SEND_AES = 2102,
-		GOT_FILE_SEND_CRC = 2103,
-		GOT_REQ_TNX = 2104,
-		LOGIN_SUCCESS_SEND_AES = 2105,
-		RECONNECT_FAILED = 2106,
-		GENERAL_ERR = 2107
-	};
-
-	struct Payload
-	{
-		uint8_t* payload;
-		Payload() : payload(nullptr) {}
-	};
-
-	SResponseHeader header;  // request header
-	Payload payload;
-};
+#pragma once
+
+constexpr auto VERSION = 3;
+constexpr auto PACKET_SIZE = 2048;
+constexpr auto UID_SIZE = 16;
+constexpr auto VERSION_SIZE = 1;
+constexpr auto CODE_SIZE = 2;
+constexpr auto PAYLOAD_SIZE = 4;
+constexpr auto REQUEST_HEADER_SIZE = 23;
+constexpr auto HEADER_SIZE = 7;
+constexpr auto NAME_SIZE = 255;
+constexpr auto PUBLIC_KEY_SIZE = 160;
+constexpr auto CLIENT_HEADER_SIZE = 23;
+constexpr auto CONTENT_SIZE = 4;
+constexpr auto CRC_SIZE = 4;
+constexpr auto FILE_NAME_SIZE = 255;
+constexpr auto MAX_CRC_SEND = 4;
+constexpr auto MAX_NAME_SIZE = 100;
+constexpr auto MAX_SENDS = 4;
+constexpr auto CHUNK_SIZE = 64 * 1024;  // file content is read, encrypted and sent in chunks of this size
+constexpr auto AES_BLOCK_SIZE = 16;
+constexpr auto FILE_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + CONTENT_SIZE + FILE_NAME_SIZE;  // file send request up to the content
+constexpr auto PACKET_POOL_BLOCKS = 8;
+constexpr auto OFFSET_SIZE = 8;
+constexpr auto FILE_SIZE_SIZE = 8;
+constexpr auto COUNT_SIZE = 4;
+constexpr auto RANGE_SIZE = 1024 * 1024;  // restore fetches files in ranges of this size
+constexpr auto LIST_PAGE_ENTRIES = 256;  // max files in one file list response
+constexpr auto LIST_ENTRY_SIZE = FILE_NAME_SIZE + FILE_SIZE_SIZE + CRC_SIZE;
+constexpr auto FETCH_RANGE_PAYLOAD_SIZE = FILE_NAME_SIZE + OFFSET_SIZE + CONTENT_SIZE;
+constexpr auto RANGE_HEADER_SIZE = OFFSET_SIZE + CONTENT_SIZE + CRC_SIZE + CONTENT_SIZE;  // offset, plain size, crc, cipher size
+constexpr auto PACK_MAX_MEMBERS = 1024;  // files in one packed container, the result flags must fit in one packet
+constexpr auto PACK_MAX_BYTES = 8 * 1024 * 1024;  // content of one packed container, the server holds it in memory
+constexpr auto PACK_INDEX_ENTRY_SIZE = FILE_NAME_SIZE + FILE_SIZE_SIZE + CRC_SIZE;
+constexpr auto PACKED_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + CONTENT_SIZE + COUNT_SIZE;  // packed files request up to the container
+constexpr auto SEQUENCE_SIZE = 4;
+constexpr auto EXTENT_SIZE = OFFSET_SIZE + FILE_SIZE_SIZE;  // offset and length of a data extent
+constexpr auto SPARSE_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + COUNT_SIZE;  // sparse file request up to the extent map
+constexpr auto MAX_SPARSE_EXTENTS = 65536;  // a file fragmented into more extents is sent whole
+constexpr auto SPARSE_MIN_HOLES = 1024 * 1024;  // holes worth the extent map, a file with fewer is sent whole
+constexpr auto PIPELINED_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + SEQUENCE_SIZE + CONTENT_SIZE + FILE_NAME_SIZE;  // pipelined file request up to the content
+constexpr auto BLOCK_SIZE_SIZE = 4;
+constexpr auto WEAK_SUM_SIZE = 4;
+constexpr auto STRONG_HASH_SIZE = 16;  // SHA-256 of a block truncated to 128 bits
+constexpr auto SIGNATURE_ENTRY_SIZE = WEAK_SUM_SIZE + STRONG_HASH_SIZE;
+constexpr auto SIGNATURE_PAGE_ENTRIES = 3072;  // block signatures in one response, a page fits in a transfer chunk
+constexpr auto SIGNATURES_PAYLOAD_SIZE = FILE_NAME_SIZE + COUNT_SIZE;
+constexpr auto SIGNATURES_HEADER_SIZE = FILE_SIZE_SIZE + BLOCK_SIZE_SIZE + 2 * COUNT_SIZE;  // stored size, block size, total and page count
+constexpr auto MIN_DELTA_BLOCK_SIZE = 2 * 1024;
+constexpr auto MAX_DELTA_BLOCK_SIZE = 32 * 1024;  // two blocks fit in a transfer chunk for the rolling window
+constexpr auto MAX_DELTA_BLOCKS = 1024 * 1024;  // a file with more blocks is sent whole
+constexpr auto DELTA_LITERAL_HEADER_SIZE = 1 + CONTENT_SIZE;  // op and length, the bytes follow
+constexpr auto DELTA_COPY_SIZE = 1 + 2 * COUNT_SIZE;  // op, first block and block count
+constexpr auto STRIPE_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + RANGE_HEADER_SIZE;  // striped range request up to the encrypted range
+constexpr auto STRIPED_COMMIT_PAYLOAD_SIZE = FILE_NAME_SIZE + FILE_SIZE_SIZE;
+constexpr auto STRIPE_MIN_SIZE = 8 * RANGE_SIZE;  // smaller files are not worth more connections
+constexpr auto DELTA_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + BLOCK_SIZE_SIZE;  // delta file request up to the ops
+constexpr auto APPEND_SEND_HEADER_SIZE = REQUEST_HEADER_SIZE + CONTENT_SIZE + FILE_NAME_SIZE + OFFSET_SIZE;  // append file request up to the appended bytes
+constexpr auto FINGERPRINT_SIZE = 32;  // SHA-256 of the whole file content
+constexpr auto FINGERPRINT_LOOKUP_PAYLOAD_SIZE = FILE_NAME_SIZE + FILE_SIZE_SIZE + FINGERPRINT_SIZE;
+constexpr auto FINGERPRINT_MIN_SIZE = 64 * 1024;  // smaller files are sent, cheaper than the lookup round trip
+constexpr auto FINGERPRINT_FILTER_BITS = 8 * 1024 * 1024;  // Bloom filter of the stored fingerprints, the same shape on both sides
+constexpr auto FINGERPRINT_FILTER_HASHES = 7;
+constexpr auto FINGERPRINT_FILTER_PAGE = 32 * 1024;  // bytes of the filter in one response
+
+enum { DEF_VAL = 0 };  // default value used to initialize protocol structures.
+
+typedef uint16_t code_t;
+typedef uint32_t payload_t;
+
+enum CRequestCode
+{
+	REGISTRATION_REQUEST = 1100,   // uuid ignored.
+	PUBLIC_KEY_REQUEST = 1101,
+	LOGIN_REQUEST = 1102,
+	FILE_SEND_REQUEST = 1103,
+	CRC_VALID_REQUEST = 1104,
+	CRC_FAILED_REQUEST = 1105,
+	FOUR_FAILED_CRC_REQUEST = 1106,
+	LIST_FILES_REQUEST = 1107,
+	FETCH_RANGE_REQUEST = 1108,
+	PACKED_FILES_REQUEST = 1109,
+	PIPELINED_FILE_REQUEST = 1110,  // file content followed by the client CKsum, answered by FILE_STORED with the same sequence
+	SPARSE_FILE_REQUEST = 1111,     // extent map and only the data extents of the file, answered like FILE_SEND_REQUEST
+	SIGNATURES_REQUEST = 1112,      // one page of the block signatures of the stored copy of a file
+	DELTA_FILE_REQUEST = 1113,      // the file as literal bytes and copies of stored blocks, answered like FILE_SEND_REQUEST
+	STRIPE_RANGE_REQUEST = 1114,    // one range of a file striped over several connections, answered by RANGE_STORED
+	STRIPED_FILE_COMMIT = 1115,     // all ranges of a striped file were stored, answered like FILE_SEND_REQUEST
+	APPEND_FILE_REQUEST = 1116,     // the bytes appended to a stored file, answered like FILE_SEND_REQUEST with the CKsum of the whole file
+	FINGERPRINT_LOOKUP_REQUEST = 1117,  // name, size and fingerprint of a file, answered by FINGERPRINT_RESULT
+	FINGERPRINT_FILTER_REQUEST = 1118   // one page of the server Bloom filter, answered by FINGERPRINT_FILTER
+};
+
+/* ops of a delta file request */
+enum EDeltaOp
+{
+	DELTA_LITERAL = 0,
+	DELTA_COPY = 1
+};
+
+#pragma pack(push, 1) // with this we can pack all the struct in once
+struct ClientRequestHeader
+{
+	uint8_t uid[16]; //16 bytes
+	uint8_t  version; //one byte
+	uint16_t  code;   // the request code to execute  , 2 byets
+	uint32_t payloadSize; //4 byets  payload size
+	ClientRequestHeader(code_t requestCode, payload_t payloadSize) : uid{ '\0' }, version(VERSION), code(requestCode), payloadSize(payloadSize) {}
+};
+#pragma pack(pop)
+
+
+struct PublicKeyRequest
+{
+	ClientRequestHeader header;
+	PublicKeyRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+
+};
+
+struct RegisterationRequest
+{
+	ClientRequestHeader header;
+	RegisterationRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct ReconnectionRequest
+{
+	ClientRequestHeader header;
+	ReconnectionRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct fileSendRequest
+{
+	ClientRequestHeader header;
+	fileSendRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct CRCValidateRequest
+{
+	ClientRequestHeader header;
+	CRCValidateRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct CRCFailedRequest
+{
+	ClientRequestHeader header;
+	CRCFailedRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct retryFileSendRequest
+{
+	ClientRequestHeader header;
+	retryFileSendRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct FileListRequest
+{
+	ClientRequestHeader header;
+	FileListRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct FetchRangeRequest
+{
+	ClientRequestHeader header;
+	FetchRangeRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct PackedFilesRequest
+{
+	ClientRequestHeader header;
+	PackedFilesRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct PipelinedFileRequest
+{
+	ClientRequestHeader header;
+	PipelinedFileRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct SparseFileRequest
+{
+	ClientRequestHeader header;
+	SparseFileRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct SignaturesRequest
+{
+	ClientRequestHeader header;
+	SignaturesRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct DeltaFileRequest
+{
+	ClientRequestHeader header;
+	DeltaFileRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct StripeRangeRequest
+{
+	ClientRequestHeader header;
+	StripeRangeRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct StripedCommitRequest
+{
+	ClientRequestHeader header;
+	StripedCommitRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct AppendFileRequest
+{
+	ClientRequestHeader header;
+	AppendFileRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct FingerprintLookupRequest
+{
+	ClientRequestHeader header;
+	FingerprintLookupRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct FingerprintFilterRequest
+{
+	ClientRequestHeader header;
+	FingerprintFilterRequest(code_t requestCode, payload_t payloadSize) : header(requestCode, payloadSize) {}
+};
+
+struct ServerResponse
+{
+
+	struct SResponseHeader
+	{
+		uint8_t  version; //one byte
+		uint16_t  code;   // the request code to execute  , 2 byets
+		uint32_t payloadSize; //4 byets  payload size
+		SResponseHeader() : version(VERSION), code(DEF_VAL), payloadSize(DEF_VAL) {}
+
+	};
+	enum SResponseCode
+	{
+		REGISTRATION_REQUEST_SUCCESS = 2100,   // uuid ignored.
+		REGISTRATION_REQUEST_FAILED = 2101,
+		GOT_PC_SEND_AES = 2102,
+		GOT_FILE_SEND_CRC = 2103,
+		GOT_REQ_TNX = 2104,
+		LOGIN_SUCCESS_SEND_AES = 2105,
+		RECONNECT_FAILED = 2106,
+		GENERAL_ERR = 2107,
+		FILE_LIST = 2108,
+		FILE_RANGE = 2109,
+		PACKED_FILES_RESULT = 2110,
+		FILE_STORED = 2111,
+		FILE_SIGNATURES = 2112,
+		RANGE_STORED = 2113,
+		FINGERPRINT_RESULT = 2114,   // stored flag and the CKsum of the file stored from the fingerprint
+		FINGERPRINT_FILTER = 2115    // page offset and the bytes of the filter
+	};
+
+	struct Payload
+	{
+		uint8_t* payload;  // not owned, points into the response buffer
+		Payload() : payload(nullptr) {}
+	};
+
+	SResponseHeader header;  // request header
+	Payload payload;
+};
@@ -0,0 +1,221 @@
+#include "AESLanes.h"
+#include "AESWrapper.h"
+#include "Tracer.h"
+#include <cstring>
+#include <stdexcept>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#if defined(__GNUC__)
+#define AES_LANES_TARGET __attribute__((target("aes,sse2")))
+#else
+#define AES_LANES_TARGET
+#endif
+
+constexpr size_t AES_ROUND_KEYS = 11;   // AES-128
+constexpr size_t AES_LANE_BLOCK = 16;
+
+bool AESLanes::accelerated()
+{
+#ifdef _MSC_VER
+	int registers[4];
+	__cpuid(registers, 1);
+	return (registers[2] & (1 << 25)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) != 0;
+#endif
+}
+
+/* one step of the AES-128 key schedule, generated is the aeskeygenassist of the previous round key */
+AES_LANES_TARGET static inline __m128i expandStep(__m128i key, __m128i generated)
+{
+	generated = _mm_shuffle_epi32(generated, 0xff);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, generated);
+}
+
+AES_LANES_TARGET static void expandKey(const uint8_t* key, __m128i* schedule)
+{
+	schedule[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+	schedule[1] = expandStep(schedule[0], _mm_aeskeygenassist_si128(schedule[0], 0x01));
+	schedule[2] = expandStep(schedule[1], _mm_aeskeygenassist_si128(schedule[1], 0x02));
+	schedule[3] = expandStep(schedule[2], _mm_aeskeygenassist_si128(schedule[2], 0x04));
+	schedule[4] = expandStep(schedule[3], _mm_aeskeygenassist_si128(schedule[3], 0x08));
+	schedule[5] = expandStep(schedule[4], _mm_aeskeygenassist_si128(schedule[4], 0x10));
+	schedule[6] = expandStep(schedule[5], _mm_aeskeygenassist_si128(schedule[5], 0x20));
+	schedule[7] = expandStep(schedule[6], _mm_aeskeygenassist_si128(schedule[6], 0x40));
+	schedule[8] = expandStep(schedule[7], _mm_aeskeygenassist_si128(schedule[7], 0x80));
+	schedule[9] = expandStep(schedule[8], _mm_aeskeygenassist_si128(schedule[8], 0x1b));
+	schedule[10] = expandStep(schedule[9], _mm_aeskeygenassist_si128(schedule[9], 0x36));
+}
+
+void AESLanes::encrypt(AESLane* lanes, size_t count)
+{
+	if (count > AES_LANES)
+	{
+		throw std::length_error("too many lanes");
+	}
+	size_t bytes = 0;
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		const size_t length = lanes[lane].plain.size();
+		const size_t needed = lanes[lane].last ? (length / AES_LANE_BLOCK + 1) * AES_LANE_BLOCK : length;
+		if (!lanes[lane].last && length % AES_LANE_BLOCK != 0)
+			throw std::length_error("only the last chunk may be a partial block");
+		if (lanes[lane].cipher.size() < needed)
+			throw std::length_error("cipher buffer is too small");
+		bytes += length;
+	}
+	TRACE_SCOPE("aes.lanes", bytes);
+	if (count == 0)
+	{
+		return;
+	}
+
+	static const bool useAESNI = accelerated();
+	if (useAESNI)
+	{
+		encryptInterleaved(lanes, count);
+		return;
+	}
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		AESWrapper aes(lanes[lane].key, AESWrapper::DEFAULT_KEYLENGTH);
+		lanes[lane].written = aes.encryptBlocks(lanes[lane].chain, lanes[lane].plain, lanes[lane].cipher, lanes[lane].last);
+	}
+}
+
+/* block i of every lane is encrypted in the same pass, round by round across the lanes, so up to AES_LANES
+independent aesenc are in flight while each lane still chains on its own previous block. the padded last
+block of a lane is built on the stack, cipher may alias plain because a block is read before it is written */
+AES_LANES_TARGET void AESLanes::encryptInterleaved(AESLane* lanes, size_t count)
+{
+	__m128i schedule[AES_LANES][AES_ROUND_KEYS];
+	__m128i chain[AES_LANES];
+	size_t blocks[AES_LANES];
+	size_t most = 0;
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		expandKey(lanes[lane].key, schedule[lane]);
+		chain[lane] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[lane].chain));
+		const size_t length = lanes[lane].plain.size();
+		blocks[lane] = length / AES_LANE_BLOCK + (lanes[lane].last ? 1 : 0);
+		most = blocks[lane] > most ? blocks[lane] : most;
+	}
+
+	/* the round loops always run all AES_LANES states so the compiler keeps them in registers, the slots of
+	lanes that are done carry a copy of a running lane and their result is dropped */
+	size_t active[AES_LANES];
+	__m128i state[AES_LANES];
+	const __m128i* keys[AES_LANES];
+
+	/* the full blocks every lane has - the bulk of equally long streams - go without the per lane checks */
+	size_t common = most;
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		const size_t full = lanes[lane].plain.size() / AES_LANE_BLOCK;
+		common = full < common ? full : common;
+	}
+	const uint8_t* plains[AES_LANES];
+	uint8_t* ciphers[AES_LANES];
+	for (size_t i = 0; i < AES_LANES; i++)
+	{
+		const size_t lane = i < count ? i : 0;
+		keys[i] = schedule[lane];
+		plains[i] = lanes[lane].plain.data();
+		ciphers[i] = lanes[lane].cipher.data();
+		active[i] = lane;
+	}
+	for (size_t block = 0; block < common; block++)
+	{
+		const size_t offset = block * AES_LANE_BLOCK;
+		for (size_t i = 0; i < AES_LANES; i++)
+		{
+			const __m128i plain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plains[i] + offset));
+			state[i] = _mm_xor_si128(_mm_xor_si128(plain, chain[active[i]]), keys[i][0]);
+		}
+		for (size_t round = 1; round < AES_ROUND_KEYS - 1; round++)
+		{
+			for (size_t i = 0; i < AES_LANES; i++)
+			{
+				state[i] = _mm_aesenc_si128(state[i], keys[i][round]);
+			}
+		}
+		for (size_t i = 0; i < AES_LANES; i++)
+		{
+			state[i] = _mm_aesenclast_si128(state[i], keys[i][AES_ROUND_KEYS - 1]);
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			chain[i] = state[i];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ciphers[i] + offset), state[i]);
+		}
+	}
+
+	for (size_t block = common; block < most; block++)
+	{
+		size_t running = 0;
+		for (size_t lane = 0; lane < count; lane++)
+		{
+			if (block >= blocks[lane])
+			{
+				continue;
+			}
+			const size_t offset = block * AES_LANE_BLOCK;
+			__m128i plain;
+			if (offset + AES_LANE_BLOCK <= lanes[lane].plain.size())
+			{
+				plain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[lane].plain.data() + offset));
+			}
+			else
+			{
+				/* PKCS#7: the rest of the plain text, then the pad length in every byte left */
+				const size_t rest = lanes[lane].plain.size() - offset;
+				uint8_t padded[AES_LANE_BLOCK];
+				memcpy(padded, lanes[lane].plain.data() + offset, rest);
+				memset(padded + rest, static_cast<int>(AES_LANE_BLOCK - rest), AES_LANE_BLOCK - rest);
+				plain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(padded));
+			}
+			keys[running] = schedule[lane];
+			state[running] = _mm_xor_si128(_mm_xor_si128(plain, chain[lane]), keys[running][0]);
+			active[running++] = lane;
+		}
+		for (size_t i = running; i < AES_LANES; i++)
+		{
+			keys[i] = keys[0];
+			state[i] = state[0];
+		}
+		for (size_t round = 1; round < AES_ROUND_KEYS - 1; round++)
+		{
+			for (size_t i = 0; i < AES_LANES; i++)
+			{
+				state[i] = _mm_aesenc_si128(state[i], keys[i][round]);
+			}
+		}
+		for (size_t i = 0; i < AES_LANES; i++)
+		{
+			state[i] = _mm_aesenclast_si128(state[i], keys[i][AES_ROUND_KEYS - 1]);
+		}
+		for (size_t i = 0; i < running; i++)
+		{
+			const size_t lane = active[i];
+			chain[lane] = state[i];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes[lane].cipher.data() + block * AES_LANE_BLOCK), chain[lane]);
+		}
+	}
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		lanes[lane].written = blocks[lane] * AES_LANE_BLOCK;
+		if (blocks[lane] > 0)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes[lane].chain), chain[lane]);
+		}
+	}
+}
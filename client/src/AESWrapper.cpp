@@ -1,60 +1,160 @@
-#include "AESWrapper.h"
-#include <modes.h>
-#include <aes.h>
-#include <filters.h>
-#include <stdexcept>
-#include <immintrin.h>	// _rdrand32_step
-
-
-unsigned char* AESWrapper::GenerateKey(unsigned char* buffer, unsigned int length)
-{
-	for (size_t i = 0; i < length; i += sizeof(unsigned int))
-		_rdrand32_step(reinterpret_cast<unsigned int*>(&buffer[i]));
-	return buffer;
-}
-
-AESWrapper::AESWrapper(const unsigned char* key, unsigned int length)
-{
-	if (length != DEFAULT_KEYLENGTH)
-		throw std::length_error("key length must be 16 bytes");
-	memcpy_s(_key, DEFAULT_KEYLENGTH, key, length);
-}
-
-AESWrapper::~AESWrapper()
-{
-}
-
-const unsigned char* AESWrapper::getKey() const
-{
-	return _key;
-}
-
-std::string AESWrapper::encrypt(const char* plain, unsigned int length)
-{
-	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
-
-	CryptoPP::AES::Encryption aesEncryption(_key, DEFAULT_KEYLENGTH);
-	CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption(aesEncryption, iv);
-
-	std::string cipher;
-	CryptoPP::StreamTransformationFilter stfEncryptor(cbcEncryption, new CryptoPP::StringSink(cipher));
-	stfEncryptor.Put(reinterpret_cast<const CryptoPP::byte*>(plain), length);
-	stfEncryptor.MessageEnd();
-	return cipher;
-}
-
-
-std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
-{
-	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
-
-	CryptoPP::AES::Decryption aesDecryption(_key, DEFAULT_KEYLENGTH);
-	CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption(aesDecryption, iv);
-
-	std::string decrypted;
-	CryptoPP::StreamTransformationFilter stfDecryptor(cbcDecryption, new CryptoPP::StringSink(decrypted));
-	stfDecryptor.Put(reinterpret_cast<const CryptoPP::byte*>(cipher), length);
-	stfDecryptor.MessageEnd();
-
-	return decrypted;
-}
+#include "AESWrapper.h"
+#include "Tracer.h"
+#include <modes.h>
+#include <aes.h>
+#include <stdexcept>
+#include <immintrin.h>	// _rdrand32_step
+
+
+unsigned char* AESWrapper::GenerateKey(unsigned char* buffer, unsigned int length)
+{
+	for (size_t i = 0; i < length; i += sizeof(unsigned int))
+		_rdrand32_step(reinterpret_cast<unsigned int*>(&buffer[i]));
+	return buffer;
+}
+
+AESWrapper::AESWrapper(const unsigned char* key, unsigned int length)
+{
+	if (length != DEFAULT_KEYLENGTH)
+		throw std::length_error("key length must be 16 bytes");
+	memcpy_s(_key, DEFAULT_KEYLENGTH, key, length);
+	resetChain();
+}
+
+AESWrapper::~AESWrapper()
+{
+}
+
+const unsigned char* AESWrapper::getKey() const
+{
+	return _key;
+}
+
+std::string AESWrapper::encrypt(const char* plain, unsigned int length)
+{
+	std::string cipher(cipherSize(length), '\0');
+	encrypt(ConstByteSpan(reinterpret_cast<const uint8_t*>(plain), length), ByteSpan(reinterpret_cast<uint8_t*>(&cipher[0]), cipher.size()));
+	return cipher;
+}
+
+size_t AESWrapper::encrypt(ConstByteSpan plain, ByteSpan cipher) const
+{
+	unsigned char iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+	return encryptBlocks(iv, plain, cipher, true);
+}
+
+/* size of the CBC cipher text of length plain bytes, PKCS#7 always adds at least one byte of padding */
+unsigned int AESWrapper::cipherSize(unsigned int length)
+{
+	return (length / CryptoPP::AES::BLOCKSIZE + 1) * CryptoPP::AES::BLOCKSIZE;
+}
+
+/* start a new chunked encryption with the same fixed iv encrypt() uses */
+void AESWrapper::resetChain()
+{
+	memset(_chain, 0, sizeof(_chain));
+}
+
+/* CBC encrypt plain into cipher continuing from chain, which is left at the last cipher block. only the last
+part of a message may be a partial block and gets the padding, cipher must have room for it */
+size_t AESWrapper::encryptBlocks(unsigned char* chain, ConstByteSpan plain, ByteSpan cipher, bool last) const
+{
+	const size_t length = plain.size();
+	TRACE_SCOPE("aes.encrypt", length);
+	const size_t fullBlocks = length - (length % CryptoPP::AES::BLOCKSIZE);
+	if (!last && fullBlocks != length)
+		throw std::length_error("only the last chunk may be a partial block");
+	if (cipher.size() < (last ? fullBlocks + CryptoPP::AES::BLOCKSIZE : fullBlocks))
+		throw std::length_error("cipher buffer is too small");
+
+	CryptoPP::AES::Encryption aesEncryption(_key, DEFAULT_KEYLENGTH);
+	CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption(aesEncryption, chain);
+	if (fullBlocks > 0)
+		cbcEncryption.ProcessData(cipher.data(), plain.data(), fullBlocks);
+
+	size_t written = fullBlocks;
+	if (last)
+	{
+		const size_t rest = length - fullBlocks;
+		CryptoPP::byte block[CryptoPP::AES::BLOCKSIZE];
+		memcpy(block, plain.data() + fullBlocks, rest);
+		memset(block + rest, static_cast<int>(CryptoPP::AES::BLOCKSIZE - rest), CryptoPP::AES::BLOCKSIZE - rest);
+		cbcEncryption.ProcessData(cipher.data() + fullBlocks, block, CryptoPP::AES::BLOCKSIZE);
+		written += CryptoPP::AES::BLOCKSIZE;
+	}
+	if (written > 0)
+		memcpy(chain, cipher.data() + written - CryptoPP::AES::BLOCKSIZE, CryptoPP::AES::BLOCKSIZE);
+	return written;
+}
+
+/* encrypt one chunk of a stream into cipher, the chaining block carries over to the next chunk so the
+concatenated output equals encrypt() of the whole stream. only the last chunk may be a partial block and gets the padding */
+unsigned int AESWrapper::encryptChunk(const char* plain, unsigned int length, unsigned char* cipher, bool last)
+{
+	return static_cast<unsigned int>(encryptChunk(ConstByteSpan(reinterpret_cast<const uint8_t*>(plain), length),
+		ByteSpan(cipher, last ? cipherSize(length) : length), last));
+}
+
+size_t AESWrapper::encryptChunk(ConstByteSpan plain, ByteSpan cipher, bool last)
+{
+	return encryptBlocks(_chain, plain, cipher, last);
+}
+
+std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
+{
+	std::string decrypted(length, '\0');
+	decrypted.resize(decrypt(ConstByteSpan(reinterpret_cast<const uint8_t*>(cipher), length), ByteSpan(reinterpret_cast<uint8_t*>(&decrypted[0]), length)));
+	return decrypted;
+}
+
+size_t AESWrapper::decrypt(ConstByteSpan cipher, ByteSpan plain) const
+{
+	unsigned char iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+	return decryptBlocks(iv, cipher, plain, true);
+}
+
+/* CBC decrypt cipher into plain continuing from chain, the counterpart of encryptBlocks. cipher is whole blocks,
+the padding is checked and removed from the last part of a message - returns the number of plain bytes */
+size_t AESWrapper::decryptBlocks(unsigned char* chain, ConstByteSpan cipher, ByteSpan plain, bool last) const
+{
+	const size_t length = cipher.size();
+	TRACE_SCOPE("aes.decrypt", length);
+	if (length % CryptoPP::AES::BLOCKSIZE != 0 || (last && length == 0))
+		throw std::length_error("cipher chunk must be whole blocks");
+	if (plain.size() < length)
+		throw std::length_error("plain buffer is too small");
+	if (length == 0)
+		return 0;
+
+	CryptoPP::byte nextChain[CryptoPP::AES::BLOCKSIZE];
+	memcpy(nextChain, cipher.data() + length - CryptoPP::AES::BLOCKSIZE, CryptoPP::AES::BLOCKSIZE);
+
+	CryptoPP::AES::Decryption aesDecryption(_key, DEFAULT_KEYLENGTH);
+	CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption(aesDecryption, chain);
+	cbcDecryption.ProcessData(plain.data(), cipher.data(), length);
+	memcpy(chain, nextChain, CryptoPP::AES::BLOCKSIZE);
+
+	if (!last)
+		return length;
+	const size_t padding = plain[length - 1];
+	if (padding == 0 || padding > CryptoPP::AES::BLOCKSIZE)
+		throw std::runtime_error("invalid padding");
+	for (size_t i = length - padding; i < length; i++)
+	{
+		if (plain[i] != padding)
+			throw std::runtime_error("invalid padding");
+	}
+	return length - padding;
+}
+
+/* decrypt one chunk of a CBC stream into plain, the counterpart of encryptChunk. cipher chunks are whole blocks,
+the padding is checked and removed from the last one - returns the number of plain bytes */
+unsigned int AESWrapper::decryptChunk(const unsigned char* cipher, unsigned int length, char* plain, bool last)
+{
+	return static_cast<unsigned int>(decryptChunk(ConstByteSpan(cipher, length), ByteSpan(reinterpret_cast<uint8_t*>(plain), length), last));
+}
+
+size_t AESWrapper::decryptChunk(ConstByteSpan cipher, ByteSpan plain, bool last)
+{
+	return decryptBlocks(_chain, cipher, plain, last);
+}
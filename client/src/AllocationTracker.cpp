@@ -0,0 +1,260 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <cstdlib>
+
+#ifdef TRACK_ALLOCATIONS
+
+/* counters of the calling thread, so the scanner threads do not show up in the scope of the upload loop */
+static thread_local uint64_t threadAllocations = 0;
+static thread_local uint64_t threadBytes = 0;
+static atomic<uint64_t> live(0);
+static atomic<uint64_t> totalAllocations(0);
+static atomic<uint64_t> totalBytes(0);
+static atomic<bool> exceeded(false);
+static thread_local AllocationScope* innermost = nullptr;
+
+/* the size is kept in front of the block so delete knows how much is freed */
+constexpr size_t SIZE_PREFIX = alignof(max_align_t);
+
+static void* trackedAllocate(size_t size)
+{
+	void* block = malloc(size + SIZE_PREFIX);
+	if (block == nullptr)
+	{
+		return nullptr;
+	}
+	*static_cast<size_t*>(block) = size;
+	threadAllocations++;
+	threadBytes += size;
+	live += size;
+	totalAllocations.fetch_add(1, memory_order_relaxed);
+	totalBytes.fetch_add(size, memory_order_relaxed);
+	return static_cast<uint8_t*>(block) + SIZE_PREFIX;
+}
+
+static void trackedFree(void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+	void* block = static_cast<uint8_t*>(memory) - SIZE_PREFIX;
+	live -= *static_cast<size_t*>(block);
+	free(block);
+}
+
+void* operator new(size_t size)
+{
+	void* memory = trackedAllocate(size);
+	if (memory == nullptr)
+	{
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	return trackedAllocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return trackedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete(void* memory, const nothrow_t&) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete[](void* memory, const nothrow_t&) noexcept
+{
+	trackedFree(memory);
+}
+
+bool AllocationTracker::enabled()
+{
+	return true;
+}
+
+uint64_t AllocationTracker::allocations()
+{
+	return threadAllocations;
+}
+
+uint64_t AllocationTracker::allocatedBytes()
+{
+	return threadBytes;
+}
+
+uint64_t AllocationTracker::liveBytes()
+{
+	return live;
+}
+
+uint64_t AllocationTracker::processAllocations()
+{
+	return totalAllocations;
+}
+
+uint64_t AllocationTracker::processBytes()
+{
+	return totalBytes;
+}
+
+bool AllocationTracker::limitExceeded()
+{
+	return exceeded;
+}
+
+void AllocationTracker::reportExceeded()
+{
+	exceeded = true;
+}
+
+AllocationScope::AllocationScope(const char* phase, uint64_t maxAllocations, uint64_t maxBytes)
+	: _phase(phase), _maxAllocations(maxAllocations), _maxBytes(maxBytes),
+	_startAllocations(threadAllocations), _startBytes(threadBytes), _outer(innermost)
+{
+	innermost = this;
+}
+
+AllocationScope::~AllocationScope()
+{
+	innermost = _outer;
+	const uint64_t count = allocations();
+	const uint64_t size = bytes();
+	const bool overCount = _maxAllocations != 0 && count > _maxAllocations;
+	const bool overBytes = _maxBytes != 0 && size > _maxBytes;
+	if (overCount || overBytes)
+	{
+		AllocationTracker::reportExceeded();
+		cerr << "allocation limit exceeded in " << _phase << ": " << count << " allocations (limit " << _maxAllocations
+			<< "), " << size << " bytes (limit " << _maxBytes << ")" << endl;
+	}
+	else if (_maxAllocations == 0 && _maxBytes == 0)
+	{
+		cerr << _phase << ": " << count << " allocations, " << size << " bytes, " << live << " bytes live" << endl;
+	}
+}
+
+uint64_t AllocationScope::allocations() const
+{
+	return threadAllocations - _startAllocations;
+}
+
+uint64_t AllocationScope::bytes() const
+{
+	return threadBytes - _startBytes;
+}
+
+/* a phase that needs memory proportional to its input (e.g. the block signatures of a delta upload) announces
+it, every enclosing scope with a limit accepts it on top of its own */
+void AllocationScope::allow(uint64_t allocations, uint64_t bytes)
+{
+	for (AllocationScope* scope = innermost; scope != nullptr; scope = scope->_outer)
+	{
+		if (scope->_maxAllocations != 0)
+		{
+			scope->_maxAllocations += allocations;
+		}
+		if (scope->_maxBytes != 0)
+		{
+			scope->_maxBytes += bytes;
+		}
+	}
+}
+
+#else
+
+bool AllocationTracker::enabled()
+{
+	return false;
+}
+
+uint64_t AllocationTracker::allocations()
+{
+	return 0;
+}
+
+uint64_t AllocationTracker::allocatedBytes()
+{
+	return 0;
+}
+
+uint64_t AllocationTracker::liveBytes()
+{
+	return 0;
+}
+
+uint64_t AllocationTracker::processAllocations()
+{
+	return 0;
+}
+
+uint64_t AllocationTracker::processBytes()
+{
+	return 0;
+}
+
+bool AllocationTracker::limitExceeded()
+{
+	return false;
+}
+
+void AllocationTracker::reportExceeded()
+{
+}
+
+AllocationScope::AllocationScope(const char* phase, uint64_t maxAllocations, uint64_t maxBytes)
+	: _phase(phase), _maxAllocations(maxAllocations), _maxBytes(maxBytes), _startAllocations(0), _startBytes(0), _outer(nullptr)
+{
+}
+
+AllocationScope::~AllocationScope()
+{
+}
+
+uint64_t AllocationScope::allocations() const
+{
+	return 0;
+}
+
+uint64_t AllocationScope::bytes() const
+{
+	return 0;
+}
+
+void AllocationScope::allow(uint64_t, uint64_t)
+{
+}
+
+#endif
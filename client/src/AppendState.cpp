@@ -0,0 +1,116 @@
+#include "AppendState.h"
+#include "RandomAccessFile.h"
+#include "Utils.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+
+AppendState::AppendState()
+{
+}
+
+AppendState::~AppendState()
+{
+}
+
+/* one line per file: length, CKsum, CKsum of the tail, last write time, then the name up to the end of the line */
+bool AppendState::load(const string& path)
+{
+	_entries.clear();
+	ifstream input(path);
+	if (!input)
+	{
+		return true;
+	}
+	string line;
+	while (getline(input, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		istringstream fields(line);
+		AppendEntry entry;
+		string name;
+		if (!(fields >> entry.length >> entry.crc >> entry.tailCRC >> entry.modified) || fields.get() != ' ' || !getline(fields, name) || name.empty())
+		{
+			_entries.clear();
+			return false;
+		}
+		_entries[name] = entry;
+	}
+	return true;
+}
+
+bool AppendState::save(const string& path) const
+{
+	const string temporary = path + ".tmp";
+	{
+		ofstream output(temporary, ios::trunc);
+		for (const auto& file : _entries)
+		{
+			output << file.second.length << ' ' << file.second.crc << ' ' << file.second.tailCRC << ' ' << file.second.modified << ' ' << file.first << '\n';
+		}
+		if (!output.flush())
+		{
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool AppendState::find(const string& name, AppendEntry& entry) const
+{
+	auto found = _entries.find(name);
+	if (found == _entries.end())
+	{
+		return false;
+	}
+	entry = found->second;
+	return true;
+}
+
+void AppendState::update(const string& name, const AppendEntry& entry)
+{
+	_entries[name] = entry;
+}
+
+void AppendState::forget(const string& name)
+{
+	_entries.erase(name);
+}
+
+/* a file that was rewritten and not appended to almost never keeps the bytes the last upload ended with */
+bool AppendState::tailCRC(RandomAccessFile& file, uint64_t length, uint32_t& crc)
+{
+	uint8_t tail[APPEND_TAIL_SIZE];
+	const size_t wanted = static_cast<size_t>(std::min<uint64_t>(length, APPEND_TAIL_SIZE));
+	size_t read = 0;
+	if (!file.readAt(length - wanted, tail, wanted, read) || read != wanted)
+	{
+		return false;
+	}
+	crc = Utils::crc32Update(0, ConstByteSpan(tail, wanted));
+	return true;
+}
+
+/* a write inside the content that was uploaded keeps the size and may miss the tail, only reading all of it again
+proves the server copy is still a prefix of the file. the bytes are read, never sent */
+bool AppendState::prefixCRC(RandomAccessFile& file, uint64_t length, ByteSpan buffer, uint32_t& crc)
+{
+	crc = 0;
+	for (uint64_t offset = 0; offset < length;)
+	{
+		const size_t wanted = static_cast<size_t>(std::min<uint64_t>(length - offset, buffer.size()));
+		size_t read = 0;
+		if (!file.readAt(offset, buffer.data(), wanted, read) || read != wanted)
+		{
+			return false;
+		}
+		crc = Utils::crc32Update(crc, ConstByteSpan(buffer.data(), wanted));
+		offset += wanted;
+	}
+	return true;
+}
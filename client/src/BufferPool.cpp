@@ -0,0 +1,253 @@
+#include "BufferPool.h"
+#include "MemoryBudget.h"
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+constexpr size_t DEFAULT_LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+static size_t largePageSize()
+{
+#ifdef _WIN32
+	const size_t size = GetLargePageMinimum();
+	return size == 0 ? DEFAULT_LARGE_PAGE_SIZE : size;
+#else
+	return DEFAULT_LARGE_PAGE_SIZE;
+#endif
+}
+
+BufferPool::BufferPool(size_t blockSize, size_t maxBlocks, MemoryBudget* budget, bool largePages)
+	: _blockSize(roundUp(blockSize, CACHE_LINE_SIZE)), _maxBlocks(maxBlocks), _totalBlocks(0), _budget(budget), _largePages(largePages)
+{
+	/* the free list and the slabs never reallocate once the pool is in use, a slab holds at least one block */
+	_free.reserve(_maxBlocks);
+	_slabs.reserve(_maxBlocks);
+}
+
+BufferPool::~BufferPool()
+{
+	for (const Slab& slab : _slabs)
+	{
+		freeSlab(slab.memory, slab.size, slab.onLargePages);
+		if (_budget != nullptr)
+		{
+			_budget->release(slab.size);
+		}
+	}
+}
+
+size_t BufferPool::blockSize() const
+{
+	return _blockSize;
+}
+
+/* allocate a slab of cache line aligned memory, large pages are used only if the system grants them */
+uint8_t* BufferPool::allocateSlab(size_t size, bool largePages, bool& onLargePages)
+{
+	onLargePages = false;
+#ifdef _WIN32
+	if (largePages)
+	{
+		void* memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (memory != nullptr)
+		{
+			onLargePages = true;
+			return static_cast<uint8_t*>(memory);
+		}
+	}
+	return static_cast<uint8_t*>(_aligned_malloc(size, CACHE_LINE_SIZE));
+#else
+	if (largePages)
+	{
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED)
+		{
+			onLargePages = true;
+			return static_cast<uint8_t*>(memory);
+		}
+	}
+	return static_cast<uint8_t*>(aligned_alloc(CACHE_LINE_SIZE, size));
+#endif
+}
+
+void BufferPool::freeSlab(uint8_t* slab, size_t size, bool onLargePages)
+{
+#ifdef _WIN32
+	(void)size;
+	if (onLargePages)
+		VirtualFree(slab, 0, MEM_RELEASE);
+	else
+		_aligned_free(slab);
+#else
+	if (onLargePages)
+		munmap(slab, size);
+	else
+		free(slab);
+#endif
+}
+
+/* add one slab of blocks to the pool, the memory is taken from the budget first.
+without wait the pool does not grow while the budget is exhausted */
+bool BufferPool::grow(bool wait)
+{
+	size_t slabSize = _blockSize;
+	if (_largePages)
+	{
+		slabSize = roundUp(_blockSize, largePageSize());
+	}
+	if (_budget != nullptr && !(wait ? _budget->acquire(slabSize) : _budget->tryAcquire(slabSize)))
+	{
+		return false;
+	}
+	bool onLargePages = false;
+	uint8_t* memory = allocateSlab(slabSize, _largePages, onLargePages);
+	if (memory == nullptr)
+	{
+		if (_budget != nullptr)
+		{
+			_budget->release(slabSize);
+		}
+		return false;
+	}
+
+	lock_guard<mutex> guard(_lock);
+	_slabs.push_back({ memory, slabSize, onLargePages });
+	for (size_t offset = 0; offset + _blockSize <= slabSize && _totalBlocks < _maxBlocks; offset += _blockSize)
+	{
+		_free.push_back(memory + offset);
+		_totalBlocks++;
+	}
+	return true;
+}
+
+BufferPool::Lease BufferPool::lease()
+{
+	unique_lock<mutex> guard(_lock);
+	while (_free.empty())
+	{
+		if (_totalBlocks < _maxBlocks)
+		{
+			/* once the pool has blocks a returned one is waited for instead of budget
+			the pool itself holds - that budget is never released while the pool lives */
+			const bool first = _totalBlocks == 0;
+			guard.unlock();
+			const bool grown = grow(first);
+			guard.lock();
+			if (grown)
+			{
+				continue;
+			}
+			if (first)
+			{
+				return Lease();
+			}
+		}
+		if (_free.empty())
+		{
+			_returned.wait(guard);
+		}
+	}
+	uint8_t* block = _free.back();
+	_free.pop_back();
+	return Lease(this, block);
+}
+
+BufferPool::Lease BufferPool::tryLease()
+{
+	unique_lock<mutex> guard(_lock);
+	if (_free.empty())
+	{
+		if (_totalBlocks >= _maxBlocks || (_budget != nullptr && _budget->inUse() + _blockSize > _budget->limit()))
+		{
+			return Lease();
+		}
+		guard.unlock();
+		if (!grow(false))
+		{
+			return Lease();
+		}
+		guard.lock();
+		if (_free.empty())
+		{
+			return Lease();
+		}
+	}
+	uint8_t* block = _free.back();
+	_free.pop_back();
+	return Lease(this, block);
+}
+
+void BufferPool::giveBack(uint8_t* block)
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_free.push_back(block);
+	}
+	_returned.notify_one();
+}
+
+BufferPool::Lease::Lease() : _pool(nullptr), _block(nullptr)
+{
+}
+
+BufferPool::Lease::Lease(BufferPool* pool, uint8_t* block) : _pool(pool), _block(block)
+{
+}
+
+BufferPool::Lease::Lease(Lease&& other) noexcept : _pool(other._pool), _block(other._block)
+{
+	other._pool = nullptr;
+	other._block = nullptr;
+}
+
+BufferPool::Lease& BufferPool::Lease::operator=(Lease&& other) noexcept
+{
+	if (this != &other)
+	{
+		reset();
+		_pool = other._pool;
+		_block = other._block;
+		other._pool = nullptr;
+		other._block = nullptr;
+	}
+	return *this;
+}
+
+BufferPool::Lease::~Lease()
+{
+	reset();
+}
+
+uint8_t* BufferPool::Lease::data() const
+{
+	return _block;
+}
+
+size_t BufferPool::Lease::size() const
+{
+	return _pool == nullptr ? 0 : _pool->blockSize();
+}
+
+bool BufferPool::Lease::valid() const
+{
+	return _block != nullptr;
+}
+
+/* return the block to its pool */
+void BufferPool::Lease::reset()
+{
+	if (_pool != nullptr && _block != nullptr)
+	{
+		_pool->giveBack(_block);
+	}
+	_pool = nullptr;
+	_block = nullptr;
+}
@@ -1,681 +1,2553 @@
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <boost/asio.hpp>
-#include <boost/array.hpp>
-#include <boost/crc.hpp>
-#include <boost/algorithm/string.hpp>
-#include <iostream>
-#include <iomanip>
-#include <boost/algorithm/hex.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
-#include <limits>
-#include "ClientLogic.h"
-#include "RSAWrapper.h"
-#include "AESWrapper.h"
-#include "Utils.h"
-#include "rsa.h"
-#include "osrng.h"
-
-using boost::asio::ip::tcp;
-using namespace boost::asio;
-
-/* stop client for runing - Fatal Error was made */
-void ClientLogic::clientStop(const string& error)
-{
-	std::cout << "Fatal Error: " << error << std::endl << "Client will stop." << std::endl;
-	system("pause");
-	exit(1);
-}
-
-ClientLogic::ClientLogic() : _fileHandler(nullptr), _socket(nullptr), _RSAPair(nullptr)
-{
-	_fileHandler = new FileHandler();
-	_socket = new SocketHandler();
-	_RSAPair = new RSAPrivateWrapper();
-	_succseed = false;
-	_clientCRC = 0;
-
-}
-
-ClientLogic::~ClientLogic()
-{
-	delete _fileHandler;
-	delete _socket;
-	delete _RSAPair;
-}
-
-/* unpack server response */
-ServerResponse* ClientLogic::unpackResponse(vector<uint8_t> responseBuffer, const uint32_t size)
-{
-	ServerResponse* res = new ServerResponse;
-
-	/* unpack and copy the server response header */
-	res->header.version = responseBuffer[0];
-	res->header.code = *reinterpret_cast<uint16_t*>(&responseBuffer[VERSION_SIZE]);
-	res->header.payloadSize = *reinterpret_cast<uint32_t*>(&responseBuffer[VERSION_SIZE + CODE_SIZE]);
-
-	/* validate the header */
-	if (res->header.version != VERSION)
-	{
-		return nullptr;
-	}
-
-	/* unpack and copy the server response payload */
-	uint32_t leftOver = size - HEADER_SIZE;
-	if (res->header.payloadSize < leftOver)
-		leftOver = res->header.payloadSize;
-	res->payload.payload = new uint8_t[leftOver];
-	memcpy(res->payload.payload, responseBuffer.data() + HEADER_SIZE, leftOver);
-
-	return res;
-}
-
-
-/* caulcalate CRC In order to verify the sending of the file to the server */
-uint32_t ClientLogic::caulcalateCRC(string fileContent)
-{
-	boost::crc_32_type crc_calculator;
-	crc_calculator.process_bytes(fileContent.data(), fileContent.size());
-	uint32_t crc = crc_calculator.checksum();
-	return crc;
-}
-string ClientLogic::encryptFileUsingAESKey(string fileContent)
-{
-	AESWrapper aes((unsigned char*)_AESKey.c_str(), AESWrapper::DEFAULT_KEYLENGTH);
-
-	cout << "content file size " << fileContent.size() << endl;
-	std::string ciphertext = aes.encrypt(fileContent.c_str(), fileContent.size());
-	return ciphertext;
-}
-
-/* extract AES symmetric key using client RSA private key */
-string ClientLogic::extractAESKey(uint8_t* payload, uint32_t len)
-{
-	/* get the client private key from me.info */
-	string base64key = _fileHandler->extractBase64privateKey(CLIENT_INFO);
-
-	RSAPrivateWrapper rsapriv_other(Utils::decode(base64key));
-
-	/* get the AES key using client private key */
-	_AESKey = rsapriv_other.decrypt(reinterpret_cast<const char*>(&payload[UID_SIZE]), len - UID_SIZE);
-
-	return _AESKey;
-}
-
-/* parse transfer info file and initialize the socket info */
-bool ClientLogic::parseAndStoreTransferInfo(const string& transferInfoPath)
-{
-	if (!_fileHandler->openFile(transferInfoPath))
-	{
-		return false;
-	}
-	string serverInfo;
-	_fileHandler->readLine(serverInfo);
-	size_t spos = serverInfo.find(":");
-	if (spos == std::string::npos)
-	{
-		return false;
-	}
-	string address = serverInfo.substr(0, spos);
-	string port = serverInfo.substr(spos + 1);
-	port.erase(port.size() - 1);
-	/* initialize socket */
-	if (!_socket->initializeSocketInfo(address, port))
-	{
-		clientStop("cannot initialize client socket for communiction");
-	}
-
-	_fileHandler->readLine(_userName);
-	_userName.erase(_userName.size() - 1);
-	if (_userName.size() > MAX_NAME_SIZE)
-	{
-		return false;
-	}
-	_fileHandler->readLine(_filePath);
-	_fileHandler->closeFile();
-	return true;
-}
-
-/* parse and store client info details */
-bool ClientLogic::parseAndStoreClientInfo()
-{
-	/* get the RSA public key */
-	_publicKey = _RSAPair->getPublicKey();
-
-	/* get the RSA private key decoded as base64 using Base64Wrapper */
-	_base64privateKey = Utils::encode(_RSAPair->getPrivateKey());
-
-	if (!_fileHandler->openFile(CLIENT_INFO, false))
-	{
-		return false;
-	}
-
-	/* write the client info into me.info file */
-	_fileHandler->writeLine(_userName);
-	_fileHandler->writeLine(_clientUID);
-	_fileHandler->writeAtOnce(_base64privateKey);
-	_fileHandler->closeFile();
-	return true;
-}
-
-/* prepare the registeration request */
-void ClientLogic::createRegisterationRequest(vector<uint8_t>& requestBuffer, bool reconnect)
-{
-	/* create new registeration request */
-	RegisterationRequest request(REGISTRATION_REQUEST, NAME_SIZE);
-	if (reconnect)
-	{
-		/* client already before was registerd  */
-
-		/* prepare the header */
-		request.header.code = LOGIN_REQUEST;
-		std::string unhexUID = Utils::reverse_hexi(_clientUID);
-		unhexUID.copy(reinterpret_cast<char*>(request.header.uid), sizeof(request.header.uid));
-	}
-
-	/* pack the header */
-	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
-
-	/* pack the payload */
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, _userName.c_str(), _userName.length());//23 is where payload starts
-	memset(requestBuffer.data() + REQUEST_HEADER_SIZE + _userName.length(), '\0', FILE_NAME_SIZE - _userName.length());
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + _userName.length(), "\0", 1);//add null ptr for name
-}
-
-/* handle client register in the first time  */
-uint8_t* ClientLogic::handleRegisterationRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	ServerResponse* response = nullptr;
-	bool _connected = false;
-	for (int i = 0; i < MAX_SENDS; i++)
-	{
-		createRegisterationRequest(requestBuffer);
-		if (!_socket->write(requestBuffer))
-		{
-			clientStop("socket failure, The data cannot be write");
-		}
-		responseBuffer.clear();
-		responseBuffer.resize(PACKET_SIZE);
-		responseBuffer = _socket->read();
-		if (responseBuffer.empty())
-		{
-			clientStop("socket failure, The data cannot be read");
-		}
-		response = unpackResponse(responseBuffer, PACKET_SIZE);
-
-		if (response == nullptr)
-		{
-			clientStop("response header is not appropriate to the protocol");
-		}
-		if (response->header.code == ServerResponse::SResponseCode::REGISTRATION_REQUEST_FAILED)
-		{
-			clientStop("name is already seen in the database");
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::GENERAL_ERR)
-		{
-			continue;
-		}
-		if (response->header.code == ServerResponse::SResponseCode::REGISTRATION_REQUEST_SUCCESS)
-		{
-			_succseed = true;
-			break;
-		}
-
-	}
-	if (!_succseed)
-	{
-		clientStop("registration request failed");
-	}
-
-	/* parse the client UID from server response and return her */
-	response->payload.payload[UID_SIZE] = '\0';
-	return response->payload.payload;
-}
-
-/* after the client registers for the first time or when the reconnection fails -
-the client exchanges encryption keys with the server so that it can send the file to backup on the server encrypted */
-void ClientLogic::handlePublicKeyRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	ServerResponse* response = nullptr;
-	for (int i = 0; i < MAX_SENDS; i++)
-	{
-		createPublicKeyRequest(requestBuffer);
-		if (!_socket->write(requestBuffer))
-		{
-			clientStop("socket failure, The data cannot be write");
-		}
-		responseBuffer.clear();
-		responseBuffer.resize(PACKET_SIZE);
-		responseBuffer = _socket->read();
-		if (responseBuffer.empty())
-		{
-			clientStop("socket failure, The data cannot be read");
-		}
-
-		response = unpackResponse(responseBuffer, PACKET_SIZE);
-
-		if (response == nullptr)
-		{
-			clientStop("response header is not appropriate to the protocol");
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::GOT_PC_SEND_AES)
-		{
-			_succseed = true;
-			_AESKey = extractAESKey(response->payload.payload, response->header.payloadSize);
-			break;
-		}
-	}
-	if (!_succseed)
-	{
-		clientStop("registration request failed");
-	}
-
-}
-void ClientLogic::createPublicKeyRequest(vector<uint8_t>& requestBuffer)
-{
-	requestBuffer.clear();
-	requestBuffer.resize(PACKET_SIZE);
-	PublicKeyRequest request(PUBLIC_KEY_REQUEST, NAME_SIZE + PUBLIC_KEY_SIZE);
-
-	/* pack the header */
-	std::string unhexUID = Utils::reverse_hexi(_clientUID);
-	unhexUID.copy(reinterpret_cast<char*>(request.header.uid), sizeof(request.header.uid));
-	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
-
-	/* pack the payload */
-	memcpy(requestBuffer.data() + CLIENT_HEADER_SIZE, _userName.c_str(), NAME_SIZE);
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + NAME_SIZE, "\0", 1);//add null ptr for name
-	memcpy(requestBuffer.data() + CLIENT_HEADER_SIZE + NAME_SIZE, _publicKey.c_str(), PUBLIC_KEY_SIZE);
-}
-
-/* prepare the file storage request for backup */
-bool ClientLogic::createFileStorageRequest(vector<std::uint8_t>& requestBuffer)
-{
-	/* check if the payload size is smaller then the max excpected payload size  */
-	if (CONTENT_SIZE + FILE_NAME_SIZE + _encryptedContent.size() > std::numeric_limits<unsigned int>::max())
-	{
-		return false;
-	}
-
-	fileSendRequest request(FILE_SEND_REQUEST, CONTENT_SIZE + FILE_NAME_SIZE + _encryptedContent.size());
-	requestBuffer.clear();
-	requestBuffer.resize(request.header.payloadSize);
-
-	/* pack the header */
-	std::string unhexUID = Utils::reverse_hexi(_clientUID);
-	unhexUID.copy(reinterpret_cast<char*>(request.header.uid), sizeof(request.header.uid));
-	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
-
-	uint32_t contentSize = _encryptedContent.size();
-
-	/* extract file name for the client file path */
-	string fileName1 = _filePath.substr(_filePath.find_last_of("/\\") + 1);
-
-	/* pack the payload */
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, &contentSize, CONTENT_SIZE);
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + CONTENT_SIZE, fileName1.c_str(), FILE_NAME_SIZE);//check why FILE_NAME_SIZE
-	memset(requestBuffer.data() + REQUEST_HEADER_SIZE + CONTENT_SIZE + fileName1.length(), '\0', FILE_NAME_SIZE - fileName1.length());
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + CONTENT_SIZE + FILE_NAME_SIZE, _encryptedContent.c_str(), contentSize);
-
-	return true;
-}
-
-/* handle send client file for backup request */
-uint32_t ClientLogic::handleFileStorageRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	ServerResponse* response = nullptr;
-
-	for (int i = 0; i < MAX_SENDS; i++)
-	{
-		if (!createFileStorageRequest(requestBuffer))
-		{
-			clientStop("request payload size is greater then the expected in the protocol");
-		}
-
-		uint32_t payloadSize;
-		memcpy(&payloadSize, requestBuffer.data() + 19, CRC_SIZE); //19 is where the payload size gonna start
-		if (!_socket->writeChuncks(requestBuffer, payloadSize))
-		{
-			clientStop("socket failure, The data cannot be write");
-		}
-		responseBuffer.clear();
-		responseBuffer.resize(PACKET_SIZE);
-		responseBuffer = _socket->read();
-		if (responseBuffer.empty())
-		{
-			clientStop("socket failure, The data cannot be read");
-		}
-
-		response = unpackResponse(responseBuffer, PACKET_SIZE);
-
-		if (response == nullptr)
-		{
-			clientStop("response header is not appropriate to the protocol");
-		}
-		if (response->header.code == ServerResponse::SResponseCode::GENERAL_ERR)
-		{
-			continue;
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::GOT_FILE_SEND_CRC)
-		{
-			_succseed = true;
-			break;
-		}
-	}
-	if (!_succseed)
-	{
-		clientStop("file send request failed");
-	}
-	uint32_t serverCRC;
-	memcpy(&serverCRC, &(response->payload.payload)[FILE_NAME_SIZE + UID_SIZE + CONTENT_SIZE], CRC_SIZE);
-	return serverCRC;
-}
-
-/* handle crc ok, crc failed and retry crc requests */
-void ClientLogic::handleSendFileAndCRCRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	int i = 0;
-	ServerResponse* response = nullptr;
-	while (true)
-	{
-		uint32_t serverCRC = handleFileStorageRequest(requestBuffer, responseBuffer);
-		_succseed = false;
-		if (_clientCRC == serverCRC)
-		{
-			handleCRCIsOkREQUEST(requestBuffer, responseBuffer);
-			break;
-		}
-		else if (i + 1 != MAX_CRC_SEND)
-		{
-			handleRetryCRCRequest(requestBuffer);
-		}
-		else
-		{
-			handleFailedCRCRequest(requestBuffer, responseBuffer);
-			_socket->write(requestBuffer);
-			break;
-		}
-		i++;
-	}
-}
-
-/* prepare appropriate crc request */
-bool ClientLogic::createCRCValidateRequest(vector<uint8_t>& requestBuffer, bool validate)
-{
-	requestBuffer.clear();
-	requestBuffer.resize(PACKET_SIZE);
-	CRCValidateRequest request(CRC_VALID_REQUEST, FILE_NAME_SIZE);
-
-	if (!validate)
-	{
-		request.header.code = CRC_FAILED_REQUEST;
-	}
-
-	/* pack the header */
-	std::string unhexUID = Utils::reverse_hexi(uid);
-	unhexUID.copy(reinterpret_cast<char*>(request.header.uid), sizeof(request.header.uid));
-	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
-
-	/* extract file name for the client file path */
-	string fileName = _filePath.substr(_filePath.find_last_of("/\\") + 1);
-
-	/* pack the payload */
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, fileName.c_str(), FILE_NAME_SIZE);//check why FILE_NAME_SIZE
-	memset(requestBuffer.data() + REQUEST_HEADER_SIZE + fileName.length(), '\0', FILE_NAME_SIZE - fileName.length());
-
-	return true;
-}
-
-/* when the check sum of the file are equel in both client-server side - handle crc ok request  */
-void ClientLogic::handleCRCIsOkREQUEST(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	ServerResponse* response = nullptr;
-
-	for (int i = 0; i < MAX_SENDS; i++)
-	{
-		createCRCValidateRequest(requestBuffer);
-		if (!_socket->write(requestBuffer))
-		{
-			clientStop("socket failure, The data cannot be write");
-		}
-		responseBuffer.clear();
-		responseBuffer.resize(PACKET_SIZE);
-		responseBuffer = _socket->read();
-
-		if (responseBuffer.empty())
-		{
-			clientStop("socket failure, The data cannot be read");
-		}
-		response = unpackResponse(responseBuffer, PACKET_SIZE);
-
-		if (response == nullptr)
-		{
-			clientStop("response header is not appropriate to the protocol");
-		}
-		if (response->header.code == ServerResponse::SResponseCode::GENERAL_ERR)
-		{
-			continue;
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::GOT_REQ_TNX)
-		{
-			_succseed = true;
-			break;
-		}
-
-	}
-	if (!_succseed)
-	{
-		clientStop("CRC ok request failed");
-	}
-}
-
-/* when the check sum response to the client request
-doesnt varified in the client side - send again the file for validation */
-void ClientLogic::handleRetryCRCRequest(vector<uint8_t>& requestBuffer)
-{
-	createCRCValidateRequest(requestBuffer, false);
-	if (!_socket->write(requestBuffer))
-	{
-		clientStop("socket failure, The data cannot be write");
-	}
-}
-
-bool ClientLogic::createCRCFailedRequest(vector<uint8_t>& requestBuffer)
-{
-	requestBuffer.clear();
-	CRCFailedRequest request(FOUR_FAILED_CRC_REQUEST, FILE_NAME_SIZE);
-
-	/* pack the header */
-	std::string unhexUID = Utils::reverse_hexi(uid);
-	unhexUID.copy(reinterpret_cast<char*>(request.header.uid), sizeof(request.header.uid));
-	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
-
-	/* extract file name for the client file path */
-	string fileName = _filePath.substr(_filePath.find_last_of("/\\") + 1);
-
-	/* pack the payload */
-	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, fileName.c_str(), FILE_NAME_SIZE);//check why FILE_NAME_SIZE
-	memset(requestBuffer.data() + REQUEST_HEADER_SIZE + fileName.length(), '\0', FILE_NAME_SIZE - fileName.length());
-	return true;
-}
-
-/* crc request failed in the four time - stop sending and inform the server about it  */
-void ClientLogic::handleFailedCRCRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	ServerResponse* response = nullptr;
-	for (int i = 0; i < MAX_SENDS; i++)
-	{
-
-		createCRCFailedRequest(requestBuffer);
-		if (!_socket->write(requestBuffer))
-		{
-			clientStop("socket failure, The data cannot be write");
-		}
-		responseBuffer.clear();
-		responseBuffer.resize(PACKET_SIZE);
-		responseBuffer = _socket->read();
-
-		if (responseBuffer.empty())
-		{
-			clientStop("socket failure, The data cannot be read");
-		}
-		response = unpackResponse(responseBuffer, PACKET_SIZE);
-
-		if (response == nullptr)
-		{
-			clientStop("response header is not appropriate to the protocol");
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::GENERAL_ERR)
-		{
-			continue;
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::GOT_REQ_TNX)
-		{
-			_succseed = true;
-			break;
-		}
-	}
-	if (!_succseed)
-	{
-		clientStop("failed CRC request failed");
-	}
-}
-
-/* client already sign in before to the server services -
-send recconect request then after it client will can send the file for backup */
-void ClientLogic::handleReconnectRequest(vector<uint8_t>& requestBuffer, vector<uint8_t>& responseBuffer)
-{
-	ServerResponse* response = nullptr;
-	for (int i = 0; i < MAX_SENDS; i++)
-	{
-		createRegisterationRequest(requestBuffer, true);
-		if (!_socket->write(requestBuffer))
-		{
-			clientStop("socket failure, The data cannot be write");
-		}
-		responseBuffer.clear();
-		responseBuffer.resize(PACKET_SIZE);
-		responseBuffer = _socket->read();
-		if (responseBuffer.empty())
-		{
-			clientStop("socket failure, The data cannot be read");
-		}
-
-		response = unpackResponse(responseBuffer, PACKET_SIZE);
-
-		if (response == nullptr)
-		{
-			clientStop("response header is not appropriate to the protocol");
-		}
-		if (response->header.code == ServerResponse::SResponseCode::GENERAL_ERR)
-		{
-			continue;
-		}
-		if (response->header.code == ServerResponse::SResponseCode::RECONNECT_FAILED)
-		{
-			/* reconnect failed: user name already exists on server database -
-			The client is re-registered as a new client and replaces with the server encryption keys */
-
-			_clientUID = Utils::hexi(handleRegisterationRequest(requestBuffer, responseBuffer), UID_SIZE);
-			handlePublicKeyRequest(requestBuffer, responseBuffer);
-			_succseed = true;
-			break;
-		}
-
-		if (response->header.code == ServerResponse::SResponseCode::LOGIN_SUCCESS_SEND_AES)
-		{
-			_succseed = true;
-			_AESKey = extractAESKey(response->payload.payload, response->header.payloadSize);
-			break;
-		}
-	}
-	if (!_succseed)
-	{
-		clientStop("registration request failed");
-	}
-}
-
-/* run the client in batch mode */
-void ClientLogic::clientMain()
-{
-	try 
-	{
-		vector<uint8_t> responseBuffer(PACKET_SIZE);
-		vector<uint8_t> requestBuffer(PACKET_SIZE);
-		if (!parseAndStoreTransferInfo(TRANSFER_INFO))
-		{
-			clientStop("couldn't parse file transfer details");
-		}
-
-		if (!_socket->connectToServer())
-		{
-			clientStop("failed to connect server");
-		}
-
-		if (!_fileHandler->checkFileExsistance(CLIENT_INFO))
-		{
-			/* the file me.info did not exist - the client registered for the first time */
-
-			_clientUID = Utils::hexi(handleRegisterationRequest(requestBuffer, responseBuffer), UID_SIZE);
-
-			_succseed = false;
-			responseBuffer.clear();
-			responseBuffer.resize(PACKET_SIZE);
-			if (!parseAndStoreClientInfo())
-			{
-				clientStop("failed create and store me info for client");
-			}
-			handlePublicKeyRequest(requestBuffer, responseBuffer);
-		}
-
-		else
-		{
-			/* The client has already registered before - the me.info file is found */
-
-			if (!_fileHandler->openFile(CLIENT_INFO))
-			{
-				clientStop("couldn't open me.info file");
-			}
-
-			/* parse client info and store them localy */
-			_fileHandler->readLine(_userName);
-			_userName.erase(_userName.size() - 1);
-			_fileHandler->readLine(_clientUID);
-			_clientUID.erase(_clientUID.size() - 1);
-			_fileHandler->closeFile();
-
-			_succseed = false;
-
-			handleReconnectRequest(requestBuffer, responseBuffer);
-		}
-
-		/* there is no such file in the client path */
-		if (!_fileHandler->checkFileExsistance(_filePath))
-		{
-			clientStop("wrong path to client file");
-		}
-
-		/* parse file content and send it to the server for backup */
-		string fileContent = _fileHandler->extractFileContent(_filePath);
-
-		/* caulcalate the client file CKsum */
-		_clientCRC = caulcalateCRC(fileContent);
-
-		_encryptedContent = encryptFileUsingAESKey(fileContent);//here is the problen the buffer is change in this function
-
-		handleSendFileAndCRCRequest(requestBuffer, responseBuffer);
-	}
-	catch (const std::exception& e)
-	{
-		throw e;
-	}
-
-}
-
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <boost/asio.hpp>
+#include <boost/array.hpp>
+#include <boost/crc.hpp>
+#include <boost/algorithm/string.hpp>
+#include <iostream>
+#include <iomanip>
+#include <boost/algorithm/hex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include "ClientLogic.h"
+#include "RSAWrapper.h"
+#include "AESWrapper.h"
+#include "AESLanes.h"
+#include "Utils.h"
+#include "RandomAccessFile.h"
+#include "EncryptedStream.h"
+#include "DeltaEncoder.h"
+#include "Tracer.h"
+#include "rsa.h"
+#include "sha.h"
+#include "osrng.h"
+
+using boost::asio::ip::tcp;
+using namespace boost::asio;
+
+/* stop client for runing - Fatal Error was made */
+void ClientLogic::clientStop(const string& error)
+{
+	LOG_ERROR("client.stop", "error=\"%s\"", error.c_str());
+	Logger::instance().flush();
+	Tracer::instance().write();
+	system("pause");
+	exit(1);
+}
+
+ClientLogic::ClientLogic(const ClientOptions& options) : _fileHandler(nullptr), _socket(nullptr), _RSAPair(nullptr), _budget(nullptr), _packetPool(nullptr), _chunkPool(nullptr),
+	_scheduler(options.schedule), _loggedIn(false), _replicator(nullptr), _replicated(0),
+	_ring(nullptr), _shards(nullptr), _tuner(nullptr), _lookups(0), _deduplicated(0), _deduplicatedBytes(0)
+{
+	_fileHandler = new FileHandler();
+	_socket = new SocketHandler();
+	_RSAPair = new RSAPrivateWrapper();
+	_options = options;
+	_budget = new MemoryBudget(options.maxMemory);
+	_packetPool = new BufferPool(PACKET_SIZE, PACKET_POOL_BLOCKS);
+	_chunkPool = new BufferPool(CHUNK_SIZE + AES_BLOCK_SIZE, options.maxMemory / (CHUNK_SIZE + AES_BLOCK_SIZE), _budget, options.largePages);
+	_succseed = false;
+	_clientCRC = 0;
+	_fileSize = 0;
+	_nextSequence = 0;
+	_prepared = { "", { 0, 0 }, 0, 0, false };
+	_appended = false;
+
+}
+
+ClientLogic::~ClientLogic()
+{
+	delete _fileHandler;
+	delete _socket;
+	delete _RSAPair;
+	delete _replicator;
+	delete _shards;
+	delete _ring;
+	delete _tuner;
+	delete _packetPool;
+	delete _chunkPool;
+	delete _budget;
+}
+
+/* keep the client ID both as hex (me.info) and as raw bytes (request headers) */
+void ClientLogic::setClientUID(const string& hexUID)
+{
+	_clientUID = hexUID;
+	_rawClientUID = Utils::reverse_hexi(hexUID);
+}
+
+void ClientLogic::packClientID(ClientRequestHeader& header) const
+{
+	_rawClientUID.copy(reinterpret_cast<char*>(header.uid), sizeof(header.uid));
+}
+
+/* unpack server response - the payload is not copied, it points into the response buffer */
+bool ClientLogic::unpackResponse(const uint8_t* responseBuffer, const uint32_t size, ServerResponse& response)
+{
+	/* unpack and copy the server response header */
+	response.header.version = responseBuffer[0];
+	memcpy(&response.header.code, responseBuffer + VERSION_SIZE, CODE_SIZE);
+	memcpy(&response.header.payloadSize, responseBuffer + VERSION_SIZE + CODE_SIZE, PAYLOAD_SIZE);
+
+	/* validate the header */
+	if (response.header.version != VERSION || size < HEADER_SIZE)
+	{
+		return false;
+	}
+
+	/* the payload left in this packet */
+	response.payload.payload = const_cast<uint8_t*>(responseBuffer) + HEADER_SIZE;
+	return true;
+}
+
+/* stream the file to the server: every chunk is read, added to the CKsum, encrypted and sent.
+the chunks are leased from the chunk pool, which is charged to the memory budget, so memory stays bounded
+by the chunk size and not by the file size. a file of a few chunks or more goes through the pipeline,
+which reads, encrypts and sends different chunks at the same time */
+bool ClientLogic::streamFileContent(uint32_t contentSize)
+{
+	if (!_fileHandler->openFile(_filePath))
+	{
+		return false;
+	}
+	AESWrapper aes((unsigned char*)_AESKey.c_str(), AESWrapper::DEFAULT_KEYLENGTH);
+	boost::crc_32_type crc_calculator;
+	uint64_t left = _fileSize;
+	uint32_t sent = 0;
+
+	/* the first read of the file is shared with the replicas, they need the CKsum up to every chunk */
+	const bool shared = _replicator != nullptr && _replicator->beginPass(_replicated, _fileSize);
+
+	/* the head of a file prepared during the handshake is already in the CKsum */
+	uint64_t checked = 0;
+	if (_prepared.active && !shared)
+	{
+		crc_calculator = boost::crc_32_type(_prepared.remainder);
+		checked = _prepared.bytes;
+	}
+	_prepared.active = false;
+
+	/* the pooled block has room for the padding, so every chunk is encrypted in place */
+	PipelineExecutor pipeline(*_chunkPool);
+	const bool streamed = pipeline.run(
+		[this, &left](PipelineBlock& block)
+		{
+			const size_t wanted = static_cast<size_t>(std::min<uint64_t>(left, CHUNK_SIZE));
+			TRACE_SCOPE("file.read", wanted);
+			block.offset = _fileSize - left;
+			block.length = _fileHandler->readChunk(ByteSpan(block.lease.data(), wanted));
+			left -= block.length;
+			block.last = left == 0;
+			/* file was truncated while we were sending it */
+			return block.length == wanted;
+		},
+		[this, &aes, &crc_calculator, checked, shared](PipelineBlock& block)
+		{
+			if (block.offset >= checked)
+			{
+				TRACE_SCOPE("crc", block.length);
+				crc_calculator.process_bytes(block.lease.data(), block.length);
+			}
+			if (shared)
+			{
+				_replicator->publish(ConstByteSpan(block.lease.data(), block.length), block.offset, static_cast<uint32_t>(crc_calculator.checksum()));
+			}
+			block.length = aes.encryptChunk(ConstByteSpan(block.lease.data(), block.length), ByteSpan(block.lease.data(), block.lease.size()), block.last);
+			return true;
+		},
+		[this, &sent](PipelineBlock& block)
+		{
+			sent += static_cast<uint32_t>(block.length);
+			return _socket->writeBytes(block.lease.data(), block.length);
+		},
+		_fileSize >= PIPELINE_MIN_SIZE);
+	_fileHandler->closeFile();
+	if (shared)
+	{
+		_replicator->endPass();
+	}
+	if (_tuner != nullptr)
+	{
+		_tuner->recordStages(pipeline.times());
+	}
+
+	_clientCRC = crc_calculator.checksum();
+	return streamed && sent == contentSize;
+}
+
+/* stream the data extents of a sparse file, the holes between them are not read. the CKsum is the one of
+the whole file - the holes are added to it as zeros without touching them */
+bool ClientLogic::streamSparseContent(RandomAccessFile& file, const vector<FileExtent>& extents, uint32_t contentSize)
+{
+	AESWrapper aes((unsigned char*)_AESKey.c_str(), AESWrapper::DEFAULT_KEYLENGTH);
+	uint32_t crc = 0;
+	uint64_t crcEnd = 0;
+	uint32_t sent = 0;
+	size_t extent = 0;
+	uint64_t done = 0;   // bytes of the current extent already read
+
+	PipelineExecutor pipeline(*_chunkPool);
+	const bool streamed = pipeline.run(
+		[&file, &extents, &extent, &done](PipelineBlock& block)
+		{
+			block.length = 0;
+			block.last = extent == extents.size();
+			if (block.last)
+			{
+				return true;
+			}
+			const FileExtent& current = extents[extent];
+			const size_t wanted = static_cast<size_t>(std::min<uint64_t>(current.length - done, CHUNK_SIZE));
+			block.offset = current.offset + done;
+			if (!file.readAt(block.offset, block.lease.data(), wanted, block.length) || block.length != wanted)
+			{
+				return false;
+			}
+			done += wanted;
+			if (done == current.length)
+			{
+				extent++;
+				done = 0;
+			}
+			block.last = extent == extents.size();
+			return true;
+		},
+		[&aes, &crc, &crcEnd](PipelineBlock& block)
+		{
+			crc = Utils::crc32Update(Utils::crc32ZeroExtend(crc, block.offset - crcEnd), ConstByteSpan(block.lease.data(), block.length));
+			crcEnd = block.offset + block.length;
+			block.length = aes.encryptChunk(ConstByteSpan(block.lease.data(), block.length), ByteSpan(block.lease.data(), block.lease.size()), block.last);
+			return true;
+		},
+		[this, &sent](PipelineBlock& block)
+		{
+			sent += static_cast<uint32_t>(block.length);
+			return _socket->writeBytes(block.lease.data(), block.length);
+		},
+		contentSize >= PIPELINE_MIN_SIZE);
+
+	_clientCRC = Utils::crc32ZeroExtend(crc, _fileSize - crcEnd);
+	return streamed && sent == contentSize;
+}
+
+/* the data extents of an open file when it has enough holes to be sent as a sparse file, false when it goes whole */
+bool ClientLogic::sparseExtents(RandomAccessFile& file, vector<FileExtent>& extents, uint64_t& dataSize)
+{
+	if (!file.dataExtents(extents, MAX_SPARSE_EXTENTS))
+	{
+		return false;
+	}
+	dataSize = 0;
+	for (const FileExtent& extent : extents)
+	{
+		dataSize += extent.length;
+	}
+	const uint64_t mapSize = static_cast<uint64_t>(extents.size()) * EXTENT_SIZE;
+	return file.size() - dataSize >= SPARSE_MIN_HOLES
+		&& CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + COUNT_SIZE + mapSize + dataSize + AES_BLOCK_SIZE <= std::numeric_limits<unsigned int>::max();
+}
+
+/* send the file as its extent map and its data extents when it has enough holes to be worth it,
+false when nothing was sent and the file goes as a whole */
+bool ClientLogic::sendSparseFile(BufferPool::Lease& requestBuffer)
+{
+	RandomAccessFile file;
+	vector<FileExtent> extents;
+	uint64_t dataSize;
+	if (!file.open(_filePath) || !sparseExtents(file, extents, dataSize))
+	{
+		return false;
+	}
+	_fileSize = file.size();
+	const uint64_t mapSize = static_cast<uint64_t>(extents.size()) * EXTENT_SIZE;
+	const uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(dataSize));
+	const uint32_t count = static_cast<uint32_t>(extents.size());
+
+	SparseFileRequest request(SPARSE_FILE_REQUEST, static_cast<payload_t>(CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + COUNT_SIZE + mapSize + contentSize));
+	memset(requestBuffer.data(), 0, SPARSE_SEND_HEADER_SIZE);
+	packClientID(request.header);
+	uint8_t* payload = requestBuffer.data() + REQUEST_HEADER_SIZE;
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(payload, &contentSize, CONTENT_SIZE);
+	memcpy(payload + CONTENT_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+	memcpy(payload + CONTENT_SIZE + FILE_NAME_SIZE, &_fileSize, FILE_SIZE_SIZE);
+	memcpy(payload + CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE, &count, COUNT_SIZE);
+	if (!_socket->writeBytes(requestBuffer.data(), SPARSE_SEND_HEADER_SIZE))
+	{
+		clientStop("socket failure, The data cannot be write");
+	}
+
+	/* the extent map goes through the request buffer a packet at a time */
+	size_t packed = 0;
+	for (const FileExtent& extent : extents)
+	{
+		memcpy(requestBuffer.data() + packed, &extent.offset, OFFSET_SIZE);
+		memcpy(requestBuffer.data() + packed + OFFSET_SIZE, &extent.length, FILE_SIZE_SIZE);
+		packed += EXTENT_SIZE;
+		if (packed + EXTENT_SIZE > PACKET_SIZE || &extent == &extents.back())
+		{
+			if (!_socket->writeBytes(requestBuffer.data(), packed))
+			{
+				clientStop("socket failure, The data cannot be write");
+			}
+			packed = 0;
+		}
+	}
+	if (!streamSparseContent(file, extents, contentSize))
+	{
+		clientStop("file content cannot be streamed to the server");
+	}
+	return true;
+}
+
+/* stream the bytes appended to the file since its last upload. the CKsum of the whole file is the stored one
+continued over the new bytes, the content before offset is not read again */
+bool ClientLogic::streamAppendedContent(RandomAccessFile& file, uint64_t offset, uint32_t storedCRC, uint32_t contentSize)
+{
+	AESWrapper aes((unsigned char*)_AESKey.c_str(), AESWrapper::DEFAULT_KEYLENGTH);
+	uint32_t crc = storedCRC;
+	uint64_t next = offset;
+	uint32_t sent = 0;
+
+	PipelineExecutor pipeline(*_chunkPool);
+	const bool streamed = pipeline.run(
+		[this, &file, &next](PipelineBlock& block)
+		{
+			const size_t wanted = static_cast<size_t>(std::min<uint64_t>(_fileSize - next, CHUNK_SIZE));
+			block.offset = next;
+			if (!file.readAt(next, block.lease.data(), wanted, block.length) || block.length != wanted)
+			{
+				return false;
+			}
+			next += wanted;
+			block.last = next == _fileSize;
+			return true;
+		},
+		[&aes, &crc](PipelineBlock& block)
+		{
+			crc = Utils::crc32Update(crc, ConstByteSpan(block.lease.data(), block.length));
+			block.length = aes.encryptChunk(ConstByteSpan(block.lease.data(), block.length), ByteSpan(block.lease.data(), block.lease.size()), block.last);
+			return true;
+		},
+		[this, &sent](PipelineBlock& block)
+		{
+			sent += static_cast<uint32_t>(block.length);
+			return _socket->writeBytes(block.lease.data(), block.length);
+		},
+		contentSize >= PIPELINE_MIN_SIZE);
+
+	_clientCRC = crc;
+	return streamed && sent == contentSize;
+}
+
+/* send only the bytes appended to the file since its last upload, false when nothing was sent and the file goes
+as a whole - there is no state for it, it did not grow or the content its last upload ended at changed. an appended
+file always has a new write time, so the whole uploaded prefix is read again and compared to its stored CKsum */
+bool ClientLogic::sendAppendedFile(BufferPool::Lease& requestBuffer)
+{
+	_appended = false;
+	AppendEntry entry;
+	RandomAccessFile file;
+	if (!_options.append || !_appendState.find(_fileName, entry) || !file.open(_filePath))
+	{
+		return false;
+	}
+	_fileSize = file.size();
+	uint32_t tailCRC;
+	if (_fileSize <= entry.length || !AppendState::tailCRC(file, entry.length, tailCRC) || tailCRC != entry.tailCRC
+		|| CONTENT_SIZE + FILE_NAME_SIZE + OFFSET_SIZE + (_fileSize - entry.length) + AES_BLOCK_SIZE > std::numeric_limits<unsigned int>::max())
+	{
+		return false;
+	}
+	{
+		TRACE_SCOPE("file.append.verify", entry.length);
+		BufferPool::Lease chunk = _chunkPool->lease();
+		uint32_t prefixCRC;
+		if (!chunk.valid() || !AppendState::prefixCRC(file, entry.length, ByteSpan(chunk.data(), chunk.size()), prefixCRC)
+			|| prefixCRC != entry.crc)
+		{
+			LOG_DEBUG("file.append.mismatch", "name=\"%s\"", _fileName.c_str());
+			return false;
+		}
+	}
+	const uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(_fileSize - entry.length));
+	LOG_DEBUG("file.append", "name=\"%s\" stored=%llu size=%llu", _fileName.c_str(),
+		static_cast<unsigned long long>(entry.length), static_cast<unsigned long long>(_fileSize));
+
+	AppendFileRequest request(APPEND_FILE_REQUEST, CONTENT_SIZE + FILE_NAME_SIZE + OFFSET_SIZE + contentSize);
+	memset(requestBuffer.data(), 0, APPEND_SEND_HEADER_SIZE);
+	packClientID(request.header);
+	uint8_t* payload = requestBuffer.data() + REQUEST_HEADER_SIZE;
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(payload, &contentSize, CONTENT_SIZE);
+	memcpy(payload + CONTENT_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+	memcpy(payload + CONTENT_SIZE + FILE_NAME_SIZE, &entry.length, OFFSET_SIZE);
+	if (!_socket->writeBytes(requestBuffer.data(), APPEND_SEND_HEADER_SIZE))
+	{
+		clientStop("socket failure, The data cannot be write");
+	}
+	if (!streamAppendedContent(file, entry.length, entry.crc, contentSize))
+	{
+		clientStop("file content cannot be streamed to the server");
+	}
+	_appended = true;
+	return true;
+}
+
+/* a file that still has the length, the write time and the tail its last upload ended with was not touched since,
+a write in place keeps the length but moves the write time */
+bool ClientLogic::unchangedSinceAppend(const UploadJob& job, const FileStamp& stamp)
+{
+	AppendEntry entry;
+	RandomAccessFile file;
+	uint32_t tailCRC;
+	return _options.append && _appendState.find(job.name, entry) && stamp.modified == entry.modified && stamp.size == entry.length
+		&& file.open(_filePath) && file.size() == entry.length && AppendState::tailCRC(file, entry.length, tailCRC) && tailCRC == entry.tailCRC;
+}
+
+/* remember what the server keeps of the file now, its next upload sends only what gets appended after it. stamp is
+the file as it was before it was read, a file that changed size meanwhile was read in the middle of a write and
+its state is dropped so the next upload sends it whole */
+void ClientLogic::recordAppendState(const FileStamp& stamp)
+{
+	RandomAccessFile file;
+	AppendEntry entry = { _fileSize, _clientCRC, 0, stamp.modified };
+	if (stamp.size != _fileSize || !file.open(_filePath) || !AppendState::tailCRC(file, _fileSize, entry.tailCRC))
+	{
+		_appendState.forget(_fileName);
+		return;
+	}
+	_appendState.update(_fileName, entry);
+}
+
+/* ask for one page of the block signatures the server keeps for the stored copy of the file */
+bool ClientLogic::requestSignatures(BufferPool::Lease& page, uint32_t startIndex, ServerResponse& response)
+{
+	memset(page.data(), 0, PACKET_SIZE);
+	SignaturesRequest request(SIGNATURES_REQUEST, SIGNATURES_PAYLOAD_SIZE);
+	packClientID(request.header);
+	memcpy(page.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(page.data() + REQUEST_HEADER_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+	memcpy(page.data() + REQUEST_HEADER_SIZE + FILE_NAME_SIZE, &startIndex, COUNT_SIZE);
+	if (!_socket->write(page.data()) || !readResponse(*_socket, page.data(), page.size(), response))
+	{
+		clientStop("socket failure, The signatures cannot be read");
+	}
+	return response.header.code == ServerResponse::SResponseCode::FILE_SIGNATURES && response.header.payloadSize >= SIGNATURES_HEADER_SIZE;
+}
+
+/* stream the ops of a delta: the bytes between the matches are read again and sent as literals,
+every run of matched blocks becomes one copy */
+bool ClientLogic::streamDeltaContent(RandomAccessFile& file, const vector<BlockMatch>& matches, uint32_t blockSize, uint32_t contentSize)
+{
+	EncryptedStream stream(*_chunkPool, _AESKey, *_socket);
+	if (!stream.valid())
+	{
+		clientStop("memory budget is smaller than a single transfer chunk");
+	}
+	auto literal = [this, &file, &stream](uint64_t offset, uint64_t end) -> bool
+	{
+		uint8_t header[DELTA_LITERAL_HEADER_SIZE] = { DELTA_LITERAL };
+		const uint32_t length = static_cast<uint32_t>(end - offset);
+		memcpy(header + 1, &length, CONTENT_SIZE);
+		if (!stream.put(header, DELTA_LITERAL_HEADER_SIZE))
+		{
+			return false;
+		}
+		while (offset < end)
+		{
+			size_t wanted = static_cast<size_t>(std::min<uint64_t>(end - offset, CHUNK_SIZE));
+			uint8_t* target = stream.space(wanted);
+			size_t read = 0;
+			/* file was changed since it was matched */
+			if (!file.readAt(offset, target, wanted, read) || read != wanted || !stream.commit(wanted))
+			{
+				return false;
+			}
+			offset += wanted;
+		}
+		return true;
+	};
+
+	uint64_t end = 0;
+	for (const BlockMatch& match : matches)
+	{
+		if (match.offset > end && !literal(end, match.offset))
+		{
+			return false;
+		}
+		uint8_t copy[DELTA_COPY_SIZE] = { DELTA_COPY };
+		memcpy(copy + 1, &match.index, COUNT_SIZE);
+		memcpy(copy + 1 + COUNT_SIZE, &match.count, COUNT_SIZE);
+		if (!stream.put(copy, DELTA_COPY_SIZE))
+		{
+			return false;
+		}
+		end = match.offset + static_cast<uint64_t>(match.count) * blockSize;
+	}
+	if (_fileSize > end && !literal(end, _fileSize))
+	{
+		return false;
+	}
+	return stream.finish() && stream.sent() == contentSize;
+}
+
+/* send the file as its changes against the copy the server keeps, false when nothing was sent and the file goes
+as a whole - the server has no verified copy, it is too large to match against or the delta would not be smaller */
+bool ClientLogic::sendDeltaFile(BufferPool::Lease& requestBuffer)
+{
+	if (!_options.delta)
+	{
+		return false;
+	}
+	RandomAccessFile file;
+	if (!file.open(_filePath))
+	{
+		return false;
+	}
+	_fileSize = file.size();
+
+	/* the signature pages are read into a transfer chunk that is the rolling window afterwards */
+	BufferPool::Lease page = _chunkPool->lease();
+	if (!page.valid())
+	{
+		clientStop("memory budget is smaller than a single transfer chunk");
+	}
+	ServerResponse response;
+	if (!requestSignatures(page, 0, response))
+	{
+		return false;
+	}
+	uint64_t storedSize;
+	uint32_t blockSize;
+	uint32_t total;
+	memcpy(&storedSize, response.payload.payload, FILE_SIZE_SIZE);
+	memcpy(&blockSize, response.payload.payload + FILE_SIZE_SIZE, BLOCK_SIZE_SIZE);
+	memcpy(&total, response.payload.payload + FILE_SIZE_SIZE + BLOCK_SIZE_SIZE, COUNT_SIZE);
+	const uint64_t newBlocks = _fileSize / std::max<uint32_t>(blockSize, 1);
+	if (blockSize < MIN_DELTA_BLOCK_SIZE || blockSize > MAX_DELTA_BLOCK_SIZE || total == 0 || total > MAX_DELTA_BLOCKS
+		|| newBlocks > MAX_DELTA_BLOCKS || storedSize / blockSize != total)
+	{
+		return false;
+	}
+
+	/* the signatures and matches grow with the file, they are the only allocations of the delta */
+	AllocationScope::allow(2, static_cast<uint64_t>(total) * sizeof(BlockSignature) + newBlocks * sizeof(BlockMatch));
+	DeltaEncoder encoder(blockSize);
+	encoder.reserve(total);
+	for (uint32_t added = 0; added < total;)
+	{
+		if (added != 0 && !requestSignatures(page, added, response))
+		{
+			return false;
+		}
+		uint32_t count;
+		memcpy(&count, response.payload.payload + FILE_SIZE_SIZE + BLOCK_SIZE_SIZE + COUNT_SIZE, COUNT_SIZE);
+		if (count == 0 || count > SIGNATURE_PAGE_ENTRIES || count > total - added
+			|| response.header.payloadSize != SIGNATURES_HEADER_SIZE + count * SIGNATURE_ENTRY_SIZE)
+		{
+			return false;
+		}
+		const uint8_t* entry = response.payload.payload + SIGNATURES_HEADER_SIZE;
+		for (uint32_t i = 0; i < count; i++, entry += SIGNATURE_ENTRY_SIZE)
+		{
+			uint32_t weak;
+			memcpy(&weak, entry, WEAK_SUM_SIZE);
+			encoder.addSignature(weak, entry + WEAK_SUM_SIZE);
+		}
+		added += count;
+	}
+
+	vector<BlockMatch> matches;
+	matches.reserve(static_cast<size_t>(newBlocks));
+	uint32_t crc;
+	if (!encoder.scan(file, _fileSize, page.data(), page.size(), matches, crc))
+	{
+		return false;
+	}
+	page.reset();
+	const uint64_t deltaSize = DeltaEncoder::deltaSize(matches, blockSize, _fileSize);
+	if (deltaSize >= _fileSize
+		|| CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + BLOCK_SIZE_SIZE + deltaSize + AES_BLOCK_SIZE > std::numeric_limits<unsigned int>::max())
+	{
+		return false;
+	}
+	_clientCRC = crc;
+	const uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(deltaSize));
+	LOG_DEBUG("file.delta", "name=\"%s\" size=%llu delta=%llu copies=%zu", _fileName.c_str(),
+		static_cast<unsigned long long>(_fileSize), static_cast<unsigned long long>(deltaSize), matches.size());
+
+	DeltaFileRequest request(DELTA_FILE_REQUEST, static_cast<payload_t>(CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE + BLOCK_SIZE_SIZE + contentSize));
+	memset(requestBuffer.data(), 0, DELTA_SEND_HEADER_SIZE);
+	packClientID(request.header);
+	uint8_t* payload = requestBuffer.data() + REQUEST_HEADER_SIZE;
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(payload, &contentSize, CONTENT_SIZE);
+	memcpy(payload + CONTENT_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+	memcpy(payload + CONTENT_SIZE + FILE_NAME_SIZE, &_fileSize, FILE_SIZE_SIZE);
+	memcpy(payload + CONTENT_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE, &blockSize, BLOCK_SIZE_SIZE);
+	if (!_socket->writeBytes(requestBuffer.data(), DELTA_SEND_HEADER_SIZE))
+	{
+		clientStop("socket failure, The data cannot be write");
+	}
+	if (!streamDeltaContent(file, matches, blockSize, contentSize))
+	{
+		clientStop("file content cannot be streamed to the server");
+	}
+	return true;
+}
+
+/* stripe worker - on its own connection, take the next ranges nobody sent yet, encrypt them and wait until the
+server stored each. every range is a CBC stream of its own, so a worker with more than one buffer takes up to
+progress.lanes ranges at a time and encrypts them together in the lanes of the multi-buffer kernel. any failure
+stops all the streams */
+void ClientLogic::sendRanges(RandomAccessFile& file, BufferPool& rangePool, StripeProgress& progress)
+{
+	Tracer::instance().nameThread("stripe");
+	auto fail = [&progress]()
+	{
+		{
+			lock_guard<mutex> guard(progress.lock);
+			progress.failed = true;
+		}
+		progress.rangeStored.notify_all();
+	};
+	SocketHandler socket;
+	socket.setBufferSize(_options.socketBuffer);
+	if (!socket.initializeSocketInfo(address, port) || !socket.connectToServer())
+	{
+		fail();
+		return;
+	}
+	/* one buffer is waited for, the others only when the budget has them */
+	BufferPool::Lease buffers[AES_LANES];
+	buffers[0] = rangePool.lease();
+	uint8_t responseBuffer[PACKET_SIZE];
+	if (!buffers[0].valid())
+	{
+		fail();
+		return;
+	}
+	size_t leased = 1;
+	while (leased < progress.lanes)
+	{
+		buffers[leased] = rangePool.tryLease();
+		if (!buffers[leased].valid())
+		{
+			break;
+		}
+		leased++;
+	}
+	const uint32_t ranges = static_cast<uint32_t>(progress.rangeCRCs.size());
+
+	while (!progress.failed)
+	{
+		AllocationScope scope("stripe upload", FILE_UPLOAD_MAX_ALLOCATIONS, FILE_UPLOAD_MAX_BYTES);
+		uint32_t batch[AES_LANES];
+		size_t count = 0;
+		while (count < leased)
+		{
+			const uint32_t range = progress.nextRange++;
+			if (range >= ranges)
+			{
+				break;
+			}
+			batch[count++] = range;
+		}
+		if (count == 0)
+		{
+			break;
+		}
+
+		/* every range is encrypted from the fixed iv, in place behind its request header */
+		AESLane lanes[AES_LANES];
+		uint8_t chains[AES_LANES][AES_BLOCK_SIZE] = {};
+		uint32_t crcs[AES_LANES];
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint64_t offset = static_cast<uint64_t>(batch[i]) * RANGE_SIZE;
+			const uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(RANGE_SIZE, _fileSize - offset));
+			uint8_t* plain = buffers[i].data() + STRIPE_SEND_HEADER_SIZE;
+			size_t read = 0;
+			if (!file.readAt(offset, plain, length, read) || read != length)
+			{
+				fail();
+				return;
+			}
+			crcs[i] = Utils::crc32Update(0, ConstByteSpan(plain, length));
+			lanes[i] = { reinterpret_cast<const uint8_t*>(_AESKey.data()), chains[i], ConstByteSpan(plain, length),
+				ByteSpan(plain, buffers[i].size() - STRIPE_SEND_HEADER_SIZE), true, 0 };
+		}
+		AESLanes::encrypt(lanes, count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t range = batch[i];
+			const uint64_t offset = static_cast<uint64_t>(range) * RANGE_SIZE;
+			const uint32_t length = static_cast<uint32_t>(lanes[i].plain.size());
+			const uint32_t cipherSize = static_cast<uint32_t>(lanes[i].written);
+			uint8_t* buffer = buffers[i].data();
+			StripeRangeRequest request(STRIPE_RANGE_REQUEST, static_cast<payload_t>(STRIPE_SEND_HEADER_SIZE - REQUEST_HEADER_SIZE + cipherSize));
+			memset(buffer, 0, STRIPE_SEND_HEADER_SIZE);
+			packClientID(request.header);
+			uint8_t* payload = buffer + REQUEST_HEADER_SIZE;
+			memcpy(buffer, &request, REQUEST_HEADER_SIZE);
+			memcpy(payload, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+			payload += FILE_NAME_SIZE;
+			memcpy(payload, &_fileSize, FILE_SIZE_SIZE);
+			memcpy(payload + FILE_SIZE_SIZE, &offset, OFFSET_SIZE);
+			memcpy(payload + FILE_SIZE_SIZE + OFFSET_SIZE, &length, CONTENT_SIZE);
+			memcpy(payload + FILE_SIZE_SIZE + OFFSET_SIZE + CONTENT_SIZE, &crcs[i], CRC_SIZE);
+			memcpy(payload + FILE_SIZE_SIZE + OFFSET_SIZE + CONTENT_SIZE + CRC_SIZE, &cipherSize, CONTENT_SIZE);
+
+			ServerResponse response;
+			if (!socket.writeBytes(buffer, STRIPE_SEND_HEADER_SIZE + cipherSize) || !socket.read(responseBuffer)
+				|| !unpackResponse(responseBuffer, PACKET_SIZE, response) || response.header.code != ServerResponse::SResponseCode::RANGE_STORED)
+			{
+				fail();
+				return;
+			}
+			/* payload: offset of the range and whether its CKsum matched */
+			uint64_t storedOffset;
+			memcpy(&storedOffset, response.payload.payload, OFFSET_SIZE);
+			if (storedOffset != offset || response.payload.payload[OFFSET_SIZE] == 0)
+			{
+				fail();
+				return;
+			}
+			progress.rangeCRCs[range] = crcs[i];
+			{
+				lock_guard<mutex> guard(progress.lock);
+				progress.stored++;
+				progress.storedBytes += length;
+			}
+			progress.rangeStored.notify_all();
+		}
+	}
+	lock_guard<mutex> guard(progress.lock);
+	progress.streamEnds.push_back(std::chrono::steady_clock::now());
+}
+
+/* --stripes=auto: start with one stream and sample the throughput every STRIPE_PROBE_RANGES ranges per stream,
+a stream is added while the last one still paid off. returns the number of streams the file ended up with */
+uint32_t ClientLogic::tuneStripes(RandomAccessFile& file, BufferPool& rangePool, StripeProgress& progress, vector<thread>& workers, uint32_t maxStreams)
+{
+	const uint32_t ranges = static_cast<uint32_t>(progress.rangeCRCs.size());
+	if (ranges < 2 * STRIPE_PROBE_RANGES)
+	{
+		/* too few ranges for a sample and a probe after it, the first stream sends them all */
+		return static_cast<uint32_t>(workers.size());
+	}
+	double best = 0;
+	uint32_t sampleStart = 0;
+	uint64_t sampleBytes = 0;
+	auto sampleTime = std::chrono::steady_clock::now();
+	while (workers.size() < maxStreams)
+	{
+		/* the last sample of a file ends with its last range, a larger target would never be reached */
+		const uint32_t sampleEnd = std::min<uint32_t>(sampleStart + static_cast<uint32_t>(workers.size()) * STRIPE_PROBE_RANGES, ranges);
+		unique_lock<mutex> guard(progress.lock);
+		progress.rangeStored.wait(guard, [&progress, sampleEnd]() { return progress.failed || progress.stored >= sampleEnd; });
+		if (progress.failed || progress.nextRange >= ranges)
+		{
+			break;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(now - sampleTime).count();
+		const double throughput = (progress.storedBytes - sampleBytes) / std::max(seconds, 1e-6);
+		sampleStart = progress.stored;
+		sampleBytes = progress.storedBytes;
+		sampleTime = now;
+		guard.unlock();
+
+		LOG_DEBUG("stripe.sample", "streams=%zu bytes_per_second=%.0f", workers.size(), throughput);
+		if (throughput < best * (1 + STRIPE_MIN_GAIN))
+		{
+			break;
+		}
+		best = throughput;
+		workers.emplace_back(&ClientLogic::sendRanges, this, std::ref(file), std::ref(rangePool), std::ref(progress));
+	}
+	return static_cast<uint32_t>(workers.size());
+}
+
+/* send a large file as ranges striped over several connections of the session, one TCP flow is limited by its
+window on long fat links. the server confirms the whole file CKsum like for a file sent in one piece.
+false when nothing was committed and the file goes over the session connection */
+bool ClientLogic::sendStripedFile(BufferPool::Lease& requestBuffer)
+{
+	if (_options.stripes <= 1)
+	{
+		return false;
+	}
+	RandomAccessFile file;
+	if (!file.open(_filePath))
+	{
+		return false;
+	}
+	_fileSize = file.size();
+	if (_fileSize < STRIPE_MIN_SIZE)
+	{
+		return false;
+	}
+
+	const uint32_t ranges = static_cast<uint32_t>((_fileSize + RANGE_SIZE - 1) / RANGE_SIZE);
+	const uint32_t maxStreams = std::min<uint32_t>(_options.stripes, ranges);
+	/* a stream encrypts up to AES_LANES ranges together while every stream still gets a fair share of the file */
+	const uint32_t lanes = std::max<uint32_t>(1, std::min<uint32_t>(static_cast<uint32_t>(AES_LANES), ranges / maxStreams));
+	BufferPool rangePool(STRIPE_SEND_HEADER_SIZE + RANGE_SIZE + AES_BLOCK_SIZE, maxStreams * lanes, _budget, _options.largePages);
+	StripeProgress progress(ranges, lanes);
+	vector<thread> workers;
+	workers.reserve(maxStreams);
+	progress.streamEnds.reserve(maxStreams);
+	for (uint32_t i = 0; i < (_options.autoStripes ? 1 : maxStreams); i++)
+	{
+		workers.emplace_back(&ClientLogic::sendRanges, this, std::ref(file), std::ref(rangePool), std::ref(progress));
+	}
+	const uint32_t streams = _options.autoStripes ? tuneStripes(file, rangePool, progress, workers, maxStreams) : maxStreams;
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+	if (progress.failed)
+	{
+		LOG_WARN("stripe.failed", "name=\"%s\" streams=%u", _fileName.c_str(), streams);
+		return false;
+	}
+	LOG_INFO("stripe.sent", "name=\"%s\" size=%llu streams=%u", _fileName.c_str(), static_cast<unsigned long long>(_fileSize), streams);
+	const std::chrono::steady_clock::time_point lastEnd = *std::max_element(progress.streamEnds.begin(), progress.streamEnds.end());
+	for (const std::chrono::steady_clock::time_point& end : progress.streamEnds)
+	{
+		_scheduler.tailIdle(lastEnd - end);
+	}
+
+	boost::crc_32_type empty;
+	_clientCRC = empty.checksum();
+	for (uint32_t range = 0; range < ranges; range++)
+	{
+		const uint64_t length = std::min<uint64_t>(RANGE_SIZE, _fileSize - static_cast<uint64_t>(range) * RANGE_SIZE);
+		_clientCRC = Utils::crc32Combine(_clientCRC, progress.rangeCRCs[range], length);
+	}
+
+	/* every range is stored, the session connection asks the server to assemble the file */
+	memset(requestBuffer.data(), 0, PACKET_SIZE);
+	StripedCommitRequest request(STRIPED_FILE_COMMIT, STRIPED_COMMIT_PAYLOAD_SIZE);
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + FILE_NAME_SIZE, &_fileSize, FILE_SIZE_SIZE);
+	if (!_socket->write(requestBuffer.data()))
+	{
+		clientStop("socket failure, The data cannot be write");
+	}
+	return true;
+}
+
+/* extract AES symmetric key using client RSA private key */
+string ClientLogic::extractAESKey(uint8_t* payload, uint32_t len)
+{
+	/* get the client private key from me.info */
+	string base64key = _fileHandler->extractBase64privateKey(CLIENT_INFO);
+
+	RSAPrivateWrapper rsapriv_other(Utils::decode(base64key));
+
+	/* get the AES key using client private key */
+	_AESKey = rsapriv_other.decrypt(reinterpret_cast<const char*>(&payload[UID_SIZE]), len - UID_SIZE);
+
+	return _AESKey;
+}
+
+/* parse transfer info file and initialize the socket info */
+bool ClientLogic::parseAndStoreTransferInfo(const string& transferInfoPath)
+{
+	if (!_fileHandler->openFile(transferInfoPath))
+	{
+		return false;
+	}
+	string serverInfo;
+	_fileHandler->readLine(serverInfo);
+	size_t spos = serverInfo.find(":");
+	if (spos == std::string::npos)
+	{
+		return false;
+	}
+	address = serverInfo.substr(0, spos);
+	port = serverInfo.substr(spos + 1);
+	port.erase(port.size() - 1);
+	/* initialize socket */
+	if (!_socket->initializeSocketInfo(address, port))
+	{
+		clientStop("cannot initialize client socket for communiction");
+	}
+
+	_fileHandler->readLine(_userName);
+	_userName.erase(_userName.size() - 1);
+	if (_userName.size() > MAX_NAME_SIZE)
+	{
+		return false;
+	}
+	_fileHandler->readLine(_filePath);
+	if (!_filePath.empty() && _filePath.back() == '\r')
+	{
+		_filePath.pop_back();
+	}
+	_fileHandler->closeFile();
+	return true;
+}
+
+/* parse and store client info details */
+bool ClientLogic::parseAndStoreClientInfo()
+{
+	/* get the RSA public key */
+	_publicKey = _RSAPair->getPublicKey();
+
+	/* get the RSA private key decoded as base64 using Base64Wrapper */
+	_base64privateKey = Utils::encode(_RSAPair->getPrivateKey());
+
+	if (!_fileHandler->openFile(CLIENT_INFO, false))
+	{
+		return false;
+	}
+
+	/* write the client info into me.info file */
+	_fileHandler->writeLine(_userName);
+	_fileHandler->writeLine(_clientUID);
+	_fileHandler->writeAtOnce(_base64privateKey);
+	_fileHandler->closeFile();
+	return true;
+}
+
+/* prepare the registeration request */
+void ClientLogic::createRegisterationRequest(BufferPool::Lease& requestBuffer, bool reconnect)
+{
+	/* create new registeration request */
+	RegisterationRequest request(REGISTRATION_REQUEST, NAME_SIZE);
+	if (reconnect)
+	{
+		/* client already before was registerd  */
+
+		/* prepare the header */
+		request.header.code = LOGIN_REQUEST;
+		packClientID(request.header);
+	}
+
+	/* pack the header */
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+
+	/* pack the payload */
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, _userName.c_str(), _userName.length());//23 is where payload starts
+	memset(requestBuffer.data() + REQUEST_HEADER_SIZE + _userName.length(), '\0', FILE_NAME_SIZE - _userName.length());
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + _userName.length(), "\0", 1);//add null ptr for name
+}
+
+/* handle client register in the first time  */
+uint8_t* ClientLogic::handleRegisterationRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	ServerResponse response;
+	bool _connected = false;
+	for (int i = 0; i < MAX_SENDS; i++)
+	{
+		createRegisterationRequest(requestBuffer);
+		if (!_socket->write(requestBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be write");
+		}
+		if (!_socket->read(responseBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be read");
+		}
+		if (!unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+		{
+			clientStop("response header is not appropriate to the protocol");
+		}
+		if (response.header.code == ServerResponse::SResponseCode::REGISTRATION_REQUEST_FAILED)
+		{
+			clientStop("name is already seen in the database");
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::GENERAL_ERR)
+		{
+			continue;
+		}
+		if (response.header.code == ServerResponse::SResponseCode::REGISTRATION_REQUEST_SUCCESS)
+		{
+			_succseed = true;
+			break;
+		}
+
+	}
+	if (!_succseed)
+	{
+		clientStop("registration request failed");
+	}
+
+	/* parse the client UID from server response and return her */
+	response.payload.payload[UID_SIZE] = '\0';
+	return response.payload.payload;
+}
+
+/* after the client registers for the first time or when the reconnection fails -
+the client exchanges encryption keys with the server so that it can send the file to backup on the server encrypted */
+void ClientLogic::handlePublicKeyRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	ServerResponse response;
+	for (int i = 0; i < MAX_SENDS; i++)
+	{
+		createPublicKeyRequest(requestBuffer);
+		if (!_socket->write(requestBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be write");
+		}
+		if (!_socket->read(responseBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be read");
+		}
+
+		if (!unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+		{
+			clientStop("response header is not appropriate to the protocol");
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::GOT_PC_SEND_AES)
+		{
+			_succseed = true;
+			_AESKey = extractAESKey(response.payload.payload, response.header.payloadSize);
+			break;
+		}
+	}
+	if (!_succseed)
+	{
+		clientStop("registration request failed");
+	}
+
+}
+void ClientLogic::createPublicKeyRequest(BufferPool::Lease& requestBuffer)
+{
+	memset(requestBuffer.data(), 0, PACKET_SIZE);
+	PublicKeyRequest request(PUBLIC_KEY_REQUEST, NAME_SIZE + PUBLIC_KEY_SIZE);
+
+	/* pack the header */
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+
+	/* pack the payload */
+	memcpy(requestBuffer.data() + CLIENT_HEADER_SIZE, _userName.c_str(), NAME_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + NAME_SIZE, "\0", 1);//add null ptr for name
+	memcpy(requestBuffer.data() + CLIENT_HEADER_SIZE + NAME_SIZE, _publicKey.c_str(), PUBLIC_KEY_SIZE);
+}
+
+/* prepare the file storage request header, the encrypted content itself is streamed after it */
+bool ClientLogic::createFileStorageRequest(BufferPool::Lease& requestBuffer)
+{
+	/* check if the payload size is smaller then the max excpected payload size  */
+	_fileSize = FileHandler::fileSize(_filePath);
+	if (CONTENT_SIZE + FILE_NAME_SIZE + _fileSize + AES_BLOCK_SIZE > std::numeric_limits<unsigned int>::max())
+	{
+		return false;
+	}
+	uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(_fileSize));
+
+	fileSendRequest request(FILE_SEND_REQUEST, CONTENT_SIZE + FILE_NAME_SIZE + contentSize);
+	memset(requestBuffer.data(), 0, PACKET_SIZE);
+
+	/* pack the header */
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+
+	/* pack the payload */
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, &contentSize, CONTENT_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + CONTENT_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+
+	return true;
+}
+
+/* handle send client file for backup request */
+uint32_t ClientLogic::handleFileStorageRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	ServerResponse response;
+
+	for (int i = 0; i < MAX_SENDS; i++)
+	{
+		if (!sendAppendedFile(requestBuffer) && !sendDeltaFile(requestBuffer) && !sendSparseFile(requestBuffer) && !sendStripedFile(requestBuffer))
+		{
+			if (!createFileStorageRequest(requestBuffer))
+			{
+				clientStop("request payload size is greater then the expected in the protocol");
+			}
+			uint32_t contentSize;
+			memcpy(&contentSize, requestBuffer.data() + REQUEST_HEADER_SIZE, CONTENT_SIZE);
+			if (!_socket->writeBytes(requestBuffer.data(), FILE_SEND_HEADER_SIZE))
+			{
+				clientStop("socket failure, The data cannot be write");
+			}
+			if (!streamFileContent(contentSize))
+			{
+				clientStop("file content cannot be streamed to the server");
+			}
+		}
+		{
+			/* the server checksums the whole file before it answers */
+			TRACE_SCOPE("file.wait_ack");
+			if (!_socket->read(responseBuffer.data()))
+			{
+				clientStop("socket failure, The data cannot be read");
+			}
+		}
+
+		if (!unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+		{
+			clientStop("response header is not appropriate to the protocol");
+		}
+		if (response.header.code == ServerResponse::SResponseCode::GENERAL_ERR)
+		{
+			/* the server does not keep the content the appended bytes follow, the file is sent whole */
+			if (_appended)
+			{
+				_appendState.forget(_fileName);
+			}
+			continue;
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::GOT_FILE_SEND_CRC)
+		{
+			_succseed = true;
+			break;
+		}
+	}
+	if (!_succseed)
+	{
+		clientStop("file send request failed");
+	}
+	uint32_t serverCRC;
+	memcpy(&serverCRC, &(response.payload.payload)[FILE_NAME_SIZE + UID_SIZE + CONTENT_SIZE], CRC_SIZE);
+	return serverCRC;
+}
+
+/* handle crc ok, crc failed and retry crc requests */
+bool ClientLogic::handleSendFileAndCRCRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	int i = 0;
+	while (true)
+	{
+		uint32_t serverCRC = handleFileStorageRequest(requestBuffer, responseBuffer);
+		_succseed = false;
+		/* the content read from a file that was written meanwhile matches the server but may be torn */
+		const bool consistent = !_options.snapshot || _snapshot.unchanged();
+		if (!consistent)
+		{
+			LOG_WARN("file.changed", "path=\"%s\" attempt=%d", _fileName.c_str(), i + 1);
+		}
+		if (_clientCRC == serverCRC && consistent)
+		{
+			handleCRCIsOkREQUEST(requestBuffer, responseBuffer);
+			return true;
+		}
+		if (_appended)
+		{
+			/* the stored content did not end where the appended bytes start, the retry sends the file whole */
+			_appendState.forget(_fileName);
+		}
+		if (i + 1 != MAX_CRC_SEND)
+		{
+			handleRetryCRCRequest(requestBuffer);
+		}
+		else
+		{
+			handleFailedCRCRequest(requestBuffer, responseBuffer);
+			return false;
+		}
+		i++;
+	}
+}
+
+/* send one file of the backup set, a file that vanished since it was found is skipped */
+bool ClientLogic::uploadFile(const UploadJob& job, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	if (!_fileHandler->checkFileExsistance(job.path))
+	{
+		LOG_WARN("file.skipped", "path=\"%s\" reason=vanished", job.path.c_str());
+		return false;
+	}
+	AllocationScope scope("file upload", FILE_UPLOAD_MAX_ALLOCATIONS, FILE_UPLOAD_MAX_BYTES);
+	TRACE_SCOPE("file.upload", job.size);
+	_filePath = job.path;
+	_fileName = job.name;
+	_succseed = false;
+	FileStamp stamp = { 0, 0 };
+	if (_options.append && !FileSnapshot::stamp(job.path, stamp))
+	{
+		LOG_WARN("file.skipped", "path=\"%s\" reason=vanished", job.path.c_str());
+		return false;
+	}
+	if (_options.snapshot)
+	{
+		if (!_snapshot.take(job.path))
+		{
+			LOG_WARN("file.skipped", "path=\"%s\" reason=vanished", job.path.c_str());
+			return false;
+		}
+		_filePath = _snapshot.path();
+	}
+	if (unchangedSinceAppend(job, stamp))
+	{
+		LOG_DEBUG("file.unchanged", "name=\"%s\"", _fileName.c_str());
+		_snapshot.release();
+		return true;
+	}
+	resumePrepared(job.path);
+	_replicated = _replicator != nullptr ? _replicator->offer(job.path, job.name) : 0;
+	const bool stored = handleSendFileAndCRCRequest(requestBuffer, responseBuffer);
+	_prepared.active = false;
+	if (_replicator != nullptr)
+	{
+		_replicator->endFile(_replicated);
+	}
+	if (stored && _options.append)
+	{
+		recordAppendState(stamp);
+	}
+	_snapshot.release();
+	return stored;
+}
+
+/* stream a packed container: the content of the files one after the other followed by their index. a file that
+cannot be read in full is padded with zeros and gets an empty name in the index, so the server skips it */
+bool ClientLogic::streamPackedContent(const vector<UploadJob>& pack, uint32_t contentSize, vector<bool>& readable)
+{
+	EncryptedStream stream(*_chunkPool, _AESKey, *_socket);
+	if (!stream.valid())
+	{
+		clientStop("memory budget is smaller than a single transfer chunk");
+	}
+
+	vector<uint32_t> crcs(pack.size(), 0);
+	readable.assign(pack.size(), true);
+	for (size_t i = 0; i < pack.size(); i++)
+	{
+		/* members are small, they are read in place and only checked for writes while they were read */
+		readable[i] = (!_options.snapshot || _snapshot.take(pack[i].path, false)) && _fileHandler->openFile(pack[i].path);
+		boost::crc_32_type crc_calculator;
+		uint64_t left = pack[i].size;
+		while (left > 0)
+		{
+			size_t wanted = static_cast<size_t>(std::min<uint64_t>(left, CHUNK_SIZE));
+			char* target = reinterpret_cast<char*>(stream.space(wanted));
+			const size_t len = readable[i] ? _fileHandler->readChunk(target, wanted) : 0;
+			if (len != wanted)
+			{
+				/* file was truncated since it was found */
+				readable[i] = false;
+				memset(target + len, 0, wanted - len);
+			}
+			crc_calculator.process_bytes(target, wanted);
+			left -= wanted;
+			if (!stream.commit(wanted))
+			{
+				_fileHandler->closeFile();
+				return false;
+			}
+		}
+		_fileHandler->closeFile();
+		crcs[i] = crc_calculator.checksum();
+		if (readable[i] && _options.snapshot && !_snapshot.unchanged())
+		{
+			LOG_WARN("file.changed", "path=\"%s\" attempt=1", pack[i].name.c_str());
+			readable[i] = false;
+		}
+	}
+
+	for (size_t i = 0; i < pack.size(); i++)
+	{
+		uint8_t entry[PACK_INDEX_ENTRY_SIZE] = { 0 };
+		if (readable[i])
+		{
+			memcpy(entry, pack[i].name.c_str(), std::min<size_t>(pack[i].name.length(), FILE_NAME_SIZE));
+		}
+		memcpy(entry + FILE_NAME_SIZE, &pack[i].size, FILE_SIZE_SIZE);
+		memcpy(entry + FILE_NAME_SIZE + FILE_SIZE_SIZE, &crcs[i], CRC_SIZE);
+		if (!stream.put(entry, PACK_INDEX_ENTRY_SIZE))
+		{
+			return false;
+		}
+	}
+	return stream.finish() && stream.sent() == contentSize;
+}
+
+/* send small files together in one packed container, stored[i] tells if the server verified and kept file i */
+bool ClientLogic::handlePackedFilesRequest(const vector<UploadJob>& pack, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, vector<bool>& stored)
+{
+	uint64_t plainSize = static_cast<uint64_t>(pack.size()) * PACK_INDEX_ENTRY_SIZE;
+	for (const UploadJob& job : pack)
+	{
+		plainSize += job.size;
+	}
+	const uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(plainSize));
+	const uint32_t count = static_cast<uint32_t>(pack.size());
+
+	PackedFilesRequest request(PACKED_FILES_REQUEST, CONTENT_SIZE + COUNT_SIZE + contentSize);
+	memset(requestBuffer.data(), 0, PACKED_SEND_HEADER_SIZE);
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, &contentSize, CONTENT_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + CONTENT_SIZE, &count, COUNT_SIZE);
+
+	vector<bool> readable;
+	if (!_socket->writeBytes(requestBuffer.data(), PACKED_SEND_HEADER_SIZE) || !streamPackedContent(pack, contentSize, readable))
+	{
+		clientStop("packed files cannot be streamed to the server");
+	}
+
+	ServerResponse response;
+	if (!_socket->read(responseBuffer.data()) || !unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+	{
+		clientStop("socket failure, The data cannot be read");
+	}
+	uint32_t results = 0;
+	if (response.header.code != ServerResponse::SResponseCode::PACKED_FILES_RESULT)
+	{
+		return false;
+	}
+	memcpy(&results, response.payload.payload, COUNT_SIZE);
+	if (results != count)
+	{
+		return false;
+	}
+	stored.assign(pack.size(), false);
+	for (size_t i = 0; i < pack.size(); i++)
+	{
+		stored[i] = readable[i] && response.payload.payload[COUNT_SIZE + i] == 1;
+	}
+	return true;
+}
+
+/* send a file with its CKsum after the content and without waiting for the server, the FILE_STORED
+response carrying the same sequence tells if the server kept it */
+bool ClientLogic::sendPipelinedFile(const UploadJob& job, uint32_t sequence, BufferPool::Lease& requestBuffer)
+{
+	AllocationScope scope("pipelined file upload", FILE_UPLOAD_MAX_ALLOCATIONS, FILE_UPLOAD_MAX_BYTES);
+	_filePath = job.path;
+	_fileName = job.name;
+	if (_options.snapshot)
+	{
+		if (!_snapshot.take(job.path))
+		{
+			return false;
+		}
+		_filePath = _snapshot.path();
+	}
+	_fileSize = FileHandler::fileSize(_filePath);
+	if (SEQUENCE_SIZE + CONTENT_SIZE + FILE_NAME_SIZE + CRC_SIZE + _fileSize + AES_BLOCK_SIZE > std::numeric_limits<unsigned int>::max())
+	{
+		return false;
+	}
+	uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(_fileSize));
+
+	PipelinedFileRequest request(PIPELINED_FILE_REQUEST, SEQUENCE_SIZE + CONTENT_SIZE + FILE_NAME_SIZE + contentSize + CRC_SIZE);
+	memset(requestBuffer.data(), 0, PIPELINED_SEND_HEADER_SIZE);
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, &sequence, SEQUENCE_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + SEQUENCE_SIZE, &contentSize, CONTENT_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + SEQUENCE_SIZE + CONTENT_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+
+	resumePrepared(job.path);
+	if (!_socket->writeBytes(requestBuffer.data(), PIPELINED_SEND_HEADER_SIZE) || !streamFileContent(contentSize))
+	{
+		clientStop("file content cannot be streamed to the server");
+	}
+	/* a file written while it was streamed gets a checksum the server rejects, it is sent again after the window */
+	uint32_t crc = _clientCRC;
+	if (_options.snapshot && !_snapshot.unchanged())
+	{
+		LOG_WARN("file.changed", "path=\"%s\" attempt=1", _fileName.c_str());
+		crc = ~crc;
+	}
+	_snapshot.release();
+	if (!_socket->writeBytes(reinterpret_cast<const uint8_t*>(&crc), CRC_SIZE))
+	{
+		clientStop("socket failure, The data cannot be write");
+	}
+	return true;
+}
+
+/* read one FILE_STORED response, it may answer any of the uploads in flight */
+void ClientLogic::readFileStored(BufferPool::Lease& responseBuffer, uint64_t& sent)
+{
+	ServerResponse response;
+	if (!_socket->read(responseBuffer.data()) || !unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+	{
+		clientStop("socket failure, The data cannot be read");
+	}
+	if (response.header.code != ServerResponse::SResponseCode::FILE_STORED)
+	{
+		/* the server answers a request it could not parse with a general error, requests are handled in order */
+		_retry.push_back(_inFlight.begin()->second);
+		_inFlight.erase(_inFlight.begin());
+		return;
+	}
+	uint32_t sequence;
+	memcpy(&sequence, response.payload.payload, SEQUENCE_SIZE);
+	auto found = _inFlight.find(sequence);
+	if (found == _inFlight.end())
+	{
+		clientStop("server acknowledged an unknown request");
+	}
+	if (response.payload.payload[SEQUENCE_SIZE] == 1)
+	{
+		sent++;
+		_scheduler.finished(found->second, true);
+		replicateStored(found->second);
+	}
+	else
+	{
+		_retry.push_back(found->second);
+	}
+	_inFlight.erase(found);
+}
+
+/* keep up to window uploads in flight, acknowledgements that already arrived are read before sending more.
+the pipelined request carries the whole content, a sparse file goes through the one file exchange instead so
+its holes are not sent - the window is drained first, the server answers requests in order */
+void ClientLogic::uploadWindowed(const UploadJob& job, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed)
+{
+	RandomAccessFile file;
+	vector<FileExtent> extents;
+	uint64_t dataSize;
+	if (job.size >= SPARSE_MIN_HOLES && file.open(job.path) && sparseExtents(file, extents, dataSize))
+	{
+		file.close();
+		drainWindow(requestBuffer, responseBuffer, sent, failed);
+		const bool stored = uploadFile(job, requestBuffer, responseBuffer);
+		stored ? sent++ : failed++;
+		_scheduler.finished(job, stored);
+		return;
+	}
+	while (!_inFlight.empty() && (_inFlight.size() >= _options.window || _socket->available() >= PACKET_SIZE))
+	{
+		readFileStored(responseBuffer, sent);
+	}
+	if (!_fileHandler->checkFileExsistance(job.path))
+	{
+		LOG_WARN("file.skipped", "path=\"%s\" reason=vanished", job.path.c_str());
+		failed++;
+		_scheduler.finished(job, false);
+		return;
+	}
+	const uint32_t sequence = _nextSequence++;
+	if (!sendPipelinedFile(job, sequence, requestBuffer))
+	{
+		failed++;
+		_scheduler.finished(job, false);
+		return;
+	}
+	_inFlight.emplace(sequence, job);
+}
+
+/* wait for every upload in flight, then send the ones the server did not store through the one file exchange.
+the connection has nothing to send while the last acknowledgements come in, that wait is tail idle time */
+void ClientLogic::drainWindow(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed)
+{
+	const std::chrono::steady_clock::time_point drainStart = std::chrono::steady_clock::now();
+	while (!_inFlight.empty())
+	{
+		readFileStored(responseBuffer, sent);
+	}
+	_scheduler.tailIdle(std::chrono::steady_clock::now() - drainStart);
+	for (const UploadJob& job : _retry)
+	{
+		const bool stored = uploadFile(job, requestBuffer, responseBuffer);
+		stored ? sent++ : failed++;
+		_scheduler.finished(job, stored);
+	}
+	_retry.clear();
+}
+
+/* a file the main server stored without a whole file upload is read by the replicas themselves */
+void ClientLogic::replicateStored(const UploadJob& job)
+{
+	if (_replicator != nullptr)
+	{
+		_replicator->endFile(_replicator->offer(job.path, job.name));
+	}
+}
+
+/* OR the Bloom filter of the server into the local one, page by page. a server without dedup support answers
+with an error, the local filter then only knows the files this client sent */
+void ClientLogic::syncFingerprints(BufferPool::Lease& requestBuffer)
+{
+	TRACE_SCOPE("dedup.sync", FINGERPRINT_FILTER_BYTES);
+	vector<uint8_t> page(HEADER_SIZE + OFFSET_SIZE + FINGERPRINT_FILTER_PAGE);
+	for (uint64_t offset = 0; offset < FINGERPRINT_FILTER_BYTES; offset += FINGERPRINT_FILTER_PAGE)
+	{
+		memset(requestBuffer.data(), 0, PACKET_SIZE);
+		FingerprintFilterRequest request(FINGERPRINT_FILTER_REQUEST, OFFSET_SIZE);
+		packClientID(request.header);
+		memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+		memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, &offset, OFFSET_SIZE);
+		ServerResponse response;
+		if (!_socket->write(requestBuffer.data()) || !readResponse(*_socket, page.data(), page.size(), response))
+		{
+			clientStop("socket failure, The fingerprint filter cannot be read");
+		}
+		uint64_t pageOffset;
+		if (response.header.code != ServerResponse::SResponseCode::FINGERPRINT_FILTER || response.header.payloadSize < OFFSET_SIZE)
+		{
+			LOG_WARN("dedup.sync", "offset=%llu reason=unsupported", static_cast<unsigned long long>(offset));
+			return;
+		}
+		memcpy(&pageOffset, response.payload.payload, OFFSET_SIZE);
+		if (pageOffset != offset || !_fingerprints.merge(offset, response.payload.payload + OFFSET_SIZE, response.header.payloadSize - OFFSET_SIZE))
+		{
+			LOG_WARN("dedup.sync", "offset=%llu reason=bad_page", static_cast<unsigned long long>(offset));
+			return;
+		}
+	}
+}
+
+/* SHA-256 and CKsum of the whole file in one read pass, false if it cannot be read */
+bool ClientLogic::fingerprintFile(const UploadJob& job, uint8_t* fingerprint, uint32_t& crc)
+{
+	TRACE_SCOPE("dedup.fingerprint", job.size);
+	RandomAccessFile file;
+	BufferPool::Lease chunk = _chunkPool->lease();
+	if (!chunk.valid() || !file.open(job.path))
+	{
+		return false;
+	}
+	CryptoPP::SHA256 sha;
+	crc = 0;
+	uint64_t offset = 0;
+	size_t read = 0;
+	do
+	{
+		if (!file.readAt(offset, chunk.data(), CHUNK_SIZE, read))
+		{
+			return false;
+		}
+		sha.Update(chunk.data(), read);
+		crc = Utils::crc32Update(crc, ConstByteSpan(chunk.data(), read));
+		offset += read;
+	} while (read == CHUNK_SIZE);
+	if (offset != job.size)
+	{
+		/* the file changes while it is read, it is left to the upload */
+		return false;
+	}
+	sha.Final(fingerprint);
+	return true;
+}
+
+/* ask the server to store the file from a copy it already keeps, for this client or another one. the server
+checks its own copy against the fingerprint and returns the CKsum of what it stored, it has to match the file */
+bool ClientLogic::storedByFingerprint(const UploadJob& job, const uint8_t* fingerprint, uint32_t crc, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	TRACE_SCOPE("dedup.lookup");
+	_lookups++;
+	memset(requestBuffer.data(), 0, PACKET_SIZE);
+	FingerprintLookupRequest request(FINGERPRINT_LOOKUP_REQUEST, FINGERPRINT_LOOKUP_PAYLOAD_SIZE);
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, job.name.c_str(), std::min<size_t>(job.name.length(), FILE_NAME_SIZE));
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + FILE_NAME_SIZE, &job.size, FILE_SIZE_SIZE);
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE + FILE_NAME_SIZE + FILE_SIZE_SIZE, fingerprint, FINGERPRINT_SIZE);
+	ServerResponse response;
+	if (!_socket->write(requestBuffer.data()) || !_socket->read(responseBuffer.data()) || !unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+	{
+		clientStop("socket failure, The fingerprint lookup cannot be read");
+	}
+	if (response.header.code != ServerResponse::SResponseCode::FINGERPRINT_RESULT || response.header.payloadSize < 1 + CRC_SIZE
+		|| response.payload.payload[0] == 0)
+	{
+		return false;
+	}
+	uint32_t serverCRC;
+	memcpy(&serverCRC, response.payload.payload + 1, CRC_SIZE);
+	if (serverCRC != crc)
+	{
+		LOG_WARN("dedup.mismatch", "name=\"%s\" client_crc=%u server_crc=%u", job.name.c_str(), crc, serverCRC);
+		return false;
+	}
+	_deduplicated++;
+	_deduplicatedBytes += job.size;
+	LOG_INFO("dedup.hit", "name=\"%s\" size=%llu", job.name.c_str(), static_cast<unsigned long long>(job.size));
+	return true;
+}
+
+/* node 0 is the server of transfer.info, the --shard nodes follow. the sessions of the other nodes log in with
+the name and key of me.info like replicas do */
+void ClientLogic::startShards()
+{
+	vector<string> nodes(1, address + ":" + port);
+	nodes.insert(nodes.end(), _options.shards.begin(), _options.shards.end());
+	_ring = new ShardRing(nodes);
+	_placed.assign(nodes.size(), 0);
+	_shards = new Replicator(_options.shards, _userName, Utils::decode(_fileHandler->extractBase64privateKey(CLIENT_INFO)));
+	_shards->trackOutcomes();
+	if (!_shards->load(SHARD_INFO))
+	{
+		LOG_WARN("shard.state", "path=\"%s\" reason=unreadable", SHARD_INFO);
+	}
+}
+
+/* the node of a file by the client ID and the name it is backed up under, a node that cannot be reached is
+passed over for the next one on the ring */
+size_t ClientLogic::placeFile(const UploadJob& job)
+{
+	vector<bool> down(_ring->nodes(), false);
+	for (size_t i = 0; i < _shards->size(); i++)
+	{
+		down[i + 1] = !_shards->alive(i);
+	}
+	const size_t node = _ring->locate(ShardRing::key(_clientUID, job.name), down);
+	_placed[node]++;
+	return node;
+}
+
+/* a file counts as stored once its node stored it. the files of a node that was dropped are placed again on the
+nodes still up, the ones that land on node 0 are handed to the upload loop in orphans. false when there was
+nothing to collect and no file is open on the nodes */
+bool ClientLogic::collectShards(bool wait, vector<UploadJob>& orphans, uint64_t& sent, uint64_t& failed)
+{
+	vector<ReplicaOutcome> outcomes;
+	if (!_shards->collect(outcomes, wait))
+	{
+		return false;
+	}
+	for (const ReplicaOutcome& outcome : outcomes)
+	{
+		const auto found = _sharded.find(outcome.id);
+		if (found == _sharded.end())
+		{
+			continue;
+		}
+		const UploadJob job = found->second;
+		_sharded.erase(found);
+		if (!outcome.returned)
+		{
+			outcome.stored ? sent++ : failed++;
+			_scheduler.finished(job, outcome.stored);
+			continue;
+		}
+		_placed[outcome.replica + 1]--;
+		const size_t node = placeFile(job);
+		LOG_INFO("shard.replaced", "name=\"%s\" from=%s to=%s", job.name.c_str(), _ring->node(outcome.replica + 1).c_str(), _ring->node(node).c_str());
+		if (node != 0)
+		{
+			_sharded[_shards->offerTo(node - 1, job.path, job.name)] = job;
+		}
+		else
+		{
+			orphans.push_back(job);
+		}
+	}
+	return true;
+}
+
+/* --tune: count the sent bytes into the epoch of the tuner, at its end the settings it picked take effect. the
+uploads still in flight went out with the old window and are acknowledged first, the next epoch is measured clean */
+void ClientLogic::tuneTransfer(uint64_t bytes, bool stripable, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed)
+{
+	if (_tuner == nullptr)
+	{
+		return;
+	}
+	_tuner->record(bytes, stripable);
+	if (_tuner->sample())
+	{
+		drainWindow(requestBuffer, responseBuffer, sent, failed);
+		_tuner->apply(_options);
+		_socket->setBufferSize(_options.socketBuffer);
+	}
+}
+
+/* send a packed container, files the server did not keep fall back to the one file exchange */
+void ClientLogic::uploadPack(vector<UploadJob>& pack, BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer, uint64_t& sent, uint64_t& failed)
+{
+	if (pack.empty())
+	{
+		return;
+	}
+	vector<bool> stored(pack.size(), false);
+	handlePackedFilesRequest(pack, requestBuffer, responseBuffer, stored);
+	for (size_t i = 0; i < pack.size(); i++)
+	{
+		if (stored[i])
+		{
+			sent++;
+			_scheduler.finished(pack[i], true);
+			replicateStored(pack[i]);
+		}
+		else
+		{
+			const bool retried = uploadFile(pack[i], requestBuffer, responseBuffer);
+			retried ? sent++ : failed++;
+			_scheduler.finished(pack[i], retried);
+		}
+	}
+	pack.clear();
+}
+
+/* prepare appropriate crc request */
+bool ClientLogic::createCRCValidateRequest(BufferPool::Lease& requestBuffer, bool validate)
+{
+	memset(requestBuffer.data(), 0, PACKET_SIZE);
+	CRCValidateRequest request(CRC_VALID_REQUEST, FILE_NAME_SIZE);
+
+	if (!validate)
+	{
+		request.header.code = CRC_FAILED_REQUEST;
+	}
+
+	/* pack the header */
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+
+	/* pack the payload */
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+
+	return true;
+}
+
+/* when the check sum of the file are equel in both client-server side - handle crc ok request  */
+void ClientLogic::handleCRCIsOkREQUEST(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	TRACE_SCOPE("crc.confirm");
+	ServerResponse response;
+
+	for (int i = 0; i < MAX_SENDS; i++)
+	{
+		createCRCValidateRequest(requestBuffer);
+		if (!_socket->write(requestBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be write");
+		}
+		if (!_socket->read(responseBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be read");
+		}
+		if (!unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+		{
+			clientStop("response header is not appropriate to the protocol");
+		}
+		if (response.header.code == ServerResponse::SResponseCode::GENERAL_ERR)
+		{
+			continue;
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::GOT_REQ_TNX)
+		{
+			_succseed = true;
+			break;
+		}
+
+	}
+	if (!_succseed)
+	{
+		clientStop("CRC ok request failed");
+	}
+}
+
+/* when the check sum response to the client request
+doesnt varified in the client side - send again the file for validation */
+void ClientLogic::handleRetryCRCRequest(BufferPool::Lease& requestBuffer)
+{
+	createCRCValidateRequest(requestBuffer, false);
+	if (!_socket->write(requestBuffer.data()))
+	{
+		clientStop("socket failure, The data cannot be write");
+	}
+}
+
+bool ClientLogic::createCRCFailedRequest(BufferPool::Lease& requestBuffer)
+{
+	memset(requestBuffer.data(), 0, PACKET_SIZE);
+	CRCFailedRequest request(FOUR_FAILED_CRC_REQUEST, FILE_NAME_SIZE);
+
+	/* pack the header */
+	packClientID(request.header);
+	memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+
+	/* pack the payload */
+	memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, _fileName.c_str(), std::min<size_t>(_fileName.length(), FILE_NAME_SIZE));
+	return true;
+}
+
+/* crc request failed in the four time - stop sending and inform the server about it  */
+void ClientLogic::handleFailedCRCRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	ServerResponse response;
+	for (int i = 0; i < MAX_SENDS; i++)
+	{
+
+		createCRCFailedRequest(requestBuffer);
+		if (!_socket->write(requestBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be write");
+		}
+		if (!_socket->read(responseBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be read");
+		}
+		if (!unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+		{
+			clientStop("response header is not appropriate to the protocol");
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::GENERAL_ERR)
+		{
+			continue;
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::GOT_REQ_TNX)
+		{
+			_succseed = true;
+			break;
+		}
+	}
+	if (!_succseed)
+	{
+		clientStop("failed CRC request failed");
+	}
+}
+
+/* client already sign in before to the server services -
+send recconect request then after it client will can send the file for backup */
+void ClientLogic::handleReconnectRequest(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	ServerResponse response;
+	for (int i = 0; i < MAX_SENDS; i++)
+	{
+		createRegisterationRequest(requestBuffer, true);
+		if (!_socket->write(requestBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be write");
+		}
+		if (!_socket->read(responseBuffer.data()))
+		{
+			clientStop("socket failure, The data cannot be read");
+		}
+
+		if (!unpackResponse(responseBuffer.data(), PACKET_SIZE, response))
+		{
+			clientStop("response header is not appropriate to the protocol");
+		}
+		if (response.header.code == ServerResponse::SResponseCode::GENERAL_ERR)
+		{
+			continue;
+		}
+		if (response.header.code == ServerResponse::SResponseCode::RECONNECT_FAILED)
+		{
+			/* reconnect failed: user name already exists on server database -
+			The client is re-registered as a new client and replaces with the server encryption keys */
+
+			setClientUID(Utils::hexi(handleRegisterationRequest(requestBuffer, responseBuffer), UID_SIZE));
+			handlePublicKeyRequest(requestBuffer, responseBuffer);
+			_succseed = true;
+			break;
+		}
+
+		if (response.header.code == ServerResponse::SResponseCode::LOGIN_SUCCESS_SEND_AES)
+		{
+			_succseed = true;
+			_AESKey = extractAESKey(response.payload.payload, response.header.payloadSize);
+			break;
+		}
+	}
+	if (!_succseed)
+	{
+		clientStop("registration request failed");
+	}
+}
+
+/* register in the first time or reconnect with the details stored in me.info, either way the client ends up with the AES key */
+void ClientLogic::clientLogin(BufferPool::Lease& requestBuffer, BufferPool::Lease& responseBuffer)
+{
+	TRACE_SCOPE("handshake");
+	if (!_fileHandler->checkFileExsistance(CLIENT_INFO))
+	{
+		/* the file me.info did not exist - the client registered for the first time */
+
+		setClientUID(Utils::hexi(handleRegisterationRequest(requestBuffer, responseBuffer), UID_SIZE));
+
+		_succseed = false;
+		if (!parseAndStoreClientInfo())
+		{
+			clientStop("failed create and store me info for client");
+		}
+		handlePublicKeyRequest(requestBuffer, responseBuffer);
+	}
+
+	else
+	{
+		/* The client has already registered before - the me.info file is found */
+
+		if (!_fileHandler->openFile(CLIENT_INFO))
+		{
+			clientStop("couldn't open me.info file");
+		}
+
+		/* parse client info and store them localy */
+		_fileHandler->readLine(_userName);
+		_userName.erase(_userName.size() - 1);
+		_fileHandler->readLine(_clientUID);
+		_clientUID.erase(_clientUID.size() - 1);
+		setClientUID(_clientUID);
+		_fileHandler->closeFile();
+
+		_succseed = false;
+
+		handleReconnectRequest(requestBuffer, responseBuffer);
+	}
+}
+
+/* checksum the head of the file while the handshake is in flight, the CKsum needs no key. reading stops as soon
+as the login is done, so the upload is never held back by it - the stream continues the CKsum from there */
+void ClientLogic::prepareFile(const string& path)
+{
+	_prepared = { path, { 0, 0 }, 0, 0, false };
+	RandomAccessFile file;
+	if (!FileSnapshot::stamp(path, _prepared.stamp) || !file.open(path))
+	{
+		_prepared.path.clear();
+		return;
+	}
+	BufferPool::Lease chunk = _chunkPool->lease();
+	boost::crc_32_type crc_calculator;
+	while (chunk.valid() && !_loggedIn && _prepared.bytes < _prepared.stamp.size)
+	{
+		const size_t wanted = static_cast<size_t>(std::min<uint64_t>(_prepared.stamp.size - _prepared.bytes, CHUNK_SIZE));
+		size_t read = 0;
+		if (!file.readAt(_prepared.bytes, chunk.data(), wanted, read) || read != wanted)
+		{
+			_prepared.path.clear();
+			return;
+		}
+		crc_calculator.process_bytes(chunk.data(), read);
+		_prepared.bytes += read;
+	}
+	_prepared.remainder = static_cast<uint32_t>(crc_calculator.get_interim_remainder());
+	LOG_DEBUG("file.prepared", "path=\"%s\" bytes=%llu size=%llu", path.c_str(),
+		static_cast<unsigned long long>(_prepared.bytes), static_cast<unsigned long long>(_prepared.stamp.size));
+}
+
+/* the prepared CKsum is used once, by the upload of its file and only if the file was not written since */
+void ClientLogic::resumePrepared(const string& path)
+{
+	FileStamp now;
+	_prepared.active = !_prepared.path.empty() && _prepared.path == path && FileSnapshot::stamp(path, now) && now == _prepared.stamp;
+	_prepared.path.clear();
+}
+
+/* run the client in batch mode, false when some file was not stored */
+bool ClientLogic::clientMain()
+{
+	try 
+	{
+		BufferPool::Lease responseBuffer = _packetPool->lease();
+		BufferPool::Lease requestBuffer = _packetPool->lease();
+		if (!parseAndStoreTransferInfo(TRANSFER_INFO))
+		{
+			clientStop("couldn't parse file transfer details");
+		}
+		if (_options.append && !_appendState.load(APPEND_INFO))
+		{
+			LOG_WARN("append.state", "path=\"%s\" reason=unreadable", APPEND_INFO);
+		}
+		if (_options.tune)
+		{
+			/* the run starts from what the earlier runs learned for this server */
+			_tuner = new TransferTuner(address + ":" + port, _options);
+			if (!_tuner->load(TUNING_INFO))
+			{
+				LOG_WARN("tune.state", "path=\"%s\" reason=unreadable", TUNING_INFO);
+			}
+			_tuner->apply(_options);
+		}
+		_socket->setBufferSize(_options.socketBuffer);
+
+		/* connecting, generating the keys and logging in run on their own thread while the files to send are
+		found and the first one is checksummed, the first byte goes out after the longer of the two and not their sum */
+		thread login([this, &requestBuffer, &responseBuffer]()
+			{
+				Tracer::instance().nameThread("login");
+				if (!_socket->connectToServer())
+				{
+					clientStop("failed to connect server");
+				}
+				AllocationScope scope("login");
+				clientLogin(requestBuffer, responseBuffer);
+				_loggedIn = true;
+			});
+
+		/* the transfer path is one file or a directory tree, which is sent while it is still being scanned */
+		const string transferPath = _filePath;
+		UploadQueue queue(_options.schedule.ordered() ? SCHEDULE_QUEUE_SIZE : UPLOAD_QUEUE_SIZE, &_scheduler);
+		DirectoryScanner scanner(_options.scan, queue);
+		if (std::filesystem::is_directory(transferPath))
+		{
+			scanner.start(transferPath);
+		}
+		else
+		{
+			/* there is no such file in the client path */
+			if (!_fileHandler->checkFileExsistance(transferPath))
+			{
+				clientStop("wrong path to client file");
+			}
+			UploadJob single = { transferPath, transferPath.substr(transferPath.find_last_of("/\\") + 1), FileHandler::fileSize(transferPath) };
+			prepareFile(transferPath);
+			queue.push(single);
+			queue.close();
+		}
+		login.join();
+		if (!_options.replicas.empty())
+		{
+			/* every replica logs in on its own thread while the first files go to the main server */
+			_replicator = new Replicator(_options.replicas, _userName, Utils::decode(_fileHandler->extractBase64privateKey(CLIENT_INFO)));
+			if (!_replicator->load(REPLICA_INFO))
+			{
+				LOG_WARN("replica.state", "path=\"%s\" reason=unreadable", REPLICA_INFO);
+			}
+			_replicator->start();
+		}
+		if (!_options.shards.empty())
+		{
+			startShards();
+			_shards->start();
+		}
+		if (_options.dedup)
+		{
+			if (_fingerprints.open(FINGERPRINT_INFO))
+			{
+				syncFingerprints(requestBuffer);
+			}
+			else
+			{
+				LOG_WARN("dedup.state", "path=\"%s\" reason=unreadable", FINGERPRINT_INFO);
+			}
+		}
+		AllocationScope scope("backup");
+
+		/* stream every file content to the server for backup, the CKsum is caulcalated on the way.
+		small files are collected into packed containers so they do not pay the round trips of their own exchange */
+		uint64_t sent = 0, failed = 0;
+		vector<UploadJob> pack;
+		uint64_t packBytes = 0;
+		vector<UploadJob> orphans;   // files of dropped shard nodes placed on this server
+		UploadJob job;
+		while (true)
+		{
+			if (_shards != nullptr)
+			{
+				collectShards(false, orphans, sent, failed);
+			}
+			if (!orphans.empty())
+			{
+				job = orphans.back();
+				orphans.pop_back();
+			}
+			else if (queue.pop(job))
+			{
+				_scheduler.dispatched();
+				const size_t node = _ring != nullptr ? placeFile(job) : 0;
+				if (node != 0)
+				{
+					/* the session of the node reads and sends the file itself, in parallel with the uploads to this server */
+					_sharded[_shards->offerTo(node - 1, job.path, job.name)] = job;
+					continue;
+				}
+			}
+			else if (_shards == nullptr || !collectShards(true, orphans, sent, failed))
+			{
+				/* the scan is done and so is every node */
+				break;
+			}
+			else
+			{
+				continue;
+			}
+			if (_options.packThreshold == 0 || job.size > _options.packThreshold)
+			{
+				/* --dedup: a file the filter may know is looked up first, a hit is stored by the server from its own
+				copy and is neither read again nor sent. the lookup is a stop and wait exchange like a packed container */
+				uint8_t fingerprint[FINGERPRINT_SIZE];
+				uint32_t crc = 0;
+				const bool fingerprinted = _options.dedup && job.size >= FINGERPRINT_MIN_SIZE && fingerprintFile(job, fingerprint, crc);
+				if (fingerprinted && _fingerprints.mayContain(fingerprint))
+				{
+					drainWindow(requestBuffer, responseBuffer, sent, failed);
+					if (storedByFingerprint(job, fingerprint, crc, requestBuffer, responseBuffer))
+					{
+						sent++;
+						_scheduler.finished(job, true);
+						replicateStored(job);
+						continue;
+					}
+				}
+				if (fingerprinted)
+				{
+					_fingerprints.add(fingerprint);
+				}
+				if (_options.window > 1)
+				{
+					uploadWindowed(job, requestBuffer, responseBuffer, sent, failed);
+				}
+				else
+				{
+					const bool stored = uploadFile(job, requestBuffer, responseBuffer);
+					stored ? sent++ : failed++;
+					_scheduler.finished(job, stored);
+				}
+				tuneTransfer(job.size, job.size >= STRIPE_MIN_SIZE, requestBuffer, responseBuffer, sent, failed);
+				continue;
+			}
+			if (pack.size() == PACK_MAX_MEMBERS || packBytes + job.size > PACK_MAX_BYTES)
+			{
+				/* a packed container is a stop and wait exchange, the pipelined uploads are acknowledged first */
+				drainWindow(requestBuffer, responseBuffer, sent, failed);
+				uploadPack(pack, requestBuffer, responseBuffer, sent, failed);
+				tuneTransfer(packBytes, false, requestBuffer, responseBuffer, sent, failed);
+				packBytes = 0;
+			}
+			pack.push_back(job);
+			packBytes += job.size;
+		}
+		drainWindow(requestBuffer, responseBuffer, sent, failed);
+		uploadPack(pack, requestBuffer, responseBuffer, sent, failed);
+		/* files of a node no outcome came for, their backlog could not be read back */
+		for (const auto& lost : _sharded)
+		{
+			failed++;
+			_scheduler.finished(lost.second, false);
+		}
+		_sharded.clear();
+		scanner.wait();
+		_scheduler.report();
+		if (_options.dedup)
+		{
+			LOG_INFO("dedup.report", "lookups=%llu deduplicated=%llu bytes_not_sent=%llu", static_cast<unsigned long long>(_lookups),
+				static_cast<unsigned long long>(_deduplicated), static_cast<unsigned long long>(_deduplicatedBytes));
+			if (!_fingerprints.flush())
+			{
+				LOG_WARN("dedup.state", "path=\"%s\" reason=not_saved", FINGERPRINT_INFO);
+			}
+		}
+		if (_tuner != nullptr)
+		{
+			_tuner->report();
+			if (!_tuner->save(TUNING_INFO))
+			{
+				LOG_WARN("tune.state", "path=\"%s\" reason=not_saved", TUNING_INFO);
+			}
+		}
+		if (_shards != nullptr)
+		{
+			_shards->finish();
+			for (size_t node = 0; node < _ring->nodes(); node++)
+			{
+				LOG_INFO("shard.placement", "node=%s files=%llu", _ring->node(node).c_str(), static_cast<unsigned long long>(_placed[node]));
+			}
+			_shards->report();
+			if (!_shards->save(SHARD_INFO))
+			{
+				LOG_WARN("shard.state", "path=\"%s\" reason=not_saved", SHARD_INFO);
+			}
+		}
+		if (_replicator != nullptr)
+		{
+			_replicator->finish();
+			_replicator->report();
+			if (!_replicator->save(REPLICA_INFO))
+			{
+				LOG_WARN("replica.state", "path=\"%s\" reason=not_saved", REPLICA_INFO);
+			}
+		}
+		if (_options.append && !_appendState.save(APPEND_INFO))
+		{
+			LOG_WARN("append.state", "path=\"%s\" reason=not_saved", APPEND_INFO);
+		}
+		if (failed > 0 || scanner.errors() > 0)
+		{
+			LOG_WARN("backup.incomplete", "sent=%llu failed=%llu unscanned=%llu", static_cast<unsigned long long>(sent),
+				static_cast<unsigned long long>(failed), static_cast<unsigned long long>(scanner.errors()));
+			return false;
+		}
+		return true;
+	}
+	catch (const std::exception& e)
+	{
+		throw e;
+	}
+
+}
+
+
+
+/* read a response that may be longer than one packet into buffer, the server pads shorter responses to a full packet */
+bool ClientLogic::readResponse(SocketHandler& socket, uint8_t* buffer, size_t capacity, ServerResponse& response)
+{
+	if (!socket.read(buffer) || !unpackResponse(buffer, PACKET_SIZE, response))
+	{
+		return false;
+	}
+	const size_t total = HEADER_SIZE + static_cast<size_t>(response.header.payloadSize);
+	if (total <= PACKET_SIZE)
+	{
+		return true;
+	}
+	if (total > capacity)
+	{
+		return false;
+	}
+	return socket.readBytes(buffer + PACKET_SIZE, total - PACKET_SIZE);
+}
+
+/* ask the server for the files it keeps for this client, one page of LIST_PAGE_ENTRIES at a time */
+bool ClientLogic::listBackedUpFiles(vector<BackedUpFile>& files)
+{
+	vector<uint8_t> listing(HEADER_SIZE + 2 * COUNT_SIZE + LIST_PAGE_ENTRIES * LIST_ENTRY_SIZE);
+	BufferPool::Lease requestBuffer = _packetPool->lease();
+	uint32_t total = 0;
+	do
+	{
+		memset(requestBuffer.data(), 0, PACKET_SIZE);
+		FileListRequest request(LIST_FILES_REQUEST, COUNT_SIZE);
+		packClientID(request.header);
+		memcpy(requestBuffer.data(), &request, REQUEST_HEADER_SIZE);
+		const uint32_t start = static_cast<uint32_t>(files.size());
+		memcpy(requestBuffer.data() + REQUEST_HEADER_SIZE, &start, COUNT_SIZE);
+
+		ServerResponse response;
+		if (!_socket->write(requestBuffer.data()) || !readResponse(*_socket, listing.data(), listing.size(), response))
+		{
+			return false;
+		}
+		if (response.header.code != ServerResponse::SResponseCode::FILE_LIST)
+		{
+			return false;
+		}
+
+		/* payload: total files, files in this page, then the entries */
+		uint32_t count;
+		memcpy(&total, response.payload.payload, COUNT_SIZE);
+		memcpy(&count, response.payload.payload + COUNT_SIZE, COUNT_SIZE);
+		if (count > LIST_PAGE_ENTRIES || (count == 0 && files.size() < total))
+		{
+			return false;
+		}
+		const uint8_t* entry = response.payload.payload + 2 * COUNT_SIZE;
+		for (uint32_t i = 0; i < count; i++, entry += LIST_ENTRY_SIZE)
+		{
+			BackedUpFile file;
+			file.name.assign(reinterpret_cast<const char*>(entry), strnlen(reinterpret_cast<const char*>(entry), FILE_NAME_SIZE));
+			memcpy(&file.size, entry + FILE_NAME_SIZE, FILE_SIZE_SIZE);
+			memcpy(&file.crc, entry + FILE_NAME_SIZE + FILE_SIZE_SIZE, CRC_SIZE);
+			files.push_back(file);
+		}
+	} while (files.size() < total);
+	return true;
+}
+
+/* prepare a request for the plain bytes [offset, offset + length) of a backed up file */
+void ClientLogic::createFetchRangeRequest(uint8_t* requestBuffer, const string& fileName, uint64_t offset, uint32_t length)
+{
+	memset(requestBuffer, 0, PACKET_SIZE);
+	FetchRangeRequest request(FETCH_RANGE_REQUEST, FETCH_RANGE_PAYLOAD_SIZE);
+	packClientID(request.header);
+	memcpy(requestBuffer, &request, REQUEST_HEADER_SIZE);
+
+	memcpy(requestBuffer + REQUEST_HEADER_SIZE, fileName.c_str(), std::min<size_t>(fileName.length(), FILE_NAME_SIZE));
+	memcpy(requestBuffer + REQUEST_HEADER_SIZE + FILE_NAME_SIZE, &offset, OFFSET_SIZE);
+	memcpy(requestBuffer + REQUEST_HEADER_SIZE + FILE_NAME_SIZE + OFFSET_SIZE, &length, CONTENT_SIZE);
+}
+
+/* restore worker - on its own connection, take the next range that nobody fetched yet, decrypt it in place,
+check its CKsum and write it at its offset. the range CKsums are combined into the file CKsum afterwards */
+void ClientLogic::fetchRanges(const BackedUpFile& file, RandomAccessFile& output, BufferPool& rangePool,
+	atomic<uint32_t>& nextRange, vector<uint32_t>& rangeCRCs, atomic<bool>& failed)
+{
+	Tracer::instance().nameThread("fetch");
+	SocketHandler socket;
+	if (!socket.initializeSocketInfo(address, port) || !socket.connectToServer())
+	{
+		failed = true;
+		return;
+	}
+	BufferPool::Lease buffer = rangePool.lease();
+	uint8_t requestBuffer[PACKET_SIZE];
+	if (!buffer.valid())
+	{
+		failed = true;
+		return;
+	}
+	AESWrapper aes((unsigned char*)_AESKey.c_str(), AESWrapper::DEFAULT_KEYLENGTH);
+
+	for (uint32_t range = nextRange++; range < rangeCRCs.size() && !failed; range = nextRange++)
+	{
+		AllocationScope scope("range fetch", FILE_UPLOAD_MAX_ALLOCATIONS, FILE_UPLOAD_MAX_BYTES);
+		const uint64_t offset = static_cast<uint64_t>(range) * RANGE_SIZE;
+		const uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(RANGE_SIZE, file.size - offset));
+		createFetchRangeRequest(requestBuffer, file.name, offset, length);
+
+		ServerResponse response;
+		if (!socket.write(requestBuffer) || !readResponse(socket, buffer.data(), buffer.size(), response)
+			|| response.header.code != ServerResponse::SResponseCode::FILE_RANGE)
+		{
+			failed = true;
+			return;
+		}
+
+		/* payload: offset, plain size, CKsum of the plain range and the encrypted range */
+		uint64_t rangeOffset;
+		uint32_t plainSize, serverCRC, cipherSize;
+		const uint8_t* payload = response.payload.payload;
+		memcpy(&rangeOffset, payload, OFFSET_SIZE);
+		memcpy(&plainSize, payload + OFFSET_SIZE, CONTENT_SIZE);
+		memcpy(&serverCRC, payload + OFFSET_SIZE + CONTENT_SIZE, CRC_SIZE);
+		memcpy(&cipherSize, payload + OFFSET_SIZE + CONTENT_SIZE + CRC_SIZE, CONTENT_SIZE);
+		if (rangeOffset != offset || plainSize != length || cipherSize != AESWrapper::cipherSize(length)
+			|| response.header.payloadSize != RANGE_HEADER_SIZE + cipherSize)
+		{
+			failed = true;
+			return;
+		}
+
+		/* every range is encrypted on its own, decrypt it in place */
+		uint8_t* plain = response.payload.payload + RANGE_HEADER_SIZE;
+		try
+		{
+			aes.resetChain();
+			if (aes.decryptChunk(ConstByteSpan(plain, cipherSize), ByteSpan(plain, cipherSize), true) != length)
+			{
+				failed = true;
+				return;
+			}
+		}
+		catch (const std::exception&)
+		{
+			failed = true;
+			return;
+		}
+
+		if (Utils::crc32Update(0, ConstByteSpan(plain, length)) != serverCRC || !output.writeAt(offset, plain, length))
+		{
+			failed = true;
+			return;
+		}
+		rangeCRCs[range] = serverCRC;
+	}
+}
+
+/* restore one backed up file into directory, fetching its ranges over several connections in parallel */
+bool ClientLogic::restoreFile(const BackedUpFile& file, const string& directory)
+{
+	/* never write outside the restore directory */
+	const std::filesystem::path relative(file.name);
+	if (file.name.empty() || relative.is_absolute() || relative.has_root_name()
+		|| std::find(relative.begin(), relative.end(), "..") != relative.end())
+	{
+		return false;
+	}
+	const string path = directory + "/" + file.name;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+	RandomAccessFile output;
+	if (!output.open(path, true, true) || !output.resize(file.size))
+	{
+		return false;
+	}
+
+	const uint32_t ranges = static_cast<uint32_t>((file.size + RANGE_SIZE - 1) / RANGE_SIZE);
+	const uint32_t streams = std::max<uint32_t>(1, std::min<uint32_t>(_options.streams, ranges));
+	BufferPool rangePool(HEADER_SIZE + RANGE_HEADER_SIZE + RANGE_SIZE + AES_BLOCK_SIZE, streams, _budget, _options.largePages);
+	vector<uint32_t> rangeCRCs(ranges);
+	atomic<uint32_t> nextRange(0);
+	atomic<bool> failed(false);
+
+	vector<thread> workers;
+	for (uint32_t i = 0; i < streams; i++)
+	{
+		workers.emplace_back(&ClientLogic::fetchRanges, this, std::cref(file), std::ref(output), std::ref(rangePool),
+			std::ref(nextRange), std::ref(rangeCRCs), std::ref(failed));
+	}
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+	output.close();
+	if (failed)
+	{
+		return false;
+	}
+
+	/* the whole file CKsum must match the one the server keeps */
+	boost::crc_32_type empty;
+	uint32_t crc = empty.checksum();
+	for (uint32_t range = 0; range < ranges; range++)
+	{
+		const uint64_t length = std::min<uint64_t>(RANGE_SIZE, file.size - static_cast<uint64_t>(range) * RANGE_SIZE);
+		crc = Utils::crc32Combine(crc, rangeCRCs[range], length);
+	}
+	return crc == file.crc;
+}
+
+/* run the client in restore mode - download one or all of the files backed up by this client */
+void ClientLogic::clientRestore()
+{
+	BufferPool::Lease responseBuffer = _packetPool->lease();
+	BufferPool::Lease requestBuffer = _packetPool->lease();
+	if (!parseAndStoreTransferInfo(TRANSFER_INFO))
+	{
+		clientStop("couldn't parse file transfer details");
+	}
+	if (!_fileHandler->checkFileExsistance(CLIENT_INFO))
+	{
+		clientStop("client is not registered, there is nothing to restore");
+	}
+	if (!_socket->connectToServer())
+	{
+		clientStop("failed to connect server");
+	}
+	clientLogin(requestBuffer, responseBuffer);
+	AllocationScope scope("restore");
+	if (!_options.shards.empty())
+	{
+		restoreSharded();
+		return;
+	}
+
+	vector<BackedUpFile> files;
+	if (!listBackedUpFiles(files))
+	{
+		clientStop("couldn't list the backed up files");
+	}
+	bool found = false;
+	for (const BackedUpFile& file : files)
+	{
+		if (_options.restoreFile != RESTORE_ALL && file.name != _options.restoreFile)
+		{
+			continue;
+		}
+		found = true;
+		LOG_INFO("restore.file", "name=\"%s\" bytes=%llu", file.name.c_str(), static_cast<unsigned long long>(file.size));
+		if (!restoreFile(file, _options.restoreDirectory))
+		{
+			clientStop("failed to restore " + file.name);
+		}
+	}
+	if (!found)
+	{
+		clientStop("no such backed up file: " + _options.restoreFile);
+	}
+}
+
+/* restore from every node of a sharded backup. a file is taken from the node the ring places it on, or from another
+node that has it when its own node does not - it was backed up before that node joined or while it was down */
+void ClientLogic::restoreSharded()
+{
+	startShards();
+	const size_t nodes = _ring->nodes();
+	const string mainAddress = address, mainPort = port, mainUID = _rawClientUID, mainKey = _AESKey;
+	SocketHandler* mainSocket = _socket;
+
+	/* the restore code works on the session state, it is pointed at one node after the other */
+	auto useNode = [&](size_t node)
+	{
+		const size_t spos = _ring->node(node).rfind(':');
+		address = node == 0 ? mainAddress : _ring->node(node).substr(0, spos);
+		port = node == 0 ? mainPort : _ring->node(node).substr(spos + 1);
+		_socket = node == 0 ? mainSocket : &_shards->socket(node - 1);
+		_rawClientUID = node == 0 ? mainUID : _shards->uid(node - 1);
+		_AESKey = node == 0 ? mainKey : _shards->aesKey(node - 1);
+	};
+
+	vector<vector<BackedUpFile>> listings(nodes);
+	vector<set<string>> names(nodes);
+	vector<bool> listed(nodes, false);
+	for (size_t node = 0; node < nodes; node++)
+	{
+		if (node > 0 && _shards->uid(node - 1).empty())
+		{
+			/* the client never backed up to the node */
+			continue;
+		}
+		if (node > 0 && !_shards->connect(node - 1))
+		{
+			LOG_WARN("shard.unreachable", "node=%s", _ring->node(node).c_str());
+			continue;
+		}
+		useNode(node);
+		listed[node] = listBackedUpFiles(listings[node]);
+		if (!listed[node])
+		{
+			LOG_WARN("shard.unreachable", "node=%s", _ring->node(node).c_str());
+		}
+		for (const BackedUpFile& file : listings[node])
+		{
+			names[node].insert(file.name);
+		}
+	}
+
+	set<string> restored;
+	for (size_t node = 0; node < nodes; node++)
+	{
+		useNode(node);
+		for (const BackedUpFile& file : listings[node])
+		{
+			if (_options.restoreFile != RESTORE_ALL && file.name != _options.restoreFile)
+			{
+				continue;
+			}
+			const size_t owner = _ring->locate(ShardRing::key(_clientUID, file.name));
+			if (restored.count(file.name) > 0 || (owner != node && names[owner].count(file.name) > 0))
+			{
+				continue;
+			}
+			LOG_INFO("restore.file", "name=\"%s\" bytes=%llu node=%s", file.name.c_str(), static_cast<unsigned long long>(file.size), _ring->node(node).c_str());
+			if (!restoreFile(file, _options.restoreDirectory))
+			{
+				useNode(0);
+				clientStop("failed to restore " + file.name);
+			}
+			restored.insert(file.name);
+		}
+	}
+	useNode(0);
+	if (restored.empty())
+	{
+		clientStop("no such backed up file: " + _options.restoreFile);
+	}
+}
+
+/* run the client in load mode - many virtual clients against the server of transfer.info or of --load-server */
+void ClientLogic::clientLoad()
+{
+	if (_options.load.server.empty())
+	{
+		if (!parseAndStoreTransferInfo(TRANSFER_INFO))
+		{
+			clientStop("couldn't parse file transfer details");
+		}
+	}
+	else
+	{
+		const size_t spos = _options.load.server.rfind(':');
+		address = _options.load.server.substr(0, spos);
+		port = spos == string::npos ? "" : _options.load.server.substr(spos + 1);
+		if (!SocketHandler::addressValidation(address) || !SocketHandler::portValidation(port))
+		{
+			clientStop("invalid load server: " + _options.load.server);
+		}
+	}
+	LoadGenerator generator(_options.load, address, port);
+	if (!generator.run())
+	{
+		clientStop("no load session was run");
+	}
+	generator.report();
+}
@@ -0,0 +1,315 @@
+#include "ClientOptions.h"
+#include "MemoryBudget.h"
+#include "protocol.h"
+#include "SocketHandler.h"
+#include <limits>
+#include <stdexcept>
+
+ClientOptions::ClientOptions() : maxMemory(DEFAULT_MAX_MEMORY), largePages(false), restore(false),
+	restoreFile(RESTORE_ALL), restoreDirectory(DEFAULT_RESTORE_DIRECTORY), streams(DEFAULT_STREAMS), window(1), packThreshold(0), delta(false),
+	stripes(1), autoStripes(false), socketBuffer(0), tune(false), snapshot(false), append(false), dedup(false)
+{
+}
+
+/* parse a positive count such as a number of streams or threads */
+bool ClientOptions::parseCount(const string& value, unsigned int& count)
+{
+	try
+	{
+		size_t pos = 0;
+		const unsigned long parsed = std::stoul(value, &pos);
+		if (pos != value.size() || parsed == 0 || parsed > MAX_COUNT)
+		{
+			return false;
+		}
+		count = static_cast<unsigned int>(parsed);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+/* parse a non negative decimal number such as a rate or a ratio */
+bool ClientOptions::parseNumber(const string& value, double& number)
+{
+	try
+	{
+		size_t pos = 0;
+		const double parsed = std::stod(value, &pos);
+		if (pos != value.size() || !(parsed >= 0))
+		{
+			return false;
+		}
+		number = parsed;
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+/* parse --name=value arguments */
+bool ClientOptions::parse(int argc, char* argv[], string& error)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const string argument = argv[i];
+		const size_t spos = argument.find('=');
+		const string name = argument.substr(0, spos);
+		const string value = (spos == string::npos) ? "" : argument.substr(spos + 1);
+
+		if (name == "--max-memory")
+		{
+			if (!MemoryBudget::parseSize(value, maxMemory))
+			{
+				error = "invalid memory size: " + value;
+				return false;
+			}
+			/* one plain chunk and its encrypted copy must fit in the budget */
+			if (maxMemory < 2 * (CHUNK_SIZE + AES_BLOCK_SIZE))
+			{
+				error = "--max-memory must be at least " + to_string(2 * (CHUNK_SIZE + AES_BLOCK_SIZE)) + " bytes";
+				return false;
+			}
+		}
+		else if (name == "--large-pages")
+		{
+			largePages = true;
+		}
+		else if (name == "--restore")
+		{
+			restore = true;
+			restoreFile = value.empty() ? RESTORE_ALL : value;
+		}
+		else if (name == "--restore-dir" && !value.empty())
+		{
+			restoreDirectory = value;
+		}
+		else if (name == "--streams")
+		{
+			if (!parseCount(value, streams))
+			{
+				error = "invalid stream count: " + value;
+				return false;
+			}
+		}
+		else if (name == "--window")
+		{
+			if (!parseCount(value, window) || window > MAX_WINDOW)
+			{
+				error = "--window must be between 1 and " + to_string(MAX_WINDOW);
+				return false;
+			}
+		}
+		else if (name == "--pack")
+		{
+			packThreshold = DEFAULT_PACK_THRESHOLD;
+			if (!value.empty() && (!MemoryBudget::parseSize(value, packThreshold) || packThreshold > PACK_MAX_BYTES))
+			{
+				error = "--pack size must be between 1 and " + to_string(PACK_MAX_BYTES) + " bytes";
+				return false;
+			}
+		}
+		else if (name == "--delta")
+		{
+			delta = true;
+		}
+		else if (name == "--snapshot")
+		{
+			snapshot = true;
+		}
+		else if (name == "--append")
+		{
+			append = true;
+		}
+		else if (name == "--dedup")
+		{
+			dedup = true;
+		}
+		else if (name == "--stripes")
+		{
+			autoStripes = value == "auto";
+			if (autoStripes)
+			{
+				stripes = MAX_STRIPES;
+			}
+			else if (!parseCount(value, stripes) || stripes > MAX_STRIPES)
+			{
+				error = "--stripes must be auto or between 1 and " + to_string(MAX_STRIPES);
+				return false;
+			}
+		}
+		else if (name == "--socket-buffer")
+		{
+			if (!MemoryBudget::parseSize(value, socketBuffer) || socketBuffer < TUNE_MIN_SOCKET_BUFFER || socketBuffer > TUNE_MAX_SOCKET_BUFFER)
+			{
+				error = "--socket-buffer must be between " + to_string(TUNE_MIN_SOCKET_BUFFER) + " and " + to_string(TUNE_MAX_SOCKET_BUFFER) + " bytes";
+				return false;
+			}
+		}
+		else if (name == "--tune")
+		{
+			tune = true;
+		}
+		else if (name == "--schedule")
+		{
+			if (!ScheduleOptions::parsePolicy(value, schedule.policy))
+			{
+				error = "--schedule must be fifo, smallest, largest or deadline";
+				return false;
+			}
+		}
+		else if (name == "--priority" && !value.empty())
+		{
+			schedule.priorities.push_back(value);
+		}
+		else if (name == "--deadline")
+		{
+			FileDeadline deadline;
+			if (!ScheduleOptions::parseDeadline(value, deadline))
+			{
+				error = "--deadline must be SECONDS:PATTERN";
+				return false;
+			}
+			schedule.deadlines.push_back(deadline);
+		}
+		else if (name == "--include" && !value.empty())
+		{
+			scan.includes.push_back(value);
+		}
+		else if (name == "--exclude" && !value.empty())
+		{
+			scan.excludes.push_back(value);
+		}
+		else if (name == "--one-file-system")
+		{
+			scan.oneFileSystem = true;
+		}
+		else if (name == "--follow-symlinks")
+		{
+			scan.followSymlinks = true;
+		}
+		else if (name == "--scan-threads")
+		{
+			if (!parseCount(value, scan.threads))
+			{
+				error = "invalid thread count: " + value;
+				return false;
+			}
+		}
+		else if (name == "--replica")
+		{
+			const size_t colon = value.rfind(':');
+			if (colon == string::npos || !SocketHandler::addressValidation(value.substr(0, colon)) || !SocketHandler::portValidation(value.substr(colon + 1)))
+			{
+				error = "--replica must be HOST:PORT";
+				return false;
+			}
+			replicas.push_back(value);
+		}
+		else if (name == "--shard")
+		{
+			const size_t colon = value.rfind(':');
+			if (colon == string::npos || !SocketHandler::addressValidation(value.substr(0, colon)) || !SocketHandler::portValidation(value.substr(colon + 1)))
+			{
+				error = "--shard must be HOST:PORT";
+				return false;
+			}
+			shards.push_back(value);
+		}
+		else if (name == "--trace")
+		{
+			if (value.empty())
+			{
+				error = "--trace must be given a file";
+				return false;
+			}
+			trace = value;
+		}
+		else if (name == "--load")
+		{
+			try
+			{
+				size_t pos = 0;
+				const unsigned long clients = std::stoul(value, &pos);
+				if (pos != value.size() || clients == 0 || clients > numeric_limits<unsigned int>::max())
+				{
+					throw invalid_argument(value);
+				}
+				load.clients = static_cast<unsigned int>(clients);
+			}
+			catch (...)
+			{
+				error = "invalid session count: " + value;
+				return false;
+			}
+		}
+		else if (name == "--load-concurrency")
+		{
+			if (!parseCount(value, load.concurrency))
+			{
+				error = "--load-concurrency must be between 1 and " + to_string(MAX_COUNT);
+				return false;
+			}
+		}
+		else if (name == "--load-rate")
+		{
+			if (!parseNumber(value, load.arrivalRate))
+			{
+				error = "invalid arrival rate: " + value;
+				return false;
+			}
+		}
+		else if (name == "--load-reconnect")
+		{
+			if (!parseNumber(value, load.reconnectRatio) || load.reconnectRatio > 1)
+			{
+				error = "--load-reconnect must be between 0 and 1";
+				return false;
+			}
+		}
+		else if (name == "--load-sizes")
+		{
+			if (!FileSizeDistribution::parse(value, load.sizes))
+			{
+				error = "--load-sizes must be fixed:SIZE, uniform:MIN-MAX or lognormal:MEDIAN,SIGMA";
+				return false;
+			}
+		}
+		else if (name == "--load-server" && !value.empty())
+		{
+			load.server = value;
+		}
+		else if (name == "--load-seed")
+		{
+			try
+			{
+				size_t pos = 0;
+				load.seed = std::stoull(value, &pos);
+				if (pos != value.size())
+				{
+					throw invalid_argument(value);
+				}
+			}
+			catch (...)
+			{
+				error = "invalid seed: " + value;
+				return false;
+			}
+		}
+		else
+		{
+			error = "unknown option: " + argument;
+			return false;
+		}
+	}
+	if (!replicas.empty() && !shards.empty())
+	{
+		error = "--replica and --shard cannot be used together";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,210 @@
+#include "DeltaEncoder.h"
+#include "RandomAccessFile.h"
+#include <boost/crc.hpp>
+#include <algorithm>
+#include <cstring>
+#include <sha.h>
+
+DeltaEncoder::DeltaEncoder(uint32_t blockSize) : _blockSize(blockSize), _sorted(false)
+{
+}
+
+DeltaEncoder::~DeltaEncoder()
+{
+}
+
+uint32_t DeltaEncoder::blockSize() const
+{
+	return _blockSize;
+}
+
+void DeltaEncoder::reserve(size_t blocks)
+{
+	_signatures.reserve(blocks);
+}
+
+void DeltaEncoder::addSignature(uint32_t weak, const uint8_t* strong)
+{
+	BlockSignature signature;
+	signature.weak = weak;
+	memcpy(signature.strong, strong, STRONG_HASH_SIZE);
+	signature.index = static_cast<uint32_t>(_signatures.size());
+	_signatures.push_back(signature);
+	_tags.set(tag(weak));
+	_sorted = false;
+}
+
+uint32_t DeltaEncoder::tag(uint32_t weak)
+{
+	return ((weak & 0xffff) + (weak >> 16)) & 0xffff;
+}
+
+/* a is the sum of the bytes and b the sum of the running sums of a, both mod 2^16 - so the checksum of the
+block one byte further is found from the one leaving and the one entering without summing the block again */
+void DeltaEncoder::weakSums(const uint8_t* data, size_t length, uint32_t& a, uint32_t& b)
+{
+	a = 0;
+	b = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		a += data[i];
+		b += a;
+	}
+	a &= 0xffff;
+	b &= 0xffff;
+}
+
+void DeltaEncoder::strongHash(const uint8_t* data, size_t length, uint8_t* hash)
+{
+	CryptoPP::SHA256 sha;
+	sha.CalculateTruncatedDigest(hash, STRONG_HASH_SIZE, data, length);
+}
+
+/* the stored block with this weak checksum and the same strong hash, the block after the previous match is
+taken first so runs of blocks stay single copies when blocks repeat */
+bool DeltaEncoder::find(uint32_t weak, const uint8_t* block, uint32_t preferred, uint32_t& index)
+{
+	if (!_tags.test(tag(weak)))
+	{
+		return false;
+	}
+	auto byWeak = [](const BlockSignature& signature, uint32_t value) { return signature.weak < value; };
+	auto first = std::lower_bound(_signatures.begin(), _signatures.end(), weak, byWeak);
+	if (first == _signatures.end() || first->weak != weak)
+	{
+		return false;
+	}
+	uint8_t strong[STRONG_HASH_SIZE];
+	strongHash(block, _blockSize, strong);
+
+	auto byIndex = [](const BlockSignature& signature, const pair<uint32_t, uint32_t>& key)
+	{
+		return signature.weak < key.first || (signature.weak == key.first && signature.index < key.second);
+	};
+	auto next = std::lower_bound(first, _signatures.end(), make_pair(weak, preferred), byIndex);
+	if (next != _signatures.end() && next->weak == weak && next->index == preferred && memcmp(next->strong, strong, STRONG_HASH_SIZE) == 0)
+	{
+		index = preferred;
+		return true;
+	}
+	for (auto candidate = first; candidate != _signatures.end() && candidate->weak == weak; ++candidate)
+	{
+		if (memcmp(candidate->strong, strong, STRONG_HASH_SIZE) == 0)
+		{
+			index = candidate->index;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* find the stored blocks in the file. every byte is read once through the window (at least two blocks),
+the CKsum of the whole file is calculated on the way so the second pass only reads the literal bytes */
+bool DeltaEncoder::scan(RandomAccessFile& file, uint64_t fileSize, uint8_t* window, size_t windowSize, vector<BlockMatch>& matches, uint32_t& crc)
+{
+	if (windowSize < 2 * static_cast<size_t>(_blockSize))
+	{
+		return false;
+	}
+	if (!_sorted)
+	{
+		std::sort(_signatures.begin(), _signatures.end(),
+			[](const BlockSignature& x, const BlockSignature& y) { return x.weak < y.weak || (x.weak == y.weak && x.index < y.index); });
+		_sorted = true;
+	}
+
+	boost::crc_32_type crc_calculator;
+	uint64_t windowStart = 0;   // file offset of window[0]
+	size_t buffered = 0;
+	uint64_t position = 0;      // file offset of the block being matched
+	uint32_t a = 0;
+	uint32_t b = 0;
+	bool rolling = false;
+	uint8_t leaving = 0;
+	while (position + _blockSize <= fileSize)
+	{
+		size_t start = static_cast<size_t>(position - windowStart);
+		if (start + _blockSize > buffered)
+		{
+			/* keep the bytes not matched yet and read on behind them */
+			memmove(window, window + start, buffered - start);
+			windowStart = position;
+			buffered -= start;
+			start = 0;
+			const size_t wanted = static_cast<size_t>(std::min<uint64_t>(windowSize - buffered, fileSize - windowStart - buffered));
+			size_t read = 0;
+			if (!file.readAt(windowStart + buffered, window + buffered, wanted, read) || read != wanted)
+			{
+				return false;
+			}
+			crc_calculator.process_bytes(window + buffered, wanted);
+			buffered += wanted;
+		}
+		const uint8_t* block = window + start;
+		if (rolling)
+		{
+			a = (a - leaving + block[_blockSize - 1]) & 0xffff;
+			b = (b - _blockSize * leaving + a) & 0xffff;
+		}
+		else
+		{
+			weakSums(block, _blockSize, a, b);
+			rolling = true;
+		}
+
+		const uint32_t preferred = matches.empty() ? 0 : matches.back().index + matches.back().count;
+		uint32_t index;
+		if (find(a | (b << 16), block, preferred, index))
+		{
+			if (!matches.empty() && index == preferred && matches.back().offset + static_cast<uint64_t>(matches.back().count) * _blockSize == position)
+			{
+				matches.back().count++;
+			}
+			else
+			{
+				matches.push_back({ position, index, 1 });
+			}
+			position += _blockSize;
+			rolling = false;
+			continue;
+		}
+		leaving = block[0];
+		position++;
+	}
+
+	/* the tail shorter than a block is a literal, it still counts in the CKsum */
+	for (uint64_t readEnd = windowStart + buffered; readEnd < fileSize;)
+	{
+		const size_t wanted = static_cast<size_t>(std::min<uint64_t>(windowSize, fileSize - readEnd));
+		size_t read = 0;
+		if (!file.readAt(readEnd, window, wanted, read) || read != wanted)
+		{
+			return false;
+		}
+		crc_calculator.process_bytes(window, wanted);
+		readEnd += wanted;
+	}
+	crc = crc_calculator.checksum();
+	return true;
+}
+
+/* plain size of the ops that describe the file with these matches */
+uint64_t DeltaEncoder::deltaSize(const vector<BlockMatch>& matches, uint32_t blockSize, uint64_t fileSize)
+{
+	uint64_t size = 0;
+	uint64_t end = 0;
+	for (const BlockMatch& match : matches)
+	{
+		if (match.offset > end)
+		{
+			size += DELTA_LITERAL_HEADER_SIZE + (match.offset - end);
+		}
+		size += DELTA_COPY_SIZE;
+		end = match.offset + static_cast<uint64_t>(match.count) * blockSize;
+	}
+	if (fileSize > end)
+	{
+		size += DELTA_LITERAL_HEADER_SIZE + (fileSize - end);
+	}
+	return size;
+}
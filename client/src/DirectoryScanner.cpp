@@ -0,0 +1,296 @@
+#include "DirectoryScanner.h"
+#include "protocol.h"
+#include "FileSnapshot.h"
+#include "Tracer.h"
+#include <cstring>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+DirectoryScanner::DirectoryScanner(const ScanOptions& options, UploadQueue& queue)
+	: _options(options), _queue(queue), _pending(0), _pushes(0), _running(0), _filesFound(0), _errors(0)
+{
+	if (_options.threads == 0)
+	{
+		_options.threads = 1;
+	}
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+	wait();
+}
+
+static bool matchFrom(const string& pattern, size_t p, const string& path, size_t s)
+{
+	while (p < pattern.size())
+	{
+		if (pattern[p] == '*')
+		{
+			const bool crossesDirectories = p + 1 < pattern.size() && pattern[p + 1] == '*';
+			const size_t next = p + (crossesDirectories ? 2 : 1);
+			/* "**" followed by '/' also matches no directory at all */
+			if (crossesDirectories && next < pattern.size() && pattern[next] == '/' && matchFrom(pattern, next + 1, path, s))
+			{
+				return true;
+			}
+			for (size_t i = s; ; i++)
+			{
+				if (matchFrom(pattern, next, path, i))
+				{
+					return true;
+				}
+				if (i == path.size() || (!crossesDirectories && path[i] == '/'))
+				{
+					return false;
+				}
+			}
+		}
+		if (s == path.size() || (pattern[p] == '?' ? path[s] == '/' : pattern[p] != path[s]))
+		{
+			return false;
+		}
+		p++;
+		s++;
+	}
+	return s == path.size();
+}
+
+/* glob match: '?' is one character, '*' any characters but '/', '**' any characters including '/' */
+bool DirectoryScanner::matchPattern(const string& pattern, const string& path)
+{
+	return matchFrom(pattern, 0, path, 0);
+}
+
+bool DirectoryScanner::matchesPath(const string& pattern, const string& relative)
+{
+	/* a pattern without '/' is matched against the file name, like .gitignore does */
+	if (pattern.find('/') == string::npos)
+	{
+		const size_t slash = relative.find_last_of('/');
+		return matchPattern(pattern, slash == string::npos ? relative : relative.substr(slash + 1));
+	}
+	return matchPattern(pattern, relative);
+}
+
+bool DirectoryScanner::matches(const vector<string>& patterns, const string& relative) const
+{
+	for (const string& pattern : patterns)
+	{
+		if (matchesPath(pattern, relative))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* identity of the file system a path lives on */
+string DirectoryScanner::fileSystemOf(const filesystem::path& path)
+{
+#ifdef _WIN32
+	std::error_code error;
+	return filesystem::absolute(path, error).root_name().string();
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+	{
+		return "";
+	}
+	return std::to_string(static_cast<unsigned long long>(info.st_dev));
+#endif
+}
+
+bool DirectoryScanner::sameFileSystem(const filesystem::path& path) const
+{
+	return !_options.oneFileSystem || fileSystemOf(path) == _rootFileSystem;
+}
+
+/* when links are followed the same directory can be reached twice, scan it once */
+bool DirectoryScanner::firstVisit(const filesystem::path& directory)
+{
+	if (!_options.followSymlinks)
+	{
+		return true;
+	}
+	std::error_code error;
+	const filesystem::path real = filesystem::canonical(directory, error);
+	if (error)
+	{
+		return false;
+	}
+	lock_guard<mutex> guard(_visitedLock);
+	return _visited.insert(real).second;
+}
+
+void DirectoryScanner::start(const string& root)
+{
+	_root = filesystem::path(root);
+	_rootFileSystem = fileSystemOf(_root);
+	for (unsigned int i = 0; i < _options.threads; i++)
+	{
+		_deques.push_back(unique_ptr<WorkDeque>(new WorkDeque()));
+	}
+	firstVisit(_root);
+	pushDirectory(0, _root);
+	_running = _options.threads;
+	for (unsigned int i = 0; i < _options.threads; i++)
+	{
+		_workers.emplace_back(&DirectoryScanner::worker, this, i);
+	}
+}
+
+void DirectoryScanner::wait()
+{
+	for (thread& worker : _workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+}
+
+uint64_t DirectoryScanner::filesFound() const
+{
+	return _filesFound;
+}
+
+uint64_t DirectoryScanner::errors() const
+{
+	return _errors;
+}
+
+void DirectoryScanner::pushDirectory(unsigned int id, const filesystem::path& directory)
+{
+	_pending++;
+	{
+		lock_guard<mutex> guard(_deques[id]->lock);
+		_deques[id]->directories.push_back(directory);
+	}
+	{
+		lock_guard<mutex> guard(_workLock);
+		_pushes++;
+	}
+	_workChanged.notify_one();
+}
+
+/* own work first (depth first keeps the deque short), then steal the oldest - largest - subtree of another thread */
+bool DirectoryScanner::takeDirectory(unsigned int id, filesystem::path& directory)
+{
+	{
+		lock_guard<mutex> guard(_deques[id]->lock);
+		if (!_deques[id]->directories.empty())
+		{
+			directory = std::move(_deques[id]->directories.back());
+			_deques[id]->directories.pop_back();
+			return true;
+		}
+	}
+	for (unsigned int i = 1; i < _deques.size(); i++)
+	{
+		WorkDeque& victim = *_deques[(id + i) % _deques.size()];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.directories.empty())
+		{
+			directory = std::move(victim.directories.front());
+			victim.directories.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void DirectoryScanner::worker(unsigned int id)
+{
+	Tracer::instance().nameThread("scanner");
+	filesystem::path directory;
+	while (_pending > 0)
+	{
+		/* an idle thread sleeps until another directory is queued - the others may be listing a large directory
+		or blocked on a full upload queue for a long time */
+		uint64_t pushes;
+		{
+			lock_guard<mutex> guard(_workLock);
+			pushes = _pushes;
+		}
+		if (!takeDirectory(id, directory))
+		{
+			unique_lock<mutex> guard(_workLock);
+			_workChanged.wait(guard, [this, pushes]() { return _pending == 0 || _pushes != pushes; });
+			continue;
+		}
+		scanDirectory(id, directory);
+		if (--_pending == 0)
+		{
+			lock_guard<mutex> guard(_workLock);
+			_workChanged.notify_all();
+		}
+	}
+	/* the last thread out ends the scan */
+	if (--_running == 0)
+	{
+		_queue.close();
+	}
+}
+
+/* one directory: files go to the upload queue, sub directories to this thread's deque.
+the entry type and size come with the directory listing itself wherever the platform provides them */
+void DirectoryScanner::scanDirectory(unsigned int id, const filesystem::path& directory)
+{
+	std::error_code error;
+	filesystem::directory_iterator entries(directory, filesystem::directory_options::skip_permission_denied, error);
+	if (error)
+	{
+		_errors++;
+		return;
+	}
+	for (const filesystem::directory_entry& entry : entries)
+	{
+		const string relative = entry.path().lexically_relative(_root).generic_string();
+		const bool isLink = entry.is_symlink(error);
+		if (isLink && !_options.followSymlinks)
+		{
+			continue;
+		}
+		if (entry.is_directory(error))
+		{
+			if (!matches(_options.excludes, relative) && sameFileSystem(entry.path()) && firstVisit(entry.path()))
+			{
+				pushDirectory(id, entry.path());
+			}
+			continue;
+		}
+		if (!entry.is_regular_file(error) || matches(_options.excludes, relative))
+		{
+			continue;
+		}
+		if (!_options.includes.empty() && !matches(_options.includes, relative))
+		{
+			continue;
+		}
+		const string name = entry.path().filename().string();
+		if (name.size() > strlen(SNAPSHOT_SUFFIX) && name.compare(name.size() - strlen(SNAPSHOT_SUFFIX), string::npos, SNAPSHOT_SUFFIX) == 0)
+		{
+			/* clone left by a backup that is running or was stopped */
+			continue;
+		}
+		if (relative.size() >= FILE_NAME_SIZE)
+		{
+			/* does not fit the protocol file name field */
+			_errors++;
+			continue;
+		}
+		const uint64_t size = entry.file_size(error);
+		if (error)
+		{
+			_errors++;
+			continue;
+		}
+		_filesFound++;
+		if (!_queue.push({ entry.path().string(), relative, size }))
+		{
+			return;
+		}
+	}
+}
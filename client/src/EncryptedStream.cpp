@@ -0,0 +1,68 @@
+#include "EncryptedStream.h"
+#include "SocketHandler.h"
+#include "protocol.h"
+#include <algorithm>
+#include <cstring>
+
+EncryptedStream::EncryptedStream(BufferPool& pool, const string& key, SocketHandler& socket)
+	: _chunk(pool.lease()), _aes(reinterpret_cast<const unsigned char*>(key.c_str()), AESWrapper::DEFAULT_KEYLENGTH),
+	_socket(socket), _filled(0), _sent(0)
+{
+}
+
+EncryptedStream::~EncryptedStream()
+{
+}
+
+bool EncryptedStream::valid() const
+{
+	return _chunk.valid() && _chunk.size() >= CHUNK_SIZE + AES_BLOCK_SIZE;
+}
+
+/* encrypt the collected bytes in place, the chunk has room for the padding */
+bool EncryptedStream::flush(bool last)
+{
+	const size_t cipherLen = _aes.encryptChunk(ConstByteSpan(_chunk.data(), _filled), ByteSpan(_chunk.data(), _chunk.size()), last);
+	_filled = 0;
+	_sent += cipherLen;
+	return _socket.writeBytes(_chunk.data(), cipherLen);
+}
+
+bool EncryptedStream::put(const uint8_t* data, size_t length)
+{
+	while (length > 0)
+	{
+		size_t len = length;
+		uint8_t* target = space(len);
+		memcpy(target, data, len);
+		if (!commit(len))
+		{
+			return false;
+		}
+		data += len;
+		length -= len;
+	}
+	return true;
+}
+
+uint8_t* EncryptedStream::space(size_t& length)
+{
+	length = std::min<size_t>(length, CHUNK_SIZE - _filled);
+	return _chunk.data() + _filled;
+}
+
+bool EncryptedStream::commit(size_t length)
+{
+	_filled += length;
+	return _filled < CHUNK_SIZE || flush(false);
+}
+
+bool EncryptedStream::finish()
+{
+	return flush(true);
+}
+
+uint32_t EncryptedStream::sent() const
+{
+	return _sent;
+}
@@ -0,0 +1,159 @@
+#include "FileSnapshot.h"
+#include <filesystem>
+#include <atomic>
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+/* clones of several threads or runs never share a name */
+static atomic<uint64_t> snapshotCounter(0);
+
+FileSnapshot::FileSnapshot() : _cloned(false), _stamp({ 0, 0 })
+{
+}
+
+FileSnapshot::~FileSnapshot()
+{
+	release();
+}
+
+bool FileSnapshot::stamp(const string& path, FileStamp& stamp)
+{
+	std::error_code error;
+	stamp.size = std::filesystem::file_size(path, error);
+	if (error)
+	{
+		return false;
+	}
+	stamp.modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	return !error;
+}
+
+/* share the extents of source with a new target file, nothing is copied. fails on file systems without cloning */
+bool FileSnapshot::reflink(const string& source, const string& target)
+{
+#ifdef _WIN32
+	HANDLE from = CreateFileA(source.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (from == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	HANDLE to = CreateFileA(target.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (to == INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(from);
+		return false;
+	}
+	/* ReFS clones whole clusters, the target is sized to the cluster boundary first and cut to the file size after */
+	bool done = false;
+	LARGE_INTEGER size;
+	DWORD sectorsPerCluster, bytesPerSector, freeClusters, totalClusters;
+	const string root = std::filesystem::absolute(source).root_path().string();
+	if (GetFileSizeEx(from, &size) && GetDiskFreeSpaceA(root.c_str(), &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters))
+	{
+		const LONGLONG cluster = static_cast<LONGLONG>(sectorsPerCluster) * bytesPerSector;
+		FILE_END_OF_FILE_INFO end;
+		end.EndOfFile.QuadPart = (size.QuadPart + cluster - 1) / cluster * cluster;
+		DUPLICATE_EXTENTS_DATA extents = {};
+		extents.FileHandle = from;
+		extents.ByteCount.QuadPart = end.EndOfFile.QuadPart;
+		DWORD bytes = 0;
+		done = size.QuadPart == 0
+			|| (SetFileInformationByHandle(to, FileEndOfFileInfo, &end, sizeof(end))
+				&& DeviceIoControl(to, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents), nullptr, 0, &bytes, nullptr));
+		end.EndOfFile = size;
+		done = done && SetFileInformationByHandle(to, FileEndOfFileInfo, &end, sizeof(end));
+	}
+	CloseHandle(from);
+	CloseHandle(to);
+#else
+	const int from = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+	if (from < 0)
+	{
+		return false;
+	}
+	const int to = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (to < 0)
+	{
+		::close(from);
+		return false;
+	}
+	const bool done = ioctl(to, FICLONE, from) == 0;
+	::close(from);
+	::close(to);
+#endif
+	if (!done)
+	{
+		std::error_code error;
+		std::filesystem::remove(target, error);
+	}
+	return done;
+}
+
+/* stamp the file and clone it when asked to and the file system can. cloning holds off writers of the
+file while the extents are shared, the clone is a point in time copy of it */
+bool FileSnapshot::take(const string& path, bool clone)
+{
+	release();
+	_source = path;
+	_path = path;
+	if (!stamp(path, _stamp))
+	{
+		return false;
+	}
+	if (clone)
+	{
+		const std::filesystem::path source(path);
+		const string target = (source.parent_path() / ("." + source.filename().string() + "." + to_string(snapshotCounter++) + SNAPSHOT_SUFFIX)).string();
+		if (reflink(path, target))
+		{
+			_path = target;
+			_cloned = true;
+		}
+	}
+	return true;
+}
+
+const string& FileSnapshot::path() const
+{
+	return _path;
+}
+
+bool FileSnapshot::cloned() const
+{
+	return _cloned;
+}
+
+/* a clone never changes after it was made, only the stamp at clone time matters. a file read in place must
+still have the stamp it had before it was read - if not, the new stamp is kept for the next read */
+bool FileSnapshot::unchanged()
+{
+	FileStamp now;
+	if (!stamp(_source, now))
+	{
+		return _cloned;
+	}
+	if (_cloned || now == _stamp)
+	{
+		return true;
+	}
+	_stamp = now;
+	return false;
+}
+
+void FileSnapshot::release()
+{
+	if (_cloned)
+	{
+		std::error_code error;
+		std::filesystem::remove(_path, error);
+	}
+	_cloned = false;
+	_path = _source;
+}
@@ -0,0 +1,193 @@
+#include "FingerprintFilter.h"
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+constexpr size_t FINGERPRINT_FILTER_FILE = FINGERPRINT_FILTER_HEADER + FINGERPRINT_FILTER_BYTES;
+
+#ifdef _WIN32
+FingerprintFilter::FingerprintFilter() : _view(nullptr), _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+{
+}
+#else
+FingerprintFilter::FingerprintFilter() : _view(nullptr), _fd(-1)
+{
+}
+#endif
+
+FingerprintFilter::~FingerprintFilter()
+{
+	close();
+}
+
+bool FingerprintFilter::open(const string& path)
+{
+	close();
+#ifdef _WIN32
+	_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	/* the mapping grows a shorter file to the size of the filter, the new bytes read as zeros */
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(FINGERPRINT_FILTER_FILE), nullptr);
+	if (_mapping == nullptr)
+	{
+		close();
+		return false;
+	}
+	_view = static_cast<uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, FINGERPRINT_FILTER_FILE));
+#else
+	_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (_fd < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	if (fstat(_fd, &status) != 0 || (static_cast<uint64_t>(status.st_size) != FINGERPRINT_FILTER_FILE && ftruncate(_fd, FINGERPRINT_FILTER_FILE) != 0))
+	{
+		close();
+		return false;
+	}
+	void* view = mmap(nullptr, FINGERPRINT_FILTER_FILE, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	_view = view == MAP_FAILED ? nullptr : static_cast<uint8_t*>(view);
+#endif
+	if (_view == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	/* a new file, or one written with another shape of the filter, starts empty */
+	uint32_t shape[2] = { FINGERPRINT_FILTER_BITS, FINGERPRINT_FILTER_HASHES };
+	if (memcmp(_view, FINGERPRINT_FILTER_MAGIC, 8) != 0 || memcmp(_view + 8, shape, sizeof(shape)) != 0)
+	{
+		memset(_view, 0, FINGERPRINT_FILTER_FILE);
+		memcpy(_view, FINGERPRINT_FILTER_MAGIC, 8);
+		memcpy(_view + 8, shape, sizeof(shape));
+	}
+	return true;
+}
+
+void FingerprintFilter::close()
+{
+#ifdef _WIN32
+	if (_view != nullptr)
+	{
+		UnmapViewOfFile(_view);
+		_view = nullptr;
+	}
+	if (_mapping != nullptr)
+	{
+		CloseHandle(_mapping);
+		_mapping = nullptr;
+	}
+	if (_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_file);
+		_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (_view != nullptr)
+	{
+		munmap(_view, FINGERPRINT_FILTER_FILE);
+		_view = nullptr;
+	}
+	if (_fd >= 0)
+	{
+		::close(_fd);
+		_fd = -1;
+	}
+#endif
+}
+
+bool FingerprintFilter::isOpen() const
+{
+	return _view != nullptr;
+}
+
+/* double hashing on the first 16 bytes of the SHA-256 - they are uniform already - the server computes the
+same positions, so the pages it sends line up with the local bits */
+void FingerprintFilter::positions(const uint8_t* fingerprint, uint64_t* bits)
+{
+	uint64_t first = 0;
+	uint64_t second = 0;
+	for (int i = 7; i >= 0; i--)
+	{
+		first = (first << 8) | fingerprint[i];
+		second = (second << 8) | fingerprint[8 + i];
+	}
+	second |= 1;
+	for (size_t i = 0; i < FINGERPRINT_FILTER_HASHES; i++)
+	{
+		bits[i] = (first + i * second) % FINGERPRINT_FILTER_BITS;
+	}
+}
+
+bool FingerprintFilter::mayContain(const uint8_t* fingerprint) const
+{
+	if (_view == nullptr)
+	{
+		return true;
+	}
+	uint64_t bits[FINGERPRINT_FILTER_HASHES];
+	positions(fingerprint, bits);
+	const uint8_t* filter = _view + FINGERPRINT_FILTER_HEADER;
+	for (uint64_t bit : bits)
+	{
+		if ((filter[bit >> 3] & (1 << (bit & 7))) == 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FingerprintFilter::add(const uint8_t* fingerprint)
+{
+	if (_view == nullptr)
+	{
+		return;
+	}
+	uint64_t bits[FINGERPRINT_FILTER_HASHES];
+	positions(fingerprint, bits);
+	uint8_t* filter = _view + FINGERPRINT_FILTER_HEADER;
+	for (uint64_t bit : bits)
+	{
+		filter[bit >> 3] |= static_cast<uint8_t>(1 << (bit & 7));
+	}
+}
+
+bool FingerprintFilter::merge(uint64_t offset, const uint8_t* bits, size_t length)
+{
+	if (_view == nullptr || offset > FINGERPRINT_FILTER_BYTES || length > FINGERPRINT_FILTER_BYTES - offset)
+	{
+		return false;
+	}
+	uint8_t* filter = _view + FINGERPRINT_FILTER_HEADER + offset;
+	for (size_t i = 0; i < length; i++)
+	{
+		filter[i] |= bits[i];
+	}
+	return true;
+}
+
+/* the pages are written back by the system anyway, flush makes them durable at the end of a run */
+bool FingerprintFilter::flush()
+{
+	if (_view == nullptr)
+	{
+		return true;
+	}
+#ifdef _WIN32
+	return FlushViewOfFile(_view, FINGERPRINT_FILTER_FILE) != 0;
+#else
+	return msync(_view, FINGERPRINT_FILTER_FILE, MS_SYNC) == 0;
+#endif
+}
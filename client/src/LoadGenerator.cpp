@@ -0,0 +1,433 @@
+#include "LoadGenerator.h"
+#include "SocketHandler.h"
+#include "AESWrapper.h"
+#include "RSAWrapper.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+#include "Utils.h"
+#include "Tracer.h"
+#include "protocol.h"
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* parse fixed:SIZE, uniform:MIN-MAX or lognormal:MEDIAN,SIGMA - sizes as MemoryBudget::parseSize takes them */
+bool FileSizeDistribution::parse(const string& value, FileSizeDistribution& sizes)
+{
+	const size_t colon = value.find(':');
+	if (colon == string::npos)
+	{
+		return false;
+	}
+	const string shape = value.substr(0, colon);
+	const string rest = value.substr(colon + 1);
+	size_t first = 0, second = 0;
+	if (shape == "fixed" && MemoryBudget::parseSize(rest, first))
+	{
+		sizes.shape = SIZE_FIXED;
+	}
+	else if (shape == "uniform")
+	{
+		const size_t dash = rest.find('-');
+		if (dash == string::npos || !MemoryBudget::parseSize(rest.substr(0, dash), first)
+			|| !MemoryBudget::parseSize(rest.substr(dash + 1), second) || second < first)
+		{
+			return false;
+		}
+		sizes.shape = SIZE_UNIFORM;
+	}
+	else if (shape == "lognormal")
+	{
+		const size_t comma = rest.find(',');
+		if (comma == string::npos || !MemoryBudget::parseSize(rest.substr(0, comma), first))
+		{
+			return false;
+		}
+		try
+		{
+			size_t pos = 0;
+			sizes.sigma = std::stod(rest.substr(comma + 1), &pos);
+			if (pos != rest.size() - comma - 1 || sizes.sigma <= 0)
+			{
+				return false;
+			}
+		}
+		catch (...)
+		{
+			return false;
+		}
+		sizes.shape = SIZE_LOGNORMAL;
+	}
+	else
+	{
+		return false;
+	}
+	sizes.first = first;
+	sizes.second = second;
+	return true;
+}
+
+uint64_t FileSizeDistribution::draw(mt19937_64& random) const
+{
+	switch (shape)
+	{
+	case SIZE_UNIFORM:
+		return uniform_int_distribution<uint64_t>(first, second)(random);
+	case SIZE_LOGNORMAL:
+	{
+		/* the server holds a whole file in memory, the tail is cut at a size it can still take */
+		const double size = lognormal_distribution<double>(log(static_cast<double>(first)), sigma)(random);
+		return static_cast<uint64_t>(std::min(size, static_cast<double>(PACK_MAX_BYTES) * 64));
+	}
+	default:
+		return first;
+	}
+}
+
+LoadGenerator::LoadGenerator(const LoadOptions& options, const string& address, const string& port)
+	: _options(options), _address(address), _port(port), _closed(false), _nextName(0)
+{
+	if (_options.concurrency == 0)
+	{
+		_options.concurrency = 1;
+	}
+	/* names stay unique across runs against the same server database */
+	_namePrefix = "load" + to_string(chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count()) + "-";
+}
+
+LoadGenerator::~LoadGenerator()
+{
+	for (RSAPrivateWrapper* key : _keys)
+	{
+		delete key;
+	}
+	for (mutex* lock : _keyLocks)
+	{
+		delete lock;
+	}
+	for (Worker* worker : _workers)
+	{
+		delete worker;
+	}
+}
+
+void LoadGenerator::packHeader(uint8_t* buffer, const string& uid, uint16_t code, uint32_t payloadSize) const
+{
+	ClientRequestHeader header(code, payloadSize);
+	uid.copy(reinterpret_cast<char*>(header.uid), sizeof(header.uid));
+	memcpy(buffer, &header, REQUEST_HEADER_SIZE);
+}
+
+/* send one request that fits a packet and read its response, the latency is kept under the request code */
+bool LoadGenerator::exchange(Worker& worker, SocketHandler& socket, uint16_t code, ConstByteSpan request, uint16_t expected, uint8_t* response)
+{
+	CodeStats& stats = worker.stats[code];
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	uint16_t answered = 0;
+	const bool done = socket.writeBytes(request.data(), request.size()) && socket.read(response);
+	if (done)
+	{
+		memcpy(&answered, response + VERSION_SIZE, CODE_SIZE);
+	}
+	if (!done || answered != expected)
+	{
+		stats.errors++;
+		return false;
+	}
+	stats.latencies.push_back(static_cast<uint32_t>(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count()));
+	return true;
+}
+
+/* the AES key follows the uid in the response. keys of the pool are shared by the workers,
+the random pool of a key is not thread safe */
+bool LoadGenerator::decryptKey(size_t key, const uint8_t* response, string& aesKey)
+{
+	uint32_t payloadSize;
+	memcpy(&payloadSize, response + VERSION_SIZE + CODE_SIZE, PAYLOAD_SIZE);
+	if (payloadSize <= UID_SIZE || payloadSize > PACKET_SIZE - HEADER_SIZE)
+	{
+		return false;
+	}
+	try
+	{
+		lock_guard<mutex> guard(*_keyLocks[key]);
+		aesKey = _keys[key]->decrypt(reinterpret_cast<const char*>(response + HEADER_SIZE + UID_SIZE), payloadSize - UID_SIZE);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+	return aesKey.size() == AESWrapper::DEFAULT_KEYLENGTH;
+}
+
+/* reconnect as the identity when it has a uid, otherwise register it and send its public key */
+bool LoadGenerator::login(Worker& worker, SocketHandler& socket, Identity& identity, string& aesKey)
+{
+	uint8_t request[REQUEST_HEADER_SIZE + NAME_SIZE + PUBLIC_KEY_SIZE] = { 0 };
+	uint8_t response[PACKET_SIZE];
+	identity.name.copy(reinterpret_cast<char*>(request + REQUEST_HEADER_SIZE), MAX_NAME_SIZE);
+	if (!identity.uid.empty())
+	{
+		packHeader(request, identity.uid, LOGIN_REQUEST, NAME_SIZE);
+		return exchange(worker, socket, LOGIN_REQUEST, ConstByteSpan(request, REQUEST_HEADER_SIZE + NAME_SIZE),
+			ServerResponse::SResponseCode::LOGIN_SUCCESS_SEND_AES, response)
+			&& decryptKey(identity.key, response, aesKey);
+	}
+
+	packHeader(request, string(), REGISTRATION_REQUEST, NAME_SIZE);
+	if (!exchange(worker, socket, REGISTRATION_REQUEST, ConstByteSpan(request, REQUEST_HEADER_SIZE + NAME_SIZE),
+		ServerResponse::SResponseCode::REGISTRATION_REQUEST_SUCCESS, response))
+	{
+		return false;
+	}
+	identity.uid.assign(reinterpret_cast<const char*>(response + HEADER_SIZE), UID_SIZE);
+	packHeader(request, identity.uid, PUBLIC_KEY_REQUEST, NAME_SIZE + PUBLIC_KEY_SIZE);
+	_publicKeys[identity.key].copy(reinterpret_cast<char*>(request + REQUEST_HEADER_SIZE + NAME_SIZE), PUBLIC_KEY_SIZE);
+	return exchange(worker, socket, PUBLIC_KEY_REQUEST, ConstByteSpan(request, sizeof(request)),
+		ServerResponse::SResponseCode::GOT_PC_SEND_AES, response)
+		&& decryptKey(identity.key, response, aesKey);
+}
+
+/* send one file of a drawn size made of the shared content and confirm or reject its CKsum */
+bool LoadGenerator::sendFile(Worker& worker, SocketHandler& socket, const Identity& identity, const string& aesKey)
+{
+	const uint64_t size = _options.sizes.draw(worker.random);
+	if (CONTENT_SIZE + FILE_NAME_SIZE + size + AES_BLOCK_SIZE > numeric_limits<uint32_t>::max())
+	{
+		return false;
+	}
+	const uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(size));
+	uint8_t header[FILE_SEND_HEADER_SIZE] = { 0 };
+	packHeader(header, identity.uid, FILE_SEND_REQUEST, CONTENT_SIZE + FILE_NAME_SIZE + contentSize);
+	memcpy(header + REQUEST_HEADER_SIZE, &contentSize, CONTENT_SIZE);
+	memcpy(header + REQUEST_HEADER_SIZE + CONTENT_SIZE, "load.bin", strlen("load.bin"));
+
+	CodeStats& stats = worker.stats[FILE_SEND_REQUEST];
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(aesKey.c_str()), AESWrapper::DEFAULT_KEYLENGTH);
+	uint32_t crc = 0;
+	bool sent = socket.writeBytes(header, FILE_SEND_HEADER_SIZE);
+	for (uint64_t offset = 0; sent && (offset < size || offset == 0); )
+	{
+		const size_t length = static_cast<size_t>(std::min<uint64_t>(size - offset, CHUNK_SIZE));
+		memcpy(worker.chunk.data(), _content.data(), length);
+		crc = Utils::crc32Update(crc, ConstByteSpan(worker.chunk.data(), length));
+		offset += length;
+		const size_t cipherLength = aes.encryptChunk(ConstByteSpan(worker.chunk.data(), length), ByteSpan(worker.chunk.data(), worker.chunk.size()), offset == size);
+		sent = socket.writeBytes(worker.chunk.data(), cipherLength);
+		if (offset == size)
+		{
+			break;
+		}
+	}
+	uint8_t response[PACKET_SIZE];
+	uint16_t answered = 0;
+	if (sent && socket.read(response))
+	{
+		memcpy(&answered, response + VERSION_SIZE, CODE_SIZE);
+	}
+	if (answered != ServerResponse::SResponseCode::GOT_FILE_SEND_CRC)
+	{
+		stats.errors++;
+		return false;
+	}
+	stats.latencies.push_back(static_cast<uint32_t>(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count()));
+	worker.bytes += size;
+
+	/* a CKsum the server got wrong is reported as an error of the file send, the server drops the file */
+	uint32_t serverCRC;
+	memcpy(&serverCRC, response + HEADER_SIZE + UID_SIZE + CONTENT_SIZE + FILE_NAME_SIZE, CRC_SIZE);
+	const uint16_t code = serverCRC == crc ? CRC_VALID_REQUEST : FOUR_FAILED_CRC_REQUEST;
+	if (serverCRC != crc)
+	{
+		stats.errors++;
+	}
+	uint8_t request[REQUEST_HEADER_SIZE + FILE_NAME_SIZE] = { 0 };
+	packHeader(request, identity.uid, code, FILE_NAME_SIZE);
+	memcpy(request + REQUEST_HEADER_SIZE, "load.bin", strlen("load.bin"));
+	return exchange(worker, socket, code, ConstByteSpan(request), ServerResponse::SResponseCode::GOT_REQ_TNX, response) && serverCRC == crc;
+}
+
+/* one virtual client: connect, log in as a new or a known client and back up one file */
+bool LoadGenerator::session(Worker& worker)
+{
+	Identity identity;
+	bool known = false;
+	{
+		lock_guard<mutex> guard(_lock);
+		if (!_registered.empty() && bernoulli_distribution(_options.reconnectRatio)(worker.random))
+		{
+			identity = _registered[uniform_int_distribution<size_t>(0, _registered.size() - 1)(worker.random)];
+			known = true;
+		}
+		else
+		{
+			identity.name = _namePrefix + to_string(_nextName++);
+			identity.key = static_cast<size_t>(_nextName % _keys.size());
+		}
+	}
+
+	SocketHandler socket;
+	CodeStats& connect = worker.stats[LOAD_CONNECT_CODE];
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (!socket.initializeSocketInfo(_address, _port) || !socket.connectToServer())
+	{
+		connect.errors++;
+		return false;
+	}
+	connect.latencies.push_back(static_cast<uint32_t>(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count()));
+
+	string aesKey;
+	if (!login(worker, socket, identity, aesKey))
+	{
+		return false;
+	}
+	if (!known)
+	{
+		lock_guard<mutex> guard(_lock);
+		_registered.push_back(identity);
+	}
+	return sendFile(worker, socket, identity, aesKey);
+}
+
+void LoadGenerator::work(Worker& worker)
+{
+	Tracer::instance().nameThread("load");
+	while (true)
+	{
+		chrono::steady_clock::time_point arrival;
+		{
+			unique_lock<mutex> guard(_lock);
+			_arrived.wait(guard, [this]() { return _closed || !_arrivals.empty(); });
+			if (_arrivals.empty())
+			{
+				return;
+			}
+			arrival = _arrivals.front();
+			_arrivals.pop_front();
+		}
+		/* closed loop sessions have no arrival time of their own, they start when they are taken */
+		if (_options.arrivalRate <= 0)
+		{
+			arrival = chrono::steady_clock::now();
+		}
+		if (!session(worker))
+		{
+			worker.failed++;
+			continue;
+		}
+		worker.sessions.push_back(static_cast<uint32_t>(chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - arrival).count()));
+	}
+}
+
+/* generate the keys and the content, then feed arrivals to the workers until every session was started */
+bool LoadGenerator::run()
+{
+	if (_options.clients == 0)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < std::min<size_t>(LOAD_KEY_POOL_SIZE, _options.concurrency); i++)
+	{
+		_keys.push_back(new RSAPrivateWrapper());
+		_publicKeys.push_back(_keys.back()->getPublicKey());
+		_keyLocks.push_back(new mutex());
+	}
+	mt19937_64 random(_options.seed);
+	_content.resize(CHUNK_SIZE);
+	for (uint8_t& byte : _content)
+	{
+		byte = static_cast<uint8_t>(random());
+	}
+
+	vector<thread> threads;
+	for (unsigned int i = 0; i < _options.concurrency; i++)
+	{
+		Worker* worker = new Worker();
+		worker->random.seed(_options.seed + i + 1);
+		worker->chunk.resize(CHUNK_SIZE + AES_BLOCK_SIZE);
+		_workers.push_back(worker);
+	}
+	_start = chrono::steady_clock::now();
+	for (Worker* worker : _workers)
+	{
+		threads.emplace_back(&LoadGenerator::work, this, std::ref(*worker));
+	}
+
+	/* Poisson arrivals: exponential gaps at the given rate, kept on an absolute schedule so they do not drift */
+	exponential_distribution<double> gap(_options.arrivalRate > 0 ? _options.arrivalRate : 1);
+	chrono::steady_clock::time_point next = _start;
+	for (unsigned int i = 0; i < _options.clients; i++)
+	{
+		if (_options.arrivalRate > 0)
+		{
+			next += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(gap(random)));
+			this_thread::sleep_until(next);
+		}
+		{
+			lock_guard<mutex> guard(_lock);
+			_arrivals.push_back(next);
+		}
+		_arrived.notify_one();
+	}
+	{
+		lock_guard<mutex> guard(_lock);
+		_closed = true;
+	}
+	_arrived.notify_all();
+	for (thread& worker : threads)
+	{
+		worker.join();
+	}
+	_end = chrono::steady_clock::now();
+	return true;
+}
+
+void LoadGenerator::percentiles(vector<uint32_t>& values, uint32_t& p50, uint32_t& p90, uint32_t& p99, uint32_t& max)
+{
+	p50 = p90 = p99 = max = 0;
+	if (values.empty())
+	{
+		return;
+	}
+	sort(values.begin(), values.end());
+	auto at = [&values](double quantile) { return values[static_cast<size_t>(quantile * (values.size() - 1))]; };
+	p50 = at(0.5);
+	p90 = at(0.9);
+	p99 = at(0.99);
+	max = values.back();
+}
+
+/* one load.request record per request code (0 is the connection setup) and one load.report for the run */
+void LoadGenerator::report()
+{
+	map<uint16_t, CodeStats> stats;
+	vector<uint32_t> sessions;
+	uint64_t failed = 0, bytes = 0;
+	for (Worker* worker : _workers)
+	{
+		for (auto& code : worker->stats)
+		{
+			CodeStats& total = stats[code.first];
+			total.latencies.insert(total.latencies.end(), code.second.latencies.begin(), code.second.latencies.end());
+			total.errors += code.second.errors;
+		}
+		sessions.insert(sessions.end(), worker->sessions.begin(), worker->sessions.end());
+		failed += worker->failed;
+		bytes += worker->bytes;
+	}
+	const double seconds = std::max(chrono::duration<double>(_end - _start).count(), 1e-9);
+	uint32_t p50, p90, p99, max;
+	for (auto& code : stats)
+	{
+		const size_t count = code.second.latencies.size();
+		percentiles(code.second.latencies, p50, p90, p99, max);
+		LOG_INFO("load.request", "code=%u count=%zu errors=%llu per_second=%.1f p50_us=%u p90_us=%u p99_us=%u max_us=%u", code.first,
+			count, static_cast<unsigned long long>(code.second.errors), count / seconds, p50, p90, p99, max);
+	}
+	const size_t completed = sessions.size();
+	percentiles(sessions, p50, p90, p99, max);
+	LOG_INFO("load.report", "sessions=%zu failed=%llu seconds=%.2f sessions_per_second=%.1f bytes_per_second=%.0f p50_ms=%u p90_ms=%u p99_ms=%u max_ms=%u",
+		completed, static_cast<unsigned long long>(failed), seconds, completed / seconds, bytes / seconds, p50, p90, p99, max);
+}
@@ -0,0 +1,155 @@
+#include "Logger.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <algorithm>
+
+constexpr auto LOG_FLUSH_INTERVAL = std::chrono::milliseconds(10);
+
+static const char* levelName(LogLevel level)
+{
+	switch (level)
+	{
+	case LOG_LEVEL_DEBUG: return "debug";
+	case LOG_LEVEL_INFO: return "info";
+	case LOG_LEVEL_WARN: return "warn";
+	default: return "error";
+	}
+}
+
+Logger& Logger::instance()
+{
+	static Logger logger;
+	return logger;
+}
+
+Logger::Logger() : _slots(new Slot[LOG_RING_SIZE]), _enqueue(0), _dequeue(0), _written(0), _dropped(0), _stop(false)
+{
+	for (size_t i = 0; i < LOG_RING_SIZE; i++)
+	{
+		_slots[i].sequence.store(i, memory_order_relaxed);
+		_slots[i].length = 0;
+	}
+	_flusher = thread(&Logger::run, this);
+}
+
+Logger::~Logger()
+{
+	_stop = true;
+	_wake.notify_one();
+	if (_flusher.joinable())
+	{
+		_flusher.join();
+	}
+	delete[] _slots;
+}
+
+/* claim a slot, format the record into it and publish it - no locks, no allocation and no I/O */
+void Logger::log(LogLevel level, const char* event, const char* format, ...)
+{
+	size_t position = _enqueue.load(memory_order_relaxed);
+	Slot* slot = nullptr;
+	while (true)
+	{
+		slot = &_slots[position & (LOG_RING_SIZE - 1)];
+		const size_t sequence = slot->sequence.load(memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+		if (difference == 0)
+		{
+			if (_enqueue.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			_dropped++;
+			return;
+		}
+		else
+		{
+			position = _enqueue.load(memory_order_relaxed);
+		}
+	}
+
+	const long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	int length = snprintf(slot->text, LOG_RECORD_SIZE, "ts=%lld level=%s event=%s ", milliseconds, levelName(level), event);
+	if (length > 0 && static_cast<size_t>(length) < LOG_RECORD_SIZE)
+	{
+		va_list arguments;
+		va_start(arguments, format);
+		const int fields = vsnprintf(slot->text + length, LOG_RECORD_SIZE - length, format, arguments);
+		va_end(arguments);
+		length = fields < 0 ? length : length + fields;
+	}
+	slot->length = std::min<size_t>(length < 0 ? 0 : static_cast<size_t>(length), LOG_RECORD_SIZE - 1);
+	slot->sequence.store(position + 1, memory_order_release);
+	/* a burst fills the ring faster than the flush interval, wake the flusher every half ring */
+	if ((position & (LOG_RING_SIZE / 2 - 1)) == LOG_RING_SIZE / 2 - 1)
+	{
+		_wake.notify_one();
+	}
+}
+
+/* write the next published record, false when there is none yet */
+bool Logger::writeNext()
+{
+	Slot& slot = _slots[_dequeue & (LOG_RING_SIZE - 1)];
+	if (slot.sequence.load(memory_order_acquire) != _dequeue + 1)
+	{
+		return false;
+	}
+	fwrite(slot.text, 1, slot.length, stdout);
+	fputc('\n', stdout);
+	slot.sequence.store(_dequeue + LOG_RING_SIZE, memory_order_release);
+	_dequeue++;
+	return true;
+}
+
+/* background flusher, writes what was logged and flushes stdout once the ring is drained */
+void Logger::run()
+{
+	uint64_t reported = 0;
+	while (true)
+	{
+		bool wrote = false;
+		while (writeNext())
+		{
+			wrote = true;
+		}
+		const uint64_t dropped = _dropped.load();
+		if (dropped != reported)
+		{
+			fprintf(stdout, "level=warn event=log.dropped records=%llu\n", static_cast<unsigned long long>(dropped - reported));
+			reported = dropped;
+			wrote = true;
+		}
+		if (wrote)
+		{
+			fflush(stdout);
+		}
+		_written.store(_dequeue, memory_order_release);
+		if (_stop && _dequeue == _enqueue.load())
+		{
+			break;
+		}
+		unique_lock<mutex> guard(_lock);
+		_wake.wait_for(guard, LOG_FLUSH_INTERVAL);
+	}
+}
+
+void Logger::flush()
+{
+	const size_t target = _enqueue.load();
+	while (_written.load(memory_order_acquire) < target)
+	{
+		_wake.notify_one();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+uint64_t Logger::dropped() const
+{
+	return _dropped;
+}
@@ -0,0 +1,113 @@
+#include "MemoryBudget.h"
+
+MemoryBudget::MemoryBudget(size_t limit) : _limit(limit), _inUse(0)
+{
+}
+
+MemoryBudget::~MemoryBudget()
+{
+}
+
+/* parse a size such as 262144, 512K, 256M or 2G */
+bool MemoryBudget::parseSize(const string& text, size_t& bytes)
+{
+	if (text.empty())
+	{
+		return false;
+	}
+	size_t multiplier = 1;
+	string digits = text;
+	switch (digits.back())
+	{
+	case 'k': case 'K': multiplier = 1024; break;
+	case 'm': case 'M': multiplier = 1024 * 1024; break;
+	case 'g': case 'G': multiplier = 1024 * 1024 * 1024; break;
+	default: break;
+	}
+	if (multiplier != 1)
+	{
+		digits.pop_back();
+	}
+	try
+	{
+		size_t pos = 0;
+		const unsigned long long value = std::stoull(digits, &pos);
+		if (pos != digits.size() || value == 0)
+		{
+			return false;
+		}
+		bytes = static_cast<size_t>(value) * multiplier;
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+/* take bytes from the budget, wait for other stages to release memory when it is exhausted */
+bool MemoryBudget::acquire(size_t bytes)
+{
+	if (bytes > _limit)
+	{
+		return false;
+	}
+	unique_lock<mutex> guard(_lock);
+	_released.wait(guard, [this, bytes]() { return _inUse + bytes <= _limit; });
+	_inUse += bytes;
+	return true;
+}
+
+bool MemoryBudget::tryAcquire(size_t bytes)
+{
+	lock_guard<mutex> guard(_lock);
+	if (_inUse + bytes > _limit)
+	{
+		return false;
+	}
+	_inUse += bytes;
+	return true;
+}
+
+void MemoryBudget::release(size_t bytes)
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_inUse -= bytes;
+	}
+	_released.notify_all();
+}
+
+size_t MemoryBudget::limit() const
+{
+	return _limit;
+}
+
+size_t MemoryBudget::inUse()
+{
+	lock_guard<mutex> guard(_lock);
+	return _inUse;
+}
+
+MemoryBudget::Lease::Lease(MemoryBudget& budget, size_t bytes) : _budget(budget), _bytes(bytes), _granted(false)
+{
+	_granted = _budget.acquire(_bytes);
+}
+
+MemoryBudget::Lease::~Lease()
+{
+	if (_granted)
+	{
+		_budget.release(_bytes);
+	}
+}
+
+bool MemoryBudget::Lease::granted() const
+{
+	return _granted;
+}
+
+size_t MemoryBudget::Lease::size() const
+{
+	return _bytes;
+}
@@ -0,0 +1,191 @@
+#include "PipelineExecutor.h"
+#include "Tracer.h"
+#include <thread>
+#include <chrono>
+
+constexpr int PIPELINE_SPINS = 64;   // yields before a waiting stage starts to sleep
+constexpr auto PIPELINE_BACKOFF = std::chrono::microseconds(50);
+
+/* a stage waiting on a full or empty ring yields first and then backs off, a slow network
+must not keep the other stages spinning on the CPU the transform stage needs */
+static void backoff(int& spins)
+{
+	if (++spins < PIPELINE_SPINS)
+	{
+		std::this_thread::yield();
+	}
+	else
+	{
+		std::this_thread::sleep_for(PIPELINE_BACKOFF);
+	}
+}
+
+/* run one stage on the block and add the time it took to busy */
+static bool timed(const PipelineExecutor::Stage& stage, PipelineBlock& block, uint64_t& busy)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const bool done = stage(block);
+	busy += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	return done;
+}
+
+PipelineExecutor::PipelineExecutor(BufferPool& pool) : _pool(pool), _failed(false), _readDone(false), _transformDone(false)
+{
+}
+
+PipelineExecutor::~PipelineExecutor()
+{
+}
+
+const PipelineTimes& PipelineExecutor::times() const
+{
+	return _times;
+}
+
+bool PipelineExecutor::push(Ring& ring, PipelineBlock& block)
+{
+	int spins = 0;
+	while (!ring.tryPush(block))
+	{
+		if (_failed)
+		{
+			return false;
+		}
+		backoff(spins);
+	}
+	return true;
+}
+
+/* false once the producer finished and the ring is empty, or when another stage failed */
+bool PipelineExecutor::pop(Ring& ring, PipelineBlock& block, const atomic<bool>& producerDone)
+{
+	int spins = 0;
+	while (!ring.tryPop(block))
+	{
+		if (_failed)
+		{
+			return false;
+		}
+		if (producerDone)
+		{
+			/* the producer may have pushed its last block right before it finished */
+			return ring.tryPop(block);
+		}
+		backoff(spins);
+	}
+	return true;
+}
+
+void PipelineExecutor::readStage(const Stage& read)
+{
+	Tracer::instance().nameThread("pipeline.read");
+	bool last = false;
+	while (!last && !_failed)
+	{
+		PipelineBlock block;
+		block.lease = _pool.lease();
+		if (!block.lease.valid() || !timed(read, block, _times.read))
+		{
+			_failed = true;
+			break;
+		}
+		last = block.last;
+		if (!push(_toTransform, block))
+		{
+			break;
+		}
+	}
+	_readDone = true;
+}
+
+void PipelineExecutor::transformStage(const Stage& transform)
+{
+	Tracer::instance().nameThread("pipeline.transform");
+	PipelineBlock block;
+	while (pop(_toTransform, block, _readDone))
+	{
+		const bool last = block.last;
+		if (!timed(transform, block, _times.transform))
+		{
+			_failed = true;
+			break;
+		}
+		if (!push(_toWrite, block) || last)
+		{
+			break;
+		}
+	}
+	_transformDone = true;
+}
+
+/* the same stages one block at a time on the calling thread, for streams too short to be worth the threads */
+bool PipelineExecutor::runInline(const Stage& read, const Stage& transform, const Stage& write)
+{
+	PipelineBlock block;
+	block.lease = _pool.lease();
+	if (!block.lease.valid())
+	{
+		return false;
+	}
+	do
+	{
+		if (!timed(read, block, _times.read) || !timed(transform, block, _times.transform) || !timed(write, block, _times.write))
+		{
+			return false;
+		}
+	} while (!block.last);
+	return true;
+}
+
+/* the write stage runs on the calling thread, true when every block went through all the stages */
+bool PipelineExecutor::run(const Stage& read, const Stage& transform, const Stage& write, bool threaded)
+{
+	_times = PipelineTimes();
+	if (!threaded)
+	{
+		return runInline(read, transform, write);
+	}
+	_failed = false;
+	_readDone = false;
+	_transformDone = false;
+	std::thread reader(&PipelineExecutor::readStage, this, std::cref(read));
+	std::thread transformer(&PipelineExecutor::transformStage, this, std::cref(transform));
+
+	bool done = false;
+	PipelineBlock block;
+	while (!done && pop(_toWrite, block, _transformDone))
+	{
+		done = block.last;
+		if (!timed(write, block, _times.write))
+		{
+			_failed = true;
+			break;
+		}
+		block.lease.reset();
+	}
+	if (!done)
+	{
+		_failed = true;
+	}
+
+	/* return the blocks still in the rings, the reader may be waiting in the pool for one of them.
+	the calling thread consumes the first ring only once the transform stage stopped consuming it */
+	while (!_readDone || !_transformDone)
+	{
+		PipelineBlock dropped;
+		if (!_toWrite.tryPop(dropped) && _transformDone)
+		{
+			_toTransform.tryPop(dropped);
+		}
+		dropped.lease.reset();
+		std::this_thread::yield();
+	}
+	reader.join();
+	transformer.join();
+	PipelineBlock dropped;
+	while (_toTransform.tryPop(dropped) || _toWrite.tryPop(dropped))
+	{
+		dropped.lease.reset();
+	}
+	return !_failed;
+}
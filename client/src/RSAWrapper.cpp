@@ -1,71 +1,71 @@
-#include "RSAWrapper.h"
-
-RSAPrivateWrapper::RSAPrivateWrapper()
-{
-	_privateKey.Initialize(_rng, BITS);
-}
-
-RSAPrivateWrapper::RSAPrivateWrapper(const char* key, unsigned int length)
-{
-	CryptoPP::StringSource ss(reinterpret_cast<const CryptoPP::byte*>(key), length, true);
-	_privateKey.Load(ss);
-}
-
-RSAPrivateWrapper::RSAPrivateWrapper(const std::string& key)
-{
-	CryptoPP::StringSource ss(key, true);
-	_privateKey.Load(ss);
-}
-
-RSAPrivateWrapper::~RSAPrivateWrapper()
-{
-}
-
-std::string RSAPrivateWrapper::getPrivateKey() const
-{
-	std::string key;
-	CryptoPP::StringSink ss(key);
-	_privateKey.Save(ss);
-	return key;
-}
-
-char* RSAPrivateWrapper::getPrivateKey(char* keyout, unsigned int length) const
-{
-	CryptoPP::ArraySink as(reinterpret_cast<CryptoPP::byte*>(keyout), length);
-	_privateKey.Save(as);
-	return keyout;
-}
-
-std::string RSAPrivateWrapper::getPublicKey() const
-{
-	CryptoPP::RSAFunction publicKey(_privateKey);
-	std::string key;
-	CryptoPP::StringSink ss(key);
-	publicKey.Save(ss);
-	return key;
-}
-
-char* RSAPrivateWrapper::getPublicKey(char* keyout, unsigned int length) const
-{
-	CryptoPP::RSAFunction publicKey(_privateKey);
-	CryptoPP::ArraySink as(reinterpret_cast<CryptoPP::byte*>(keyout), length);
-	publicKey.Save(as);
-	return keyout;
-}
-
-std::string RSAPrivateWrapper::decrypt(const std::string& cipher)
-{
-	std::string decrypted;
-	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
-	CryptoPP::StringSource ss_cipher(cipher, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
-	return decrypted;
-}
-
-std::string RSAPrivateWrapper::decrypt(const char* cipher, unsigned int length)
-{
-	std::string decrypted;
-	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
-	CryptoPP::StringSource ss_cipher(reinterpret_cast<const CryptoPP::byte*>(cipher), length, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
-	return decrypted;
-}
-
+#include "RSAWrapper.h"
+
+RSAPrivateWrapper::RSAPrivateWrapper()
+{
+	_privateKey.Initialize(_rng, BITS);
+}
+
+RSAPrivateWrapper::RSAPrivateWrapper(const char* key, unsigned int length)
+{
+	CryptoPP::StringSource ss(reinterpret_cast<const CryptoPP::byte*>(key), length, true);
+	_privateKey.Load(ss);
+}
+
+RSAPrivateWrapper::RSAPrivateWrapper(const std::string& key)
+{
+	CryptoPP::StringSource ss(key, true);
+	_privateKey.Load(ss);
+}
+
+RSAPrivateWrapper::~RSAPrivateWrapper()
+{
+}
+
+std::string RSAPrivateWrapper::getPrivateKey() const
+{
+	std::string key;
+	CryptoPP::StringSink ss(key);
+	_privateKey.Save(ss);
+	return key;
+}
+
+char* RSAPrivateWrapper::getPrivateKey(char* keyout, unsigned int length) const
+{
+	CryptoPP::ArraySink as(reinterpret_cast<CryptoPP::byte*>(keyout), length);
+	_privateKey.Save(as);
+	return keyout;
+}
+
+std::string RSAPrivateWrapper::getPublicKey() const
+{
+	CryptoPP::RSAFunction publicKey(_privateKey);
+	std::string key;
+	CryptoPP::StringSink ss(key);
+	publicKey.Save(ss);
+	return key;
+}
+
+char* RSAPrivateWrapper::getPublicKey(char* keyout, unsigned int length) const
+{
+	CryptoPP::RSAFunction publicKey(_privateKey);
+	CryptoPP::ArraySink as(reinterpret_cast<CryptoPP::byte*>(keyout), length);
+	publicKey.Save(as);
+	return keyout;
+}
+
+std::string RSAPrivateWrapper::decrypt(const std::string& cipher)
+{
+	std::string decrypted;
+	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
+	CryptoPP::StringSource ss_cipher(cipher, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
+	return decrypted;
+}
+
+std::string RSAPrivateWrapper::decrypt(const char* cipher, unsigned int length)
+{
+	std::string decrypted;
+	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
+	CryptoPP::StringSource ss_cipher(reinterpret_cast<const CryptoPP::byte*>(cipher), length, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
+	return decrypted;
+}
+
@@ -0,0 +1,251 @@
+#include "RandomAccessFile.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+RandomAccessFile::RandomAccessFile() : _handle(INVALID_HANDLE_VALUE)
+{
+}
+#else
+RandomAccessFile::RandomAccessFile() : _fd(-1)
+{
+}
+#endif
+
+RandomAccessFile::~RandomAccessFile()
+{
+	close();
+}
+
+bool RandomAccessFile::open(const string& path, bool write, bool truncate)
+{
+	close();
+#ifdef _WIN32
+	const DWORD access = write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+	const DWORD disposition = !write ? OPEN_EXISTING : (truncate ? CREATE_ALWAYS : OPEN_ALWAYS);
+	_handle = CreateFileA(path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, disposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+	int flags = write ? (O_RDWR | O_CREAT) : O_RDONLY;
+	if (write && truncate)
+	{
+		flags |= O_TRUNC;
+	}
+	_fd = ::open(path.c_str(), flags, 0644);
+#endif
+	return isOpen();
+}
+
+void RandomAccessFile::close()
+{
+#ifdef _WIN32
+	if (_handle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_handle);
+		_handle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (_fd >= 0)
+	{
+		::close(_fd);
+		_fd = -1;
+	}
+#endif
+}
+
+bool RandomAccessFile::isOpen() const
+{
+#ifdef _WIN32
+	return _handle != INVALID_HANDLE_VALUE;
+#else
+	return _fd >= 0;
+#endif
+}
+
+/* read up to length bytes at offset, read is less than length only at end of file */
+bool RandomAccessFile::readAt(uint64_t offset, uint8_t* buffer, size_t length, size_t& read)
+{
+	read = 0;
+	while (read < length)
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped = {};
+		const uint64_t position = offset + read;
+		overlapped.Offset = static_cast<DWORD>(position);
+		overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+		DWORD done = 0;
+		if (!ReadFile(_handle, buffer + read, static_cast<DWORD>(length - read), &done, &overlapped))
+		{
+			return GetLastError() == ERROR_HANDLE_EOF;
+		}
+#else
+		const ssize_t done = pread(_fd, buffer + read, length - read, static_cast<off_t>(offset + read));
+		if (done < 0)
+		{
+			return false;
+		}
+#endif
+		if (done == 0)
+		{
+			break;
+		}
+		read += done;
+	}
+	return true;
+}
+
+bool RandomAccessFile::writeAt(uint64_t offset, const uint8_t* data, size_t length)
+{
+	size_t written = 0;
+	while (written < length)
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped = {};
+		const uint64_t position = offset + written;
+		overlapped.Offset = static_cast<DWORD>(position);
+		overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+		DWORD done = 0;
+		if (!WriteFile(_handle, data + written, static_cast<DWORD>(length - written), &done, &overlapped))
+		{
+			return false;
+		}
+#else
+		const ssize_t done = pwrite(_fd, data + written, length - written, static_cast<off_t>(offset + written));
+		if (done <= 0)
+		{
+			return false;
+		}
+#endif
+		written += done;
+	}
+	return true;
+}
+
+/* set the file size, growing leaves a hole that reads as zeros */
+bool RandomAccessFile::resize(uint64_t size)
+{
+#ifdef _WIN32
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+	return SetFileInformationByHandle(_handle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+#else
+	return ftruncate(_fd, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+uint64_t RandomAccessFile::size()
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_handle, &size))
+	{
+		return 0;
+	}
+	return static_cast<uint64_t>(size.QuadPart);
+#else
+	struct stat info;
+	if (fstat(_fd, &info) != 0)
+	{
+		return 0;
+	}
+	return static_cast<uint64_t>(info.st_size);
+#endif
+}
+
+/* the data extents of the file in file order - a file without holes, or on a file system that does not
+report them, is one extent. FSCTL_QUERY_ALLOCATED_RANGES on Windows, SEEK_DATA and SEEK_HOLE elsewhere */
+bool RandomAccessFile::dataExtents(vector<FileExtent>& extents, size_t maxExtents)
+{
+	extents.clear();
+	const uint64_t fileSize = size();
+#ifdef _WIN32
+	FILE_ALLOCATED_RANGE_BUFFER query;
+	FILE_ALLOCATED_RANGE_BUFFER ranges[64];
+	query.FileOffset.QuadPart = 0;
+	query.Length.QuadPart = static_cast<LONGLONG>(fileSize);
+	while (query.Length.QuadPart > 0)
+	{
+		DWORD bytes = 0;
+		const BOOL done = DeviceIoControl(_handle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), ranges, sizeof(ranges), &bytes, nullptr);
+		if (!done && GetLastError() != ERROR_MORE_DATA)
+		{
+			if (GetLastError() != ERROR_INVALID_FUNCTION)
+			{
+				return false;
+			}
+			/* the file system has no sparse files */
+			extents.clear();
+			extents.push_back({ 0, fileSize });
+			return true;
+		}
+		const DWORD count = bytes / sizeof(ranges[0]);
+		for (DWORD i = 0; i < count; i++)
+		{
+			/* ranges are whole clusters, the last one may end after the end of the file */
+			const uint64_t offset = static_cast<uint64_t>(ranges[i].FileOffset.QuadPart);
+			const uint64_t end = std::min<uint64_t>(offset + static_cast<uint64_t>(ranges[i].Length.QuadPart), fileSize);
+			if (offset >= end)
+			{
+				continue;
+			}
+			if (extents.size() == maxExtents)
+			{
+				return false;
+			}
+			extents.push_back({ offset, end - offset });
+		}
+		if (done || count == 0)
+		{
+			break;
+		}
+		/* more ranges than fit in the buffer, continue after the last one */
+		const LONGLONG next = ranges[count - 1].FileOffset.QuadPart + ranges[count - 1].Length.QuadPart;
+		query.Length.QuadPart = static_cast<LONGLONG>(fileSize) - next;
+		query.FileOffset.QuadPart = next;
+	}
+#elif defined(SEEK_DATA) && defined(SEEK_HOLE)
+	off_t data = 0;
+	while (static_cast<uint64_t>(data) < fileSize)
+	{
+		data = lseek(_fd, data, SEEK_DATA);
+		if (data < 0)
+		{
+			if (errno == ENXIO)
+			{
+				/* only a hole is left up to the end of the file */
+				break;
+			}
+			if (errno != EINVAL)
+			{
+				return false;
+			}
+			/* the file system has no sparse files */
+			extents.clear();
+			extents.push_back({ 0, fileSize });
+			return true;
+		}
+		const off_t hole = lseek(_fd, data, SEEK_HOLE);
+		if (hole < 0)
+		{
+			return false;
+		}
+		if (extents.size() == maxExtents)
+		{
+			return false;
+		}
+		const uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(hole), fileSize);
+		extents.push_back({ static_cast<uint64_t>(data), end - static_cast<uint64_t>(data) });
+		data = hole;
+	}
+#else
+	extents.push_back({ 0, fileSize });
+#endif
+	return true;
+}
@@ -0,0 +1,699 @@
+#include "Replicator.h"
+#include "SocketHandler.h"
+#include "AESWrapper.h"
+#include "RSAWrapper.h"
+#include "RandomAccessFile.h"
+#include "Logger.h"
+#include "Utils.h"
+#include "Tracer.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+Replicator::Replicator(const vector<string>& endpoints, const string& userName, const string& privateKey)
+	: _userName(userName), _privateKey(privateKey), _nextFile(0), _currentFile(0), _passFile(0), _passSize(0), _passOpen(false),
+	_published(0), _window(REPLICA_WINDOW * CHUNK_SIZE), _slots(REPLICA_WINDOW), _closed(false), _tracked(false), _open(0)
+{
+	RSAPrivateWrapper key(_privateKey);
+	_publicKey = key.getPublicKey();
+	for (const string& endpoint : endpoints)
+	{
+		Replica* replica = new Replica();
+		const size_t spos = endpoint.rfind(':');
+		replica->index = _replicas.size();
+		replica->endpoint = endpoint;
+		replica->backlogPath = "backlog." + endpoint + ".tmp";
+		std::replace(replica->backlogPath.begin(), replica->backlogPath.end(), ':', '_');
+		replica->address = endpoint.substr(0, spos);
+		replica->port = endpoint.substr(spos + 1);
+		replica->socket = new SocketHandler();
+		replica->chunk.resize(CHUNK_SIZE + AES_BLOCK_SIZE);
+		_replicas.push_back(replica);
+	}
+}
+
+Replicator::~Replicator()
+{
+	finish();
+	for (Replica* replica : _replicas)
+	{
+		if (replica->backlog.is_open())
+		{
+			replica->backlog.close();
+			std::remove(replica->backlogPath.c_str());
+		}
+		delete replica->socket;
+		delete replica;
+	}
+}
+
+/* one line per replica: HOST:PORT and the uid of this client on it in hex */
+bool Replicator::load(const string& path)
+{
+	ifstream input(path);
+	if (!input)
+	{
+		return true;
+	}
+	string line;
+	while (getline(input, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		istringstream fields(line);
+		string endpoint, uid;
+		if (!(fields >> endpoint >> uid) || uid.size() != 2 * UID_SIZE)
+		{
+			return false;
+		}
+		for (Replica* replica : _replicas)
+		{
+			if (replica->endpoint == endpoint)
+			{
+				replica->uid = Utils::reverse_hexi(uid);
+			}
+		}
+	}
+	return true;
+}
+
+/* replicas of an earlier run that are not used now keep their line */
+bool Replicator::save(const string& path) const
+{
+	map<string, string> uids;
+	ifstream input(path);
+	string line;
+	while (getline(input, line))
+	{
+		istringstream fields(line);
+		string endpoint, uid;
+		if (fields >> endpoint >> uid)
+		{
+			uids[endpoint] = uid;
+		}
+	}
+	input.close();
+	for (const Replica* replica : _replicas)
+	{
+		if (!replica->uid.empty())
+		{
+			uids[replica->endpoint] = Utils::hexi(reinterpret_cast<const uint8_t*>(replica->uid.data()), UID_SIZE);
+		}
+	}
+
+	const string temporary = path + ".tmp";
+	{
+		ofstream output(temporary, ios::trunc);
+		for (const auto& uid : uids)
+		{
+			output << uid.first << ' ' << uid.second << '\n';
+		}
+		if (!output.flush())
+		{
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void Replicator::start()
+{
+	for (Replica* replica : _replicas)
+	{
+		replica->worker = thread(&Replicator::run, this, std::ref(*replica));
+	}
+}
+
+/* never waits for a replica, one that is far behind keeps the files past its list in its backlog file */
+uint64_t Replicator::queue(size_t first, size_t last, const string& path, const string& name, bool current)
+{
+	unique_lock<mutex> guard(_lock);
+	const uint64_t file = ++_nextFile;
+	if (current)
+	{
+		_currentFile = file;
+	}
+	for (size_t i = first; i < last; i++)
+	{
+		if (_replicas[i]->alive)
+		{
+			push(*_replicas[i], { file, path, name });
+			_open += _tracked ? 1 : 0;
+		}
+		else if (_tracked)
+		{
+			/* dropped after the caller placed the file on it */
+			_outcomes.push_back({ file, i, false, true });
+		}
+	}
+	guard.unlock();
+	_changed.notify_all();
+	return file;
+}
+
+uint64_t Replicator::offer(const string& path, const string& name)
+{
+	return queue(0, _replicas.size(), path, name, true);
+}
+
+uint64_t Replicator::offerTo(size_t replica, const string& path, const string& name)
+{
+	return queue(replica, replica + 1, path, name, false);
+}
+
+void Replicator::trackOutcomes()
+{
+	lock_guard<mutex> guard(_lock);
+	_tracked = true;
+}
+
+/* false when there was nothing to collect and no file is open */
+bool Replicator::collect(vector<ReplicaOutcome>& outcomes, bool wait)
+{
+	unique_lock<mutex> guard(_lock);
+	if (wait)
+	{
+		_changed.wait(guard, [this]() { return !_outcomes.empty() || _open == 0; });
+	}
+	outcomes.swap(_outcomes);
+	_outcomes.clear();
+	return !outcomes.empty();
+}
+
+/* called with the lock held. once the list of the replica is full the file and every one after it go to the end
+of its backlog file, a file that cannot be written there is kept in memory */
+void Replicator::push(Replica& replica, const ReplicaTask& task)
+{
+	if (replica.tasks.size() < REPLICA_MAX_BACKLOG && replica.backlogRead == replica.backlogWritten)
+	{
+		replica.tasks.push_back(task);
+		return;
+	}
+	if (!replica.backlog.is_open())
+	{
+		replica.backlog.open(replica.backlogPath, ios::binary | ios::trunc);
+		if (replica.backlog.is_open())
+		{
+			LOG_INFO("replica.backlog", "endpoint=%s files=%zu path=\"%s\"", replica.endpoint.c_str(), replica.tasks.size(), replica.backlogPath.c_str());
+		}
+	}
+	const uint32_t pathLength = static_cast<uint32_t>(task.path.size());
+	const uint32_t nameLength = static_cast<uint32_t>(task.name.size());
+	replica.backlog.write(reinterpret_cast<const char*>(&task.id), sizeof(task.id));
+	replica.backlog.write(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+	replica.backlog.write(task.path.data(), pathLength);
+	replica.backlog.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+	replica.backlog.write(task.name.data(), nameLength);
+	if (!replica.backlog)
+	{
+		replica.tasks.push_back(task);
+		return;
+	}
+	replica.backlogWritten++;
+}
+
+/* called with the lock held, up to limit files of the backlog file onto the list. files that cannot be read
+back count as failed */
+void Replicator::readBacklog(Replica& replica, size_t limit)
+{
+	if (replica.backlogRead == replica.backlogWritten)
+	{
+		return;
+	}
+	replica.backlog.flush();
+	ifstream input(replica.backlogPath, ios::binary);
+	input.seekg(static_cast<streamoff>(replica.backlogOffset));
+	for (size_t i = 0; i < limit && replica.backlogRead < replica.backlogWritten; i++)
+	{
+		ReplicaTask task;
+		uint32_t pathLength = 0, nameLength = 0;
+		if (input.read(reinterpret_cast<char*>(&task.id), sizeof(task.id)) && input.read(reinterpret_cast<char*>(&pathLength), sizeof(pathLength)))
+		{
+			task.path.resize(pathLength);
+			if (input.read(&task.path[0], pathLength) && input.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength)))
+			{
+				task.name.resize(nameLength);
+				input.read(&task.name[0], nameLength);
+			}
+		}
+		if (!input)
+		{
+			const uint64_t lost = replica.backlogWritten - replica.backlogRead;
+			LOG_WARN("replica.backlog_lost", "endpoint=%s files=%llu", replica.endpoint.c_str(), static_cast<unsigned long long>(lost));
+			replica.failed += lost;
+			_open -= _tracked ? lost : 0;
+			replica.backlogRead = replica.backlogWritten;
+			break;
+		}
+		replica.tasks.push_back(task);
+		replica.backlogRead++;
+	}
+	replica.backlogOffset = static_cast<uint64_t>(input.tellg());
+	if (replica.backlogRead == replica.backlogWritten)
+	{
+		replica.backlog.close();
+		std::remove(replica.backlogPath.c_str());
+		replica.backlogWritten = 0;
+		replica.backlogRead = 0;
+		replica.backlogOffset = 0;
+	}
+}
+
+/* called with the lock held */
+void Replicator::finishTask(Replica& replica, uint64_t file, bool stored)
+{
+	stored ? replica.stored++ : replica.failed++;
+	if (_tracked)
+	{
+		_open--;
+		_outcomes.push_back({ file, replica.index, stored, false });
+	}
+}
+
+/* only the first read of a file is shared, a send the main server asked for again is not replicated again.
+replicas still on the pass of an earlier file read the rest of it themselves */
+bool Replicator::beginPass(uint64_t file, uint64_t size)
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		if (file == 0 || file != _currentFile || file == _passFile)
+		{
+			return false;
+		}
+		for (Replica* replica : _replicas)
+		{
+			replica->attached = false;
+		}
+		_passFile = file;
+		_passSize = size;
+		_passOpen = true;
+		_published = 0;
+	}
+	_changed.notify_all();
+	return true;
+}
+
+/* the slot of the chunk a window ago is reused, a replica that did not take that chunk yet is detached */
+void Replicator::publish(ConstByteSpan plain, uint64_t offset, uint32_t crc)
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		for (Replica* replica : _replicas)
+		{
+			if (replica->attached && replica->consumed + REPLICA_WINDOW <= _published)
+			{
+				replica->attached = false;
+				LOG_DEBUG("replica.detached", "endpoint=%s offset=%llu", replica->endpoint.c_str(), static_cast<unsigned long long>(offset));
+			}
+		}
+		const size_t slot = static_cast<size_t>(_published % REPLICA_WINDOW);
+		memcpy(_window.data() + slot * CHUNK_SIZE, plain.data(), plain.size());
+		_slots[slot] = { offset, plain.size(), crc };
+		_published++;
+	}
+	_changed.notify_all();
+}
+
+/* the chunks published stay in the window until the next pass, replicas that were behind still take them */
+void Replicator::endPass()
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_passOpen = false;
+	}
+	_changed.notify_all();
+}
+
+void Replicator::endFile(uint64_t file)
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		if (_currentFile == file)
+		{
+			_currentFile = 0;
+		}
+	}
+	_changed.notify_all();
+}
+
+void Replicator::finish()
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_closed = true;
+	}
+	_changed.notify_all();
+	for (Replica* replica : _replicas)
+	{
+		if (replica->worker.joinable())
+		{
+			replica->worker.join();
+		}
+	}
+}
+
+void Replicator::report() const
+{
+	lock_guard<mutex> guard(_lock);
+	for (const Replica* replica : _replicas)
+	{
+		LOG_INFO("replica.report", "endpoint=%s alive=%d stored=%llu failed=%llu shared_bytes=%llu own_bytes=%llu", replica->endpoint.c_str(),
+			replica->alive ? 1 : 0, static_cast<unsigned long long>(replica->stored), static_cast<unsigned long long>(replica->failed),
+			static_cast<unsigned long long>(replica->sharedBytes), static_cast<unsigned long long>(replica->ownBytes));
+	}
+}
+
+size_t Replicator::size() const
+{
+	return _replicas.size();
+}
+
+bool Replicator::alive(size_t replica) const
+{
+	lock_guard<mutex> guard(_lock);
+	return _replicas[replica]->alive;
+}
+
+bool Replicator::connect(size_t replica)
+{
+	uint8_t buffer[PACKET_SIZE];
+	Replica& node = *_replicas[replica];
+	if (!node.socket->initializeSocketInfo(node.address, node.port) || !node.socket->connectToServer() || !login(node, buffer))
+	{
+		drop(node, "login");
+		return false;
+	}
+	return true;
+}
+
+SocketHandler& Replicator::socket(size_t replica)
+{
+	return *_replicas[replica]->socket;
+}
+
+const string& Replicator::uid(size_t replica) const
+{
+	return _replicas[replica]->uid;
+}
+
+const string& Replicator::aesKey(size_t replica) const
+{
+	return _replicas[replica]->aesKey;
+}
+
+/* a replica that cannot be reached or breaks the protocol is left out for the rest of the backup. with tracked
+outcomes its queued files are handed back to be placed elsewhere instead of counting as failed */
+void Replicator::drop(Replica& replica, const string& reason)
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		replica.alive = false;
+		replica.attached = false;
+		readBacklog(replica, numeric_limits<size_t>::max());
+		if (_tracked)
+		{
+			for (const ReplicaTask& task : replica.tasks)
+			{
+				_open--;
+				_outcomes.push_back({ task.id, replica.index, false, true });
+			}
+		}
+		else
+		{
+			replica.failed += replica.tasks.size();
+		}
+		replica.tasks.clear();
+	}
+	_changed.notify_all();
+	LOG_WARN("replica.dropped", "endpoint=%s reason=%s", replica.endpoint.c_str(), reason.c_str());
+}
+
+void Replicator::packRequest(const Replica& replica, uint8_t* buffer, uint16_t code, uint32_t payloadSize, const string& text) const
+{
+	memset(buffer, 0, PACKET_SIZE);
+	ClientRequestHeader header(code, payloadSize);
+	replica.uid.copy(reinterpret_cast<char*>(header.uid), sizeof(header.uid));
+	memcpy(buffer, &header, REQUEST_HEADER_SIZE);
+	text.copy(reinterpret_cast<char*>(buffer + REQUEST_HEADER_SIZE), std::min<size_t>(text.size(), FILE_NAME_SIZE));
+}
+
+/* send a request that fits a packet, the response is read into the same buffer. false on a socket failure */
+bool Replicator::exchange(Replica& replica, uint8_t* buffer, size_t requestSize, uint16_t& code)
+{
+	if (!replica.socket->writeBytes(buffer, requestSize) || !replica.socket->read(buffer))
+	{
+		return false;
+	}
+	memcpy(&code, buffer + VERSION_SIZE, CODE_SIZE);
+	return buffer[0] == VERSION;
+}
+
+/* reconnect with the uid of replicas.info, or register the client name and the public key of me.info -
+every replica has its own uid and AES key for the client */
+bool Replicator::login(Replica& replica, uint8_t* buffer)
+{
+	uint16_t code = 0;
+	if (!replica.uid.empty())
+	{
+		packRequest(replica, buffer, LOGIN_REQUEST, NAME_SIZE, _userName);
+		if (!exchange(replica, buffer, REQUEST_HEADER_SIZE + NAME_SIZE, code))
+		{
+			return false;
+		}
+	}
+	if (code != ServerResponse::SResponseCode::LOGIN_SUCCESS_SEND_AES)
+	{
+		replica.uid.clear();
+		packRequest(replica, buffer, REGISTRATION_REQUEST, NAME_SIZE, _userName);
+		if (!exchange(replica, buffer, REQUEST_HEADER_SIZE + NAME_SIZE, code) || code != ServerResponse::SResponseCode::REGISTRATION_REQUEST_SUCCESS)
+		{
+			return false;
+		}
+		replica.uid.assign(reinterpret_cast<const char*>(buffer + HEADER_SIZE), UID_SIZE);
+		packRequest(replica, buffer, PUBLIC_KEY_REQUEST, NAME_SIZE + PUBLIC_KEY_SIZE, _userName);
+		_publicKey.copy(reinterpret_cast<char*>(buffer + REQUEST_HEADER_SIZE + NAME_SIZE), PUBLIC_KEY_SIZE);
+		if (!exchange(replica, buffer, REQUEST_HEADER_SIZE + NAME_SIZE + PUBLIC_KEY_SIZE, code) || code != ServerResponse::SResponseCode::GOT_PC_SEND_AES)
+		{
+			return false;
+		}
+	}
+
+	uint32_t payloadSize;
+	memcpy(&payloadSize, buffer + VERSION_SIZE + CODE_SIZE, PAYLOAD_SIZE);
+	if (payloadSize <= UID_SIZE || payloadSize > PACKET_SIZE - HEADER_SIZE)
+	{
+		return false;
+	}
+	try
+	{
+		RSAPrivateWrapper key(_privateKey);
+		replica.aesKey = key.decrypt(reinterpret_cast<const char*>(buffer + HEADER_SIZE + UID_SIZE), payloadSize - UID_SIZE);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+	return replica.aesKey.size() == AESWrapper::DEFAULT_KEYLENGTH;
+}
+
+/* the next chunk of the file into the chunk buffer of the replica - from the shared pass while attached, read from
+the file otherwise. a file that became shorter is padded with zeros to keep the request framed and is not complete */
+void Replicator::nextChunk(Replica& replica, RandomAccessFile& file, uint64_t size, uint64_t& offset, uint32_t& crc, size_t& length, bool& complete)
+{
+	{
+		unique_lock<mutex> guard(_lock);
+		if (replica.attached)
+		{
+			_changed.wait(guard, [this, &replica]() { return !replica.attached || replica.consumed < _published || !_passOpen; });
+			if (replica.attached && replica.consumed < _published)
+			{
+				const size_t slot = static_cast<size_t>(replica.consumed % REPLICA_WINDOW);
+				length = _slots[slot].length;
+				memcpy(replica.chunk.data(), _window.data() + slot * CHUNK_SIZE, length);
+				offset = _slots[slot].offset + length;
+				crc = _slots[slot].crc;
+				replica.consumed++;
+				replica.sharedBytes += length;
+				return;
+			}
+			/* the pass ended early, the file is read from where it stopped */
+			replica.attached = false;
+		}
+	}
+	length = static_cast<size_t>(std::min<uint64_t>(size - offset, CHUNK_SIZE));
+	size_t read = 0;
+	if (!file.isOpen() || !file.readAt(offset, replica.chunk.data(), length, read) || read != length)
+	{
+		memset(replica.chunk.data() + read, 0, length - read);
+		complete = false;
+	}
+	crc = Utils::crc32Update(crc, ConstByteSpan(replica.chunk.data(), length));
+	offset += length;
+	replica.ownBytes += length;
+}
+
+/* send one file to the replica and confirm its CKsum, a mismatch is sent again read from the file as the main
+upload does. false if the file was not stored, the replica is dropped on a connection failure */
+bool Replicator::sendFile(Replica& replica, const ReplicaTask& task, RandomAccessFile& file, bool shared, uint8_t* buffer)
+{
+	for (int attempt = 0; attempt < MAX_CRC_SEND; attempt++)
+	{
+		uint64_t size = 0;
+		file.close();
+		const bool opened = file.open(task.path);
+		{
+			lock_guard<mutex> guard(_lock);
+			replica.attached = shared && attempt == 0 && replica.attached;
+			replica.consumed = replica.attached ? replica.consumed : 0;
+			size = replica.attached ? _passSize : (opened ? file.size() : 0);
+		}
+		if (!opened && !(shared && attempt == 0))
+		{
+			LOG_WARN("replica.skipped", "endpoint=%s path=\"%s\" reason=vanished", replica.endpoint.c_str(), task.path.c_str());
+			return false;
+		}
+		if (CONTENT_SIZE + FILE_NAME_SIZE + size + AES_BLOCK_SIZE > numeric_limits<uint32_t>::max())
+		{
+			return false;
+		}
+		const uint32_t contentSize = AESWrapper::cipherSize(static_cast<unsigned int>(size));
+		packRequest(replica, buffer, FILE_SEND_REQUEST, CONTENT_SIZE + FILE_NAME_SIZE + contentSize, "");
+		memcpy(buffer + REQUEST_HEADER_SIZE, &contentSize, CONTENT_SIZE);
+		task.name.copy(reinterpret_cast<char*>(buffer + REQUEST_HEADER_SIZE + CONTENT_SIZE), std::min<size_t>(task.name.size(), FILE_NAME_SIZE));
+		if (!replica.socket->writeBytes(buffer, FILE_SEND_HEADER_SIZE))
+		{
+			drop(replica, "write");
+			return false;
+		}
+
+		AESWrapper aes(reinterpret_cast<const unsigned char*>(replica.aesKey.c_str()), AESWrapper::DEFAULT_KEYLENGTH);
+		uint64_t offset = 0;
+		uint32_t crc = 0;
+		bool complete = true;
+		do
+		{
+			size_t length = 0;
+			nextChunk(replica, file, size, offset, crc, length, complete);
+			const size_t cipherLength = aes.encryptChunk(ConstByteSpan(replica.chunk.data(), length),
+				ByteSpan(replica.chunk.data(), replica.chunk.size()), offset == size);
+			if (!replica.socket->writeBytes(replica.chunk.data(), cipherLength))
+			{
+				drop(replica, "write");
+				return false;
+			}
+		} while (offset < size);
+
+		uint16_t code = 0;
+		if (!replica.socket->read(buffer))
+		{
+			drop(replica, "read");
+			return false;
+		}
+		memcpy(&code, buffer + VERSION_SIZE, CODE_SIZE);
+		if (code == ServerResponse::SResponseCode::GENERAL_ERR)
+		{
+			continue;
+		}
+		if (code != ServerResponse::SResponseCode::GOT_FILE_SEND_CRC)
+		{
+			drop(replica, "protocol");
+			return false;
+		}
+		uint32_t serverCRC;
+		memcpy(&serverCRC, buffer + HEADER_SIZE + UID_SIZE + CONTENT_SIZE + FILE_NAME_SIZE, CRC_SIZE);
+		if (complete && serverCRC == crc)
+		{
+			packRequest(replica, buffer, CRC_VALID_REQUEST, FILE_NAME_SIZE, task.name);
+			if (!exchange(replica, buffer, REQUEST_HEADER_SIZE + FILE_NAME_SIZE, code))
+			{
+				drop(replica, "read");
+				return false;
+			}
+			return code == ServerResponse::SResponseCode::GOT_REQ_TNX;
+		}
+		LOG_WARN("replica.crc_mismatch", "endpoint=%s name=\"%s\" attempt=%d", replica.endpoint.c_str(), task.name.c_str(), attempt + 1);
+		if (attempt + 1 == MAX_CRC_SEND)
+		{
+			packRequest(replica, buffer, FOUR_FAILED_CRC_REQUEST, FILE_NAME_SIZE, task.name);
+			if (!exchange(replica, buffer, REQUEST_HEADER_SIZE + FILE_NAME_SIZE, code))
+			{
+				drop(replica, "read");
+			}
+			return false;
+		}
+		packRequest(replica, buffer, CRC_FAILED_REQUEST, FILE_NAME_SIZE, task.name);
+		if (!replica.socket->writeBytes(buffer, REQUEST_HEADER_SIZE + FILE_NAME_SIZE))
+		{
+			drop(replica, "write");
+			return false;
+		}
+	}
+	return false;
+}
+
+/* the session of one replica: log in, then send its files in the order they were offered. a file the main upload
+is about to send is waited for, so the replica can take it from the shared pass */
+void Replicator::run(Replica& replica)
+{
+	Tracer::instance().nameThread("replica");
+	uint8_t buffer[PACKET_SIZE];
+	if (!replica.socket->initializeSocketInfo(replica.address, replica.port) || !replica.socket->connectToServer() || !login(replica, buffer))
+	{
+		drop(replica, "login");
+		return;
+	}
+	LOG_INFO("replica.login", "endpoint=%s", replica.endpoint.c_str());
+
+	RandomAccessFile file;
+	while (true)
+	{
+		ReplicaTask task;
+		bool shared = false;
+		{
+			unique_lock<mutex> guard(_lock);
+			if (replica.tasks.empty())
+			{
+				readBacklog(replica, REPLICA_MAX_BACKLOG);
+			}
+			_changed.wait(guard, [this, &replica]() { return _closed || !replica.tasks.empty() || !replica.alive; });
+			if (replica.tasks.empty())
+			{
+				return;
+			}
+			task = replica.tasks.front();
+			replica.tasks.pop_front();
+			_changed.wait(guard, [this, &task]() { return _currentFile != task.id || _passFile == task.id; });
+			/* the first chunk of the pass is still in the window */
+			shared = _passFile == task.id && _published <= REPLICA_WINDOW;
+			replica.attached = shared;
+			replica.consumed = 0;
+		}
+		_changed.notify_all();
+		const bool stored = sendFile(replica, task, file, shared, buffer);
+		file.close();
+		{
+			lock_guard<mutex> guard(_lock);
+			if (!replica.alive && _tracked)
+			{
+				/* the connection broke during the file, it is not known to be stored */
+				_open--;
+				_outcomes.push_back({ task.id, replica.index, false, true });
+			}
+			else
+			{
+				finishTask(replica, task.id, stored && replica.alive);
+			}
+		}
+		_changed.notify_all();
+		if (!replica.alive)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#include "ShardRing.h"
+#include <algorithm>
+
+ShardRing::ShardRing(const vector<string>& nodes) : _nodes(nodes)
+{
+	_points.reserve(_nodes.size() * SHARD_VIRTUAL_NODES);
+	for (size_t node = 0; node < _nodes.size(); node++)
+	{
+		for (size_t point = 0; point < SHARD_VIRTUAL_NODES; point++)
+		{
+			_points.push_back(make_pair(hash(_nodes[node] + "#" + to_string(point)), node));
+		}
+	}
+	sort(_points.begin(), _points.end());
+}
+
+size_t ShardRing::nodes() const
+{
+	return _nodes.size();
+}
+
+const string& ShardRing::node(size_t index) const
+{
+	return _nodes[index];
+}
+
+size_t ShardRing::locate(const string& key) const
+{
+	return locate(key, vector<bool>());
+}
+
+/* walk clockwise from the hash of the key to the first point of a node that is up */
+size_t ShardRing::locate(const string& key, const vector<bool>& down) const
+{
+	const uint64_t position = hash(key);
+	auto point = upper_bound(_points.begin(), _points.end(), make_pair(position, _nodes.size()));
+	for (size_t i = 0; i < _points.size(); i++, point++)
+	{
+		if (point == _points.end())
+		{
+			point = _points.begin();
+		}
+		if (point->second >= down.size() || !down[point->second])
+		{
+			return point->second;
+		}
+	}
+	return 0;
+}
+
+/* files are placed by the client and the name they are backed up under, the same file of two clients may land apart */
+string ShardRing::key(const string& clientID, const string& name)
+{
+	return clientID + "/" + name;
+}
+
+/* FNV-1a with a final mix, names that differ in one character still land far apart on the ring */
+uint64_t ShardRing::hash(const string& text)
+{
+	uint64_t value = 14695981039346656037ULL;
+	for (unsigned char c : text)
+	{
+		value ^= c;
+		value *= 1099511628211ULL;
+	}
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+	return value;
+}
@@ -1,174 +1,212 @@
-#include <boost/asio.hpp>
-#include <boost/array.hpp>
-#include <iostream>
-#include "protocol.h"
-#include "SocketHandler.h"
-
-
-using boost::asio::ip::tcp;
-using boost::asio::io_context;
-
-SocketHandler::SocketHandler() : _ioContext(nullptr), _resolver(nullptr), _socket(nullptr)
-{
-	_ioContext = new io_context();
-	_socket = new tcp::socket(*_ioContext);
-	_resolver = new tcp::resolver(*_ioContext);
-}
-
-/* initalize socket info */
-bool SocketHandler::initializeSocketInfo(const string& address, const string& port)
-{
-	if (!addressValidation(address) || !portValidation(port))
-	{
-		return false;
-	}
-	_address = address;
-	_port = port;
-
-	return true;
-}
-
-/* make connection to the server */
-bool SocketHandler::connectToServer()
-{
-	try
-	{
-		auto endpoint = _resolver->resolve(_address, _port);
-		boost::asio::connect(*_socket, endpoint);
-		_socket->non_blocking(false);
-	}
-	catch (...)
-	{
-		return false;
-	}
-	return true;
-}
-
-/* write the request in one chunk of 2048 bytes */
-bool SocketHandler::write(vector<uint8_t>& requestBuffer)
-{
-	boost::system::error_code error;
-	const size_t len = boost::asio::write(*_socket, boost::asio::buffer(requestBuffer.data(), PACKET_SIZE), error);
-	if (len == 0)
-	{
-		cout << "message was not sent!" << endl;
-
-		/* error. Failed sending and shouldn't use buffer.*/
-		return false;
-	}
-
-	if (error)
-	{
-
-		return false;
-	}
-	cout << "message sent!" << endl;
-	return true;
-}
-
-
-/* read server resonse in one chunk of 2048 bytes  */
-std::vector<uint8_t> SocketHandler::read()
-{
-	boost::system::error_code error;
-	
-	boost::asio::deadline_timer timer(*_ioContext);
-	timer.expires_from_now(boost::posix_time::seconds(25));
-
-	/* set up a deadline timer to cancel the blocking read operation if it takes too long */ 
-	timer.async_wait([&error](const boost::system::error_code& ec) {
-		if (ec != boost::asio::error::operation_aborted) {
-			error = boost::asio::error::timed_out;
-		}
-		});
-
-	auto data = make_unique<vector<uint8_t>>(PACKET_SIZE);
-	size_t len = boost::asio::read(*_socket, boost::asio::buffer(*data), error);
-
-	/* cancel the timer now that the blocking read operation has completed */ 
-	timer.cancel();
-
-	if (len == 0) 
-	{
-		std::cout << "response message failed!" << std::endl;
-		/* error. Failed receiving and shouldn't use buffer.*/
-		return vector<uint8_t>();
-	}
-
-	if (error && error != boost::asio::error::eof) {
-		std::cout << "read failed: " << error.message() << std::endl;
-		return vector<uint8_t>(); // Some other error.
-	}
-
-	std::cout << "response message was read!" << std::endl;
-	return std::move(*data);
-}
-
-
-
-
-/* sending file in chunks, first send the header and after that send the data in 2048 bytes size chuck */
-bool SocketHandler::writeChuncks(vector<uint8_t>& requestBuffer, uint32_t payload_size)
-{
-	boost::system::error_code error;
-	const size_t len = boost::asio::write(*_socket, boost::asio::buffer(requestBuffer, CLIENT_HEADER_SIZE), error);
-
-	if (len == 0 || error)
-	{
-		/* error. Failed sending and shouldn't use buffer.*/
-		return false;
-	}
-
-	for (uint32_t i = 0; i < payload_size; i += PACKET_SIZE)
-	{
-		size_t bytes_written = _socket->write_some(boost::asio::buffer(requestBuffer.data() + i + CLIENT_HEADER_SIZE, std::min<uint32_t>(PACKET_SIZE, payload_size - i)), error);
-		if (bytes_written == 0 || error)
-		{
-			/* error. Failed sending and shouldn't use buffer.*/
-			return false;
-		}
-
-	}
-	requestBuffer.clear();
-	requestBuffer.resize(PACKET_SIZE);
-	
-	return true;
-}
-/* address validation */
-bool SocketHandler::addressValidation(const string& address)
-{
-	if ((address == "localhost") || (address == "LOCALHOST"))
-		return true;
-	try
-	{
-		(void)boost::asio::ip::address_v4::from_string(address);
-	}
-	catch (...)
-	{
-		return false;
-	}
-	return true;
-}
-
-
-/* port validation */
-bool SocketHandler::portValidation(const string& port)
-{
-	try
-	{
-		const int p = std::stoi(port);
-		return (p != 0);  // port 0 is invalid..
-	}
-	catch (...)
-	{
-		return false;
-	}
-}
-
-SocketHandler::~SocketHandler()
-{
-	delete _ioContext;
-	delete _socket;
-	delete _resolver;
-}
-
+#include <boost/asio.hpp>
+#include <boost/array.hpp>
+#include <iostream>
+#include "protocol.h"
+#include "SocketHandler.h"
+#include "Tracer.h"
+
+
+using boost::asio::ip::tcp;
+using boost::asio::io_context;
+
+SocketHandler::SocketHandler() : _ioContext(nullptr), _resolver(nullptr), _socket(nullptr), _bufferSize(0)
+{
+	_ioContext = new io_context();
+	_socket = new tcp::socket(*_ioContext);
+	_resolver = new tcp::resolver(*_ioContext);
+}
+
+/* initalize socket info */
+bool SocketHandler::initializeSocketInfo(const string& address, const string& port)
+{
+	if (!addressValidation(address) || !portValidation(port))
+	{
+		return false;
+	}
+	_address = address;
+	_port = port;
+
+	return true;
+}
+
+/* make connection to the server */
+bool SocketHandler::connectToServer()
+{
+	TRACE_SCOPE("socket.connect");
+	try
+	{
+		auto endpoint = _resolver->resolve(_address, _port);
+		boost::asio::connect(*_socket, endpoint);
+		_socket->non_blocking(false);
+		applyBufferSize();
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+/* write a request packed in one packet of 2048 bytes - only the header and the payload are sent,
+the server reads exactly that much and would take trailing padding for the next request */
+bool SocketHandler::write(const uint8_t* packet)
+{
+	boost::system::error_code error;
+	uint32_t payloadSize;
+	memcpy(&payloadSize, packet + UID_SIZE + VERSION_SIZE + CODE_SIZE, PAYLOAD_SIZE);
+	const size_t requestSize = std::min<size_t>(PACKET_SIZE, REQUEST_HEADER_SIZE + static_cast<size_t>(payloadSize));
+	TRACE_SCOPE("socket.write", requestSize);
+	const size_t len = boost::asio::write(*_socket, boost::asio::buffer(packet, requestSize), error);
+	if (len == 0)
+	{
+		LOG_ERROR("socket.write_failed", "error=\"%s\"", error.message().c_str());
+
+		/* error. Failed sending and shouldn't use buffer.*/
+		return false;
+	}
+
+	if (error)
+	{
+
+		return false;
+	}
+	LOG_DEBUG("socket.write", "bytes=%zu", len);
+	return true;
+}
+
+
+/* read server resonse in one chunk of 2048 bytes - the server pads every response to a full packet,
+so a shorter read is a response cut by a closed connection  */
+bool SocketHandler::read(uint8_t* packet)
+{
+	TRACE_SCOPE("socket.read", PACKET_SIZE);
+	boost::system::error_code error;
+	if (!readFully(packet, PACKET_SIZE, error))
+	{
+		LOG_ERROR("socket.read_failed", "error=\"%s\"", error.message().c_str());
+		return false;
+	}
+	LOG_DEBUG("socket.read", "bytes=%d", PACKET_SIZE);
+	return true;
+}
+
+/* read exactly length bytes or fail after READ_TIMEOUT_SECONDS without them. the read runs on the io_context of
+the socket for at most the timeout, a read still pending then is cancelled and its handler run before returning,
+so nothing is left queued between two reads */
+bool SocketHandler::readFully(uint8_t* buffer, size_t length, boost::system::error_code& error)
+{
+	size_t len = 0;
+	error = boost::asio::error::would_block;
+	boost::asio::async_read(*_socket, boost::asio::buffer(buffer, length),
+		[&error, &len](const boost::system::error_code& ec, size_t transferred)
+		{
+			error = ec;
+			len = transferred;
+		});
+	_ioContext->restart();
+	_ioContext->run_for(std::chrono::seconds(READ_TIMEOUT_SECONDS));
+	if (error == boost::asio::error::would_block)
+	{
+		boost::system::error_code ignored;
+		_socket->cancel(ignored);
+		_ioContext->restart();
+		_ioContext->run();
+		error = boost::asio::error::timed_out;
+		return false;
+	}
+	return !error && len == length;
+}
+
+/* read exactly length bytes - the rest of a response whose payload does not fit in one packet */
+bool SocketHandler::readBytes(uint8_t* buffer, size_t length)
+{
+	TRACE_SCOPE("socket.read", length);
+	boost::system::error_code error;
+	return readFully(buffer, length, error);
+}
+
+/* write raw bytes as they are - used to stream the file content after the request header */
+bool SocketHandler::writeBytes(const uint8_t* data, size_t length)
+{
+	TRACE_SCOPE("socket.write", length);
+	boost::system::error_code error;
+	const size_t len = boost::asio::write(*_socket, boost::asio::buffer(data, length), error);
+	if (len != length || error)
+	{
+		/* error. Failed sending and shouldn't use buffer.*/
+		return false;
+	}
+	return true;
+}
+
+size_t SocketHandler::available()
+{
+	boost::system::error_code error;
+	const size_t bytes = _socket->available(error);
+	return error ? 0 : bytes;
+}
+
+/* the size takes effect at once on a connected socket. the receive buffer set after the handshake cannot widen the
+window scale the connection agreed on, the client mostly sends and the send buffer is what bounds it */
+void SocketHandler::setBufferSize(size_t bytes)
+{
+	_bufferSize = bytes;
+	if (_socket->is_open())
+	{
+		applyBufferSize();
+	}
+}
+
+void SocketHandler::applyBufferSize()
+{
+	if (_bufferSize == 0)
+	{
+		return;
+	}
+	boost::system::error_code error;
+	_socket->set_option(boost::asio::socket_base::send_buffer_size(static_cast<int>(_bufferSize)), error);
+	_socket->set_option(boost::asio::socket_base::receive_buffer_size(static_cast<int>(_bufferSize)), error);
+	if (error)
+	{
+		LOG_WARN("socket.buffer", "bytes=%zu error=\"%s\"", _bufferSize, error.message().c_str());
+	}
+}
+
+/* address validation */
+bool SocketHandler::addressValidation(const string& address)
+{
+	if ((address == "localhost") || (address == "LOCALHOST"))
+		return true;
+	try
+	{
+		(void)boost::asio::ip::address_v4::from_string(address);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	return true;
+}
+
+
+/* port validation */
+bool SocketHandler::portValidation(const string& port)
+{
+	try
+	{
+		const int p = std::stoi(port);
+		return (p != 0);  // port 0 is invalid..
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
+SocketHandler::~SocketHandler()
+{
+	delete _ioContext;
+	delete _socket;
+	delete _resolver;
+}
+
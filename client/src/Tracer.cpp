@@ -0,0 +1,161 @@
+#include "Tracer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+/* the buffer of the calling thread, handed back to the tracer when the thread exits */
+struct TraceThread
+{
+	Tracer::Buffer* buffer;
+	TraceThread() : buffer(nullptr) {}
+	~TraceThread()
+	{
+		if (buffer != nullptr)
+		{
+			Tracer::instance().release(buffer);
+		}
+	}
+};
+
+static thread_local TraceThread current;
+
+static uint64_t steadyNanoseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Tracer& Tracer::instance()
+{
+	static Tracer tracer;
+	return tracer;
+}
+
+Tracer::Tracer() : _enabled(false), _origin(steadyNanoseconds()), _nextThread(0), _dropped(0)
+{
+}
+
+Tracer::~Tracer()
+{
+	for (Buffer* buffer : _buffers)
+	{
+		delete buffer;
+	}
+}
+
+void Tracer::enable(const string& path)
+{
+	_path = path;
+	_enabled.store(true, memory_order_release);
+}
+
+bool Tracer::enabled() const
+{
+	return _enabled.load(memory_order_relaxed);
+}
+
+uint64_t Tracer::now() const
+{
+	return steadyNanoseconds() - _origin;
+}
+
+uint64_t Tracer::dropped() const
+{
+	return _dropped.load(memory_order_relaxed);
+}
+
+/* a free buffer that last belonged to a thread of the same name, so the threads of every file share one track */
+Tracer::Buffer* Tracer::acquire(const char* name)
+{
+	lock_guard<mutex> guard(_lock);
+	for (size_t i = 0; i < _free.size(); i++)
+	{
+		if (_free[i]->name == name || (_free[i]->name != nullptr && name != nullptr && strcmp(_free[i]->name, name) == 0))
+		{
+			Buffer* buffer = _free[i];
+			_free.erase(_free.begin() + i);
+			return buffer;
+		}
+	}
+	Buffer* buffer = new Buffer();
+	buffer->id = ++_nextThread;
+	buffer->name = name;
+	_buffers.push_back(buffer);
+	return buffer;
+}
+
+void Tracer::release(Buffer* buffer)
+{
+	lock_guard<mutex> guard(_lock);
+	_free.push_back(buffer);
+}
+
+void Tracer::nameThread(const char* name)
+{
+	if (!enabled())
+	{
+		return;
+	}
+	if (current.buffer == nullptr)
+	{
+		current.buffer = acquire(name);
+	}
+	current.buffer->name = name;
+}
+
+void Tracer::record(const char* name, uint64_t start, uint64_t bytes)
+{
+	if (current.buffer == nullptr)
+	{
+		current.buffer = acquire(nullptr);
+	}
+	Buffer& buffer = *current.buffer;
+	const size_t count = buffer.count.load(memory_order_relaxed);
+	if (count == TRACE_BUFFER_EVENTS)
+	{
+		_dropped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	TraceEvent& event = buffer.events[count];
+	event.name = name;
+	event.start = start;
+	event.duration = now() - start;
+	event.bytes = bytes;
+	buffer.count.store(count + 1, memory_order_release);
+}
+
+/* the events recorded so far as a Chrome Trace Event JSON object. threads still running keep recording,
+only the events published before are written */
+bool Tracer::write()
+{
+	if (!enabled())
+	{
+		return true;
+	}
+	FILE* output = fopen(_path.c_str(), "w");
+	if (output == nullptr)
+	{
+		return false;
+	}
+	lock_guard<mutex> guard(_lock);
+	fprintf(output, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%llu},\"traceEvents\":[\n", static_cast<unsigned long long>(dropped()));
+	fprintf(output, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"client\"}}");
+	for (const Buffer* buffer : _buffers)
+	{
+		fprintf(output, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", buffer->id,
+			buffer->name != nullptr ? buffer->name : "thread");
+		const size_t count = buffer->count.load(memory_order_acquire);
+		for (size_t i = 0; i < count; i++)
+		{
+			const TraceEvent& event = buffer->events[i];
+			fprintf(output, ",\n{\"name\":\"%s\",\"cat\":\"client\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", event.name,
+				buffer->id, event.start / 1000.0, event.duration / 1000.0);
+			if (event.bytes != 0)
+			{
+				fprintf(output, ",\"args\":{\"bytes\":%llu}", static_cast<unsigned long long>(event.bytes));
+			}
+			fputc('}', output);
+		}
+	}
+	fprintf(output, "\n]}\n");
+	return fclose(output) == 0;
+}
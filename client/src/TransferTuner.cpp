@@ -0,0 +1,375 @@
+#include "TransferTuner.h"
+#include "ClientOptions.h"
+#include "Logger.h"
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstdio>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+constexpr size_t TUNE_FIRST_SOCKET_BUFFER = 256 * 1024;   // first step of a socket buffer left at the system default
+
+/* CPU seconds the client used so far on all of its threads */
+static double processCPUSeconds()
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+	{
+		return 0;
+	}
+	const uint64_t ticks = ((static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime) +
+		((static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime);
+	return ticks / 1e7;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+static const char* stageName(int stage)
+{
+	static const char* const names[] = { "read", "transform", "write" };
+	return names[stage];
+}
+
+TransferTuner::TransferTuner(const string& endpoint, const ClientOptions& options) : _endpoint(endpoint), _current(0), _direction(1),
+	_misses(0), _probing(false), _previous(0), _idle(0), _best(0), _bestCPU(0), _epochs(0), _kept(0), _bytes(0), _stripable(0),
+	_start(std::chrono::steady_clock::now()), _startCPU(processCPUSeconds())
+{
+	/* a window above 1 sends every file pipelined, which never appends, sends a delta, a sparse extent map or
+	stripes - the window is not climbed when one of those was asked for */
+	if (!options.append && !options.delta && !options.autoStripes && options.stripes <= 1)
+	{
+		_parameters.push_back({ "window", options.window, 1, MAX_WINDOW, true });
+	}
+	/* --stripes=auto already sizes the streams of every file */
+	if (!options.autoStripes)
+	{
+		_parameters.push_back({ "stripes", options.stripes, 1, MAX_STRIPES, false });
+	}
+	_parameters.push_back({ "socket_buffer", options.socketBuffer, TUNE_MIN_SOCKET_BUFFER, TUNE_MAX_SOCKET_BUFFER, true });
+}
+
+TunedParameter* TransferTuner::find(const string& name)
+{
+	for (TunedParameter& parameter : _parameters)
+	{
+		if (parameter.name == name)
+		{
+			return &parameter;
+		}
+	}
+	return nullptr;
+}
+
+/* a line is "HOST:PORT name=value ...", values out of range are left out */
+bool TransferTuner::load(const string& path)
+{
+	ifstream input(path);
+	if (!input)
+	{
+		return true;
+	}
+	string line;
+	while (getline(input, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		istringstream fields(line);
+		string endpoint, setting;
+		if (!(fields >> endpoint))
+		{
+			return false;
+		}
+		if (endpoint != _endpoint)
+		{
+			continue;
+		}
+		while (fields >> setting)
+		{
+			const size_t equals = setting.find('=');
+			if (equals == string::npos)
+			{
+				return false;
+			}
+			TunedParameter* parameter = find(setting.substr(0, equals));
+			if (parameter == nullptr)
+			{
+				continue;
+			}
+			try
+			{
+				const unsigned long long value = std::stoull(setting.substr(equals + 1));
+				if (value >= parameter->min && value <= parameter->max)
+				{
+					parameter->value = static_cast<size_t>(value);
+				}
+			}
+			catch (...)
+			{
+				return false;
+			}
+		}
+		LOG_INFO("tune.loaded", "endpoint=%s", _endpoint.c_str());
+	}
+	return true;
+}
+
+bool TransferTuner::save(const string& path) const
+{
+	map<string, string> settings;
+	ifstream input(path);
+	string line;
+	while (getline(input, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		const size_t space = line.find(' ');
+		if (space != string::npos)
+		{
+			settings[line.substr(0, space)] = line.substr(space + 1);
+		}
+	}
+	input.close();
+	ostringstream learned;
+	for (const TunedParameter& parameter : _parameters)
+	{
+		learned << parameter.name << '=' << parameter.value << ' ';
+	}
+	learned << "bytes_per_second=" << static_cast<uint64_t>(_best);
+	settings[_endpoint] = learned.str();
+
+	const string temporary = path + ".tmp";
+	{
+		ofstream output(temporary, ios::trunc);
+		for (const auto& setting : settings)
+		{
+			output << setting.first << ' ' << setting.second << '\n';
+		}
+		if (!output.flush())
+		{
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void TransferTuner::apply(ClientOptions& options) const
+{
+	for (const TunedParameter& parameter : _parameters)
+	{
+		const string name = parameter.name;
+		if (name == "window")
+		{
+			options.window = static_cast<unsigned int>(parameter.value);
+		}
+		else if (name == "stripes")
+		{
+			options.stripes = static_cast<unsigned int>(parameter.value);
+		}
+		else if (name == "socket_buffer")
+		{
+			options.socketBuffer = parameter.value;
+		}
+	}
+}
+
+void TransferTuner::record(uint64_t bytes, bool stripable)
+{
+	_bytes += bytes;
+	if (stripable)
+	{
+		_stripable += bytes;
+	}
+}
+
+void TransferTuner::recordStages(const PipelineTimes& times)
+{
+	_stages.read += times.read;
+	_stages.transform += times.transform;
+	_stages.write += times.write;
+}
+
+/* an epoch without pipelined files, striped ones only, is taken as bound by the network */
+TransferTuner::Stage TransferTuner::bottleneck() const
+{
+	if (_stages.read > _stages.write && _stages.read >= _stages.transform)
+	{
+		return STAGE_READ;
+	}
+	if (_stages.transform > _stages.write)
+	{
+		return STAGE_TRANSFORM;
+	}
+	return STAGE_WRITE;
+}
+
+/* the next value of the parameter in the direction, false at its bound. a socket buffer at the
+system default starts from TUNE_FIRST_SOCKET_BUFFER */
+bool TransferTuner::step(TunedParameter& parameter, int direction) const
+{
+	size_t value = parameter.value;
+	if (value < parameter.min)
+	{
+		if (direction < 0)
+		{
+			return false;
+		}
+		value = std::max<size_t>(parameter.min, TUNE_FIRST_SOCKET_BUFFER);
+	}
+	else
+	{
+		value = direction > 0 ? std::min<size_t>(parameter.max, value * 2) : std::max<size_t>(parameter.min, value / 2);
+	}
+	if (value == parameter.value)
+	{
+		return false;
+	}
+	parameter.value = value;
+	return true;
+}
+
+/* step the current parameter, or the next one that can move and may pay off. stripes and a window above 1
+exclude each other, the one that does not take effect is not probed */
+bool TransferTuner::probe()
+{
+	const Stage bound = bottleneck();
+	const TunedParameter* window = find("window");
+	const TunedParameter* stripes = find("stripes");
+	const bool pipelined = window != nullptr && window->value > 1;
+	const bool striped = stripes != nullptr && stripes->value > 1;
+	for (size_t tries = 0; tries < 2 * _parameters.size(); tries++)
+	{
+		TunedParameter& parameter = _parameters[_current];
+		const bool useless = (parameter.network && bound != STAGE_WRITE) ||
+			(&parameter == stripes && (_stripable == 0 || pipelined)) || (&parameter == window && striped);
+		const size_t previous = parameter.value;
+		if (!useless && step(parameter, _direction))
+		{
+			_previous = previous;
+			_probing = true;
+			LOG_INFO("tune.probe", "endpoint=%s parameter=%s from=%zu to=%zu", _endpoint.c_str(), parameter.name, previous, parameter.value);
+			return true;
+		}
+		_misses++;
+		if (_direction > 0)
+		{
+			_direction = -1;
+		}
+		else
+		{
+			_direction = 1;
+			_current = (_current + 1) % _parameters.size();
+		}
+	}
+	_probing = false;
+	return false;
+}
+
+bool TransferTuner::sample()
+{
+	if (_bytes < TUNE_EPOCH_BYTES)
+	{
+		return false;
+	}
+	const auto now = std::chrono::steady_clock::now();
+	const double seconds = std::chrono::duration<double>(now - _start).count();
+	if (seconds < TUNE_EPOCH_SECONDS)
+	{
+		return false;
+	}
+	const double cpu = processCPUSeconds();
+	const double throughput = _bytes / seconds;
+	const double cpuPerByte = (cpu - _startCPU) / _bytes;
+	_epochs++;
+	LOG_INFO("tune.epoch", "endpoint=%s bytes=%llu bytes_per_second=%.0f cpu_ns_per_byte=%.2f bottleneck=%s read_ms=%llu transform_ms=%llu write_ms=%llu",
+		_endpoint.c_str(), static_cast<unsigned long long>(_bytes), throughput, cpuPerByte * 1e9, stageName(bottleneck()),
+		static_cast<unsigned long long>(_stages.read / 1000000), static_cast<unsigned long long>(_stages.transform / 1000000),
+		static_cast<unsigned long long>(_stages.write / 1000000));
+
+	bool changed = false;
+	if (_probing)
+	{
+		TunedParameter& parameter = _parameters[_current];
+		const bool faster = throughput > _best * (1 + TUNE_MIN_GAIN);
+		const bool cheaper = throughput >= _best * (1 - TUNE_MIN_GAIN) && cpuPerByte < _bestCPU * (1 - TUNE_MIN_GAIN);
+		if (faster || cheaper)
+		{
+			/* the step paid off, the next one goes the same way */
+			LOG_INFO("tune.kept", "endpoint=%s parameter=%s value=%zu bytes_per_second=%.0f", _endpoint.c_str(), parameter.name, parameter.value, throughput);
+			_best = throughput;
+			_bestCPU = cpuPerByte;
+			_kept++;
+			_misses = 0;
+			probe();
+		}
+		else
+		{
+			parameter.value = _previous;
+			_probing = false;
+			_misses++;
+			if (_direction > 0)
+			{
+				_direction = -1;
+			}
+			else
+			{
+				_direction = 1;
+				_current = (_current + 1) % _parameters.size();
+			}
+		}
+		changed = true;
+	}
+	else
+	{
+		/* the settings kept are measured again before every probe, the link may have changed meanwhile */
+		_best = throughput;
+		_bestCPU = cpuPerByte;
+		if (_misses >= 2 * _parameters.size() && ++_idle < TUNE_REPROBE_EPOCHS)
+		{
+			changed = false;
+		}
+		else
+		{
+			if (_misses >= 2 * _parameters.size())
+			{
+				_idle = 0;
+				_misses = 0;
+			}
+			changed = probe();
+		}
+	}
+
+	_bytes = 0;
+	_stripable = 0;
+	_stages = PipelineTimes();
+	_start = std::chrono::steady_clock::now();
+	_startCPU = processCPUSeconds();
+	return changed;
+}
+
+void TransferTuner::report() const
+{
+	ostringstream settings;
+	for (const TunedParameter& parameter : _parameters)
+	{
+		settings << ' ' << parameter.name << '=' << parameter.value;
+	}
+	LOG_INFO("tune.report", "endpoint=%s epochs=%llu kept=%llu bytes_per_second=%.0f%s", _endpoint.c_str(),
+		static_cast<unsigned long long>(_epochs), static_cast<unsigned long long>(_kept), _best, settings.str().c_str());
+}
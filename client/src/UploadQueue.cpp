@@ -0,0 +1,85 @@
+#include "UploadQueue.h"
+#include "UploadScheduler.h"
+#include <algorithm>
+
+UploadQueue::UploadQueue(size_t capacity, UploadScheduler* scheduler)
+	: _capacity(capacity), _closed(false), _batchStarted(false), _sequence(0), _scheduler(scheduler)
+{
+}
+
+UploadQueue::~UploadQueue()
+{
+}
+
+bool UploadQueue::push(const UploadJob& job)
+{
+	unique_lock<mutex> guard(_lock);
+	_notFull.wait(guard, [this]() { return _closed || _jobs.size() < _capacity; });
+	if (_closed)
+	{
+		return false;
+	}
+	_jobs.push_back(job);
+	_jobs.back().sequence = _sequence++;
+	if (_scheduler != nullptr)
+	{
+		_scheduler->classify(_jobs.back());
+		/* a heap keeps the job the scheduler wants next in front */
+		std::push_heap(_jobs.begin(), _jobs.end(), [this](const UploadJob& x, const UploadJob& y) { return _scheduler->before(y, x); });
+	}
+	_notEmpty.notify_one();
+	return true;
+}
+
+/* an ordered queue waits for its first batch to be complete, after that it hands out the best job it holds */
+bool UploadQueue::ready() const
+{
+	if (_closed || _scheduler == nullptr || !_scheduler->options().ordered() || _batchStarted)
+	{
+		return !_jobs.empty() || _closed;
+	}
+	return _jobs.size() >= _capacity;
+}
+
+bool UploadQueue::pop(UploadJob& job)
+{
+	unique_lock<mutex> guard(_lock);
+	const chrono::steady_clock::time_point waitStart = chrono::steady_clock::now();
+	_notEmpty.wait(guard, [this]() { return ready(); });
+	if (_jobs.empty())
+	{
+		return false;
+	}
+	if (_scheduler != nullptr)
+	{
+		_scheduler->idle(chrono::steady_clock::now() - waitStart);
+		std::pop_heap(_jobs.begin(), _jobs.end(), [this](const UploadJob& x, const UploadJob& y) { return _scheduler->before(y, x); });
+		_batchStarted = true;
+		job = _jobs.back();
+		_jobs.pop_back();
+	}
+	else
+	{
+		job = _jobs.front();
+		_jobs.pop_front();
+	}
+	_notFull.notify_one();
+	return true;
+}
+
+/* no more jobs will be pushed, pop drains what is left */
+void UploadQueue::close()
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_closed = true;
+	}
+	_notEmpty.notify_all();
+	_notFull.notify_all();
+}
+
+size_t UploadQueue::size()
+{
+	lock_guard<mutex> guard(_lock);
+	return _jobs.size();
+}
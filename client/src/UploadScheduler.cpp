@@ -0,0 +1,193 @@
+#include "UploadScheduler.h"
+#include "UploadQueue.h"
+#include "DirectoryScanner.h"
+#include "Logger.h"
+#include <limits>
+
+bool ScheduleOptions::ordered() const
+{
+	return policy != SCHEDULE_FIFO || !priorities.empty();
+}
+
+bool ScheduleOptions::parsePolicy(const string& value, SchedulePolicy& policy)
+{
+	if (value == "fifo")
+		policy = SCHEDULE_FIFO;
+	else if (value == "smallest")
+		policy = SCHEDULE_SMALLEST;
+	else if (value == "largest")
+		policy = SCHEDULE_LARGEST;
+	else if (value == "deadline")
+		policy = SCHEDULE_DEADLINE;
+	else
+		return false;
+	return true;
+}
+
+/* parse SECONDS:PATTERN */
+bool ScheduleOptions::parseDeadline(const string& value, FileDeadline& deadline)
+{
+	const size_t colon = value.find(':');
+	if (colon == string::npos || colon == 0 || colon + 1 == value.size())
+	{
+		return false;
+	}
+	try
+	{
+		size_t pos = 0;
+		const string seconds = value.substr(0, colon);
+		deadline.seconds = std::stoull(seconds, &pos);
+		if (pos != seconds.size())
+		{
+			return false;
+		}
+	}
+	catch (...)
+	{
+		return false;
+	}
+	deadline.pattern = value.substr(colon + 1);
+	return true;
+}
+
+UploadScheduler::UploadScheduler(const ScheduleOptions& options)
+	: _options(options), _start(chrono::steady_clock::now()), _dispatched(false), _idle(chrono::steady_clock::duration::zero()),
+	_tailIdle(chrono::steady_clock::duration::zero()), _files(0), _failed(0), _missed(0), _classFinish(options.priorities.size() + 1, 0)
+{
+}
+
+UploadScheduler::~UploadScheduler()
+{
+}
+
+const ScheduleOptions& UploadScheduler::options() const
+{
+	return _options;
+}
+
+/* the first matching pattern decides, a file without a deadline keeps 0 */
+void UploadScheduler::classify(UploadJob& job) const
+{
+	job.priority = static_cast<uint32_t>(_options.priorities.size());
+	for (size_t i = 0; i < _options.priorities.size(); i++)
+	{
+		if (DirectoryScanner::matchesPath(_options.priorities[i], job.name))
+		{
+			job.priority = static_cast<uint32_t>(i);
+			break;
+		}
+	}
+	job.deadline = 0;
+	for (const FileDeadline& deadline : _options.deadlines)
+	{
+		if (DirectoryScanner::matchesPath(deadline.pattern, job.name))
+		{
+			job.deadline = deadline.seconds * 1000;
+			break;
+		}
+	}
+}
+
+bool UploadScheduler::before(const UploadJob& first, const UploadJob& second) const
+{
+	if (first.priority != second.priority)
+	{
+		return first.priority < second.priority;
+	}
+	switch (_options.policy)
+	{
+	case SCHEDULE_SMALLEST:
+		if (first.size != second.size)
+			return first.size < second.size;
+		break;
+	case SCHEDULE_LARGEST:
+		if (first.size != second.size)
+			return first.size > second.size;
+		break;
+	case SCHEDULE_DEADLINE:
+	{
+		const uint64_t firstDeadline = first.deadline == 0 ? numeric_limits<uint64_t>::max() : first.deadline;
+		const uint64_t secondDeadline = second.deadline == 0 ? numeric_limits<uint64_t>::max() : second.deadline;
+		if (firstDeadline != secondDeadline)
+			return firstDeadline < secondDeadline;
+		/* among the same deadline the small files are done first */
+		if (first.size != second.size)
+			return first.size < second.size;
+		break;
+	}
+	default:
+		break;
+	}
+	return first.sequence < second.sequence;
+}
+
+void UploadScheduler::dispatched()
+{
+	if (!_dispatched)
+	{
+		_dispatched = true;
+		_firstDispatch = chrono::steady_clock::now();
+		_lastFinish = _firstDispatch;
+	}
+}
+
+/* the upload loop waited for the queue - the scan was behind or an ordered queue was still collecting its batch */
+void UploadScheduler::idle(chrono::steady_clock::duration waited)
+{
+	if (_dispatched)
+	{
+		_idle += waited;
+	}
+}
+
+/* a connection had nothing left to send while the batch was not done - striped streams that ran out of ranges
+and the session connection waiting for the last acknowledgements of the window */
+void UploadScheduler::tailIdle(chrono::steady_clock::duration waited)
+{
+	_tailIdle += waited;
+}
+
+void UploadScheduler::finished(const UploadJob& job, bool stored)
+{
+	const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	_lastFinish = now;
+	_files++;
+	if (!stored)
+	{
+		_failed++;
+	}
+	if (job.deadline != 0 && milliseconds(now - _start) > job.deadline)
+	{
+		_missed++;
+		LOG_WARN("schedule.deadline_missed", "name=\"%s\" deadline_ms=%llu late_ms=%llu", job.name.c_str(),
+			static_cast<unsigned long long>(job.deadline), static_cast<unsigned long long>(milliseconds(now - _start) - job.deadline));
+	}
+	if (job.priority < _classFinish.size())
+	{
+		_classFinish[job.priority] = milliseconds(now - _firstDispatch);
+	}
+}
+
+void UploadScheduler::report()
+{
+	if (!_dispatched)
+	{
+		return;
+	}
+	static const char* const POLICY_NAMES[] = { "fifo", "smallest", "largest", "deadline" };
+	const uint64_t makespan = milliseconds(_lastFinish - _firstDispatch);
+	LOG_INFO("schedule.report", "policy=%s files=%llu failed=%llu makespan_ms=%llu idle_ms=%llu tail_idle_ms=%llu deadline_missed=%llu",
+		POLICY_NAMES[_options.policy], static_cast<unsigned long long>(_files), static_cast<unsigned long long>(_failed),
+		static_cast<unsigned long long>(makespan), static_cast<unsigned long long>(milliseconds(_idle)),
+		static_cast<unsigned long long>(milliseconds(_tailIdle)), static_cast<unsigned long long>(_missed));
+	for (size_t i = 0; _options.priorities.size() > 0 && i < _classFinish.size(); i++)
+	{
+		LOG_INFO("schedule.class", "class=%zu pattern=\"%s\" finished_ms=%llu", i,
+			i < _options.priorities.size() ? _options.priorities[i].c_str() : "*", static_cast<unsigned long long>(_classFinish[i]));
+	}
+}
+
+uint64_t UploadScheduler::milliseconds(chrono::steady_clock::duration duration)
+{
+	return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(duration).count());
+}
@@ -1,61 +1,147 @@
-#include "Utils.h"
-#include <boost/algorithm/hex.hpp>
-
-/*  convert to unhex representation */
-string Utils::reverse_hexi(const string& hexString)
-{
-	try
-	{
-		std::string byteString;
-		boost::algorithm::unhex(hexString, std::back_inserter(byteString));
-		return byteString;
-	}
-	catch (...)
-	{
-		return "";
-	}
-}
-
-/*  convert to hexedecimal representation */
-string Utils::hexi(const uint8_t* buffer, const size_t size)
-{
-	if (size == 0 || buffer == nullptr)
-		return "";
-	const std::string byteString(buffer, buffer + size);
-	if (byteString.empty())
-		return "";
-	try
-	{
-		return boost::algorithm::hex(byteString);
-	}
-	catch (...)
-	{
-		return "";
-	}
-}
-
-/* base64 encoder */
-std::string Utils::encode(const std::string& str)
-{
-	std::string encoded;
-	CryptoPP::StringSource ss(str, true,
-		new CryptoPP::Base64Encoder(
-			new CryptoPP::StringSink(encoded)
-		) // Base64Encoder
-	); // StringSource
-
-	return encoded;
-}
-
-/* base64 decoder */
-std::string Utils::decode(const std::string& str)
-{
-	std::string decoded;
-	CryptoPP::StringSource ss(str, true,
-		new CryptoPP::Base64Decoder(
-			new CryptoPP::StringSink(decoded)
-		) // Base64Decoder
-	); // StringSource
-
-	return decoded;
-}
+#include "Utils.h"
+#include <boost/algorithm/hex.hpp>
+#include <boost/crc.hpp>
+
+/*  convert to unhex representation */
+string Utils::reverse_hexi(const string& hexString)
+{
+	try
+	{
+		std::string byteString;
+		boost::algorithm::unhex(hexString, std::back_inserter(byteString));
+		return byteString;
+	}
+	catch (...)
+	{
+		return "";
+	}
+}
+
+/*  convert to hexedecimal representation */
+string Utils::hexi(const uint8_t* buffer, const size_t size)
+{
+	if (size == 0 || buffer == nullptr)
+		return "";
+	const std::string byteString(buffer, buffer + size);
+	if (byteString.empty())
+		return "";
+	try
+	{
+		return boost::algorithm::hex(byteString);
+	}
+	catch (...)
+	{
+		return "";
+	}
+}
+
+/* base64 encoder */
+std::string Utils::encode(const std::string& str)
+{
+	std::string encoded;
+	CryptoPP::StringSource ss(str, true,
+		new CryptoPP::Base64Encoder(
+			new CryptoPP::StringSink(encoded)
+		) // Base64Encoder
+	); // StringSource
+
+	return encoded;
+}
+
+/* base64 decoder */
+std::string Utils::decode(const std::string& str)
+{
+	std::string decoded;
+	CryptoPP::StringSource ss(str, true,
+		new CryptoPP::Base64Decoder(
+			new CryptoPP::StringSink(decoded)
+		) // Base64Decoder
+	); // StringSource
+
+	return decoded;
+}
+
+
+/* CRC-32 of A+B from crc(A) and the bytes of B, what zlib.crc32(B, crc) gives - a CKsum is continued over the
+buffers of a transfer as they pass by, nothing is collected. boost keeps the running register bit reflected */
+uint32_t Utils::crc32Update(uint32_t crc, ConstByteSpan data)
+{
+	uint32_t reflected = 0;
+	uint32_t bits = ~crc;
+	for (int i = 0; i < 32; i++, bits >>= 1)
+	{
+		reflected = (reflected << 1) | (bits & 1);
+	}
+	boost::crc_32_type crc_calculator(reflected);
+	crc_calculator.process_bytes(data.data(), data.size());
+	return crc_calculator.checksum();
+}
+
+/* CRC-32 (the polynomial boost::crc_32_type and zlib use) of len zero bytes is a linear operator on the CRC register,
+kept as a 32x32 matrix over GF(2). squaring it doubles the number of zero bytes it stands for */
+static uint32_t gf2MatrixTimes(const uint32_t* matrix, uint32_t vector)
+{
+	uint32_t sum = 0;
+	while (vector)
+	{
+		if (vector & 1)
+			sum ^= *matrix;
+		vector >>= 1;
+		matrix++;
+	}
+	return sum;
+}
+
+static void gf2MatrixSquare(uint32_t* square, const uint32_t* matrix)
+{
+	for (int n = 0; n < 32; n++)
+		square[n] = gf2MatrixTimes(matrix, matrix[n]);
+}
+
+/* apply the operator of len zero bytes to the CRC register */
+static uint32_t crc32Shift(uint32_t crc, uint64_t len)
+{
+	uint32_t even[32];
+	uint32_t odd[32];
+	if (len == 0)
+		return crc;
+
+	/* operator for one zero bit */
+	odd[0] = 0xedb88320UL;
+	uint32_t row = 1;
+	for (int n = 1; n < 32; n++)
+	{
+		odd[n] = row;
+		row <<= 1;
+	}
+	gf2MatrixSquare(even, odd);  // two zero bits
+	gf2MatrixSquare(odd, even);  // four zero bits
+
+	/* apply len zero bytes, first square gives the operator for one zero byte */
+	do
+	{
+		gf2MatrixSquare(even, odd);
+		if (len & 1)
+			crc = gf2MatrixTimes(even, crc);
+		len >>= 1;
+		if (len == 0)
+			break;
+		gf2MatrixSquare(odd, even);
+		if (len & 1)
+			crc = gf2MatrixTimes(odd, crc);
+		len >>= 1;
+	} while (len != 0);
+	return crc;
+}
+
+/* CRC-32 of the concatenation A+B from crc(A), crc(B) and the length of B - lets parts of a file be checksummed separately */
+uint32_t Utils::crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+	return crc32Shift(crc1, len2) ^ crc2;
+}
+
+/* CRC-32 of A followed by zeros zero bytes from crc(A), without touching the zeros */
+uint32_t Utils::crc32ZeroExtend(uint32_t crc, uint64_t zeros)
+{
+	return ~crc32Shift(~crc, zeros);
+}
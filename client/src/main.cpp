@@ -1,19 +1,67 @@
-#include "ClientLogic.h"
-#include <iostream>
-
-/* creating an instance of client class and call to clientMain method to run the client in batch mode */
-int main()
-{
-	try
-	{
-		ClientLogic client;
-		client.clientMain();
-		cout << "Communication with the server was successful. The file has been transferred to the server for backup." << endl;
-		return 0;
-	}
-	catch (const std::exception& e)
-	{
-		cout << e.what() << endl;
-		exit(1);
-	}
-}
+#include "ClientLogic.h"
+#include "Tracer.h"
+#include <iostream>
+
+/* creating an instance of client class and call to clientMain method to run the client in batch mode */
+int main(int argc, char* argv[])
+{
+	/* start the logger before any phase is measured, its ring is allocated once */
+	Logger::instance();
+	try
+	{
+		ClientOptions options;
+		string error;
+		if (!options.parse(argc, argv, error))
+		{
+			cout << error << endl;
+			return 1;
+		}
+		if (!options.trace.empty())
+		{
+			Tracer::instance().enable(options.trace);
+			Tracer::instance().nameThread("main");
+		}
+		ClientLogic client(options);
+		if (options.load.clients > 0)
+		{
+			client.clientLoad();
+			Logger::instance().flush();
+		Tracer::instance().write();
+			cout << "The load run has finished, its report is in the client log." << endl;
+			return 0;
+		}
+		if (options.restore)
+		{
+			client.clientRestore();
+			Logger::instance().flush();
+		Tracer::instance().write();
+			if (AllocationTracker::limitExceeded())
+			{
+				return 1;
+			}
+			cout << "Communication with the server was successful. The files have been restored to " << options.restoreDirectory << "." << endl;
+			return 0;
+		}
+		const bool complete = client.clientMain();
+		Logger::instance().flush();
+		Tracer::instance().write();
+		if (AllocationTracker::limitExceeded())
+		{
+			return 1;
+		}
+		if (!complete)
+		{
+			cout << "The backup is incomplete, some files were not stored. The client log lists them." << endl;
+			return 1;
+		}
+		cout << "Communication with the server was successful. The file has been transferred to the server for backup." << endl;
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		Logger::instance().flush();
+		Tracer::instance().write();
+		cout << e.what() << endl;
+		exit(1);
+	}
+}
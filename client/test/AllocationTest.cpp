@@ -0,0 +1,208 @@
+#include "ClientLogic.h"
+#include "AESWrapper.h"
+#include "AllocationTracker.h"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+/* allocation regression test of the upload path. every case writes an N byte file, streams it through
+ClientLogic::streamFileContent to a socket of this process under the limits of a file upload, and encrypts
+N bytes chunk by chunk through AESWrapper. the scopes only see the calling thread, so the upload is also
+measured across the process to count the pipeline stages. a case that goes over FILE_UPLOAD_MAX_ALLOCATIONS or
+FILE_UPLOAD_MAX_BYTES, or that allocates more for a larger file, fails the test - a change that copies the file
+content or allocates per chunk makes the program exit with 1. it needs the tracking build (TRACK_ALLOCATIONS),
+the project runs it after every build */
+
+constexpr auto TEST_FILE = "allocation_test.bin";
+constexpr auto TEST_KEY = "0123456789abcdef";
+
+/* the sizes of the cases, smallest first. the files of the pipeline are compared with each other, the
+smaller ones stream on the calling thread and are compared with each other */
+static const uint64_t TEST_SIZES[] = { 1000, CHUNK_SIZE + 1, PIPELINE_MIN_SIZE, 64 * CHUNK_SIZE, 256 * CHUNK_SIZE };
+
+/* accepts one connection and reads it to the end, the bytes received are the ones the upload sent */
+class SocketSink
+{
+public:
+	SocketSink() : _acceptor(_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)), _socket(_context),
+		_buffer(CHUNK_SIZE), _accepted(false), _received(0)
+	{
+		/* everything is allocated up front, the thread only reads while the upload is measured */
+		_thread = thread([this]()
+			{
+				boost::system::error_code error;
+				_acceptor.accept(_socket, error);
+				_accepted = true;
+				while (!error)
+				{
+					_received += _socket.read_some(boost::asio::buffer(_buffer), error);
+				}
+			});
+	}
+	string port() const { return to_string(_acceptor.local_endpoint().port()); }
+	void waitAccepted() const { while (!_accepted) std::this_thread::yield(); }
+	uint64_t wait() { _thread.join(); return _received; }
+private:
+	io_context _context;
+	tcp::acceptor _acceptor;
+	tcp::socket _socket;
+	vector<uint8_t> _buffer;
+	thread _thread;
+	atomic<bool> _accepted;
+	uint64_t _received;
+};
+
+struct CaseResult
+{
+	uint64_t allocations;
+	uint64_t bytes;
+	uint64_t processAllocations;    // the allocations of every thread, the pipeline stages included
+	uint64_t processBytes;
+};
+
+class AllocationTest
+{
+public:
+	static bool writeFile(uint64_t size);
+	static bool streamFile(uint64_t size, CaseResult& result);
+	static bool encryptChunks(uint64_t size, CaseResult& result);
+	static bool sameCost(const char* name, const CaseResult* results, size_t first, size_t last);
+};
+
+bool AllocationTest::writeFile(uint64_t size)
+{
+	ofstream file(TEST_FILE, ios::binary | ios::trunc);
+	vector<char> chunk(CHUNK_SIZE);
+	for (size_t i = 0; i < chunk.size(); i++)
+	{
+		chunk[i] = static_cast<char>(i * 31);
+	}
+	for (uint64_t left = size; left > 0;)
+	{
+		const size_t length = static_cast<size_t>(std::min<uint64_t>(left, CHUNK_SIZE));
+		file.write(chunk.data(), length);
+		left -= length;
+	}
+	return static_cast<bool>(file.flush());
+}
+
+/* the file content as a file upload sends it after the request header */
+bool AllocationTest::streamFile(uint64_t size, CaseResult& result)
+{
+	SocketSink sink;
+	const uint32_t contentSize = static_cast<uint32_t>((size / AES_BLOCK_SIZE + 1) * AES_BLOCK_SIZE);
+	bool streamed;
+	{
+		ClientLogic client;
+		client._filePath = TEST_FILE;
+		client._fileSize = size;
+		client._AESKey = TEST_KEY;
+		if (!client._socket->initializeSocketInfo("127.0.0.1", sink.port()) || !client._socket->connectToServer())
+		{
+			cerr << "cannot connect the sink" << endl;
+			return false;
+		}
+		sink.waitAccepted();
+		const uint64_t processAllocations = AllocationTracker::processAllocations();
+		const uint64_t processBytes = AllocationTracker::processBytes();
+		AllocationScope scope("file upload", FILE_UPLOAD_MAX_ALLOCATIONS, FILE_UPLOAD_MAX_BYTES);
+		streamed = client.streamFileContent(contentSize);
+		result.allocations = scope.allocations();
+		result.bytes = scope.bytes();
+		result.processAllocations = AllocationTracker::processAllocations() - processAllocations;
+		result.processBytes = AllocationTracker::processBytes() - processBytes;
+	}
+	const uint64_t received = sink.wait();
+	if (!streamed || received != contentSize)
+	{
+		cerr << "file of " << size << " bytes: sent " << received << " of " << contentSize << " bytes" << endl;
+		return false;
+	}
+	if (result.processAllocations > FILE_UPLOAD_MAX_ALLOCATIONS || result.processBytes > FILE_UPLOAD_MAX_BYTES)
+	{
+		cerr << "file of " << size << " bytes: " << result.processAllocations << " allocations, " << result.processBytes
+			<< " bytes across the threads of the upload, over the limits of a file upload" << endl;
+		return false;
+	}
+	return true;
+}
+
+/* the transform stage alone, every chunk encrypted in place like the pipeline does */
+bool AllocationTest::encryptChunks(uint64_t size, CaseResult& result)
+{
+	vector<uint8_t> chunk(CHUNK_SIZE + AES_BLOCK_SIZE);
+	AllocationScope scope("chunk encryption", FILE_UPLOAD_MAX_ALLOCATIONS, FILE_UPLOAD_MAX_BYTES);
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(TEST_KEY), AESWrapper::DEFAULT_KEYLENGTH);
+	for (uint64_t left = size; left > 0;)
+	{
+		const size_t length = static_cast<size_t>(std::min<uint64_t>(left, CHUNK_SIZE));
+		left -= length;
+		aes.encryptChunk(ConstByteSpan(chunk.data(), length), ByteSpan(chunk.data(), chunk.size()), left == 0);
+	}
+	result.allocations = scope.allocations();
+	result.bytes = scope.bytes();
+	result.processAllocations = result.allocations;
+	result.processBytes = result.bytes;
+	return true;
+}
+
+/* the cases from first to last must cost what the smallest of them costs */
+bool AllocationTest::sameCost(const char* name, const CaseResult* results, size_t first, size_t last)
+{
+	bool same = true;
+	for (size_t i = first + 1; i <= last; i++)
+	{
+		if (results[i].processAllocations > results[first].processAllocations || results[i].processBytes > results[first].processBytes)
+		{
+			cerr << name << " of " << TEST_SIZES[i] << " bytes: " << results[i].processAllocations << " allocations, " << results[i].processBytes
+				<< " bytes, more than the " << results[first].processAllocations << " allocations, " << results[first].processBytes << " bytes of "
+				<< TEST_SIZES[first] << " bytes" << endl;
+			same = false;
+		}
+	}
+	return same;
+}
+
+int main()
+{
+	Logger::instance();
+	if (!AllocationTracker::enabled())
+	{
+		cerr << "build the test with TRACK_ALLOCATIONS defined" << endl;
+		return 1;
+	}
+	const size_t cases = sizeof(TEST_SIZES) / sizeof(TEST_SIZES[0]);
+	CaseResult uploads[cases];
+	CaseResult encryptions[cases];
+	bool passed = true;
+	for (size_t i = 0; i < cases; i++)
+	{
+		if (!AllocationTest::writeFile(TEST_SIZES[i]))
+		{
+			cerr << "cannot write " << TEST_FILE << endl;
+			return 1;
+		}
+		passed = AllocationTest::streamFile(TEST_SIZES[i], uploads[i]) && passed;
+		passed = AllocationTest::encryptChunks(TEST_SIZES[i], encryptions[i]) && passed;
+		cout << TEST_SIZES[i] << " bytes: upload " << uploads[i].allocations << " allocations " << uploads[i].bytes << " bytes ("
+			<< uploads[i].processAllocations << " allocations " << uploads[i].processBytes << " bytes on all threads), encryption "
+			<< encryptions[i].allocations << " allocations " << encryptions[i].bytes << " bytes" << endl;
+	}
+	std::remove(TEST_FILE);
+
+	size_t pipelined = 0;
+	while (pipelined < cases && TEST_SIZES[pipelined] < PIPELINE_MIN_SIZE)
+	{
+		pipelined++;
+	}
+	passed = AllocationTest::sameCost("upload", uploads, 0, pipelined - 1) && passed;
+	passed = AllocationTest::sameCost("upload", uploads, pipelined, cases - 1) && passed;
+	passed = AllocationTest::sameCost("encryption", encryptions, 0, cases - 1) && passed;
+	passed = !AllocationTracker::limitExceeded() && passed;
+	Logger::instance().flush();
+	cout << (passed ? "allocation test passed" : "allocation test FAILED") << endl;
+	return passed ? 0 : 1;
+}
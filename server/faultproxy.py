@@ -0,0 +1,421 @@
+""" fault injecting TCP proxy between the backup client and a local server.
+
+every connection of the client is forwarded to the server through a link that can add latency, jitter, a rate
+limit, retransmission delays of lost segments, outages, a slow reading server, cut responses and bursts of
+GENERIC_ERROR responses. with --run the client command is started once per scenario against the proxy and its
+run time, throughput and the time it needed to make progress again after every fault are reported.
+
+    python faultproxy.py --server 127.0.0.1:1234 --listen 127.0.0.1:1235 --scenario wan
+    python faultproxy.py --server 127.0.0.1:1234 --scenario all --transfer-info ../client/Debug/transfer.info --run "client.exe"
+"""
+import argparse
+import queue
+import random
+import shlex
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+import protocol
+
+PACKET_SIZE = 2048  # every server response is padded to one packet, longer ones carry their payload size
+CHUNK_SIZE = 64 * 1024  # bytes read from a socket at once
+RATE_SLICE = 16 * 1024  # a rate limited chunk is sent in slices of this size so the link stays smooth
+RETRANSMISSION_TIMEOUT = 0.2  # a lost segment is seen by the application as this much more latency
+SLOW_READER_BUFFER = 8 * 1024  # receive buffer of the proxy side of a slow reader, the client soon blocks on it
+DEFAULT_RUN_TIMEOUT = 300  # seconds a client run may take before it is reported as hung
+
+
+class Scenario:
+    """ the faults of a link. times are in seconds, rates in bytes per second, 0 turns a fault off """
+
+    FIELDS = ('delay', 'jitter', 'rate', 'loss', 'outageEvery', 'outageFor', 'readerRate', 'truncateResponse',
+              'truncateAt', 'errorFrom', 'errorCount')
+
+    def __init__(self, name, **faults):
+        self.name = name
+        self.delay = 0.0  # one way latency added to both directions
+        self.jitter = 0.0  # the latency varies by up to this much, the byte order is kept
+        self.rate = 0  # bandwidth cap of each direction
+        self.loss = 0.0  # share of the chunks that are delayed by a retransmission
+        self.outageEvery = 0  # the link goes down after every this many bytes sent by the client
+        self.outageFor = 0.0  # and nothing moves in either direction for this long
+        self.readerRate = 0  # the server reads the client bytes this slowly
+        self.truncateResponse = 0  # this response of the run (1 is the first) is cut and the connection closed
+        self.truncateAt = 0  # bytes of the cut response that still get through
+        self.errorFrom = 0  # this response and the ones after it are replaced by GENERIC_ERROR
+        self.errorCount = 0
+        for field, value in faults.items():
+            if field not in Scenario.FIELDS:
+                raise ValueError(f"unknown fault {field}")
+            setattr(self, field, value)
+
+    def describe(self):
+        faults = [f"{field}={getattr(self, field)}" for field in Scenario.FIELDS if getattr(self, field)]
+        return ' '.join(faults) if faults else 'no faults'
+
+
+SCENARIOS = [
+    Scenario('baseline'),
+    Scenario('wan', delay=0.04, jitter=0.01),
+    Scenario('lossy', delay=0.02, loss=0.01),
+    Scenario('capped', rate=1024 * 1024),
+    Scenario('outages', outageEvery=8 * 1024 * 1024, outageFor=5.0),
+    Scenario('dead-link', outageEvery=1024 * 1024, outageFor=60.0),  # longer than the 25s read timeout of the client
+    Scenario('slow-reader', readerRate=256 * 1024),
+    Scenario('truncated', truncateResponse=3, truncateAt=100),
+    Scenario('error-burst', errorFrom=3, errorCount=3),
+]
+
+
+class Statistics:
+    """ what went through the proxy during one run, shared by the connections """
+
+    def __init__(self, verbose):
+        self.verbose = verbose  # print every fault as it is injected
+        self.lock = threading.Lock()
+        self.start = time.monotonic()
+        self.connections = 0
+        self.uploaded = 0  # bytes client to server
+        self.downloaded = 0  # bytes server to client
+        self.responses = 0  # server responses seen, counted over all connections
+        self.serverErrors = 0  # GENERIC_ERROR responses the server sent itself
+        self.lost = 0
+        self.faults = []  # (time, kind) of every fault injected
+        self.recoveries = []  # seconds from a fault to the next response that went through untouched
+        self.pending = []  # faults still waiting for that response
+
+    def fault(self, kind):
+        with self.lock:
+            now = time.monotonic()
+            self.faults.append((now - self.start, kind))
+            self.pending.append(now)
+        if self.verbose:
+            print(f"fault {kind} at {now - self.start:.3f}s")
+
+    def nextResponse(self):
+        with self.lock:
+            self.responses += 1
+            return self.responses
+
+    def progress(self):
+        """ a clean response reached the client, every fault before it is recovered from """
+        with self.lock:
+            now = time.monotonic()
+            self.recoveries.extend(now - faultTime for faultTime in self.pending)
+            self.pending = []
+
+    def add(self, field, count):
+        with self.lock:
+            setattr(self, field, getattr(self, field) + count)
+
+
+class RateLimit:
+    """ token bucket of one direction """
+
+    def __init__(self, rate):
+        self.rate = rate
+        self.nextFree = time.monotonic()
+
+    def wait(self, length):
+        if self.rate <= 0:
+            return
+        now = time.monotonic()
+        start = max(self.nextFree, now)
+        self.nextFree = start + length / self.rate
+        if start > now:
+            time.sleep(start - now)
+
+
+class Link:
+    """ one client connection and its connection to the server. each direction has a reader thread, which
+    stamps every chunk with the time it may be delivered, and a writer thread, which delivers it no earlier and
+    no faster than the scenario allows """
+
+    def __init__(self, client, server, scenario, statistics):
+        self.client = client
+        self.server = server
+        self.scenario = scenario
+        self.statistics = statistics
+        self.closed = threading.Event()
+        self.pausedUntil = 0.0  # an outage holds both directions until then
+        self.sinceOutage = 0
+        self.random = random.Random()
+
+    def start(self):
+        if self.scenario.readerRate:
+            self.client.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, SLOW_READER_BUFFER)
+        upload = queue.Queue()
+        download = queue.Queue()
+        threads = [threading.Thread(target=self.readUpload, args=(upload,)),
+                   threading.Thread(target=self.write, args=(upload, self.server, 'uploaded')),
+                   threading.Thread(target=self.readDownload, args=(download,)),
+                   threading.Thread(target=self.write, args=(download, self.client, 'downloaded'))]
+        for thread in threads:
+            thread.daemon = True
+            thread.start()
+
+    def close(self):
+        if self.closed.is_set():
+            return
+        self.closed.set()
+        for sock in (self.client, self.server):
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            sock.close()
+
+    def deliveryTime(self, last):
+        """ when a chunk read now may be delivered, never before the chunk read before it """
+        latency = self.scenario.delay
+        if self.scenario.jitter:
+            latency = max(0.0, latency + self.random.uniform(-self.scenario.jitter, self.scenario.jitter))
+        if self.scenario.loss and self.random.random() < self.scenario.loss:
+            self.statistics.add('lost', 1)
+            latency += RETRANSMISSION_TIMEOUT
+        return max(last, time.monotonic() + latency)
+
+    def readUpload(self, chunks):
+        """ the client bytes are forwarded as they come, a slow reader takes them at its own rate """
+        reader = RateLimit(self.scenario.readerRate)
+        last = 0.0
+        try:
+            while not self.closed.is_set():
+                data = self.client.recv(SLOW_READER_BUFFER if self.scenario.readerRate else CHUNK_SIZE)
+                if not data:
+                    break
+                reader.wait(len(data))
+                last = self.deliveryTime(last)
+                chunks.put((last, data, None))
+        except OSError:
+            pass
+        chunks.put(None)
+
+    def readExactly(self, length):
+        data = b''
+        while len(data) < length:
+            chunk = self.server.recv(length - len(data))
+            if not chunk:
+                return data
+            data += chunk
+        return data
+
+    def readDownload(self, chunks):
+        """ the server bytes are forwarded response by response, so a response can be cut or replaced whole """
+        last = 0.0
+        try:
+            while not self.closed.is_set():
+                response = self.readExactly(PACKET_SIZE)
+                if len(response) < protocol.HEADER_SIZE:
+                    break
+                version, code, payloadSize = struct.unpack("<BHL", response[:protocol.HEADER_SIZE])
+                if protocol.HEADER_SIZE + payloadSize > PACKET_SIZE:
+                    response += self.readExactly(protocol.HEADER_SIZE + payloadSize - PACKET_SIZE)
+                if code == protocol.EResponseCode.GENERIC_ERROR.value:
+                    self.statistics.add('serverErrors', 1)
+                number = self.statistics.nextResponse()
+                last = self.deliveryTime(last)
+                scenario = self.scenario
+                if number == scenario.truncateResponse:
+                    self.statistics.fault('truncated')
+                    chunks.put((last, response[:scenario.truncateAt], 'cut'))
+                    break
+                if scenario.errorCount and scenario.errorFrom <= number < scenario.errorFrom + scenario.errorCount:
+                    self.statistics.fault('error')
+                    error = protocol.ResponseHeader(protocol.EResponseCode.GENERIC_ERROR.value).pack()
+                    chunks.put((last, error + b'\x00' * (PACKET_SIZE - len(error)), 'injected'))
+                    continue
+                chunks.put((last, response, None))
+        except OSError:
+            pass
+        chunks.put(None)
+
+    def write(self, chunks, destination, counter):
+        """ deliver the chunks of one direction, a cut chunk closes the connection after it. a response that
+        reaches the client as the server sent it ends the recovery from the faults before it """
+        limit = RateLimit(self.scenario.rate)
+        upload = counter == 'uploaded'
+        try:
+            while True:
+                item = chunks.get()
+                if item is None:
+                    destination.shutdown(socket.SHUT_WR)
+                    break
+                deliverAt, data, fault = item
+                while True:
+                    wait = max(deliverAt, self.pausedUntil) - time.monotonic()
+                    if wait <= 0:
+                        break
+                    time.sleep(wait)
+                for offset in range(0, len(data), RATE_SLICE):
+                    piece = data[offset:offset + RATE_SLICE]
+                    limit.wait(len(piece))
+                    destination.sendall(piece)
+                self.statistics.add(counter, len(data))
+                if upload and self.scenario.outageEvery:
+                    self.sinceOutage += len(data)
+                    if self.sinceOutage >= self.scenario.outageEvery:
+                        self.sinceOutage = 0
+                        self.pausedUntil = time.monotonic() + self.scenario.outageFor
+                        self.statistics.fault('outage')
+                if fault == 'cut':
+                    self.close()
+                    break
+                if not upload and fault is None:
+                    self.statistics.progress()
+        except OSError:
+            self.close()
+
+
+class FaultProxy:
+    """ accepts the client connections and links each one to a new connection to the server """
+
+    def __init__(self, listen, server, scenario, verbose=False):
+        self.listen = listen
+        self.server = server
+        self.scenario = scenario
+        self.statistics = Statistics(verbose)
+        self.sock = None
+        self.links = []
+
+    def start(self):
+        self.sock = socket.socket()
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind(self.listen)
+        self.sock.listen(16)
+        thread = threading.Thread(target=self.accept)
+        thread.daemon = True
+        thread.start()
+        return self.sock.getsockname()
+
+    def accept(self):
+        while True:
+            try:
+                client, address = self.sock.accept()
+            except OSError:
+                return
+            try:
+                server = socket.create_connection(self.server)
+            except OSError as e:
+                print(f"proxy cannot connect the server: {e}")
+                client.close()
+                continue
+            for sock in (client, server):
+                sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self.statistics.add('connections', 1)
+            link = Link(client, server, self.scenario, self.statistics)
+            self.links.append(link)
+            link.start()
+
+    def stop(self):
+        self.sock.close()
+        for link in self.links:
+            link.close()
+
+
+def parseEndpoint(value):
+    """ HOST:PORT to an address tuple """
+    host, separator, port = value.rpartition(':')
+    if not separator:
+        raise argparse.ArgumentTypeError(f"{value} is not HOST:PORT")
+    return host or '127.0.0.1', int(port)
+
+
+def pointTransferInfo(path, endpoint):
+    """ point the first line of the client transfer.info at the proxy, returns the old content to put back """
+    with open(path, 'rb') as file:
+        content = file.read()
+    newline = b'\r\n' if b'\r\n' in content else b'\n'
+    lines = content.split(newline)
+    lines[0] = f"{endpoint[0]}:{endpoint[1]}".encode('utf-8')
+    with open(path, 'wb') as file:
+        file.write(newline.join(lines))
+    return content
+
+
+def runClient(command, timeout, cwd):
+    """ seconds the client ran and how it ended: ok, failed or hung """
+    start = time.monotonic()
+    try:
+        result = subprocess.run(shlex.split(command), cwd=cwd, timeout=timeout,
+                                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        outcome = 'ok' if result.returncode == 0 else f"failed({result.returncode})"
+    except subprocess.TimeoutExpired:
+        outcome = 'hung'
+    return time.monotonic() - start, outcome
+
+
+def report(scenario, statistics, seconds, outcome):
+    recoveries = statistics.recoveries
+    recovery = f"{sum(recoveries) / len(recoveries):.3f}/{max(recoveries):.3f}" if recoveries else '-'
+    unrecovered = len(statistics.pending)
+    print(f"{scenario.name:<12} {outcome:<11} {seconds:8.2f}s {statistics.uploaded / seconds / 1e6:9.2f} "
+          f"{statistics.connections:5} {len(statistics.faults):6} {unrecovered:11} {recovery:>15} "
+          f"{statistics.serverErrors:7} {statistics.lost:5}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="fault injecting proxy between the backup client and a local server")
+    parser.add_argument('--server', type=parseEndpoint, default=('127.0.0.1', 1234), help="HOST:PORT of the server")
+    parser.add_argument('--listen', type=parseEndpoint, default=('127.0.0.1', 0), help="HOST:PORT of the proxy, any free port by default")
+    parser.add_argument('--scenario', default='baseline', help="one of " + ', '.join(s.name for s in SCENARIOS) + " or all")
+    parser.add_argument('--run', help="client command to benchmark, started once per scenario after the proxy is up")
+    parser.add_argument('--cwd', help="directory the client command runs in")
+    parser.add_argument('--transfer-info', help="client transfer.info to point at the proxy during the runs, restored after")
+    parser.add_argument('--repeat', type=int, default=1, help="runs of every scenario")
+    parser.add_argument('--timeout', type=float, default=DEFAULT_RUN_TIMEOUT, help="seconds before a run counts as hung")
+    for field in Scenario.FIELDS:
+        parser.add_argument('--' + field, type=float, help="override the fault of the scenario")
+    arguments = parser.parse_args()
+
+    if arguments.scenario == 'all':
+        scenarios = SCENARIOS
+    else:
+        scenarios = [scenario for scenario in SCENARIOS if scenario.name == arguments.scenario]
+        if not scenarios:
+            parser.error(f"unknown scenario {arguments.scenario}")
+    for scenario in scenarios:
+        for field in Scenario.FIELDS:
+            value = getattr(arguments, field)
+            if value is not None:
+                setattr(scenario, field, type(getattr(scenario, field))(value))
+
+    if arguments.run is None:
+        # a proxy for manual runs, it serves until interrupted
+        if len(scenarios) != 1:
+            parser.error("--scenario all needs --run")
+        proxy = FaultProxy(arguments.listen, arguments.server, scenarios[0], True)
+        endpoint = proxy.start()
+        print(f"proxy {endpoint[0]}:{endpoint[1]} -> {arguments.server[0]}:{arguments.server[1]}, {scenarios[0].describe()}")
+        start = time.monotonic()
+        try:
+            while True:
+                time.sleep(1)
+        except KeyboardInterrupt:
+            proxy.stop()
+        report(scenarios[0], proxy.statistics, time.monotonic() - start, 'stopped')
+        return 0
+
+    print(f"{'scenario':<12} {'outcome':<11} {'time':>9} {'MB/s up':>9} {'conns':>5} {'faults':>6} "
+          f"{'unrecovered':>11} {'recovery avg/max':>15} {'errors':>7} {'lost':>5}")
+    for scenario in scenarios:
+        for _ in range(arguments.repeat):
+            proxy = FaultProxy(arguments.listen, arguments.server, scenario)
+            endpoint = proxy.start()
+            saved = pointTransferInfo(arguments.transfer_info, endpoint) if arguments.transfer_info else None
+            try:
+                seconds, outcome = runClient(arguments.run, arguments.timeout, arguments.cwd)
+            finally:
+                proxy.stop()
+                if saved is not None:
+                    with open(arguments.transfer_info, 'wb') as file:
+                        file.write(saved)
+            report(scenario, proxy.statistics, seconds, outcome)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -1,298 +1,787 @@
-import struct
-from enum import Enum
-
-# some important sizes
-SERVER_VERSION = 3
-DEFAULT_VAL = 0
-HEADER_SIZE = 7
-CLIENT_HEADER_SIZE = 23
-CLIENT_ID_SIZE = 16
-CLIENT_NAME_SIZE = 255
-PUBLIC_KEY_SIZE = 160
-AES_KEY_SIZE = 128
-FILE_CONTENT_SIZE = 4
-FILE_NAME_SIZE = 255
-MAX_PAYLOAD_SIZE = 0xFFFFFFFF
-EXCPECTED_CLIENT_PK_SIZE = 160
-PAYLOAD_SIZE_2103R_CODE = 279
-
-
-class ERequestCode(Enum):
-    REGISTRATION_REQUEST = 1100  # uuid ignored.
-    PUBLIC_KEY_REQUEST = 1101
-    RECONNECT_REQUEST = 1102
-    FILE_SEND_REQUEST = 1103
-    CRC_CHECKED_OK = 1104
-    RETRY_CRC_REQUEST = 1105
-    FAILED_CRC_REQUEST = 1106
-
-
-class EResponseCode(Enum):
-    RESPONSE_REGISTRATION_SUCCESSFUL = 2100
-    RESPONSE_REGISTRATION_UNSUCCESSFUL = 2101
-    PUBLIC_KEY_REQUEST_SUCCESSFUL = 2102
-    FILE_RECVIE_SEND_CRC = 2103
-    CONFIRMED_MESSAGE_THANKS = 2104
-    RECONNECT_REQUEST_SUCCESSFUL = 2105
-    RECONNECT_REQUEST_FAILED = 2106
-    GENERIC_ERROR = 2107
-
-
-class RequestHeader:
-    def __init__(self):
-        self.clientID = b""
-        self.version = DEFAULT_VAL      # 1 byte
-        self.code = DEFAULT_VAL         # 2 bytes
-        self.payloadSize = DEFAULT_VAL  # 4 bytes
-        self.SIZE = CLIENT_ID_SIZE + HEADER_SIZE
-
-    def unpack(self, data):
-        """ little endian unpack request Header """
-        try:
-            self.clientID = struct.unpack(f"<{CLIENT_ID_SIZE}s", data[:CLIENT_ID_SIZE])[0]
-            headerData = data[CLIENT_ID_SIZE:CLIENT_ID_SIZE + HEADER_SIZE]
-            self.version, self.code, self.payloadSize = struct.unpack("<BHL", headerData)
-            return self.validateHeader()
-            # return True
-        except:
-            self.__init__()  # reset values
-            return False
-
-    def validateHeader(self):
-        if self.version != SERVER_VERSION or self.payloadSize == 0:
-            return False
-        return True
-
-
-class ResponseHeader:
-    def __init__(self, code):
-        self.version = SERVER_VERSION
-        self.code = code
-        self.payloadSize = DEFAULT_VAL
-
-    def pack(self):
-        """ little endian response header pack """
-        try:
-            return struct.pack("<BHL", self.version, self.code, self.payloadSize)
-        except:
-            return b""
-
-
-class GenericErrorResponse:
-    def __init__(self):
-        self.header = ResponseHeader(EResponseCode.GENERIC_ERROR.value)
-
-    def pack(self):
-        """ little endian pack response header with error code"""
-        try:
-            data = self.header.pack()
-            return data
-        except:
-            return b""
-
-class ReconnectRequest:
-    def __init__(self):
-        self.header = RequestHeader()
-        self.name = b""
-
-    def unpack(self, data):
-        """ little endian unpack request header and client name """
-        if not self.header.unpack(data):
-            return False
-        try:
-            self.name = struct.unpack(f"<{FILE_NAME_SIZE}s", data[23:23 + FILE_NAME_SIZE])[0]
-            return True
-        except:
-            self.__init__()  # reset values
-            return False
-
-
-class CRCFailedRequest:
-    def __init__(self):
-        self.header = RequestHeader()
-        self.fileName = b""
-
-    def unpack(self, data):
-        """ little endian unpack request header and client file name """
-        if not self.header.unpack(data):
-            return False
-        try:
-            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[CLIENT_HEADER_SIZE:
-                                                                      CLIENT_HEADER_SIZE + FILE_NAME_SIZE])[0]
-            return True
-        except:
-            return b""
-
-
-class ValidateCRCRequest:
-    def __init__(self):
-        self.header = RequestHeader()
-        self.fileName = b""
-
-    def unpack(self, data):
-        """ little endian unpack request header and client file name """
-        if not self.header.unpack(data):
-            return False
-        try:
-            self.header.unpack(data)
-            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[CLIENT_HEADER_SIZE:
-                                                                      CLIENT_HEADER_SIZE + FILE_NAME_SIZE])[0]
-            return True
-        except:
-            return b""
-
-
-class ConfirmedMessageResponse:
-    def __init__(self):
-        self.header = ResponseHeader(EResponseCode.CONFIRMED_MESSAGE_THANKS.value)
-        self.clientID = b""
-
-    def pack(self):
-        """ little endian pack response header and client ID """
-        try:
-            data = self.header.pack()
-            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
-            return data
-        except:
-            return b""
-
-
-class ReconnectFailedResponse:
-    def __init__(self):
-        self.header = ResponseHeader(EResponseCode.RECONNECT_REQUEST_FAILED)
-        self.clientId = b""
-
-    def pack(self):
-        """ little endian pack response header and client ID """
-        try:
-            data = self.header.pack()
-            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientId)
-            return data
-        except:
-            return b""
-
-
-class FileSendRequest:
-    def __init__(self):
-        self.header = RequestHeader()
-        self.contentSize = b""
-        self.fileName = b""
-        self.fileContent = b""
-
-    def unpack(self, data):
-        """ little endian unpack request header and client file details """
-        if not self.header.unpack(data):
-            return False
-        try:
-            # self.header.unpack(data)
-            contentSizeData = data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + FILE_CONTENT_SIZE]
-            self.contentSize = struct.unpack("<L", contentSizeData)[0]
-            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[27:27 + FILE_NAME_SIZE])[0]
-            self.fileContent = struct.unpack(f"<{self.contentSize}s", data[27 + FILE_NAME_SIZE:
-                                                                           27 + FILE_NAME_SIZE + self.contentSize])[0]
-            return True
-        except:
-            return False
-
-
-class FileSendResponse:
-    def __init__(self):
-        self.header = ResponseHeader(EResponseCode.FILE_RECVIE_SEND_CRC.value)
-        self.clientID = b""
-        self.contentSize = b""
-        self.fileName = b""
-        self.Checksum = b""
-
-    def pack(self):
-        """ little endian pack response header and client file details """
-        try:
-            data = self.header.pack()
-            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
-            data += struct.pack("<L",  self.contentSize)
-            data += struct.pack(f"<{FILE_NAME_SIZE}s", self.fileName)
-            data += struct.pack("<L",  self.Checksum)
-            return data
-        except:
-            return b""
-
-
-class PublicKeyRequest:
-    def __init__(self):
-        self.header = RequestHeader()
-        self.name = b""
-        self.publicKey = b""
-
-    def unpack(self, data):
-        """ little endian unpack request header and client name and public key """
-        if not self.header.unpack(data):
-            return False
-        try:
-            nameData = data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + CLIENT_NAME_SIZE]
-            self.name = str(struct.unpack(f"<{CLIENT_NAME_SIZE}s", nameData)[0].partition(b'\0')[0].decode('utf-8'))
-            publicKeyData = data[
-                            CLIENT_HEADER_SIZE + CLIENT_NAME_SIZE:CLIENT_HEADER_SIZE + CLIENT_NAME_SIZE + PUBLIC_KEY_SIZE]
-            self.publicKey = struct.unpack(f"<{PUBLIC_KEY_SIZE}s", publicKeyData)[0]
-            return True
-        except:
-            return False
-
-
-class PublicKeyResponse:
-    def __init__(self):
-        self.header = ResponseHeader(EResponseCode.PUBLIC_KEY_REQUEST_SUCCESSFUL.value)
-        self.clientID = b""
-        self.AESEncryptedKey = b""
-
-    def pack(self):
-        """ little endian pack response header and client ID and encrypted AES key """
-        try:
-            self.header.payloadSize = len(self.AESEncryptedKey) + CLIENT_ID_SIZE
-            data = self.header.pack()
-            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
-            data += struct.pack(f"<{AES_KEY_SIZE}s", self.AESEncryptedKey)
-            return data
-        except:
-            return b""
-
-
-class RegistrationRequest:
-    def __init__(self):
-        self.header = RequestHeader()
-        self.name = b""
-
-    def unpack(self, data):
-        """ little endian unpack request header and client registration data """
-        if not self.header.unpack(data):
-            return False
-        try:
-
-            # trim the byte array after the nul terminating character.
-            nameData = data[self.header.SIZE:self.header.SIZE + CLIENT_NAME_SIZE]
-            self.name = str(struct.unpack(f"<{CLIENT_NAME_SIZE}s", nameData)[0].partition(b'\0')[0].decode('utf-8'))
-            return True
-        except:
-            return False
-
-
-class RegistrationResponse:
-    def __init__(self):
-        self.header = ResponseHeader(EResponseCode.RESPONSE_REGISTRATION_SUCCESSFUL.value)
-        self.clientID = b""
-
-    def pack(self):
-        """ little endian pack response Header and client ID """
-        try:
-            data = self.header.pack()
-            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
-            return data
-        except:
-            return b""
-
-    def registrationUnsuccessful(self):
-        """ in case that registration was failed """
-        self.header.code = EResponseCode.RESPONSE_REGISTRATION_UNSUCCESSFUL.value
-        try:
-            data = self.header.pack()
-            return data
-        except:
-            return b""
+import struct
+from enum import Enum
+
+# some important sizes
+SERVER_VERSION = 3
+DEFAULT_VAL = 0
+HEADER_SIZE = 7
+CLIENT_HEADER_SIZE = 23
+CLIENT_ID_SIZE = 16
+CLIENT_NAME_SIZE = 255
+PUBLIC_KEY_SIZE = 160
+AES_KEY_SIZE = 128
+FILE_CONTENT_SIZE = 4
+FILE_NAME_SIZE = 255
+MAX_PAYLOAD_SIZE = 0xFFFFFFFF
+EXCPECTED_CLIENT_PK_SIZE = 160
+PAYLOAD_SIZE_2103R_CODE = 279
+COUNT_SIZE = 4
+OFFSET_SIZE = 8
+LIST_PAGE_ENTRIES = 256
+MAX_RANGE_SIZE = 4 * 1024 * 1024
+PACK_MAX_MEMBERS = 1024
+PACK_INDEX_ENTRY_SIZE = FILE_NAME_SIZE + OFFSET_SIZE + 4
+SEQUENCE_SIZE = 4
+CRC_SIZE = 4
+EXTENT_SIZE = 2 * OFFSET_SIZE
+BLOCK_SIZE_SIZE = 4
+STRONG_HASH_SIZE = 16
+SIGNATURE_PAGE_ENTRIES = 3072
+MIN_DELTA_BLOCK_SIZE = 2 * 1024
+MAX_DELTA_BLOCK_SIZE = 32 * 1024
+DELTA_LITERAL = 0
+DELTA_COPY = 1
+FINGERPRINT_SIZE = 32  # SHA-256 of the whole file content
+FINGERPRINT_MIN_SIZE = 64 * 1024  # smaller files are not fingerprinted, sending them is cheaper than a lookup
+FINGERPRINT_FILTER_BITS = 8 * 1024 * 1024  # Bloom filter of the stored fingerprints, the client keeps one of the same shape
+FINGERPRINT_FILTER_HASHES = 7
+FINGERPRINT_FILTER_PAGE = 32 * 1024  # bytes of the filter in one response
+
+
+class ERequestCode(Enum):
+    REGISTRATION_REQUEST = 1100  # uuid ignored.
+    PUBLIC_KEY_REQUEST = 1101
+    RECONNECT_REQUEST = 1102
+    FILE_SEND_REQUEST = 1103
+    CRC_CHECKED_OK = 1104
+    RETRY_CRC_REQUEST = 1105
+    FAILED_CRC_REQUEST = 1106
+    LIST_FILES_REQUEST = 1107
+    FETCH_RANGE_REQUEST = 1108
+    PACKED_FILES_REQUEST = 1109
+    PIPELINED_FILE_REQUEST = 1110
+    SPARSE_FILE_REQUEST = 1111
+    SIGNATURES_REQUEST = 1112
+    DELTA_FILE_REQUEST = 1113
+    STRIPE_RANGE_REQUEST = 1114
+    STRIPED_FILE_COMMIT = 1115
+    APPEND_FILE_REQUEST = 1116
+    FINGERPRINT_LOOKUP_REQUEST = 1117
+    FINGERPRINT_FILTER_REQUEST = 1118
+
+
+class EResponseCode(Enum):
+    RESPONSE_REGISTRATION_SUCCESSFUL = 2100
+    RESPONSE_REGISTRATION_UNSUCCESSFUL = 2101
+    PUBLIC_KEY_REQUEST_SUCCESSFUL = 2102
+    FILE_RECVIE_SEND_CRC = 2103
+    CONFIRMED_MESSAGE_THANKS = 2104
+    RECONNECT_REQUEST_SUCCESSFUL = 2105
+    RECONNECT_REQUEST_FAILED = 2106
+    GENERIC_ERROR = 2107
+    FILE_LIST = 2108
+    FILE_RANGE = 2109
+    PACKED_FILES_RESULT = 2110
+    FILE_STORED = 2111
+    FILE_SIGNATURES = 2112
+    RANGE_STORED = 2113
+    FINGERPRINT_RESULT = 2114
+    FINGERPRINT_FILTER = 2115
+
+
+class RequestHeader:
+    def __init__(self):
+        self.clientID = b""
+        self.version = DEFAULT_VAL      # 1 byte
+        self.code = DEFAULT_VAL         # 2 bytes
+        self.payloadSize = DEFAULT_VAL  # 4 bytes
+        self.SIZE = CLIENT_ID_SIZE + HEADER_SIZE
+
+    def unpack(self, data):
+        """ little endian unpack request Header """
+        try:
+            self.clientID = struct.unpack(f"<{CLIENT_ID_SIZE}s", data[:CLIENT_ID_SIZE])[0]
+            headerData = data[CLIENT_ID_SIZE:CLIENT_ID_SIZE + HEADER_SIZE]
+            self.version, self.code, self.payloadSize = struct.unpack("<BHL", headerData)
+            return self.validateHeader()
+            # return True
+        except:
+            self.__init__()  # reset values
+            return False
+
+    def validateHeader(self):
+        if self.version != SERVER_VERSION or self.payloadSize == 0:
+            return False
+        return True
+
+
+class ResponseHeader:
+    def __init__(self, code):
+        self.version = SERVER_VERSION
+        self.code = code
+        self.payloadSize = DEFAULT_VAL
+
+    def pack(self):
+        """ little endian response header pack """
+        try:
+            return struct.pack("<BHL", self.version, self.code, self.payloadSize)
+        except:
+            return b""
+
+
+class GenericErrorResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.GENERIC_ERROR.value)
+
+    def pack(self):
+        """ little endian pack response header with error code"""
+        try:
+            data = self.header.pack()
+            return data
+        except:
+            return b""
+
+class ReconnectRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.name = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header and client name """
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.name = struct.unpack(f"<{FILE_NAME_SIZE}s", data[23:23 + FILE_NAME_SIZE])[0]
+            return True
+        except:
+            self.__init__()  # reset values
+            return False
+
+
+class CRCFailedRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header and client file name """
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[CLIENT_HEADER_SIZE:
+                                                                      CLIENT_HEADER_SIZE + FILE_NAME_SIZE])[0]
+            return True
+        except:
+            return b""
+
+
+class ValidateCRCRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header and client file name """
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.header.unpack(data)
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[CLIENT_HEADER_SIZE:
+                                                                      CLIENT_HEADER_SIZE + FILE_NAME_SIZE])[0]
+            return True
+        except:
+            return b""
+
+
+class ConfirmedMessageResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.CONFIRMED_MESSAGE_THANKS.value)
+        self.clientID = b""
+
+    def pack(self):
+        """ little endian pack response header and client ID """
+        try:
+            data = self.header.pack()
+            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
+            return data
+        except:
+            return b""
+
+
+class ReconnectFailedResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.RECONNECT_REQUEST_FAILED)
+        self.clientId = b""
+
+    def pack(self):
+        """ little endian pack response header and client ID """
+        try:
+            data = self.header.pack()
+            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientId)
+            return data
+        except:
+            return b""
+
+
+class FileSendRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.contentSize = b""
+        self.fileName = b""
+        self.fileContent = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header and client file details """
+        if not self.header.unpack(data):
+            return False
+        try:
+            # self.header.unpack(data)
+            contentSizeData = data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + FILE_CONTENT_SIZE]
+            self.contentSize = struct.unpack("<L", contentSizeData)[0]
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[27:27 + FILE_NAME_SIZE])[0]
+            self.fileContent = struct.unpack(f"<{self.contentSize}s", data[27 + FILE_NAME_SIZE:
+                                                                           27 + FILE_NAME_SIZE + self.contentSize])[0]
+            return True
+        except:
+            return False
+
+
+class FileSendResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FILE_RECVIE_SEND_CRC.value)
+        self.clientID = b""
+        self.contentSize = b""
+        self.fileName = b""
+        self.Checksum = b""
+
+    def pack(self):
+        """ little endian pack response header and client file details """
+        try:
+            data = self.header.pack()
+            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
+            data += struct.pack("<L",  self.contentSize)
+            data += struct.pack(f"<{FILE_NAME_SIZE}s", self.fileName)
+            data += struct.pack("<L",  self.Checksum)
+            return data
+        except:
+            return b""
+
+
+class PublicKeyRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.name = b""
+        self.publicKey = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header and client name and public key """
+        if not self.header.unpack(data):
+            return False
+        try:
+            nameData = data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + CLIENT_NAME_SIZE]
+            self.name = str(struct.unpack(f"<{CLIENT_NAME_SIZE}s", nameData)[0].partition(b'\0')[0].decode('utf-8'))
+            publicKeyData = data[
+                            CLIENT_HEADER_SIZE + CLIENT_NAME_SIZE:CLIENT_HEADER_SIZE + CLIENT_NAME_SIZE + PUBLIC_KEY_SIZE]
+            self.publicKey = struct.unpack(f"<{PUBLIC_KEY_SIZE}s", publicKeyData)[0]
+            return True
+        except:
+            return False
+
+
+class PublicKeyResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.PUBLIC_KEY_REQUEST_SUCCESSFUL.value)
+        self.clientID = b""
+        self.AESEncryptedKey = b""
+
+    def pack(self):
+        """ little endian pack response header and client ID and encrypted AES key """
+        try:
+            self.header.payloadSize = len(self.AESEncryptedKey) + CLIENT_ID_SIZE
+            data = self.header.pack()
+            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
+            data += struct.pack(f"<{AES_KEY_SIZE}s", self.AESEncryptedKey)
+            return data
+        except:
+            return b""
+
+
+class RegistrationRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.name = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header and client registration data """
+        if not self.header.unpack(data):
+            return False
+        try:
+
+            # trim the byte array after the nul terminating character.
+            nameData = data[self.header.SIZE:self.header.SIZE + CLIENT_NAME_SIZE]
+            self.name = str(struct.unpack(f"<{CLIENT_NAME_SIZE}s", nameData)[0].partition(b'\0')[0].decode('utf-8'))
+            return True
+        except:
+            return False
+
+
+class RegistrationResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.RESPONSE_REGISTRATION_SUCCESSFUL.value)
+        self.clientID = b""
+
+    def pack(self):
+        """ little endian pack response Header and client ID """
+        try:
+            data = self.header.pack()
+            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
+            return data
+        except:
+            return b""
+
+    def registrationUnsuccessful(self):
+        """ in case that registration was failed """
+        self.header.code = EResponseCode.RESPONSE_REGISTRATION_UNSUCCESSFUL.value
+        try:
+            data = self.header.pack()
+            return data
+        except:
+            return b""
+
+
+class FileListRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.startIndex = DEFAULT_VAL
+
+    def unpack(self, data):
+        """ little endian unpack request header and the index of the first listed file """
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.startIndex = struct.unpack("<L", data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + COUNT_SIZE])[0]
+            return True
+        except:
+            return False
+
+
+class FileListResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FILE_LIST.value)
+        self.total = DEFAULT_VAL
+        self.entries = []  # (file name, size, checksum)
+
+    def pack(self):
+        """ little endian pack response header, the number of files and one page of file entries """
+        try:
+            self.header.payloadSize = 2 * COUNT_SIZE + len(self.entries) * (FILE_NAME_SIZE + OFFSET_SIZE + 4)
+            data = self.header.pack()
+            data += struct.pack("<LL", self.total, len(self.entries))
+            for fileName, size, checksum in self.entries:
+                data += struct.pack(f"<{FILE_NAME_SIZE}sQL", fileName, size, checksum)
+            return data
+        except:
+            return b""
+
+
+class FetchRangeRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+        self.offset = DEFAULT_VAL
+        self.length = DEFAULT_VAL
+
+    def unpack(self, data):
+        """ little endian unpack request header, file name and the requested range """
+        if not self.header.unpack(data):
+            return False
+        try:
+            rangeData = data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + FILE_NAME_SIZE + OFFSET_SIZE + FILE_CONTENT_SIZE]
+            self.fileName, self.offset, self.length = struct.unpack(f"<{FILE_NAME_SIZE}sQL", rangeData)
+            return self.length <= MAX_RANGE_SIZE
+        except:
+            return False
+
+
+class FileRangeResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FILE_RANGE.value)
+        self.offset = DEFAULT_VAL
+        self.plainSize = DEFAULT_VAL
+        self.Checksum = DEFAULT_VAL
+        self.encryptedContent = b""
+
+    def pack(self):
+        """ little endian pack response header, range details and the encrypted range """
+        try:
+            self.header.payloadSize = OFFSET_SIZE + 3 * FILE_CONTENT_SIZE + len(self.encryptedContent)
+            data = self.header.pack()
+            data += struct.pack("<QLLL", self.offset, self.plainSize, self.Checksum, len(self.encryptedContent))
+            data += self.encryptedContent
+            return data
+        except:
+            return b""
+
+
+class PackedFilesRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.contentSize = DEFAULT_VAL
+        self.count = DEFAULT_VAL
+        self.packedContent = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header, the number of packed files and the encrypted container """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + FILE_CONTENT_SIZE + COUNT_SIZE
+            self.contentSize, self.count = struct.unpack("<LL", data[CLIENT_HEADER_SIZE:offset])
+            self.packedContent = data[offset:offset + self.contentSize]
+            return len(self.packedContent) == self.contentSize and 0 < self.count <= PACK_MAX_MEMBERS
+        except:
+            return False
+
+    def entries(self, content):
+        """ split the decrypted container into (file name, content, checksum), the index of the members follows
+        their content. a member with an empty name was not readable by the client and is None """
+        indexStart = len(content) - self.count * PACK_INDEX_ENTRY_SIZE
+        if indexStart < 0:
+            return None
+        members = []
+        offset = 0
+        for i in range(self.count):
+            entry = content[indexStart + i * PACK_INDEX_ENTRY_SIZE:indexStart + (i + 1) * PACK_INDEX_ENTRY_SIZE]
+            fileName, size, checksum = struct.unpack(f"<{FILE_NAME_SIZE}sQL", entry)
+            if offset + size > indexStart:
+                return None
+            fileName = fileName.rstrip(b'\x00')
+            members.append((fileName, content[offset:offset + size], checksum) if fileName else None)
+            offset += size
+        return members if offset == indexStart else None
+
+
+class PackedFilesResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.PACKED_FILES_RESULT.value)
+        self.results = []  # one flag per packed file, true when it was stored
+
+    def pack(self):
+        """ little endian pack response header and the stored flag of every packed file in container order """
+        try:
+            self.header.payloadSize = COUNT_SIZE + len(self.results)
+            data = self.header.pack()
+            data += struct.pack("<L", len(self.results))
+            data += bytes(1 if stored else 0 for stored in self.results)
+            return data
+        except:
+            return b""
+
+
+class PipelinedFileRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.sequence = DEFAULT_VAL
+        self.contentSize = DEFAULT_VAL
+        self.fileName = b""
+        self.fileContent = b""
+        self.Checksum = DEFAULT_VAL
+
+    def unpack(self, data):
+        """ little endian unpack request header, sequence, file details and the client CKsum after the content """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + SEQUENCE_SIZE + FILE_CONTENT_SIZE
+            self.sequence, self.contentSize = struct.unpack("<LL", data[CLIENT_HEADER_SIZE:offset])
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[offset:offset + FILE_NAME_SIZE])[0]
+            offset += FILE_NAME_SIZE
+            self.fileContent = data[offset:offset + self.contentSize]
+            offset += self.contentSize
+            self.Checksum = struct.unpack("<L", data[offset:offset + CRC_SIZE])[0]
+            return len(self.fileContent) == self.contentSize
+        except:
+            return False
+
+
+class FileStoredResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FILE_STORED.value)
+        self.sequence = DEFAULT_VAL
+        self.stored = False
+        self.Checksum = DEFAULT_VAL
+
+    def pack(self):
+        """ little endian pack response header, the sequence of the answered request, stored flag and server CKsum """
+        try:
+            self.header.payloadSize = SEQUENCE_SIZE + 1 + CRC_SIZE
+            data = self.header.pack()
+            data += struct.pack("<LBL", self.sequence, 1 if self.stored else 0, self.Checksum)
+            return data
+        except:
+            return b""
+
+
+class SparseFileRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.contentSize = DEFAULT_VAL
+        self.fileName = b""
+        self.fileSize = DEFAULT_VAL
+        self.extents = []  # (offset, length) of the data in the file, in file order
+        self.fileContent = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header, file details, the extent map and the encrypted data extents """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + FILE_CONTENT_SIZE
+            self.contentSize = struct.unpack("<L", data[CLIENT_HEADER_SIZE:offset])[0]
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[offset:offset + FILE_NAME_SIZE])[0]
+            offset += FILE_NAME_SIZE
+            self.fileSize, count = struct.unpack("<QL", data[offset:offset + OFFSET_SIZE + COUNT_SIZE])
+            offset += OFFSET_SIZE + COUNT_SIZE
+            end = 0
+            self.extents = []
+            for i in range(count):
+                extentOffset, length = struct.unpack("<QQ", data[offset:offset + EXTENT_SIZE])
+                if extentOffset < end or extentOffset + length > self.fileSize:
+                    return False
+                self.extents.append((extentOffset, length))
+                end = extentOffset + length
+                offset += EXTENT_SIZE
+            self.fileContent = data[offset:offset + self.contentSize]
+            return len(self.fileContent) == self.contentSize
+        except:
+            return False
+
+
+class SignaturesRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+        self.startIndex = DEFAULT_VAL
+
+    def unpack(self, data):
+        """ little endian unpack request header, file name and the index of the first signed block """
+        if not self.header.unpack(data):
+            return False
+        try:
+            signaturesData = data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + FILE_NAME_SIZE + COUNT_SIZE]
+            self.fileName, self.startIndex = struct.unpack(f"<{FILE_NAME_SIZE}sL", signaturesData)
+            return True
+        except:
+            return False
+
+
+class FileSignaturesResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FILE_SIGNATURES.value)
+        self.fileSize = DEFAULT_VAL
+        self.blockSize = DEFAULT_VAL
+        self.total = DEFAULT_VAL
+        self.signatures = []  # (weak checksum, strong hash) of the blocks in this page
+
+    def pack(self):
+        """ little endian pack response header, stored file size, block size, number of blocks and one page of signatures """
+        try:
+            self.header.payloadSize = OFFSET_SIZE + BLOCK_SIZE_SIZE + 2 * COUNT_SIZE + len(self.signatures) * (4 + STRONG_HASH_SIZE)
+            data = self.header.pack()
+            data += struct.pack("<QLLL", self.fileSize, self.blockSize, self.total, len(self.signatures))
+            for weak, strong in self.signatures:
+                data += struct.pack(f"<L{STRONG_HASH_SIZE}s", weak, strong)
+            return data
+        except:
+            return b""
+
+
+class DeltaFileRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.contentSize = DEFAULT_VAL
+        self.fileName = b""
+        self.fileSize = DEFAULT_VAL
+        self.blockSize = DEFAULT_VAL
+        self.deltaContent = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header, file details, block size and the encrypted delta ops """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + FILE_CONTENT_SIZE
+            self.contentSize = struct.unpack("<L", data[CLIENT_HEADER_SIZE:offset])[0]
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[offset:offset + FILE_NAME_SIZE])[0]
+            offset += FILE_NAME_SIZE
+            self.fileSize, self.blockSize = struct.unpack("<QL", data[offset:offset + OFFSET_SIZE + BLOCK_SIZE_SIZE])
+            offset += OFFSET_SIZE + BLOCK_SIZE_SIZE
+            self.deltaContent = data[offset:offset + self.contentSize]
+            return len(self.deltaContent) == self.contentSize
+        except:
+            return False
+
+    @staticmethod
+    def ops(content):
+        """ split the decrypted delta into (DELTA_LITERAL, bytes) and (DELTA_COPY, (first block, count)), None if malformed """
+        ops = []
+        offset = 0
+        while offset < len(content):
+            op = content[offset]
+            if op == DELTA_LITERAL and offset + 1 + FILE_CONTENT_SIZE <= len(content):
+                length = struct.unpack("<L", content[offset + 1:offset + 1 + FILE_CONTENT_SIZE])[0]
+                offset += 1 + FILE_CONTENT_SIZE
+                if offset + length > len(content):
+                    return None
+                ops.append((op, content[offset:offset + length]))
+                offset += length
+            elif op == DELTA_COPY and offset + 1 + 2 * COUNT_SIZE <= len(content):
+                ops.append((op, struct.unpack("<LL", content[offset + 1:offset + 1 + 2 * COUNT_SIZE])))
+                offset += 1 + 2 * COUNT_SIZE
+            else:
+                return None
+        return ops
+
+
+class StripeRangeRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+        self.fileSize = DEFAULT_VAL
+        self.offset = DEFAULT_VAL
+        self.plainSize = DEFAULT_VAL
+        self.Checksum = DEFAULT_VAL
+        self.encryptedContent = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header, file details, range details and the encrypted range """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + FILE_NAME_SIZE + 2 * OFFSET_SIZE + 3 * FILE_CONTENT_SIZE
+            self.fileName, self.fileSize, self.offset, self.plainSize, self.Checksum, cipherSize = \
+                struct.unpack(f"<{FILE_NAME_SIZE}sQQLLL", data[CLIENT_HEADER_SIZE:offset])
+            self.encryptedContent = data[offset:offset + cipherSize]
+            return len(self.encryptedContent) == cipherSize and self.plainSize <= MAX_RANGE_SIZE \
+                and self.offset + self.plainSize <= self.fileSize
+        except:
+            return False
+
+
+class RangeStoredResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.RANGE_STORED.value)
+        self.offset = DEFAULT_VAL
+        self.stored = False
+
+    def pack(self):
+        """ little endian pack response header, the offset of the answered range and the stored flag """
+        try:
+            self.header.payloadSize = OFFSET_SIZE + 1
+            data = self.header.pack()
+            data += struct.pack("<QB", self.offset, 1 if self.stored else 0)
+            return data
+        except:
+            return b""
+
+
+class StripedCommitRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+        self.fileSize = DEFAULT_VAL
+
+    def unpack(self, data):
+        """ little endian unpack request header, file name and size of a striped file """
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.fileName, self.fileSize = struct.unpack(f"<{FILE_NAME_SIZE}sQ", data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + FILE_NAME_SIZE + OFFSET_SIZE])
+            return True
+        except:
+            return False
+
+
+class AppendFileRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.contentSize = DEFAULT_VAL
+        self.fileName = b""
+        self.offset = DEFAULT_VAL
+        self.fileContent = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header, file name, the size already stored and the encrypted appended bytes """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + FILE_CONTENT_SIZE
+            self.contentSize = struct.unpack("<L", data[CLIENT_HEADER_SIZE:offset])[0]
+            self.fileName = struct.unpack(f"<{FILE_NAME_SIZE}s", data[offset:offset + FILE_NAME_SIZE])[0]
+            offset += FILE_NAME_SIZE
+            self.offset = struct.unpack("<Q", data[offset:offset + OFFSET_SIZE])[0]
+            offset += OFFSET_SIZE
+            self.fileContent = data[offset:offset + self.contentSize]
+            return len(self.fileContent) == self.contentSize
+        except:
+            return False
+
+
+class FingerprintLookupRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.fileName = b""
+        self.fileSize = DEFAULT_VAL
+        self.fingerprint = b""
+
+    def unpack(self, data):
+        """ little endian unpack request header, file name, file size and the fingerprint of its content """
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = CLIENT_HEADER_SIZE + FILE_NAME_SIZE + OFFSET_SIZE + FINGERPRINT_SIZE
+            self.fileName, self.fileSize, self.fingerprint = \
+                struct.unpack(f"<{FILE_NAME_SIZE}sQ{FINGERPRINT_SIZE}s", data[CLIENT_HEADER_SIZE:offset])
+            return True
+        except:
+            return False
+
+
+class FingerprintResultResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FINGERPRINT_RESULT.value)
+        self.stored = False
+        self.Checksum = DEFAULT_VAL
+
+    def pack(self):
+        """ little endian pack response header, whether the file is now stored for the client and its CKsum """
+        try:
+            self.header.payloadSize = 1 + CRC_SIZE
+            data = self.header.pack()
+            data += struct.pack("<BL", 1 if self.stored else 0, self.Checksum)
+            return data
+        except:
+            return b""
+
+
+class FingerprintFilterRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.offset = DEFAULT_VAL
+
+    def unpack(self, data):
+        """ little endian unpack request header and the offset of the requested page of the filter """
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.offset = struct.unpack("<Q", data[CLIENT_HEADER_SIZE:CLIENT_HEADER_SIZE + OFFSET_SIZE])[0]
+            return self.offset < FINGERPRINT_FILTER_BITS // 8
+        except:
+            return False
+
+
+class FingerprintFilterResponse:
+    def __init__(self):
+        self.header = ResponseHeader(EResponseCode.FINGERPRINT_FILTER.value)
+        self.offset = DEFAULT_VAL
+        self.bits = b""
+
+    def pack(self):
+        """ little endian pack response header, the offset of the page and its bytes of the filter """
+        try:
+            self.header.payloadSize = OFFSET_SIZE + len(self.bits)
+            data = self.header.pack()
+            data += struct.pack("<Q", self.offset) + self.bits
+            return data
+        except:
+            return b""
@@ -1,343 +1,997 @@
-import os
-import uuid
-import zlib
-import socket
-import selectors
-import database
-import protocol
-import datetime
-from pathlib import Path
-from Crypto.Cipher import AES
-from Crypto.PublicKey import RSA
-from Crypto.Cipher import PKCS1_OAEP
-from Crypto.Util.Padding import unpad
-from Crypto.Random import get_random_bytes
-
-
-class Server:
-    DATABASE = 'server.db'
-    PACKET_SIZE = 2048
-    MAX_QUEUE_CONNECTIONS = 10
-    IS_BLOCKING = False
-    CLIENTS_FILES_DIRECTORY = 'clientsFiles'
-
-    def __init__(self, host, port):
-        self.host = host
-        self.port = port
-        self.database = database.Database(Server.DATABASE)
-        self.sel = selectors.DefaultSelector()
-        # client request handle
-        self.requestHandle = {
-            protocol.ERequestCode.REGISTRATION_REQUEST.value: self.handleRegistrationRequest,
-            protocol.ERequestCode.PUBLIC_KEY_REQUEST.value: self.handlePublicKeyRequest,
-            protocol.ERequestCode.FILE_SEND_REQUEST.value: self.handleFileSendRequest,
-            protocol.ERequestCode.RECONNECT_REQUEST.value: self.handleReconnectRequest,
-            protocol.ERequestCode.CRC_CHECKED_OK.value: self.handleCRCOkRequest,
-            protocol.ERequestCode.RETRY_CRC_REQUEST.value:  self.handleRetryCRCRequest,
-            protocol.ERequestCode.FAILED_CRC_REQUEST.value: self.handleFailedCRCRequest
-        }
-
-    def handleFailedCRCRequest(self, conn, data):
-        """ indicate that the file was validated in the 4 time was failed - client stop to send, update the database """
-        print("server handle client failed crc request")
-        currentTime = str(datetime.datetime.now())
-        clientRequest = protocol.ValidateCRCRequest()
-        serverResponse = protocol.ConfirmedMessageResponse()
-        if not clientRequest.unpack(data):
-            return False
-
-        # delete non confirmed file from the local server clients folder
-        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00')
-        filePath = os.path.join(Server.CLIENTS_FILES_DIRECTORY, fileName)
-        filePathLink = Path(filePath)
-        try:
-            # The client file is not verified - delete him from the database and from the local folder
-            filePathLink.unlink()
-            if not self.database.deleteFile(clientRequest.header.clientID.hex(), fileName):
-                return False
-            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
-                return False
-        except:
-            # some problem with the database
-            return False
-        serverResponse.clientID = clientRequest.header.clientID
-        return self.write(conn, serverResponse.pack())
-
-    def handleRetryCRCRequest(self, conn, data):
-        """ indicate that the client try to validate his file content another time - update the database  """
-        print("server handle client retry crc request")
-        currentTime = str(datetime.datetime.now())
-        clientRequest = protocol.ValidateCRCRequest()
-        if not clientRequest.unpack(data):
-            return False
-        try:
-            # update the time for the last client request
-            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
-                return False
-        except:
-            return False
-        return True
-
-    def handleCRCOkRequest(self, conn, data):
-        """ CKsum was verified. update the database and send thanks response """
-        print("server handle client crc request is OK")
-        currentTime = str(datetime.datetime.now())
-        clientRequest = protocol.ValidateCRCRequest()
-        serverResponse = protocol.ConfirmedMessageResponse()
-        if not clientRequest.unpack(data):
-            return False
-
-        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00') + '\x00'
-        try:
-            if not self.database.setVerified(clientRequest.header.clientID.hex(), 1, fileName):
-                return False
-            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
-                return False
-        except:
-            # some problem with the database
-            return False
-        serverResponse.clientID = clientRequest.header.clientID
-        return self.write(conn, serverResponse.pack())
-
-    def handleReconnectRequest(self, conn, data):
-        """ reconnected client, send AES key encrypted with client public key and his client ID """
-        print("server handle client reconnect request")
-        currentTime = str(datetime.datetime.now())
-        clientRequest = protocol.RegistrationRequest()
-        serverResponse = protocol.PublicKeyResponse()  # same like public key response
-        if not clientRequest.unpack(data):
-            return False
-        clientID = clientRequest.header.clientID.hex()
-        try:
-            # validata client details with the database
-            clientName = self.database.getClientName(clientID)
-            print(f"client name is {clientName[0]}")
-            clientPublicKey = self.database.getClientPublicKey(clientID)
-        except:
-            # some problem with the database
-            return False
-        if not clientName or not clientPublicKey or len(clientPublicKey) != protocol.EXCPECTED_CLIENT_PK_SIZE:
-            # reconnect failed
-            serverResponse = protocol.ReconnectFailedResponse()
-            return self.write(conn, serverResponse.pack())
-        else:
-            try:
-                # set the current time when client send the request and try parse AES key
-                if not self.database.setLastSeen(clientID, currentTime):
-                    return False
-                AESKey = self.database.getAESSymmetricKey(clientID)
-            except:
-                # some problem with the database
-                return False
-
-            # encrypt the AES key using the client public key
-            publicKey = RSA.import_key(clientPublicKey)
-            cipher = PKCS1_OAEP.new(publicKey)
-            cipherText = cipher.encrypt(AESKey)
-
-            serverResponse.clientID = clientRequest.header.clientID
-            serverResponse.AESEncryptedKey = cipherText
-            serverResponse.header.code = protocol.EResponseCode.RECONNECT_REQUEST_SUCCESSFUL.value
-            return self.write(conn, serverResponse.pack())
-
-    def handleFileSendRequest(self, conn, data):
-        print("server handle client send file request")
-        currentTime = str(datetime.datetime.now())
-        clientRequest = protocol.FileSendRequest()
-        serverResponse = protocol.FileSendResponse()
-        if not clientRequest.unpack(data):
-            return False
-        clientID = clientRequest.header.clientID.hex()
-        try:
-            self.database.setLastSeen(clientID, currentTime)
-            AESKey = self.database.getAESSymmetricKey(clientID)
-        except:
-            # some problem with the database
-            return False
-
-        # decrypt the client file content
-        IV = b'\x00' * 16
-        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
-
-        content = unpad(decryptor.decrypt(clientRequest.fileContent), 16)
-        # calculate CKsum of the file content
-        crc32 = self.crcChunksCalculate(content)
-
-        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00') + '\x00'
-        filePath = os.path.join(Server.CLIENTS_FILES_DIRECTORY, fileName) + '\x00'
-        try:
-            if not self.database.checkFileExsistence(clientID, fileName):
-                currentFile = database.File(clientID, fileName, filePath, 0)
-                self.database.storeFile(currentFile)
-            else:
-                self.database.setVerified(clientID, 0, fileName)
-                self.database.setLastSeen(clientID, currentTime)
-        except:
-            # some problem with the database
-            return False
-        # create new file for the client in local folder
-        filePath = filePath.rstrip('\x00')
-        with open(filePath, 'wb') as file:
-            file.write(content)
-            file.close()
-
-        serverResponse.clientID = clientRequest.header.clientID
-        serverResponse.contentSize = len(clientRequest.fileContent)
-        serverResponse.fileName = clientRequest.fileName
-        serverResponse.Checksum = crc32
-        serverResponse.header.payloadSize = protocol.PAYLOAD_SIZE_2103R_CODE
-        return self.write(conn, serverResponse.pack())
-
-    def crcChunksCalculate(self, fileContent):
-        """ calculate CKsum on client file content in chunks of 1MB """
-        chunkSize = 1024 * 1024  # 1MB
-        checkSum = 0
-        for i in range(0, len(fileContent), chunkSize):
-            chunk = fileContent[i:i + chunkSize]
-            checkSum = zlib.crc32(chunk, checkSum)
-        return checkSum & 0xffffffff
-
-    def handlePublicKeyRequest(self, conn, data):
-        """ parse client public key and send AES key encrypt with the client public key """
-        print("server handle client public key request")
-        currentTime = str(datetime.datetime.now())
-        clientRequest = protocol.PublicKeyRequest()
-        serverResponse = protocol.PublicKeyResponse()
-        if not clientRequest.unpack(data):
-            print("we can't unpack the client header data")
-            return False
-        try:
-            # here check if the uid that received is the same as this in the database
-            if not self.database.clientIdExists(clientRequest.header.clientID.hex()):
-                return False
-        except:
-            # some problem with the database
-            return False
-
-        # generate AES key for the server and encrypt it with client public key
-        AESKey = get_random_bytes(16)
-
-        # encrypt the server AES key with the client public key
-        publicKey = RSA.import_key(clientRequest.publicKey)
-        cipher = PKCS1_OAEP.new(publicKey)
-        cipherText = cipher.encrypt(AESKey)
-
-        # try to store public key, AES key and update the last seen in the database
-        currentClient = database.Client(clientRequest.header.clientID.hex(), clientRequest.name,
-                                        clientRequest.publicKey, currentTime, AESKey)
-        try:
-            if not self.database.setPublicAndAESKey(currentClient):
-                return False
-            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
-                return False
-        except:
-            # some problem with the database
-            return False
-
-        serverResponse.clientID = clientRequest.header.clientID
-        serverResponse.AESEncryptedKey = cipherText
-        return self.write(conn, serverResponse.pack())
-
-    def handleRegistrationRequest(self, conn, data):
-        """ try to register a new user and save to database """
-        print("server handle client registration request")
-        currentTime = datetime.datetime.now()
-        clientRequest = protocol.RegistrationRequest()
-        serverResponse = protocol.RegistrationResponse()
-        try:
-            if not clientRequest.unpack(data) or not clientRequest.name.isalnum():
-                return False
-            if self.database.clientUsernameExists(clientRequest.name):
-                # registration failed! name is already in the database - registration request failed
-                serverResponse.registrationUnsuccessful()
-                return self.write(conn, serverResponse.pack())
-        except:
-            # some problem with the database
-            return False
-
-        serverResponse.clientID = uuid.uuid4().bytes
-        currentClient = database.Client(serverResponse.clientID.hex(), clientRequest.name, 0, currentTime, 0)
-        if not self.database.storeClient(currentClient):
-            # some error with the database
-            return False
-        serverResponse.header.payloadSize = protocol.CLIENT_ID_SIZE
-        return self.write(conn, serverResponse.pack())
-
-    def read(self, conn, mask):
-        """ read client data header anf after it read the payload in chunks of PACKET_SIZE """
-        # reading the client header first
-        try:
-            data = conn.recv(protocol.CLIENT_HEADER_SIZE)
-        except ConnectionResetError:
-            print("Client closed the connection unexpectedly")
-            self.sel.unregister(conn)
-            conn.close()
-            return
-        requestHeader = protocol.RequestHeader()
-        if data:
-            success = False
-            if not requestHeader.unpack(data):
-                return False
-            else:
-                remaining_payload_size = requestHeader.payloadSize
-                # reading in chunks of 2048
-                while remaining_payload_size > 0:
-                    chunk = conn.recv(min(remaining_payload_size, Server.PACKET_SIZE))
-                    remaining_payload_size -= len(chunk)
-                    data += chunk
-                if requestHeader.code in self.requestHandle.keys():
-                    success = self.requestHandle[requestHeader.code](conn, data)
-            if not success:
-                # send to client generic error response with the details of the failure
-                serverResponse = protocol.GenericErrorResponse()
-                return self.write(conn, serverResponse.pack())
-        else:
-            self.sel.unregister(conn)
-            conn.close()
-            print("connection has been closed!")
-
-    def accept(self, sock, mask):
-        """ accept connection from client """
-        conn, addr = sock.accept()
-        print("client has connected!")
-        # client socket is'nt blocking
-        conn.setblocking(Server.IS_BLOCKING)
-        conn.settimeout(25)
-        self.sel.register(conn, selectors.EVENT_READ, self.read)
-
-    def write(self, conn, data):
-        try:
-            # sending the data in chunks of 2048 bytes
-            data += b'\x00' * (2048 - len(data))
-            conn.sendall(data)
-            print("server response send to client")
-            return True
-        except:
-            return False
-
-    def start(self):
-        """ start listen for connections. contains the main loop, and the database, client folder initialization """
-        try:
-            #
-            self.database.initialize()
-            if not os.path.exists(Server.CLIENTS_FILES_DIRECTORY):
-                os.makedirs(Server.CLIENTS_FILES_DIRECTORY)
-            sock = socket.socket()
-            sock.bind((self.host, self.port))
-            sock.listen(Server.MAX_QUEUE_CONNECTIONS)
-            # server is'nt blocking
-            sock.setblocking(Server.IS_BLOCKING)
-            self.sel.register(sock, selectors.EVENT_READ, self.accept)
-
-        except Exception as e:
-            print(e)
-            return False
-        print(f"Server is listening for connections on port {self.port}..")
-        while True:
-            try:
-                events = self.sel.select()
-                for key, mask in events:
-                    callback = key.data
-                    callback(key.fileobj, mask)
-            except Exception as e:
-                print(f"Server main loop exception: {e}")
+import os
+import uuid
+import zlib
+import socket
+import selectors
+import database
+import protocol
+import utils
+import datetime
+import hashlib
+import itertools
+from pathlib import Path
+from Crypto.Cipher import AES
+from Crypto.PublicKey import RSA
+from Crypto.Cipher import PKCS1_OAEP
+from Crypto.Util.Padding import pad, unpad
+from Crypto.Random import get_random_bytes
+
+
+class Server:
+    DATABASE = 'server.db'
+    PACKET_SIZE = 2048
+    MAX_QUEUE_CONNECTIONS = 10
+    IS_BLOCKING = False
+    CLIENTS_FILES_DIRECTORY = 'clientsFiles'
+    APPEND_STATE_SUFFIX = '.append'
+
+    def __init__(self, host, port):
+        self.host = host
+        self.port = port
+        self.database = database.Database(Server.DATABASE)
+        self.sel = selectors.DefaultSelector()
+        self.stripes = {}  # (client, file name) of a striped upload -> {offset: length} of the ranges stored so far
+        self.fingerprintFilters = {}  # client ID -> Bloom filter of the fingerprints of its files, built at its first filter request
+        # client request handle
+        self.requestHandle = {
+            protocol.ERequestCode.REGISTRATION_REQUEST.value: self.handleRegistrationRequest,
+            protocol.ERequestCode.PUBLIC_KEY_REQUEST.value: self.handlePublicKeyRequest,
+            protocol.ERequestCode.FILE_SEND_REQUEST.value: self.handleFileSendRequest,
+            protocol.ERequestCode.RECONNECT_REQUEST.value: self.handleReconnectRequest,
+            protocol.ERequestCode.CRC_CHECKED_OK.value: self.handleCRCOkRequest,
+            protocol.ERequestCode.RETRY_CRC_REQUEST.value:  self.handleRetryCRCRequest,
+            protocol.ERequestCode.FAILED_CRC_REQUEST.value: self.handleFailedCRCRequest,
+            protocol.ERequestCode.LIST_FILES_REQUEST.value: self.handleListFilesRequest,
+            protocol.ERequestCode.FETCH_RANGE_REQUEST.value: self.handleFetchRangeRequest,
+            protocol.ERequestCode.PACKED_FILES_REQUEST.value: self.handlePackedFilesRequest,
+            protocol.ERequestCode.PIPELINED_FILE_REQUEST.value: self.handlePipelinedFileRequest,
+            protocol.ERequestCode.SPARSE_FILE_REQUEST.value: self.handleSparseFileRequest,
+            protocol.ERequestCode.SIGNATURES_REQUEST.value: self.handleSignaturesRequest,
+            protocol.ERequestCode.DELTA_FILE_REQUEST.value: self.handleDeltaFileRequest,
+            protocol.ERequestCode.STRIPE_RANGE_REQUEST.value: self.handleStripeRangeRequest,
+            protocol.ERequestCode.STRIPED_FILE_COMMIT.value: self.handleStripedFileCommit,
+            protocol.ERequestCode.APPEND_FILE_REQUEST.value: self.handleAppendFileRequest,
+            protocol.ERequestCode.FINGERPRINT_LOOKUP_REQUEST.value: self.handleFingerprintLookupRequest,
+            protocol.ERequestCode.FINGERPRINT_FILTER_REQUEST.value: self.handleFingerprintFilterRequest
+        }
+
+    def handleListFilesRequest(self, conn, data):
+        """ send one page of the verified files stored for the client with their size and CKsum """
+        print("server handle client list files request")
+        clientRequest = protocol.FileListRequest()
+        serverResponse = protocol.FileListResponse()
+        if not clientRequest.unpack(data):
+            return False
+        try:
+            files = self.database.getClientFiles(clientRequest.header.clientID.hex())
+        except:
+            # some problem with the database
+            return False
+        serverResponse.total = len(files)
+        page = files[clientRequest.startIndex:clientRequest.startIndex + protocol.LIST_PAGE_ENTRIES]
+        for fileName, pathName in page:
+            try:
+                size, checkSum = self.crcFileCalculate(pathName.rstrip('\x00'))
+            except OSError:
+                return False
+            serverResponse.entries.append((fileName.rstrip('\x00').encode('utf-8'), size, checkSum))
+        return self.write(conn, serverResponse.pack())
+
+    def handleFetchRangeRequest(self, conn, data):
+        """ send a range of a client file encrypted on its own with the client AES key, with the CKsum of the plain range """
+        clientRequest = protocol.FetchRangeRequest()
+        serverResponse = protocol.FileRangeResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00') + '\x00'
+        try:
+            AESKey = self.database.getAESSymmetricKey(clientID)
+            pathName = self.database.getFilePath(clientID, fileName)
+        except:
+            # some problem with the database
+            return False
+        if not AESKey or not pathName:
+            return False
+        try:
+            with open(pathName.rstrip('\x00'), 'rb') as file:
+                file.seek(clientRequest.offset)
+                content = file.read(clientRequest.length)
+        except OSError:
+            return False
+
+        IV = b'\x00' * 16
+        encryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        serverResponse.offset = clientRequest.offset
+        serverResponse.plainSize = len(content)
+        serverResponse.Checksum = self.crcChunksCalculate(content)
+        serverResponse.encryptedContent = encryptor.encrypt(pad(content, 16))
+        return self.write(conn, serverResponse.pack())
+
+    def handlePackedFilesRequest(self, conn, data):
+        """ unpack a container of small client files, every file whose CKsum matches the index is stored as verified
+        so it needs no CRC round trips, the client sends the rest on their own """
+        print("server handle client packed files request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.PackedFilesRequest()
+        serverResponse = protocol.PackedFilesResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        try:
+            self.database.setLastSeen(clientID, currentTime)
+            AESKey = self.database.getAESSymmetricKey(clientID)
+        except:
+            # some problem with the database
+            return False
+
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        try:
+            content = unpad(decryptor.decrypt(clientRequest.packedContent), 16)
+        except ValueError:
+            return False
+        members = clientRequest.entries(content)
+        if members is None:
+            return False
+        for member in members:
+            serverResponse.results.append(member is not None and self.storeVerifiedFile(clientID, *member))
+        return self.write(conn, serverResponse.pack())
+
+    def handlePipelinedFileRequest(self, conn, data):
+        """ store a client file whose CKsum came with the content, the client does not wait for the answer before
+        sending more so it carries the request sequence """
+        print("server handle client pipelined file request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.PipelinedFileRequest()
+        serverResponse = protocol.FileStoredResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        serverResponse.sequence = clientRequest.sequence
+        try:
+            self.database.setLastSeen(clientID, currentTime)
+            AESKey = self.database.getAESSymmetricKey(clientID)
+        except:
+            # some problem with the database
+            return False
+
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        try:
+            content = unpad(decryptor.decrypt(clientRequest.fileContent), 16)
+        except ValueError:
+            return self.write(conn, serverResponse.pack())
+        serverResponse.Checksum = self.crcChunksCalculate(content)
+        serverResponse.stored = self.storeVerifiedFile(clientID, clientRequest.fileName.rstrip(b'\x00'), content,
+                                                     clientRequest.Checksum)
+        return self.write(conn, serverResponse.pack())
+
+    def storeVerifiedFile(self, clientID, fileName, content, checksum):
+        """ store a file of a packed container or a pipelined upload as verified when its CKsum matches """
+        try:
+            fileName = fileName.decode('utf-8')
+        except UnicodeDecodeError:
+            return False
+        filePath = self.clientFilePath(clientID, fileName)
+        if filePath is None or self.crcChunksCalculate(content) != checksum:
+            return False
+        try:
+            os.makedirs(os.path.dirname(filePath), exist_ok=True)
+            self.database.forgetFingerprint(filePath)
+            with open(filePath, 'wb') as file:
+                file.write(content)
+            if not self.database.checkFileExsistence(clientID, fileName + '\x00'):
+                self.database.storeFile(database.File(clientID, fileName + '\x00', filePath + '\x00', 1))
+            else:
+                self.database.setVerified(clientID, 1, fileName + '\x00')
+            if len(content) >= protocol.FINGERPRINT_MIN_SIZE:
+                self.recordFingerprint(clientID, hashlib.sha256(content).digest(), len(content), filePath)
+        except:
+            return False
+        return True
+
+    @staticmethod
+    def clientFolder(clientID):
+        """ prefix of the local paths of every file of a client """
+        return os.path.join(Server.CLIENTS_FILES_DIRECTORY, clientID) + os.sep
+
+    def clientFilePath(self, clientID, fileName):
+        """ local path of a client file, None if the name would leave the client folder """
+        parts = fileName.replace('\\', '/').split('/')
+        if not fileName or fileName.startswith('/') or ':' in fileName or any(part in ('', '.', '..') for part in parts):
+            return None
+        return os.path.join(Server.CLIENTS_FILES_DIRECTORY, clientID, *parts)
+
+    def handleFailedCRCRequest(self, conn, data):
+        """ indicate that the file was validated in the 4 time was failed - client stop to send, update the database """
+        print("server handle client failed crc request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.ValidateCRCRequest()
+        serverResponse = protocol.ConfirmedMessageResponse()
+        if not clientRequest.unpack(data):
+            return False
+
+        # delete non confirmed file from the local server clients folder
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00')
+        filePath = self.clientFilePath(clientRequest.header.clientID.hex(), fileName)
+        if filePath is None:
+            return False
+        filePathLink = Path(filePath)
+        try:
+            # The client file is not verified - delete him from the database and from the local folder
+            filePathLink.unlink()
+            Path(filePath + Server.APPEND_STATE_SUFFIX).unlink(missing_ok=True)
+            self.database.forgetFingerprint(filePath)
+            if not self.database.deleteFile(clientRequest.header.clientID.hex(), fileName + '\x00'):
+                return False
+            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
+                return False
+        except:
+            # some problem with the database
+            return False
+        serverResponse.clientID = clientRequest.header.clientID
+        return self.write(conn, serverResponse.pack())
+
+    def handleRetryCRCRequest(self, conn, data):
+        """ indicate that the client try to validate his file content another time - update the database  """
+        print("server handle client retry crc request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.ValidateCRCRequest()
+        if not clientRequest.unpack(data):
+            return False
+        try:
+            # update the time for the last client request
+            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
+                return False
+        except:
+            return False
+        return True
+
+    def handleCRCOkRequest(self, conn, data):
+        """ CKsum was verified. update the database and send thanks response """
+        print("server handle client crc request is OK")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.ValidateCRCRequest()
+        serverResponse = protocol.ConfirmedMessageResponse()
+        if not clientRequest.unpack(data):
+            return False
+
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00') + '\x00'
+        try:
+            if not self.database.setVerified(clientRequest.header.clientID.hex(), 1, fileName):
+                return False
+            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
+                return False
+            pathName = self.database.getFilePath(clientRequest.header.clientID.hex(), fileName)
+        except:
+            # some problem with the database
+            return False
+        if pathName:
+            # the verified content may be stored again under other names of the client, its fingerprint is computed here and never taken from a client
+            try:
+                size, fingerprint = self.fingerprintFileCalculate(pathName.rstrip('\x00'))
+                if size >= protocol.FINGERPRINT_MIN_SIZE:
+                    self.recordFingerprint(clientRequest.header.clientID.hex(), fingerprint, size, pathName.rstrip('\x00'))
+            except OSError:
+                pass
+        serverResponse.clientID = clientRequest.header.clientID
+        return self.write(conn, serverResponse.pack())
+
+    def fingerprintFileCalculate(self, filePath):
+        """ size and SHA-256 of a stored file in chunks of 1MB """
+        chunkSize = 1024 * 1024  # 1MB
+        size = 0
+        digest = hashlib.sha256()
+        with open(filePath, 'rb') as file:
+            while True:
+                chunk = file.read(chunkSize)
+                if not chunk:
+                    break
+                size += len(chunk)
+                digest.update(chunk)
+        return size, digest.digest()
+
+    @staticmethod
+    def fingerprintBits(fingerprint):
+        """ bit positions of a fingerprint in the Bloom filter - double hashing on the first 16 bytes of the SHA-256,
+        the client computes the same positions for its copy of the filter """
+        first = int.from_bytes(fingerprint[0:8], 'little')
+        second = int.from_bytes(fingerprint[8:16], 'little') | 1
+        return [((first + i * second) & 0xFFFFFFFFFFFFFFFF) % protocol.FINGERPRINT_FILTER_BITS
+                for i in range(protocol.FINGERPRINT_FILTER_HASHES)]
+
+    def recordFingerprint(self, clientID, fingerprint, size, filePath):
+        """ a verified file may now be stored under another name of the same client by its fingerprint """
+        if self.database.storeFingerprint(fingerprint, size, filePath) and clientID in self.fingerprintFilters:
+            Server.addFingerprint(self.fingerprintFilters[clientID], fingerprint)
+
+    @staticmethod
+    def addFingerprint(fingerprintFilter, fingerprint):
+        """ set the bits of a fingerprint in a Bloom filter """
+        for bit in Server.fingerprintBits(fingerprint):
+            fingerprintFilter[bit >> 3] |= 1 << (bit & 7)
+
+    def clientFingerprintFilter(self, clientID):
+        """ the Bloom filter of the fingerprints of the files of one client. lookups only ever copy files of the
+        client that asks, so neither the filter nor a lookup tells one client what another one stores """
+        if clientID not in self.fingerprintFilters:
+            fingerprintFilter = bytearray(protocol.FINGERPRINT_FILTER_BITS // 8)
+            for fingerprint in self.database.getFingerprints(Server.clientFolder(clientID)):
+                Server.addFingerprint(fingerprintFilter, fingerprint)
+            self.fingerprintFilters[clientID] = fingerprintFilter
+        return self.fingerprintFilters[clientID]
+
+    def copyFingerprinted(self, sourcePath, filePath, fingerprint, size):
+        """ copy a stored file to another path when its content still has the fingerprint, returns its CKsum or
+        None. the copy goes to a temporary file first, a file that changed meanwhile leaves the target untouched.
+        it is a copy, not a link, so an append to one of the files does not change the other """
+        chunkSize = 1024 * 1024  # 1MB
+        tempPath = filePath + '.dedup'
+        digest = hashlib.sha256()
+        checkSum = 0
+        copied = 0
+        try:
+            os.makedirs(os.path.dirname(filePath), exist_ok=True)
+            with open(sourcePath, 'rb') as source, open(tempPath, 'wb') as target:
+                while True:
+                    chunk = source.read(chunkSize)
+                    if not chunk:
+                        break
+                    copied += len(chunk)
+                    digest.update(chunk)
+                    checkSum = zlib.crc32(chunk, checkSum)
+                    target.write(chunk)
+            if copied != size or digest.digest() != fingerprint:
+                os.remove(tempPath)
+                return None
+        except OSError:
+            Path(tempPath).unlink(missing_ok=True)
+            return None
+        return checkSum & 0xffffffff
+
+    def handleFingerprintLookupRequest(self, conn, data):
+        """ the client has a file whose fingerprint may be stored already under another of its names. on a hit the
+        stored content is copied to the client file and recorded as verified, the file is never sent. the files of
+        other clients are never a source - knowing the size and SHA-256 of a file must not be enough to get it """
+        print("server handle client fingerprint lookup request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.FingerprintLookupRequest()
+        serverResponse = protocol.FingerprintResultResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        try:
+            fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00')
+            sourcePaths = self.database.getFingerprintPaths(clientRequest.fingerprint, clientRequest.fileSize, Server.clientFolder(clientID))
+        except:
+            return False
+        filePath = self.clientFilePath(clientID, fileName)
+        if filePath is None:
+            return False
+        for sourcePath in sourcePaths:
+            checkSum = self.copyFingerprinted(sourcePath, filePath, clientRequest.fingerprint, clientRequest.fileSize)
+            if checkSum is None:
+                # the stored file changed since it was fingerprinted
+                self.database.forgetFingerprint(sourcePath)
+                continue
+            if self.registerReceivedFile(clientID, clientRequest.fileName, currentTime) is None:
+                Path(filePath + '.dedup').unlink(missing_ok=True)
+                return False
+            try:
+                os.replace(filePath + '.dedup', filePath)
+                if not self.database.setVerified(clientID, 1, fileName + '\x00'):
+                    return False
+            except OSError:
+                return False
+            self.recordFingerprint(clientID, clientRequest.fingerprint, clientRequest.fileSize, filePath)
+            serverResponse.stored = True
+            serverResponse.Checksum = checkSum
+            break
+        return self.write(conn, serverResponse.pack())
+
+    def handleFingerprintFilterRequest(self, conn, data):
+        """ send one page of the Bloom filter of the fingerprints stored for the client, the client checks its files
+        against it before it asks for a lookup """
+        clientRequest = protocol.FingerprintFilterRequest()
+        serverResponse = protocol.FingerprintFilterResponse()
+        if not clientRequest.unpack(data):
+            return False
+        serverResponse.offset = clientRequest.offset
+        try:
+            fingerprintFilter = self.clientFingerprintFilter(clientRequest.header.clientID.hex())
+        except:
+            return False
+        serverResponse.bits = bytes(fingerprintFilter[clientRequest.offset:clientRequest.offset + protocol.FINGERPRINT_FILTER_PAGE])
+        return self.write(conn, serverResponse.pack())
+
+    def handleReconnectRequest(self, conn, data):
+        """ reconnected client, send AES key encrypted with client public key and his client ID """
+        print("server handle client reconnect request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.RegistrationRequest()
+        serverResponse = protocol.PublicKeyResponse()  # same like public key response
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        try:
+            # validata client details with the database
+            clientName = self.database.getClientName(clientID)
+            print(f"client name is {clientName[0]}")
+            clientPublicKey = self.database.getClientPublicKey(clientID)
+        except:
+            # some problem with the database
+            return False
+        if not clientName or not clientPublicKey or len(clientPublicKey) != protocol.EXCPECTED_CLIENT_PK_SIZE:
+            # reconnect failed
+            serverResponse = protocol.ReconnectFailedResponse()
+            return self.write(conn, serverResponse.pack())
+        else:
+            try:
+                # set the current time when client send the request and try parse AES key
+                if not self.database.setLastSeen(clientID, currentTime):
+                    return False
+                AESKey = self.database.getAESSymmetricKey(clientID)
+            except:
+                # some problem with the database
+                return False
+
+            # encrypt the AES key using the client public key
+            publicKey = RSA.import_key(clientPublicKey)
+            cipher = PKCS1_OAEP.new(publicKey)
+            cipherText = cipher.encrypt(AESKey)
+
+            serverResponse.clientID = clientRequest.header.clientID
+            serverResponse.AESEncryptedKey = cipherText
+            serverResponse.header.code = protocol.EResponseCode.RECONNECT_REQUEST_SUCCESSFUL.value
+            return self.write(conn, serverResponse.pack())
+
+    def handleFileSendRequest(self, conn, data):
+        print("server handle client send file request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.FileSendRequest()
+        serverResponse = protocol.FileSendResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        try:
+            self.database.setLastSeen(clientID, currentTime)
+            AESKey = self.database.getAESSymmetricKey(clientID)
+        except:
+            # some problem with the database
+            return False
+
+        # decrypt the client file content
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+
+        content = unpad(decryptor.decrypt(clientRequest.fileContent), 16)
+        # calculate CKsum of the file content
+        crc32 = self.crcChunksCalculate(content)
+
+        filePath = self.registerReceivedFile(clientID, clientRequest.fileName, currentTime)
+        if filePath is None:
+            return False
+        with open(filePath, 'wb') as file:
+            file.write(content)
+            file.close()
+
+        serverResponse.clientID = clientRequest.header.clientID
+        serverResponse.contentSize = len(clientRequest.fileContent)
+        serverResponse.fileName = clientRequest.fileName
+        serverResponse.Checksum = crc32
+        serverResponse.header.payloadSize = protocol.PAYLOAD_SIZE_2103R_CODE
+        return self.write(conn, serverResponse.pack())
+
+    def handleSparseFileRequest(self, conn, data):
+        """ store a sparse client file - only the data extents were sent, the holes are recreated by seeking
+        over them so the stored file stays sparse. the CKsum covers the whole file, holes read as zeros """
+        print("server handle client sparse file request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.SparseFileRequest()
+        serverResponse = protocol.FileSendResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        try:
+            self.database.setLastSeen(clientID, currentTime)
+            AESKey = self.database.getAESSymmetricKey(clientID)
+        except:
+            # some problem with the database
+            return False
+
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        try:
+            content = unpad(decryptor.decrypt(clientRequest.fileContent), 16)
+        except ValueError:
+            return False
+        if sum(length for _, length in clientRequest.extents) != len(content):
+            return False
+
+        filePath = self.registerReceivedFile(clientID, clientRequest.fileName, currentTime)
+        if filePath is None:
+            return False
+        checkSum = 0
+        end = 0
+        position = 0
+        with open(filePath, 'wb') as file:
+            for offset, length in clientRequest.extents:
+                extent = content[position:position + length]
+                file.seek(offset)
+                file.write(extent)
+                checkSum = zlib.crc32(extent, utils.crc32ZeroExtend(checkSum, offset - end))
+                end = offset + length
+                position += length
+            file.truncate(clientRequest.fileSize)
+        checkSum = utils.crc32ZeroExtend(checkSum, clientRequest.fileSize - end)
+
+        serverResponse.clientID = clientRequest.header.clientID
+        serverResponse.contentSize = len(clientRequest.fileContent)
+        serverResponse.fileName = clientRequest.fileName
+        serverResponse.Checksum = checkSum
+        serverResponse.header.payloadSize = protocol.PAYLOAD_SIZE_2103R_CODE
+        return self.write(conn, serverResponse.pack())
+
+    @staticmethod
+    def deltaBlockSize(fileSize):
+        """ block size for the signatures of a stored file, about the square root of its size in whole KB """
+        blockSize = -(-int(fileSize ** 0.5) // 1024) * 1024
+        return min(max(blockSize, protocol.MIN_DELTA_BLOCK_SIZE), protocol.MAX_DELTA_BLOCK_SIZE)
+
+    @staticmethod
+    def blockSignature(block):
+        """ rsync weak checksum (sum of the bytes and sum of their running sums, both mod 2^16) and truncated SHA-256 """
+        a = sum(block) & 0xffff
+        b = sum(itertools.accumulate(block)) & 0xffff
+        return a | (b << 16), hashlib.sha256(block).digest()[:protocol.STRONG_HASH_SIZE]
+
+    def handleSignaturesRequest(self, conn, data):
+        """ send one page of the block signatures of the verified copy of a client file, only whole blocks are signed """
+        clientRequest = protocol.SignaturesRequest()
+        serverResponse = protocol.FileSignaturesResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00') + '\x00'
+        try:
+            pathName = self.database.getFilePath(clientID, fileName)
+        except:
+            # some problem with the database
+            return False
+        if not pathName:
+            return False
+        try:
+            with open(pathName.rstrip('\x00'), 'rb') as file:
+                fileSize = os.fstat(file.fileno()).st_size
+                blockSize = self.deltaBlockSize(fileSize)
+                total = fileSize // blockSize
+                if total == 0 or clientRequest.startIndex >= total:
+                    return False
+                file.seek(clientRequest.startIndex * blockSize)
+                count = min(total - clientRequest.startIndex, protocol.SIGNATURE_PAGE_ENTRIES)
+                for i in range(count):
+                    serverResponse.signatures.append(self.blockSignature(file.read(blockSize)))
+        except OSError:
+            return False
+        serverResponse.fileSize = fileSize
+        serverResponse.blockSize = blockSize
+        serverResponse.total = total
+        return self.write(conn, serverResponse.pack())
+
+    def handleDeltaFileRequest(self, conn, data):
+        """ rebuild a client file from its delta - literal bytes and copies of blocks of the verified copy. the new
+        file is written next to the old one and replaces it only when complete, the CKsum goes back like for a whole file """
+        print("server handle client delta file request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.DeltaFileRequest()
+        serverResponse = protocol.FileSendResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00') + '\x00'
+        try:
+            self.database.setLastSeen(clientID, currentTime)
+            AESKey = self.database.getAESSymmetricKey(clientID)
+            oldPath = self.database.getFilePath(clientID, fileName)
+        except:
+            # some problem with the database
+            return False
+        if not AESKey or not oldPath:
+            return False
+
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        try:
+            ops = protocol.DeltaFileRequest.ops(unpad(decryptor.decrypt(clientRequest.deltaContent), 16))
+        except ValueError:
+            return False
+        if ops is None:
+            return False
+
+        oldPath = oldPath.rstrip('\x00')
+        tempPath = oldPath + '.delta'
+        checkSum = 0
+        size = 0
+        try:
+            with open(oldPath, 'rb') as old, open(tempPath, 'wb') as file:
+                blockSize = self.deltaBlockSize(os.fstat(old.fileno()).st_size)
+                total = os.fstat(old.fileno()).st_size // blockSize
+                if clientRequest.blockSize != blockSize:
+                    raise ValueError("block size")
+                for op, value in ops:
+                    if op == protocol.DELTA_COPY:
+                        first, count = value
+                        if first + count > total:
+                            raise ValueError("block index")
+                        old.seek(first * blockSize)
+                        for i in range(count):
+                            value = old.read(blockSize)
+                            file.write(value)
+                            checkSum = zlib.crc32(value, checkSum)
+                        size += count * blockSize
+                    else:
+                        file.write(value)
+                        checkSum = zlib.crc32(value, checkSum)
+                        size += len(value)
+            if size != clientRequest.fileSize:
+                raise ValueError("file size")
+        except (OSError, ValueError):
+            if os.path.exists(tempPath):
+                os.remove(tempPath)
+            return False
+
+        filePath = self.registerReceivedFile(clientID, clientRequest.fileName, currentTime)
+        if filePath is None:
+            os.remove(tempPath)
+            return False
+        os.replace(tempPath, filePath)
+
+        serverResponse.clientID = clientRequest.header.clientID
+        serverResponse.contentSize = len(clientRequest.deltaContent)
+        serverResponse.fileName = clientRequest.fileName
+        serverResponse.Checksum = checkSum & 0xffffffff
+        serverResponse.header.payloadSize = protocol.PAYLOAD_SIZE_2103R_CODE
+        return self.write(conn, serverResponse.pack())
+
+    def handleStripeRangeRequest(self, conn, data):
+        """ store one range of a file the client stripes over several connections. ranges arrive in any order on
+        any connection of the client, they are written at their offset into a file next to the stored one """
+        clientRequest = protocol.StripeRangeRequest()
+        serverResponse = protocol.RangeStoredResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00')
+        filePath = self.clientFilePath(clientID, fileName)
+        try:
+            AESKey = self.database.getAESSymmetricKey(clientID)
+        except:
+            # some problem with the database
+            return False
+        if not AESKey or filePath is None:
+            return False
+
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        try:
+            content = unpad(decryptor.decrypt(clientRequest.encryptedContent), 16)
+        except ValueError:
+            return False
+        serverResponse.offset = clientRequest.offset
+        serverResponse.stored = len(content) == clientRequest.plainSize and self.crcChunksCalculate(content) == clientRequest.Checksum
+        if serverResponse.stored:
+            stripePath = filePath + '.stripe'
+            os.makedirs(os.path.dirname(stripePath), exist_ok=True)
+            try:
+                with open(stripePath, 'r+b' if os.path.exists(stripePath) else 'wb') as file:
+                    file.seek(clientRequest.offset)
+                    file.write(content)
+            except OSError:
+                return False
+            self.stripes.setdefault((clientID, fileName), {})[clientRequest.offset] = len(content)
+        return self.write(conn, serverResponse.pack())
+
+    def handleStripedFileCommit(self, conn, data):
+        """ all ranges of a striped file were stored - replace the client file with it and send back the CKsum of
+        the whole file, from here on it is confirmed like a file sent in one piece """
+        print("server handle client striped file commit")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.StripedCommitRequest()
+        serverResponse = protocol.FileSendResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00')
+        ranges = self.stripes.pop((clientID, fileName), {})
+        filePath = self.clientFilePath(clientID, fileName)
+        if filePath is None:
+            return False
+        stripePath = filePath + '.stripe'
+        end = 0
+        for offset in sorted(ranges):
+            if offset != end:
+                break
+            end += ranges[offset]
+        if end != clientRequest.fileSize or not os.path.exists(stripePath):
+            # a range is missing, the client sends the file again
+            if os.path.exists(stripePath):
+                os.remove(stripePath)
+            return False
+
+        if self.registerReceivedFile(clientID, clientRequest.fileName, currentTime) is None:
+            return False
+        try:
+            with open(stripePath, 'r+b') as file:
+                file.truncate(clientRequest.fileSize)
+            os.replace(stripePath, filePath)
+            size, checkSum = self.crcFileCalculate(filePath)
+        except OSError:
+            return False
+
+        serverResponse.clientID = clientRequest.header.clientID
+        serverResponse.contentSize = 0
+        serverResponse.fileName = clientRequest.fileName
+        serverResponse.Checksum = checkSum
+        serverResponse.header.payloadSize = protocol.PAYLOAD_SIZE_2103R_CODE
+        return self.write(conn, serverResponse.pack())
+
+    def appendBase(self, filePath):
+        """ size and CKsum of a stored file. they are kept next to the file after every append, a file that was
+        replaced since is read once to compute them. None if there is no such file """
+        try:
+            stat = os.stat(filePath)
+            with open(filePath + Server.APPEND_STATE_SUFFIX) as state:
+                size, checkSum, modified = (int(value) for value in state.read().split())
+            if size == stat.st_size and modified == stat.st_mtime_ns:
+                return size, checkSum
+        except (OSError, ValueError):
+            pass
+        try:
+            return self.crcFileCalculate(filePath)
+        except OSError:
+            return None
+
+    def handleAppendFileRequest(self, conn, data):
+        """ extend the stored copy of a growing client file with the bytes appended since its last upload. the
+        CKsum of the whole file continues from the one of the stored content, so only the new bytes are read """
+        print("server handle client append file request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.AppendFileRequest()
+        serverResponse = protocol.FileSendResponse()
+        if not clientRequest.unpack(data):
+            return False
+        clientID = clientRequest.header.clientID.hex()
+        fileName = clientRequest.fileName.decode('utf-8').rstrip('\x00')
+        try:
+            self.database.setLastSeen(clientID, currentTime)
+            AESKey = self.database.getAESSymmetricKey(clientID)
+            stored = self.database.checkFileExsistence(clientID, fileName + '\x00')
+        except:
+            # some problem with the database
+            return False
+        filePath = self.clientFilePath(clientID, fileName)
+        if not AESKey or not stored or filePath is None:
+            return False
+
+        IV = b'\x00' * 16
+        decryptor = AES.new(AESKey, AES.MODE_CBC, IV)
+        try:
+            content = unpad(decryptor.decrypt(clientRequest.fileContent), 16)
+        except ValueError:
+            return False
+        # the client appends to the content it uploaded last, anything else is sent whole
+        base = self.appendBase(filePath)
+        if base is None or base[0] != clientRequest.offset:
+            return False
+
+        if self.registerReceivedFile(clientID, clientRequest.fileName, currentTime) is None:
+            return False
+        checkSum = zlib.crc32(content, base[1]) & 0xffffffff
+        try:
+            with open(filePath, 'r+b') as file:
+                file.seek(clientRequest.offset)
+                file.write(content)
+                file.truncate()
+            with open(filePath + Server.APPEND_STATE_SUFFIX, 'w') as state:
+                state.write(f"{clientRequest.offset + len(content)} {checkSum} {os.stat(filePath).st_mtime_ns}")
+        except OSError:
+            return False
+
+        serverResponse.clientID = clientRequest.header.clientID
+        serverResponse.contentSize = len(clientRequest.fileContent)
+        serverResponse.fileName = clientRequest.fileName
+        serverResponse.Checksum = checkSum
+        serverResponse.header.payloadSize = protocol.PAYLOAD_SIZE_2103R_CODE
+        return self.write(conn, serverResponse.pack())
+
+    def registerReceivedFile(self, clientID, rawFileName, currentTime):
+        """ record a received file as not verified yet, returns the local path to write it to or None """
+        fileName = rawFileName.decode('utf-8').rstrip('\x00')
+        filePath = self.clientFilePath(clientID, fileName)
+        if filePath is None:
+            return None
+        fileName += '\x00'
+        try:
+            # the content is replaced, it is fingerprinted again once it is verified
+            self.database.forgetFingerprint(filePath)
+            if not self.database.checkFileExsistence(clientID, fileName):
+                currentFile = database.File(clientID, fileName, filePath + '\x00', 0)
+                self.database.storeFile(currentFile)
+            else:
+                self.database.setVerified(clientID, 0, fileName)
+                self.database.setLastSeen(clientID, currentTime)
+        except:
+            # some problem with the database
+            return None
+        # create new file for the client in local folder, names of a directory backup keep their sub folders
+        os.makedirs(os.path.dirname(filePath), exist_ok=True)
+        return filePath
+
+    def crcChunksCalculate(self, fileContent):
+        """ calculate CKsum on client file content in chunks of 1MB """
+        chunkSize = 1024 * 1024  # 1MB
+        checkSum = 0
+        for i in range(0, len(fileContent), chunkSize):
+            chunk = fileContent[i:i + chunkSize]
+            checkSum = zlib.crc32(chunk, checkSum)
+        return checkSum & 0xffffffff
+
+    def crcFileCalculate(self, filePath):
+        """ calculate size and CKsum of a stored file in chunks of 1MB without loading all of it """
+        chunkSize = 1024 * 1024  # 1MB
+        size = 0
+        checkSum = 0
+        with open(filePath, 'rb') as file:
+            while True:
+                chunk = file.read(chunkSize)
+                if not chunk:
+                    break
+                size += len(chunk)
+                checkSum = zlib.crc32(chunk, checkSum)
+        return size, checkSum & 0xffffffff
+
+    def handlePublicKeyRequest(self, conn, data):
+        """ parse client public key and send AES key encrypt with the client public key """
+        print("server handle client public key request")
+        currentTime = str(datetime.datetime.now())
+        clientRequest = protocol.PublicKeyRequest()
+        serverResponse = protocol.PublicKeyResponse()
+        if not clientRequest.unpack(data):
+            print("we can't unpack the client header data")
+            return False
+        try:
+            # here check if the uid that received is the same as this in the database
+            if not self.database.clientIdExists(clientRequest.header.clientID.hex()):
+                return False
+        except:
+            # some problem with the database
+            return False
+
+        # generate AES key for the server and encrypt it with client public key
+        AESKey = get_random_bytes(16)
+
+        # encrypt the server AES key with the client public key
+        publicKey = RSA.import_key(clientRequest.publicKey)
+        cipher = PKCS1_OAEP.new(publicKey)
+        cipherText = cipher.encrypt(AESKey)
+
+        # try to store public key, AES key and update the last seen in the database
+        currentClient = database.Client(clientRequest.header.clientID.hex(), clientRequest.name,
+                                        clientRequest.publicKey, currentTime, AESKey)
+        try:
+            if not self.database.setPublicAndAESKey(currentClient):
+                return False
+            if not self.database.setLastSeen(clientRequest.header.clientID.hex(), currentTime):
+                return False
+        except:
+            # some problem with the database
+            return False
+
+        serverResponse.clientID = clientRequest.header.clientID
+        serverResponse.AESEncryptedKey = cipherText
+        return self.write(conn, serverResponse.pack())
+
+    def handleRegistrationRequest(self, conn, data):
+        """ try to register a new user and save to database """
+        print("server handle client registration request")
+        currentTime = datetime.datetime.now()
+        clientRequest = protocol.RegistrationRequest()
+        serverResponse = protocol.RegistrationResponse()
+        try:
+            if not clientRequest.unpack(data) or not clientRequest.name.isalnum():
+                return False
+            if self.database.clientUsernameExists(clientRequest.name):
+                # registration failed! name is already in the database - registration request failed
+                serverResponse.registrationUnsuccessful()
+                return self.write(conn, serverResponse.pack())
+        except:
+            # some problem with the database
+            return False
+
+        serverResponse.clientID = uuid.uuid4().bytes
+        currentClient = database.Client(serverResponse.clientID.hex(), clientRequest.name, 0, currentTime, 0)
+        if not self.database.storeClient(currentClient):
+            # some error with the database
+            return False
+        serverResponse.header.payloadSize = protocol.CLIENT_ID_SIZE
+        return self.write(conn, serverResponse.pack())
+
+    def read(self, conn, mask):
+        """ read client data header anf after it read the payload in chunks of PACKET_SIZE """
+        # reading the client header first
+        try:
+            data = conn.recv(protocol.CLIENT_HEADER_SIZE)
+        except ConnectionResetError:
+            print("Client closed the connection unexpectedly")
+            self.sel.unregister(conn)
+            conn.close()
+            return
+        requestHeader = protocol.RequestHeader()
+        if data:
+            success = False
+            if not requestHeader.unpack(data):
+                return False
+            else:
+                remaining_payload_size = requestHeader.payloadSize
+                # reading in chunks of 2048
+                while remaining_payload_size > 0:
+                    chunk = conn.recv(min(remaining_payload_size, Server.PACKET_SIZE))
+                    remaining_payload_size -= len(chunk)
+                    data += chunk
+                if requestHeader.code in self.requestHandle.keys():
+                    success = self.requestHandle[requestHeader.code](conn, data)
+            if not success:
+                # send to client generic error response with the details of the failure
+                serverResponse = protocol.GenericErrorResponse()
+                return self.write(conn, serverResponse.pack())
+        else:
+            self.sel.unregister(conn)
+            conn.close()
+            print("connection has been closed!")
+
+    def accept(self, sock, mask):
+        """ accept connection from client """
+        conn, addr = sock.accept()
+        print("client has connected!")
+        # client socket is'nt blocking
+        conn.setblocking(Server.IS_BLOCKING)
+        conn.settimeout(25)
+        self.sel.register(conn, selectors.EVENT_READ, self.read)
+
+    def write(self, conn, data):
+        try:
+            # sending the data in chunks of 2048 bytes
+            data += b'\x00' * (2048 - len(data))
+            conn.sendall(data)
+            print("server response send to client")
+            return True
+        except:
+            return False
+
+    def start(self):
+        """ start listen for connections. contains the main loop, and the database, client folder initialization """
+        try:
+            #
+            self.database.initialize()
+            if not os.path.exists(Server.CLIENTS_FILES_DIRECTORY):
+                os.makedirs(Server.CLIENTS_FILES_DIRECTORY)
+            sock = socket.socket()
+            sock.bind((self.host, self.port))
+            sock.listen(Server.MAX_QUEUE_CONNECTIONS)
+            # server is'nt blocking
+            sock.setblocking(Server.IS_BLOCKING)
+            self.sel.register(sock, selectors.EVENT_READ, self.accept)
+
+        except Exception as e:
+            print(e)
+            return False
+        print(f"Server is listening for connections on port {self.port}..")
+        while True:
+            try:
+                events = self.sel.select()
+                for key, mask in events:
+                    callback = key.data
+                    callback(key.fileobj, mask)
+            except Exception as e:
+                print(f"Server main loop exception: {e}")
@@ -1,17 +1,54 @@
-def stopServer(err):
-    """ print err and stop script execution """
-    print(f"\nFatal Error: {err}\nBackup Server will halt!")
-    exit(1)
-
-
-def parsePort(filepath):
-    """ parse port """
-    port = None
-    try:
-        with open(filepath, "r") as port_info:
-            port = port_info.readline().strip()
-            port = int(port)
-    except (ValueError, FileNotFoundError):
-        port = None
-    finally:
-        return port
+def gf2MatrixTimes(matrix, vector):
+    """ multiply a 32x32 matrix over GF(2) by a vector """
+    total = 0
+    i = 0
+    while vector:
+        if vector & 1:
+            total ^= matrix[i]
+        vector >>= 1
+        i += 1
+    return total
+
+
+def crc32ZeroExtend(crc, zeros):
+    """ CRC-32 of some data followed by zeros zero bytes from the CRC-32 of the data, without touching the zeros.
+    the zlib crc32_combine operator squaring - the cost depends on log(zeros) and not on zeros """
+    if zeros <= 0:
+        return crc
+    crc ^= 0xffffffff
+    odd = [0xedb88320] + [1 << n for n in range(31)]  # operator for one zero bit
+    even = [gf2MatrixTimes(odd, row) for row in odd]  # two zero bits
+    odd = [gf2MatrixTimes(even, row) for row in even]  # four zero bits
+    while True:
+        even = [gf2MatrixTimes(odd, row) for row in odd]
+        if zeros & 1:
+            crc = gf2MatrixTimes(even, crc)
+        zeros >>= 1
+        if zeros == 0:
+            break
+        odd = [gf2MatrixTimes(even, row) for row in even]
+        if zeros & 1:
+            crc = gf2MatrixTimes(odd, crc)
+        zeros >>= 1
+        if zeros == 0:
+            break
+    return crc ^ 0xffffffff
+
+
+def stopServer(err):
+    """ print err and stop script execution """
+    print(f"\nFatal Error: {err}\nBackup Server will halt!")
+    exit(1)
+
+
+def parsePort(filepath):
+    """ parse port """
+    port = None
+    try:
+        with open(filepath, "r") as port_info:
+            port = port_info.readline().strip()
+            port = int(port)
+    except (ValueError, FileNotFoundError):
+        port = None
+    finally:
+        return port